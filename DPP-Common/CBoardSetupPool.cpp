@@ -0,0 +1,98 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CBoardSetupPool.cpp
+# @brief Implement the pool of threads that sets boards up.
+
+*/
+#include "CBoardSetupPool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <sstream>
+#include <thread>
+
+/**
+ * constructor
+ * @param nThreads - most boards set up at once, 0 is treated as 1.
+ */
+CBoardSetupPool::CBoardSetupPool(unsigned nThreads) :
+    m_nThreads(nThreads ? nThreads : 1), m_wallSeconds(0.0)
+{}
+
+/**
+ * run
+ *    Set up the boards.
+ *
+ * @param nBoards - How many.
+ * @param setup   - Called with each board's index, from a pool thread.
+ * @throw whatever the first board to fail threw.
+ */
+void
+CBoardSetupPool::run(size_t nBoards, std::function<void(size_t)> setup)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    std::vector<std::exception_ptr> failures(nBoards);
+    m_seconds.assign(nBoards, 0.0);
+    std::atomic<size_t> next(0);
+
+    auto worker = [&]() {
+        for (size_t i = next++; i < nBoards; i = next++) {
+            Clock::time_point start = Clock::now();
+            try {
+                setup(i);
+            }
+            catch (...) {
+                failures[i] = std::current_exception();
+            }
+            m_seconds[i] = std::chrono::duration<double>(Clock::now() - start).count();
+        }
+    };
+
+    Clock::time_point start = Clock::now();
+    size_t nThreads = std::min<size_t>(m_nThreads, nBoards);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < nThreads; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();                                // This thread is one of the pool.
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    m_wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    for (size_t i = 0; i < nBoards; i++) {
+        if (failures[i]) std::rethrow_exception(failures[i]);
+    }
+}
+/**
+ * report
+ *    Describe the last run.
+ *
+ * @param what - What the boards are, e.g. "PHA".
+ * @return std::string - one line per board and a total.
+ */
+std::string
+CBoardSetupPool::report(const char* what) const
+{
+    std::ostringstream result;
+    result.setf(std::ios::fixed);
+    result.precision(3);
+    double sum = 0.0;
+    for (size_t i = 0; i < m_seconds.size(); i++) {
+        result << what << " board " << i << " setup " << m_seconds[i] << "s\n";
+        sum += m_seconds[i];
+    }
+    result << m_seconds.size() << ' ' << what << " boards set up in " << m_wallSeconds
+           << "s on " << std::min<size_t>(m_nThreads, m_seconds.size()) << " thread(s), "
+           << sum << "s one after another\n";
+    return result.str();
+}
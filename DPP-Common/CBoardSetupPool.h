@@ -0,0 +1,55 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CBoardSetupPool.h
+# @brief Set up several boards at once on a pool of threads.
+
+*/
+#ifndef CBOARDSETUPPOOL_H
+#define CBOARDSETUPPOOL_H
+
+#include <stddef.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @class CBoardSetupPool
+ *    Opening, resetting, calibrating and programming a board is mostly
+ *    waiting:  round trips over its link and the settling sleeps.  Each
+ *    board has its own handle, so the compound event segments can set
+ *    their boards up at the same time and then start them in order (the
+ *    slaves armed before the master starts) once all are set up.
+ *
+ *    run() calls setup(i) for each board on up to nThreads threads and
+ *    returns when all have finished, which is the barrier before the
+ *    starts.  If any throw, the exception of the first board (in board
+ *    order) that did is rethrown once all have finished, as a serial setup
+ *    would have thrown it.  Boards daisy chained on one link can be set
+ *    up at once as the backend serializes the link's accesses.
+ */
+class CBoardSetupPool
+{
+private:
+    unsigned            m_nThreads;
+    std::vector<double> m_seconds;      // Each board's setup time.
+    double              m_wallSeconds;
+
+public:
+    CBoardSetupPool(unsigned nThreads);
+
+    void run(size_t nBoards, std::function<void(size_t)> setup);
+
+    unsigned                   threads() const     { return m_nThreads; }
+    const std::vector<double>& seconds() const     { return m_seconds; }
+    double                     wallSeconds() const { return m_wallSeconds; }
+    std::string                report(const char* what) const;
+};
+
+#endif
@@ -0,0 +1,282 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CCAENDigitizerBackend.cpp
+# @brief Forward the digitizer backend to the CAEN digitizer library.
+
+*/
+#include "CCAENDigitizerBackend.h"
+#include <CAENDigitizer.h>
+
+// Unless told otherwise, drivers use the CAEN library:
+
+static CCAENDigitizerBackend caenBackend;
+CDigitizerBackend* CDigitizerBackend::m_pDefault(&caenBackend);
+
+/**
+ * getDefault
+ * @return CDigitizerBackend* - the backend new drivers will use.
+ */
+CDigitizerBackend*
+CDigitizerBackend::getDefault()
+{
+    return m_pDefault;
+}
+/**
+ * setDefault
+ *    Set the backend drivers constructed from now on will use.
+ *
+ * @param pBackend - the backend, nullptr restores the CAEN library backend.
+ *                   The caller retains ownership.
+ */
+void
+CDigitizerBackend::setDefault(CDigitizerBackend* pBackend)
+{
+    m_pDefault = pBackend ? pBackend : &caenBackend;
+}
+
+/*------------------------------------------------------------------------------
+ *  Each method is the CAEN_DGTZ_ function of the same name, called with the
+ *  lock of the board's link held:
+ */
+
+/**
+ * openDigitizer
+ *    Also remembers which link the board is on so its calls can be
+ *    serialized with those of the other boards on the link.
+ */
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::openDigitizer(CAEN_DGTZ_ConnectionType linkType, int linkNum, int conetNode,
+    uint32_t vmeBase, int* handle)
+{
+    std::mutex* pLink;
+    {
+        std::lock_guard<std::mutex> guard(m_linksLock);
+        pLink = &m_links[std::make_pair(int(linkType), linkNum)];
+    }
+    std::lock_guard<std::mutex> guard(*pLink);
+    CAEN_DGTZ_ErrorCode status = CAEN_DGTZ_OpenDigitizer(linkType, linkNum, conetNode, vmeBase, handle);
+    if (status == CAEN_DGTZ_Success) {
+        std::lock_guard<std::mutex> guard(m_linksLock);
+        m_boardLinks[*handle] = pLink;
+    }
+    return status;
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::closeDigitizer(int handle)
+{
+    std::mutex& link(linkLock(handle));
+    std::lock_guard<std::mutex> guard(link);
+    CAEN_DGTZ_ErrorCode status = CAEN_DGTZ_CloseDigitizer(handle);
+    {
+        std::lock_guard<std::mutex> guard(m_linksLock);
+        m_boardLinks.erase(handle);
+    }
+    return status;
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::getInfo(int handle, CAEN_DGTZ_BoardInfo_t* info)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_GetInfo(handle, info);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::reset(int handle)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_Reset(handle);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::calibrate(int handle)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_Calibrate(handle);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::readRegister(int handle, uint32_t address, uint32_t* data)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_ReadRegister(handle, address, data);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::writeRegister(int handle, uint32_t address, uint32_t data)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_WriteRegister(handle, address, data);
+}
+/**
+ * setRecordLength
+ *    CAEN_DGTZ_SetRecordLength takes the channel as an optional trailing
+ *    parameter.
+ */
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::setRecordLength(int handle, uint32_t size, int channel)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    if (channel < 0) {
+        return CAEN_DGTZ_SetRecordLength(handle, size);
+    }
+    return CAEN_DGTZ_SetRecordLength(handle, size, channel);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::setAcquisitionMode(int handle, CAEN_DGTZ_AcqMode_t mode)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_SetAcquisitionMode(handle, mode);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::setDPPAcquisitionMode(int handle, CAEN_DGTZ_DPP_AcqMode_t mode, CAEN_DGTZ_DPP_SaveParam_t param)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_SetDPPAcquisitionMode(handle, mode, param);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::setChannelEnableMask(int handle, uint32_t mask)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_SetChannelEnableMask(handle, mask);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::setChannelDCOffset(int handle, uint32_t channel, uint32_t value)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_SetChannelDCOffset(handle, channel, value);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::setChannelPulsePolarity(int handle, uint32_t channel, CAEN_DGTZ_PulsePolarity_t polarity)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_SetChannelPulsePolarity(handle, channel, polarity);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::setDPPParameters(int handle, uint32_t channelMask, void* params)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_SetDPPParameters(handle, channelMask, params);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::setDPPPreTriggerSize(int handle, int channel, uint32_t samples)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_SetDPPPreTriggerSize(handle, channel, samples);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::setIOLevel(int handle, CAEN_DGTZ_IOLevel_t level)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_SetIOLevel(handle, level);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::setDPPEventAggregation(int handle, int threshold, int maxsize)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_SetDPPEventAggregation(handle, threshold, maxsize);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::setMaxNumAggregatesBLT(int handle, uint32_t numAggr)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_SetMaxNumAggregatesBLT(handle, numAggr);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::setRunSynchronizationMode(int handle, CAEN_DGTZ_RunSyncMode_t mode)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_SetRunSynchronizationMode(handle, mode);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::swStartAcquisition(int handle)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_SWStartAcquisition(handle);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::swStopAcquisition(int handle)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_SWStopAcquisition(handle);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::clearData(int handle)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_ClearData(handle);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::mallocReadoutBuffer(int handle, char** buffer, uint32_t* size)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_MallocReadoutBuffer(handle, buffer, size);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::freeReadoutBuffer(char** buffer)
+{
+    return CAEN_DGTZ_FreeReadoutBuffer(buffer);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::mallocDPPEvents(int handle, void** events, uint32_t* allocatedSize)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_MallocDPPEvents(handle, events, allocatedSize);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::freeDPPEvents(int handle, void** events)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_FreeDPPEvents(handle, events);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::mallocDPPWaveforms(int handle, void** waveforms, uint32_t* allocatedSize)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_MallocDPPWaveforms(handle, waveforms, allocatedSize);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::freeDPPWaveforms(int handle, void* waveforms)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_FreeDPPWaveforms(handle, waveforms);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::readData(int handle, CAEN_DGTZ_ReadMode_t mode, char* buffer, uint32_t* bufferSize)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_ReadData(handle, mode, buffer, bufferSize);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::getDPPEvents(int handle, char* buffer, uint32_t bufferSize, void** events, uint32_t* numEvents)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_GetDPPEvents(handle, buffer, bufferSize, events, numEvents);
+}
+CAEN_DGTZ_ErrorCode
+CCAENDigitizerBackend::decodeDPPWaveforms(int handle, void* event, void* waveforms)
+{
+    std::lock_guard<std::mutex> guard(linkLock(handle));
+    return CAEN_DGTZ_DecodeDPPWaveforms(handle, event, waveforms);
+}
+/*------------------------------------------------------------------------------
+ * Private methods.
+ */
+
+/**
+ * linkLock
+ *    Find the mutex that serializes calls on a board's link.
+ *
+ * @param handle - Handle from openDigitizer.
+ * @return std::mutex& - The link's lock.  Handles we didn't open share one
+ *                       lock so the library still sees one call at a time.
+ */
+std::mutex&
+CCAENDigitizerBackend::linkLock(int handle)
+{
+    std::lock_guard<std::mutex> guard(m_linksLock);
+    std::map<int, std::mutex*>::iterator p = m_boardLinks.find(handle);
+    return (p == m_boardLinks.end()) ? m_unknownLink : *(p->second);
+}
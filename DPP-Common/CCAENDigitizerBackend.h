@@ -0,0 +1,96 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CCAENDigitizerBackend.h
+# @brief Digitizer backend that uses the CAEN digitizer library.
+
+*/
+#ifndef CCAENDIGITIZERBACKEND_H
+#define CCAENDIGITIZERBACKEND_H
+
+#include "CDigitizerBackend.h"
+#include <map>
+#include <mutex>
+#include <utility>
+
+/**
+ * @class CCAENDigitizerBackend
+ *    Forwards each backend method to the corresponding CAEN_DGTZ_
+ *    function.  This is the default backend.
+ *
+ *    The library makes no promise about calls on the boards of one link
+ *    (a CONET chain, a USB or VME bridge) overlapping, yet readout threads
+ *    (CDppReadoutThread) and parallel setup (CBoardSetupPool) make such
+ *    calls from different threads.  So each link has a mutex, and every
+ *    call that takes a handle holds the lock of the board's link for the
+ *    duration of the call.  Boards on different links don't wait on each
+ *    other.
+ */
+class CCAENDigitizerBackend : public CDigitizerBackend
+{
+private:
+    std::mutex                                 m_linksLock;    // Guards the two maps.
+    std::map<std::pair<int, int>, std::mutex>  m_links;        // (link type, number) -> lock.
+    std::map<int, std::mutex*>                 m_boardLinks;   // handle -> its link's lock.
+    std::mutex                                 m_unknownLink;  // Handles we didn't open.
+
+public:
+    virtual CAEN_DGTZ_ErrorCode openDigitizer(
+        CAEN_DGTZ_ConnectionType linkType, int linkNum, int conetNode,
+        uint32_t vmeBase, int* handle
+    );
+    virtual CAEN_DGTZ_ErrorCode closeDigitizer(int handle);
+    virtual CAEN_DGTZ_ErrorCode getInfo(int handle, CAEN_DGTZ_BoardInfo_t* info);
+    virtual CAEN_DGTZ_ErrorCode reset(int handle);
+    virtual CAEN_DGTZ_ErrorCode calibrate(int handle);
+
+    virtual CAEN_DGTZ_ErrorCode readRegister(int handle, uint32_t address, uint32_t* data);
+    virtual CAEN_DGTZ_ErrorCode writeRegister(int handle, uint32_t address, uint32_t data);
+
+    virtual CAEN_DGTZ_ErrorCode setRecordLength(int handle, uint32_t size, int channel = -1);
+    virtual CAEN_DGTZ_ErrorCode setAcquisitionMode(int handle, CAEN_DGTZ_AcqMode_t mode);
+    virtual CAEN_DGTZ_ErrorCode setDPPAcquisitionMode(
+        int handle, CAEN_DGTZ_DPP_AcqMode_t mode, CAEN_DGTZ_DPP_SaveParam_t param
+    );
+    virtual CAEN_DGTZ_ErrorCode setChannelEnableMask(int handle, uint32_t mask);
+    virtual CAEN_DGTZ_ErrorCode setChannelDCOffset(int handle, uint32_t channel, uint32_t value);
+    virtual CAEN_DGTZ_ErrorCode setChannelPulsePolarity(
+        int handle, uint32_t channel, CAEN_DGTZ_PulsePolarity_t polarity
+    );
+    virtual CAEN_DGTZ_ErrorCode setDPPParameters(int handle, uint32_t channelMask, void* params);
+    virtual CAEN_DGTZ_ErrorCode setDPPPreTriggerSize(int handle, int channel, uint32_t samples);
+    virtual CAEN_DGTZ_ErrorCode setIOLevel(int handle, CAEN_DGTZ_IOLevel_t level);
+    virtual CAEN_DGTZ_ErrorCode setDPPEventAggregation(int handle, int threshold, int maxsize);
+    virtual CAEN_DGTZ_ErrorCode setMaxNumAggregatesBLT(int handle, uint32_t numAggr);
+    virtual CAEN_DGTZ_ErrorCode setRunSynchronizationMode(int handle, CAEN_DGTZ_RunSyncMode_t mode);
+
+    virtual CAEN_DGTZ_ErrorCode swStartAcquisition(int handle);
+    virtual CAEN_DGTZ_ErrorCode swStopAcquisition(int handle);
+    virtual CAEN_DGTZ_ErrorCode clearData(int handle);
+
+    virtual CAEN_DGTZ_ErrorCode mallocReadoutBuffer(int handle, char** buffer, uint32_t* size);
+    virtual CAEN_DGTZ_ErrorCode freeReadoutBuffer(char** buffer);
+    virtual CAEN_DGTZ_ErrorCode mallocDPPEvents(int handle, void** events, uint32_t* allocatedSize);
+    virtual CAEN_DGTZ_ErrorCode freeDPPEvents(int handle, void** events);
+    virtual CAEN_DGTZ_ErrorCode mallocDPPWaveforms(int handle, void** waveforms, uint32_t* allocatedSize);
+    virtual CAEN_DGTZ_ErrorCode freeDPPWaveforms(int handle, void* waveforms);
+
+    virtual CAEN_DGTZ_ErrorCode readData(
+        int handle, CAEN_DGTZ_ReadMode_t mode, char* buffer, uint32_t* bufferSize
+    );
+    virtual CAEN_DGTZ_ErrorCode getDPPEvents(
+        int handle, char* buffer, uint32_t bufferSize, void** events, uint32_t* numEvents
+    );
+    virtual CAEN_DGTZ_ErrorCode decodeDPPWaveforms(int handle, void* event, void* waveforms);
+
+private:
+    std::mutex& linkLock(int handle);
+};
+
+#endif
@@ -0,0 +1,58 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CConfigurationCache.cpp
+# @brief Implement configuration file versions for CConfigurationCache.
+
+*/
+#include "CConfigurationCache.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fstream>
+
+/**
+ * stat
+ *    Get the modification time and size of a file.
+ *
+ * @param filename - The file.
+ * @return bool - false if the file doesn't exist.
+ */
+bool
+CConfigurationFileVersion::stat(const std::string& filename)
+{
+    struct stat info;
+    if (::stat(filename.c_str(), &info)) return false;
+    s_mtimeNs = static_cast<int64_t>(info.st_mtim.tv_sec)*1000000000 + info.st_mtim.tv_nsec;
+    s_size    = info.st_size;
+    return true;
+}
+/**
+ * hashContents
+ *    FNV-1a hash of the file's contents.
+ *
+ * @param filename - The file.
+ * @return bool - false if it can't be read.
+ */
+bool
+CConfigurationFileVersion::hashContents(const std::string& filename)
+{
+    std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!in) return false;
+
+    uint64_t hash = 14695981039346656037ULL;
+    char     buffer[8192];
+    while (in.read(buffer, sizeof(buffer)) || in.gcount()) {
+        std::streamsize n = in.gcount();
+        for (std::streamsize i = 0; i < n; i++) {
+            hash = (hash ^ static_cast<uint8_t>(buffer[i]))*1099511628211ULL;
+        }
+    }
+    s_hash = hash;
+    return true;
+}
@@ -0,0 +1,146 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CConfigurationCache.h
+# @brief Process wide cache of parsed Compass configuration files.
+
+*/
+#ifndef CCONFIGURATIONCACHE_H
+#define CCONFIGURATIONCACHE_H
+
+#include <stdint.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * @class CConfigurationFileVersion
+ *    Identifies the contents of a configuration file:  its modification
+ *    time and size, which are cheap to get, and a hash of its contents for
+ *    when they change but the contents don't (e.g. the file was saved
+ *    again unchanged).
+ */
+class CConfigurationFileVersion
+{
+public:
+    int64_t  s_mtimeNs;
+    int64_t  s_size;
+    uint64_t s_hash;
+
+    CConfigurationFileVersion() : s_mtimeNs(-1), s_size(-1), s_hash(0) {}
+
+    bool stat(const std::string& filename);
+    bool sameStat(const CConfigurationFileVersion& rhs) const
+    {
+        return (s_mtimeNs == rhs.s_mtimeNs) && (s_size == rhs.s_size);
+    }
+    bool hashContents(const std::string& filename);
+};
+
+/**
+ * @class CConfigurationCache
+ *    Each board's event segment parses the Compass configuration at
+ *    initialize, so with N boards the same file was parsed N times at each
+ *    begin run.  Model is what the file is parsed into (CompassProject for
+ *    PHA boards, PSDParameters for PSD boards); there is one cache per Model
+ *    for the whole process (instance()).  get() parses a file only if it's
+ *    new or its contents changed since it was last parsed, otherwise all
+ *    the boards share the model parsed first.  The models are shared, so
+ *    the boards must not modify them (copy what they'll change).
+ *
+ *    get() may be called from any thread; the first caller for a version
+ *    of a file parses it, the others wait and then share it.
+ */
+template <class Model>
+class CConfigurationCache
+{
+public:
+    typedef std::shared_ptr<Model> ModelPtr;
+
+private:
+    struct Entry {
+        CConfigurationFileVersion s_version;
+        ModelPtr                  s_model;
+    };
+
+    std::mutex                   m_lock;
+    std::map<std::string, Entry> m_entries;   // By file name.
+    uint64_t                     m_parses;
+    uint64_t                     m_hits;
+
+public:
+    CConfigurationCache() : m_parses(0), m_hits(0) {}
+
+    /**
+     * instance
+     * @return CConfigurationCache& - the process' cache of Models.
+     */
+    static CConfigurationCache& instance()
+    {
+        static CConfigurationCache cache;
+        return cache;
+    }
+
+    /**
+     * get
+     *    Get the model of a file, parsing it if necessary.
+     *
+     * @param filename - The configuration file.
+     * @param parse    - Callable: ModelPtr parse(const std::string& filename),
+     *                   may throw, which get() passes on.
+     * @return ModelPtr - the model of the file's current contents.
+     */
+    template <class Parser>
+    ModelPtr get(const std::string& filename, Parser parse)
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        CConfigurationFileVersion   version;
+        if (!version.stat(filename)) {
+            m_entries.erase(filename);
+            return parse(filename);       // Let the parser report the problem.
+        }
+
+        auto p = m_entries.find(filename);
+        if (p != m_entries.end()) {
+            if (version.sameStat(p->second.s_version)) {
+                m_hits++;
+                return p->second.s_model;
+            }
+            if (version.hashContents(filename) &&
+                (version.s_hash == p->second.s_version.s_hash)) {
+                p->second.s_version = version;         // Touched, not changed.
+                m_hits++;
+                return p->second.s_model;
+            }
+        } else {
+            version.hashContents(filename);
+        }
+
+        Entry entry;
+        entry.s_version = version;
+        entry.s_model   = parse(filename);
+        m_parses++;
+        m_entries[filename] = entry;
+        return entry.s_model;
+    }
+    /**
+     * clear
+     *    Forget the models; boards that have them keep them.
+     */
+    void clear()
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_entries.clear();
+    }
+    uint64_t parses() const { return m_parses; }    // Files parsed.
+    uint64_t hits() const   { return m_hits; }      // Parses saved.
+};
+
+#endif
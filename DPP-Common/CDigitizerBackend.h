@@ -0,0 +1,107 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CDigitizerBackend.h
+# @brief Abstract access to a digitizer (CAEN library or simulation).
+
+*/
+#ifndef CDIGITIZERBACKEND_H
+#define CDIGITIZERBACKEND_H
+
+#include <stdint.h>
+#include <CAENDigitizerType.h>
+
+/**
+ * @class CDigitizerBackend
+ *    The readout drivers (CAENPha, CDPpPsdEventSegment, CDppReadoutThread)
+ *    talk to their digitizers only through this interface.  Each method
+ *    has the semantics, parameters and CAEN_DGTZ_ErrorCode returns of the
+ *    CAEN_DGTZ_ function of the same name so that:
+ *    - CCAENDigitizerBackend just forwards to the CAEN library.
+ *    - CSimulatedDigitizer can stand in for a crate of 725/730 boards.
+ *
+ *    The drivers decode the blocks ReadData returns with getDPPEvents
+ *    unless told to use the in tree CDppAggregateParser (see CDppHitStore).
+ *
+ *    Drivers pick up the process wide default backend when they are
+ *    constructed unless told otherwise.  The default is the CAEN library;
+ *    a Readout can call setDefault() in its Skeleton before creating
+ *    event segments to run on e.g. simulated boards.
+ */
+class CDigitizerBackend
+{
+private:
+    static CDigitizerBackend* m_pDefault;
+public:
+    virtual ~CDigitizerBackend() {}
+
+    static CDigitizerBackend* getDefault();
+    static void               setDefault(CDigitizerBackend* pBackend);
+
+    // Connection and identification:
+
+    virtual CAEN_DGTZ_ErrorCode openDigitizer(
+        CAEN_DGTZ_ConnectionType linkType, int linkNum, int conetNode,
+        uint32_t vmeBase, int* handle
+    ) = 0;
+    virtual CAEN_DGTZ_ErrorCode closeDigitizer(int handle) = 0;
+    virtual CAEN_DGTZ_ErrorCode getInfo(int handle, CAEN_DGTZ_BoardInfo_t* info) = 0;
+    virtual CAEN_DGTZ_ErrorCode reset(int handle) = 0;
+    virtual CAEN_DGTZ_ErrorCode calibrate(int handle) = 0;
+
+    // Registers:
+
+    virtual CAEN_DGTZ_ErrorCode readRegister(int handle, uint32_t address, uint32_t* data) = 0;
+    virtual CAEN_DGTZ_ErrorCode writeRegister(int handle, uint32_t address, uint32_t data) = 0;
+
+    // Configuration helpers of the library.  channel < 0 in setRecordLength
+    // means all channels.
+
+    virtual CAEN_DGTZ_ErrorCode setRecordLength(int handle, uint32_t size, int channel = -1) = 0;
+    virtual CAEN_DGTZ_ErrorCode setAcquisitionMode(int handle, CAEN_DGTZ_AcqMode_t mode) = 0;
+    virtual CAEN_DGTZ_ErrorCode setDPPAcquisitionMode(
+        int handle, CAEN_DGTZ_DPP_AcqMode_t mode, CAEN_DGTZ_DPP_SaveParam_t param
+    ) = 0;
+    virtual CAEN_DGTZ_ErrorCode setChannelEnableMask(int handle, uint32_t mask) = 0;
+    virtual CAEN_DGTZ_ErrorCode setChannelDCOffset(int handle, uint32_t channel, uint32_t value) = 0;
+    virtual CAEN_DGTZ_ErrorCode setChannelPulsePolarity(
+        int handle, uint32_t channel, CAEN_DGTZ_PulsePolarity_t polarity
+    ) = 0;
+    virtual CAEN_DGTZ_ErrorCode setDPPParameters(int handle, uint32_t channelMask, void* params) = 0;
+    virtual CAEN_DGTZ_ErrorCode setDPPPreTriggerSize(int handle, int channel, uint32_t samples) = 0;
+    virtual CAEN_DGTZ_ErrorCode setIOLevel(int handle, CAEN_DGTZ_IOLevel_t level) = 0;
+    virtual CAEN_DGTZ_ErrorCode setDPPEventAggregation(int handle, int threshold, int maxsize) = 0;
+    virtual CAEN_DGTZ_ErrorCode setMaxNumAggregatesBLT(int handle, uint32_t numAggr) = 0;
+    virtual CAEN_DGTZ_ErrorCode setRunSynchronizationMode(int handle, CAEN_DGTZ_RunSyncMode_t mode) = 0;
+
+    // Acquisition control:
+
+    virtual CAEN_DGTZ_ErrorCode swStartAcquisition(int handle) = 0;
+    virtual CAEN_DGTZ_ErrorCode swStopAcquisition(int handle) = 0;
+    virtual CAEN_DGTZ_ErrorCode clearData(int handle) = 0;     // Drop what the board buffered.
+
+    // Readout buffers and data:
+
+    virtual CAEN_DGTZ_ErrorCode mallocReadoutBuffer(int handle, char** buffer, uint32_t* size) = 0;
+    virtual CAEN_DGTZ_ErrorCode freeReadoutBuffer(char** buffer) = 0;
+    virtual CAEN_DGTZ_ErrorCode mallocDPPEvents(int handle, void** events, uint32_t* allocatedSize) = 0;
+    virtual CAEN_DGTZ_ErrorCode freeDPPEvents(int handle, void** events) = 0;
+    virtual CAEN_DGTZ_ErrorCode mallocDPPWaveforms(int handle, void** waveforms, uint32_t* allocatedSize) = 0;
+    virtual CAEN_DGTZ_ErrorCode freeDPPWaveforms(int handle, void* waveforms) = 0;
+
+    virtual CAEN_DGTZ_ErrorCode readData(
+        int handle, CAEN_DGTZ_ReadMode_t mode, char* buffer, uint32_t* bufferSize
+    ) = 0;
+    virtual CAEN_DGTZ_ErrorCode getDPPEvents(
+        int handle, char* buffer, uint32_t bufferSize, void** events, uint32_t* numEvents
+    ) = 0;
+    virtual CAEN_DGTZ_ErrorCode decodeDPPWaveforms(int handle, void* event, void* waveforms) = 0;
+};
+
+#endif
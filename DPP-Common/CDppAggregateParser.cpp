@@ -0,0 +1,355 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CDppAggregateParser.cpp
+# @brief Implement the structure of arrays DPP buffer parser.
+
+*/
+#include "CDppAggregateParser.h"
+#include "CDppEventDecoder.h"
+#include "CDigitizerBackend.h"
+#include "DppAggregateFormat.h"
+#include <algorithm>
+
+using namespace DppFormat;
+
+/**
+ * Columns
+ *    Where decodeEvents puts the hits of one channel.  Raw pointers rather
+ *    than the DppHitColumns vectors, whose stores could otherwise alias
+ *    their data pointers as far as the compiler knows.
+ */
+namespace {
+    struct Columns {
+        uint32_t*        s_timeTag;
+        uint16_t*        s_energy;
+        uint16_t*        s_chargeLong;
+        uint16_t*        s_extras;
+        uint32_t*        s_extras2;
+        uint32_t*        s_format;
+        const uint32_t** s_waveforms;
+    };
+}
+
+/**
+ * decodeEvents
+ *    Decode the nEvents events of one couple aggregate into the columns of
+ *    the couple's even (out[0]) and odd (out[1]) channels.  The only data
+ *    dependence is which channel an event goes to; that's an index, not a
+ *    branch.  When WORDS is nonzero it's the event size (and stride) as a
+ *    compile time constant, otherwise the event size is words.
+ *
+ * @param n - Hits already in each channel's columns, updated.
+ */
+template <bool PSD, uint32_t WORDS>
+static void
+decodeEvents(
+    const uint32_t* pEvents, uint32_t words, uint32_t nEvents, uint32_t format,
+    const Columns* out, uint32_t* n
+)
+{
+    const uint32_t stride    = WORDS ? WORDS : words;
+    const bool     extras    = (format & FMT_EXTRAS) != 0;
+    const uint32_t extraWord = extras ? stride - 2 : 0;
+    const uint32_t extraMask = extras ? 0xffffffff : 0;
+    const bool     samples   = (format & FMT_SAMPLES) != 0;
+
+    uint32_t count[2] = {n[0], n[1]};
+    for (uint32_t i = 0; i < nEvents; i++) {
+        const uint32_t* e    = pEvents + i*stride;
+        uint32_t        tag  = e[0];
+        uint32_t        last = e[stride - 1];
+        uint32_t        odd  = tag >> 31;
+        const Columns&  o(out[odd]);
+        uint32_t        k    = count[odd]++;
+
+        o.s_timeTag[k]   = tag & EVT_TIMETAG_MASK;
+        o.s_extras2[k]   = e[extraWord] & extraMask;
+        o.s_format[k]    = format;
+        o.s_waveforms[k] = samples ? e + 1 : nullptr;
+        if (PSD) {
+            o.s_energy[k]     = last & PSD_SHORT_MASK;
+            o.s_chargeLong[k] = last >> PSD_LONG_SHIFT;
+            o.s_extras[k]     = (last & PSD_PUR_BIT) >> 15;
+        } else {
+            o.s_energy[k]     = last & PHA_ENERGY_MASK;
+            o.s_extras[k]     = (last >> PHA_EXTRAS_SHIFT) & PHA_EXTRAS_MASK;
+        }
+    }
+    n[0] = count[0];
+    n[1] = count[1];
+}
+
+/**
+ * constructor
+ *
+ * @param psd      - Parse DPP-PSD rather than DPP-PHA events.
+ * @param capacity - Hits per channel to allocate for up front.  The
+ *                   columns grow as needed regardless.
+ */
+CDppAggregateParser::CDppAggregateParser(bool psd, uint32_t capacity) :
+    m_psd(psd), m_pBackend(nullptr), m_handle(-1)
+{
+    for (int i = 0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
+        m_events[i]           = nullptr;
+        m_nEvents[i]          = 0;
+        m_channels[i].s_nHits = 0;
+        reserveChannel(i, capacity);
+    }
+}
+/**
+ * destructor
+ *    Give the backend back its event arrays, if we have some.  The board
+ *    must still be open.
+ */
+CDppAggregateParser::~CDppAggregateParser()
+{
+    useLibrary(nullptr, -1);
+}
+/**
+ * useLibrary
+ *    Decode with a board's backend (GetDPPEvents) rather than in tree, or
+ *    go back to decoding in tree.  The backend sizes its event arrays for
+ *    the board as it's set up now, so call this after the board has been
+ *    set up.  Any hits we held are forgotten.
+ *
+ * @param pBackend - The board's backend, nullptr to decode in tree.
+ * @param handle   - The board's handle.
+ * @return CAEN_DGTZ_ErrorCode - from the backend's mallocDPPEvents.  If that
+ *                   fails we decode in tree.
+ */
+CAEN_DGTZ_ErrorCode
+CDppAggregateParser::useLibrary(CDigitizerBackend* pBackend, int handle)
+{
+    if (m_pBackend) m_pBackend->freeDPPEvents(m_handle, m_events);
+    m_pBackend = nullptr;
+    m_handle   = -1;
+    for (int i = 0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
+        m_events[i]           = nullptr;
+        m_nEvents[i]          = 0;
+        m_channels[i].s_nHits = 0;
+    }
+    if (!pBackend) return CAEN_DGTZ_Success;
+
+    uint32_t            size;
+    CAEN_DGTZ_ErrorCode status = pBackend->mallocDPPEvents(handle, m_events, &size);
+    if (status != CAEN_DGTZ_Success) return status;
+    m_pBackend = pBackend;
+    m_handle   = handle;
+    return CAEN_DGTZ_Success;
+}
+/**
+ * parse
+ *    Decode the board aggregates in a buffer into the channel columns,
+ *    replacing whatever the previous buffer left there.
+ *
+ * @param buffer     - The readout buffer.
+ * @param bufferSize - Bytes in the buffer.
+ * @return CAEN_DGTZ_ErrorCode - CAEN_DGTZ_InvalidEvent if the buffer is not
+ *                     a sequence of valid aggregates.  The columns then
+ *                     hold what was parsed before the bad aggregate.  With
+ *                     the library it's what GetDPPEvents returned, and the
+ *                     columns are empty on failure.
+ */
+CAEN_DGTZ_ErrorCode
+CDppAggregateParser::parse(const char* buffer, uint32_t bufferSize)
+{
+    for (int i = 0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
+        m_channels[i].s_nHits = 0;
+    }
+    if (m_pBackend) {
+        CAEN_DGTZ_ErrorCode status = m_pBackend->getDPPEvents(
+            m_handle, const_cast<char*>(buffer), bufferSize, m_events, m_nEvents
+        );
+        if (status != CAEN_DGTZ_Success) return status;
+        copyEvents();
+        return CAEN_DGTZ_Success;
+    }
+
+    const uint32_t* p    = reinterpret_cast<const uint32_t*>(buffer);
+    const uint32_t* pEnd = p + bufferSize/sizeof(uint32_t);
+    while (p < pEnd) {
+        if ((p[0] & BOARD_TYPE_MASK) != BOARD_TYPE) return CAEN_DGTZ_InvalidEvent;
+        const uint32_t* pBoardEnd = p + (p[0] & BOARD_SIZE_MASK);
+        if ((pBoardEnd > pEnd) || (pBoardEnd - p < BOARD_HEADER_WORDS)) {
+            return CAEN_DGTZ_InvalidEvent;
+        }
+        uint32_t        mask      = p[1] & BOARD_COUPLE_MASK;
+        const uint32_t* pCouple   = p + BOARD_HEADER_WORDS;
+
+        for (int c = 0; c < CAEN_DGTZ_MAX_CHANNEL/2; c++) {
+            if (!(mask & (1 << c))) continue;
+            if (pCouple + COUPLE_HEADER_WORDS > pBoardEnd) return CAEN_DGTZ_InvalidEvent;
+            uint32_t        coupleWords = pCouple[0] & COUPLE_SIZE_MASK;
+            const uint32_t* pCoupleEnd  = pCouple + coupleWords;
+            uint32_t        format      = pCouple[1];
+            uint32_t        words       = eventWords(format);
+            if ((coupleWords < COUPLE_HEADER_WORDS) || (pCoupleEnd > pBoardEnd)) {
+                return CAEN_DGTZ_InvalidEvent;
+            }
+            if ((coupleWords - COUPLE_HEADER_WORDS) % words) return CAEN_DGTZ_InvalidEvent;
+
+            uint32_t nEvents = (coupleWords - COUPLE_HEADER_WORDS)/words;
+            if (nEvents) {
+                reserveChannel(2*c,     m_channels[2*c].s_nHits + nEvents);
+                reserveChannel(2*c + 1, m_channels[2*c + 1].s_nHits + nEvents);
+                decodeCouple(c, format, pCouple + COUPLE_HEADER_WORDS, nEvents);
+            }
+            pCouple = pCoupleEnd;
+        }
+        p = pBoardEnd;
+    }
+    return CAEN_DGTZ_Success;
+}
+/**
+ * decodeWaveforms
+ *    Unpack the traces of a hit the way CAEN_DGTZ_DecodeDPPWaveforms would.
+ *
+ * @param channel   - The hit's channel.
+ * @param hit       - Index of the hit in the channel's columns.
+ * @param waveforms - CAEN_DGTZ_DPP_PHA/PSD_Waveforms_t allocated by
+ *                    CDppEventDecoder::mallocWaveforms (or the backend).
+ */
+CAEN_DGTZ_ErrorCode
+CDppAggregateParser::decodeWaveforms(int channel, uint32_t hit, void* waveforms) const
+{
+    if (m_pBackend) {
+        void* event = m_psd ?
+            static_cast<void*>(static_cast<CAEN_DGTZ_DPP_PSD_Event_t*>(m_events[channel]) + hit) :
+            static_cast<void*>(static_cast<CAEN_DGTZ_DPP_PHA_Event_t*>(m_events[channel]) + hit);
+        return m_pBackend->decodeDPPWaveforms(m_handle, event, waveforms);
+    }
+    const DppHitColumns& c(m_channels[channel]);
+    uint32_t* pRaw = const_cast<uint32_t*>(c.s_waveforms[hit]);
+    if (m_psd) {
+        CAEN_DGTZ_DPP_PSD_Event_t event;
+        event.Format    = c.s_format[hit];
+        event.Waveforms = pRaw;
+        return CDppEventDecoder::decodeWaveforms(true, &event, waveforms);
+    } else {
+        CAEN_DGTZ_DPP_PHA_Event_t event;
+        event.Format    = c.s_format[hit];
+        event.Waveforms = pRaw;
+        return CDppEventDecoder::decodeWaveforms(false, &event, waveforms);
+    }
+}
+/*-------------------------------------------------------------------
+ * Private methods.
+ */
+
+/**
+ * reserveChannel
+ *    Make sure a channel's columns can hold at least nHits hits.  Growth
+ *    is geometric so a run settles on a size quickly.
+ */
+void
+CDppAggregateParser::reserveChannel(int channel, uint32_t nHits)
+{
+    DppHitColumns& c(m_channels[channel]);
+    if (nHits <= c.s_timeTag.size()) return;
+
+    size_t size = std::max<size_t>(nHits, 2*c.s_timeTag.size());
+    c.s_timeTag.resize(size);
+    c.s_energy.resize(size);
+    c.s_chargeLong.resize(size);                 // Stays zero for PHA.
+    c.s_extras.resize(size);
+    c.s_extras2.resize(size);
+    c.s_format.resize(size);
+    c.s_waveforms.resize(size);
+}
+/**
+ * copyEvents
+ *    Copy the events the backend decoded into the channel columns.  The
+ *    time tags are masked to 31 bits as the in tree parser leaves them.
+ */
+void
+CDppAggregateParser::copyEvents()
+{
+    for (int ch = 0; ch < CAEN_DGTZ_MAX_CHANNEL; ch++) {
+        uint32_t       n = m_nEvents[ch];
+        DppHitColumns& c(m_channels[ch]);
+        reserveChannel(ch, n);
+        if (m_psd) {
+            const CAEN_DGTZ_DPP_PSD_Event_t* e =
+                static_cast<const CAEN_DGTZ_DPP_PSD_Event_t*>(m_events[ch]);
+            for (uint32_t i = 0; i < n; i++) {
+                c.s_timeTag[i]    = e[i].TimeTag & EVT_TIMETAG_MASK;
+                c.s_energy[i]     = e[i].ChargeShort;
+                c.s_chargeLong[i] = e[i].ChargeLong;
+                c.s_extras[i]     = e[i].Pur;
+                c.s_extras2[i]    = e[i].Extras;
+                c.s_format[i]     = e[i].Format;
+                c.s_waveforms[i]  = e[i].Waveforms;
+            }
+        } else {
+            const CAEN_DGTZ_DPP_PHA_Event_t* e =
+                static_cast<const CAEN_DGTZ_DPP_PHA_Event_t*>(m_events[ch]);
+            for (uint32_t i = 0; i < n; i++) {
+                c.s_timeTag[i]   = e[i].TimeTag & EVT_TIMETAG_MASK;
+                c.s_energy[i]    = e[i].Energy;
+                c.s_extras[i]    = e[i].Extras;
+                c.s_extras2[i]   = e[i].Extras2;
+                c.s_format[i]    = e[i].Format;
+                c.s_waveforms[i] = e[i].Waveforms;
+            }
+        }
+        c.s_nHits = n;
+    }
+}
+/**
+ * decodeCouple
+ *    Decode the events of a couple aggregate into its channels' columns,
+ *    picking the decodeEvents specialization for the event size.  The
+ *    columns must already have room for all the events.
+ *
+ * @param couple  - Couple number, channels 2*couple and 2*couple+1.
+ * @param format  - The couple aggregate's format word.
+ * @param pEvents - The first event.
+ * @param nEvents - Number of events.
+ */
+void
+CDppAggregateParser::decodeCouple(
+    int couple, uint32_t format, const uint32_t* pEvents, uint32_t nEvents
+)
+{
+    uint32_t words = eventWords(format);
+    Columns  out[2];
+    uint32_t n[2];
+    for (int i = 0; i < 2; i++) {
+        DppHitColumns& c(m_channels[2*couple + i]);
+        n[i]                = c.s_nHits;
+        out[i].s_timeTag    = c.s_timeTag.data();
+        out[i].s_energy     = c.s_energy.data();
+        out[i].s_chargeLong = c.s_chargeLong.data();
+        out[i].s_extras     = c.s_extras.data();
+        out[i].s_extras2    = c.s_extras2.data();
+        out[i].s_format     = c.s_format.data();
+        out[i].s_waveforms  = c.s_waveforms.data();
+    }
+
+#define DECODE(psd, size) decodeEvents<psd, size>(pEvents, words, nEvents, format, out, n)
+
+    if (m_psd) {
+        switch (words) {
+        case 2:  DECODE(true, 2); break;
+        case 3:  DECODE(true, 3); break;
+        default: DECODE(true, 0); break;
+        }
+    } else {
+        switch (words) {
+        case 2:  DECODE(false, 2); break;
+        case 3:  DECODE(false, 3); break;
+        default: DECODE(false, 0); break;
+        }
+    }
+#undef DECODE
+
+    m_channels[2*couple].s_nHits     = n[0];
+    m_channels[2*couple + 1].s_nHits = n[1];
+}
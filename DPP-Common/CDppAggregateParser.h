@@ -0,0 +1,106 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CDppAggregateParser.h
+# @brief Parse DPP-PHA/PSD readout buffers into per channel hit columns.
+
+*/
+#ifndef CDPPAGGREGATEPARSER_H
+#define CDPPAGGREGATEPARSER_H
+
+#include <stdint.h>
+#include <vector>
+#include <CAENDigitizerType.h>
+
+class CDigitizerBackend;
+
+/**
+ * DppHitColumns
+ *    The hits of one channel from a readout buffer, one array per field
+ *    (structure of arrays) rather than an array of CAEN event structs.
+ *    Only the first s_nHits elements of each column are valid.  The values
+ *    are those CAEN_DGTZ_GetDPPEvents puts in the like named struct fields:
+ *
+ *    | Column        | PHA        | PSD         |
+ *    |---------------|------------|-------------|
+ *    | s_timeTag     | TimeTag    | TimeTag     |
+ *    | s_energy      | Energy     | ChargeShort |
+ *    | s_chargeLong  | 0          | ChargeLong  |
+ *    | s_extras      | Extras     | Pur         |
+ *    | s_extras2     | Extras2    | Extras      |
+ *    | s_format      | Format     | Format      |
+ *    | s_waveforms   | Waveforms  | Waveforms   |
+ */
+struct DppHitColumns {
+    uint32_t                     s_nHits;
+    std::vector<uint32_t>        s_timeTag;      // 31 bit trigger time tag, ticks.
+    std::vector<uint16_t>        s_energy;
+    std::vector<uint16_t>        s_chargeLong;
+    std::vector<uint16_t>        s_extras;
+    std::vector<uint32_t>        s_extras2;
+    std::vector<uint32_t>        s_format;
+    std::vector<const uint32_t*> s_waveforms;    // Samples in the buffer, nullptr if none.
+};
+
+/**
+ * @class CDppAggregateParser
+ *    Turns a readout buffer into DppHitColumns for each channel.
+ *
+ *    After useLibrary() the buffer is decoded by the board's backend
+ *    (CAEN_DGTZ_GetDPPEvents for real boards) into event arrays the parser
+ *    owns, and the events are then copied into the columns.  Traces are
+ *    decoded by the backend as well.  This is what the readout drivers do
+ *    unless told to decode in tree.
+ *
+ *    Otherwise the parser is an in tree replacement for GetDPPEvents.  It
+ *    parses the board and couple aggregates of the buffer (see
+ *    DppAggregateFormat.h) directly into the columns.
+ *
+ *    Every event in a couple aggregate has the same size, so the events of
+ *    each couple aggregate are decoded by a branch free loop with a fixed
+ *    stride straight into the columns of the couple's even and odd
+ *    channels.  For the list mode event sizes (2 and 3 words) the stride
+ *    is a compile time constant.
+ *
+ *    The columns grow as needed and are kept from buffer to buffer so after
+ *    the first few buffers parsing does not allocate.  Waveform samples
+ *    are not copied, s_waveforms points into the buffer, which must live
+ *    as long as the hits are used.
+ */
+class CDppAggregateParser
+{
+private:
+    bool               m_psd;
+    CDigitizerBackend* m_pBackend;          // Decodes for us if not null.
+    int                m_handle;
+    void*              m_events[CAEN_DGTZ_MAX_CHANNEL];    // The backend's event arrays.
+    uint32_t           m_nEvents[CAEN_DGTZ_MAX_CHANNEL];
+    DppHitColumns      m_channels[CAEN_DGTZ_MAX_CHANNEL];
+
+public:
+    CDppAggregateParser(bool psd, uint32_t capacity = 0);
+    ~CDppAggregateParser();
+
+    CAEN_DGTZ_ErrorCode useLibrary(CDigitizerBackend* pBackend, int handle);
+    CAEN_DGTZ_ErrorCode parse(const char* buffer, uint32_t bufferSize);
+
+    bool                 isPsd() const                 { return m_psd; }
+    bool                 usesLibrary() const           { return m_pBackend != nullptr; }
+    uint32_t             hits(int channel) const       { return m_channels[channel].s_nHits; }
+    const DppHitColumns& channel(int channel) const    { return m_channels[channel]; }
+
+    CAEN_DGTZ_ErrorCode  decodeWaveforms(int channel, uint32_t hit, void* waveforms) const;
+
+private:
+    void reserveChannel(int channel, uint32_t nHits);
+    void copyEvents();
+    void decodeCouple(int couple, uint32_t format, const uint32_t* pEvents, uint32_t nEvents);
+};
+
+#endif
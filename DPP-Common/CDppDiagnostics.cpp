@@ -0,0 +1,111 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CDppDiagnostics.cpp
+# @brief Implement the readout anomaly counters.
+
+*/
+#include "CDppDiagnostics.h"
+#include <iostream>
+
+static const char* counterNames[CDppDiagnostics::COUNTERS] = {
+    "fake events", "comm errors", "decode failures", "rejected reads",
+    "oversize events", "rollovers"
+};
+
+/**
+ * constructor
+ *
+ * @param name - Prefixes our log messages e.g. "PHA board 1".
+ */
+CDppDiagnostics::CDppDiagnostics(const std::string& name) :
+    m_name(name)
+{
+    setLogInterval(10);
+    reset();
+}
+/**
+ * setLogInterval
+ *
+ * @param seconds - After the first, log each kind of report at most this often.
+ */
+void
+CDppDiagnostics::setLogInterval(unsigned seconds)
+{
+    m_logInterval = std::chrono::seconds(seconds);
+}
+/**
+ * reset
+ *    Zero the counts e.g. at the start of a run.
+ */
+void
+CDppDiagnostics::reset()
+{
+    for (unsigned i = 0; i < COUNTERS; i++) {
+        for (unsigned c = 0; c <= CHANNELS; c++) {
+            m_counts[i][c].store(0, std::memory_order_relaxed);
+        }
+        m_log[i].s_logged     = false;
+        m_log[i].s_suppressed = 0;
+    }
+}
+/**
+ * total
+ * @return uint64_t - the count over all channels and the board.
+ */
+uint64_t
+CDppDiagnostics::total(Counter which) const
+{
+    uint64_t result = 0;
+    for (unsigned c = 0; c <= CHANNELS; c++) {
+        result += get(which, c);
+    }
+    return result;
+}
+/**
+ * report
+ *    Count one of something and log it unless that's been done within the
+ *    log interval.
+ *
+ * @param which    - What.
+ * @param chan     - The channel, BOARD if none.
+ * @param pMessage - What to log.
+ */
+void
+CDppDiagnostics::report(Counter which, unsigned chan, const char* pMessage)
+{
+    count(which, chan);
+
+    LogState&         log(m_log[which]);
+    Clock::time_point now = Clock::now();
+    if (log.s_logged && (now - log.s_last) < m_logInterval) {
+        log.s_suppressed++;
+        return;
+    }
+    std::cerr << m_name;
+    if (chan != BOARD) std::cerr << " channel " << chan;
+    std::cerr << ": " << pMessage;
+    if (log.s_suppressed) {
+        std::cerr << " (" << log.s_suppressed << " more not logged)";
+    }
+    std::cerr << std::endl;
+
+    log.s_logged     = true;
+    log.s_last       = now;
+    log.s_suppressed = 0;
+}
+/**
+ * name
+ * @return const char* - what a counter counts.
+ */
+const char*
+CDppDiagnostics::name(Counter which)
+{
+    return counterNames[which];
+}
@@ -0,0 +1,104 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CDppDiagnostics.h
+# @brief Per board and channel counts of the readout's anomalies.
+
+*/
+#ifndef CDPPDIAGNOSTICS_H
+#define CDPPDIAGNOSTICS_H
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <CAENDigitizerType.h>
+
+/**
+ * @class CDppDiagnostics
+ *    Writing to the console for every odd hit costs more than reading it.
+ *    The drivers count what goes wrong here instead, per channel or for
+ *    the board as a whole (BOARD):
+ *
+ *    - FAKE_EVENTS     - the 'fake' hits the boards emit at time tag rollovers.
+ *    - COMM_ERRORS     - block transfers that failed.
+ *    - DECODE_FAILURES - blocks or waveforms that couldn't be decoded.
+ *    - REJECTED_READS  - reads that found no hit to format.
+ *    - OVERSIZE_EVENTS - hits too big for the event buffer.
+ *    - ROLLOVERS       - time tag rollovers, from the hit store.
+ *
+ *    Only the readout thread counts, so a count is a relaxed load and store,
+ *    as cheap as a plain increment, and any thread (e.g. the scalers) may
+ *    read them.  report() also logs, but only the first of a kind and then
+ *    at most once per log interval, with the number of those not logged.
+ */
+class CDppDiagnostics
+{
+public:
+    static const unsigned CHANNELS = CAEN_DGTZ_MAX_CHANNEL;
+    static const unsigned BOARD    = CHANNELS;      // Counts not tied to a channel.
+
+    enum Counter {
+        FAKE_EVENTS, COMM_ERRORS, DECODE_FAILURES, REJECTED_READS,
+        OVERSIZE_EVENTS, ROLLOVERS, COUNTERS
+    };
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct LogState {
+        bool              s_logged;
+        Clock::time_point s_last;
+        uint64_t          s_suppressed;   // Reports since s_last not logged.
+    };
+
+    std::string           m_name;         // Prefixes log messages.
+    std::atomic<uint64_t> m_counts[COUNTERS][CHANNELS + 1];
+    LogState              m_log[COUNTERS];
+    Clock::duration       m_logInterval;
+
+public:
+    CDppDiagnostics(const std::string& name = "DPP");
+
+    void setName(const std::string& name)      { m_name = name; }
+    void setLogInterval(unsigned seconds);
+    void reset();
+
+    /**
+     * count
+     *    Count one of something.
+     *
+     * @param which - What.
+     * @param chan  - The channel, BOARD if none.
+     */
+    void count(Counter which, unsigned chan = BOARD)
+    {
+        std::atomic<uint64_t>& c(m_counts[which][chan]);
+        c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    /**
+     * set
+     *    Set a count kept elsewhere (e.g. ROLLOVERS).
+     */
+    void set(Counter which, unsigned chan, uint64_t value)
+    {
+        m_counts[which][chan].store(value, std::memory_order_relaxed);
+    }
+    uint64_t get(Counter which, unsigned chan = BOARD) const
+    {
+        return m_counts[which][chan].load(std::memory_order_relaxed);
+    }
+    uint64_t total(Counter which) const;
+
+    void report(Counter which, unsigned chan, const char* pMessage);
+
+    static const char* name(Counter which);
+};
+
+#endif
@@ -0,0 +1,258 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CDppEventDecoder.cpp
+# @brief Implement the hardware independent DPP buffer decoder.
+
+*/
+#include "CDppEventDecoder.h"
+#include "DppAggregateFormat.h"
+#include <stdlib.h>
+
+using namespace DppFormat;
+
+// Waveform structs are allocated for the longest trace a format word
+// can describe:
+
+static const uint32_t MAX_SAMPLES = FMT_NS_MASK*FMT_NS_UNIT;
+
+/**
+ * isPsd
+ *    The x725/x730 DPP-PSD firmware is AMC release 136.x, DPP-PHA is 139.x.
+ *
+ * @param info - Board information from getInfo.
+ * @return bool - true if the board runs DPP-PSD firmware.
+ */
+bool
+CDppEventDecoder::isPsd(const CAEN_DGTZ_BoardInfo_t& info)
+{
+    return atoi(info.AMC_FirmwareRel) == 136;
+}
+/**
+ * getEvents
+ *    Decode the board aggregates in a buffer into per channel arrays of
+ *    CAEN_DGTZ_DPP_PHA_Event_t or CAEN_DGTZ_DPP_PSD_Event_t.  The Waveforms
+ *    member of each event points at its samples in the buffer.
+ *
+ * @param psd        - PSD rather than PHA structs.
+ * @param buffer     - The readout buffer.
+ * @param bufferSize - Bytes in the buffer.
+ * @param events     - CAEN_DGTZ_MAX_CHANNEL event arrays.  If nullptr the events
+ *                     are only counted.
+ * @param numEvents  - Receives the number of events in each channel.
+ * @param capacity   - Number of events each array can hold.
+ * @return CAEN_DGTZ_ErrorCode - CAEN_DGTZ_InvalidEvent if the buffer is not a
+ *                     sequence of valid aggregates, CAEN_DGTZ_OutOfMemory if
+ *                     a channel has more than capacity events.
+ */
+CAEN_DGTZ_ErrorCode
+CDppEventDecoder::getEvents(
+    bool psd, const char* buffer, uint32_t bufferSize,
+    void** events, uint32_t* numEvents, uint32_t capacity
+)
+{
+    for (int i = 0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
+        numEvents[i] = 0;
+    }
+    const uint32_t* p    = reinterpret_cast<const uint32_t*>(buffer);
+    const uint32_t* pEnd = p + bufferSize/sizeof(uint32_t);
+    while (p < pEnd) {
+        if ((p[0] & BOARD_TYPE_MASK) != BOARD_TYPE) return CAEN_DGTZ_InvalidEvent;
+        const uint32_t* pBoardEnd = p + (p[0] & BOARD_SIZE_MASK);
+        uint32_t        mask      = p[1] & BOARD_COUPLE_MASK;
+        const uint32_t* pCouple   = p + BOARD_HEADER_WORDS;
+        if ((pBoardEnd > pEnd) || (pBoardEnd <= p)) return CAEN_DGTZ_InvalidEvent;
+
+        for (int c = 0; c < CAEN_DGTZ_MAX_CHANNEL/2; c++) {
+            if (!(mask & (1 << c))) continue;
+            const uint32_t* pCoupleEnd = pCouple + (pCouple[0] & COUPLE_SIZE_MASK);
+            uint32_t        format     = pCouple[1];
+            uint32_t        nWords     = eventWords(format);
+            if (pCoupleEnd > pBoardEnd) return CAEN_DGTZ_InvalidEvent;
+
+            for (const uint32_t* e = pCouple + COUPLE_HEADER_WORDS;
+                 e + nWords <= pCoupleEnd; e += nWords) {
+                int ch = 2*c + ((e[0] & EVT_ODD_CHANNEL) ? 1 : 0);
+                if (!events) {
+                    numEvents[ch]++;
+                    continue;
+                }
+                if (numEvents[ch] >= capacity) return CAEN_DGTZ_OutOfMemory;
+                uint32_t* pWf   = (format & FMT_SAMPLES) ? const_cast<uint32_t*>(e + 1) : nullptr;
+                uint32_t  last  = e[nWords - 1];
+                uint32_t  extra = (format & FMT_EXTRAS) ? e[nWords - 2] : 0;
+                if (!psd) {
+                    CAEN_DGTZ_DPP_PHA_Event_t& evt(
+                        static_cast<CAEN_DGTZ_DPP_PHA_Event_t*>(events[ch])[numEvents[ch]]
+                    );
+                    evt.Format    = format;
+                    evt.TimeTag   = e[0] & EVT_TIMETAG_MASK;
+                    evt.Energy    = last & PHA_ENERGY_MASK;
+                    evt.Extras    = (last >> PHA_EXTRAS_SHIFT) & PHA_EXTRAS_MASK;
+                    evt.Waveforms = pWf;
+                    evt.Extras2   = extra;
+                } else {
+                    CAEN_DGTZ_DPP_PSD_Event_t& evt(
+                        static_cast<CAEN_DGTZ_DPP_PSD_Event_t*>(events[ch])[numEvents[ch]]
+                    );
+                    evt.Format      = format;
+                    evt.Format2     = 0;
+                    evt.TimeTag     = e[0] & EVT_TIMETAG_MASK;
+                    evt.ChargeShort = last & PSD_SHORT_MASK;
+                    evt.ChargeLong  = last >> PSD_LONG_SHIFT;
+                    evt.Baseline    = 0;
+                    evt.Pur         = (last & PSD_PUR_BIT) ? 1 : 0;
+                    evt.Waveforms   = pWf;
+                    evt.Extras      = extra;
+                }
+                numEvents[ch]++;
+            }
+            pCouple = pCoupleEnd;
+        }
+        p = pBoardEnd;
+    }
+    return CAEN_DGTZ_Success;
+}
+/**
+ * decodeWaveforms
+ *    Unpack the samples of a hit into traces.  Dual trace samples
+ *    alternate between trace 1 and trace 2.
+ *
+ * @param psd       - PSD rather than PHA structs.
+ * @param event     - Event decoded by getEvents.
+ * @param waveforms - Waveform struct allocated by mallocWaveforms.
+ */
+CAEN_DGTZ_ErrorCode
+CDppEventDecoder::decodeWaveforms(bool psd, const void* event, void* waveforms)
+{
+    uint32_t  format;
+    uint32_t* pRaw;
+    if (!psd) {
+        const CAEN_DGTZ_DPP_PHA_Event_t* pEvt = static_cast<const CAEN_DGTZ_DPP_PHA_Event_t*>(event);
+        format = pEvt->Format;
+        pRaw   = pEvt->Waveforms;
+    } else {
+        const CAEN_DGTZ_DPP_PSD_Event_t* pEvt = static_cast<const CAEN_DGTZ_DPP_PSD_Event_t*>(event);
+        format = pEvt->Format;
+        pRaw   = pEvt->Waveforms;
+    }
+    uint32_t  ns      = pRaw ? samplesPerTrace(format) : 0;
+    bool      dual    = (format & FMT_DUAL_TRACE) != 0;
+    uint16_t* samples = reinterpret_cast<uint16_t*>(pRaw);
+    int       stride  = dual ? 2 : 1;
+
+    if (!psd) {
+        CAEN_DGTZ_DPP_PHA_Waveforms_t* pWf = static_cast<CAEN_DGTZ_DPP_PHA_Waveforms_t*>(waveforms);
+        pWf->Ns        = ns;
+        pWf->DualTrace = dual ? 1 : 0;
+        pWf->VProbe1   = (format >> FMT_PROBE1_SHIFT) & FMT_PROBE1_MASK;
+        pWf->VProbe2   = (format >> PHA_FMT_PROBE2_SHIFT) & PHA_FMT_PROBE2_MASK;
+        pWf->VDProbe   = (format >> PHA_FMT_DPROBE_SHIFT) & PHA_FMT_DPROBE_MASK;
+        for (uint32_t i = 0; i < ns; i++) {
+            uint16_t s      = samples[stride*i];
+            pWf->Trace1[i]  = s & SAMPLE_MASK;
+            pWf->Trace2[i]  = dual ? (samples[stride*i + 1] & SAMPLE_MASK) : 0;
+            pWf->DTrace1[i] = (s >> 14) & 1;
+            pWf->DTrace2[i] = (s >> 15) & 1;
+        }
+    } else {
+        CAEN_DGTZ_DPP_PSD_Waveforms_t* pWf = static_cast<CAEN_DGTZ_DPP_PSD_Waveforms_t*>(waveforms);
+        pWf->Ns        = ns;
+        pWf->dualTrace = dual ? 1 : 0;
+        pWf->anlgProbe = (format >> FMT_PROBE1_SHIFT) & FMT_PROBE1_MASK;
+        pWf->dgtProbe1 = (format >> PSD_FMT_DPROBE1_SHIFT) & PSD_FMT_DPROBE_MASK;
+        pWf->dgtProbe2 = (format >> PSD_FMT_DPROBE2_SHIFT) & PSD_FMT_DPROBE_MASK;
+        for (uint32_t i = 0; i < ns; i++) {
+            uint16_t s      = samples[stride*i];
+            pWf->Trace1[i]  = s & SAMPLE_MASK;
+            pWf->Trace2[i]  = dual ? (samples[stride*i + 1] & SAMPLE_MASK) : 0;
+            pWf->DTrace1[i] = (s >> 14) & 1;
+            pWf->DTrace2[i] = (s >> 15) & 1;
+        }
+    }
+    return CAEN_DGTZ_Success;
+}
+/**
+ * mallocEvents
+ *    Allocate capacity events of the firmware's type for each channel.
+ *
+ * @param psd           - PSD rather than PHA structs.
+ * @param capacity      - events per channel.
+ * @param events        - Receives the CAEN_DGTZ_MAX_CHANNEL arrays.
+ * @param allocatedSize - Receives the total bytes allocated.
+ */
+CAEN_DGTZ_ErrorCode
+CDppEventDecoder::mallocEvents(bool psd, uint32_t capacity, void** events, uint32_t* allocatedSize)
+{
+    size_t eventSize = psd ? sizeof(CAEN_DGTZ_DPP_PSD_Event_t) : sizeof(CAEN_DGTZ_DPP_PHA_Event_t);
+
+    *allocatedSize = 0;
+    for (int i = 0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
+        events[i] = calloc(capacity, eventSize);
+        if (!events[i]) {
+            freeEvents(events);
+            return CAEN_DGTZ_OutOfMemory;
+        }
+        *allocatedSize += capacity*eventSize;
+    }
+    return CAEN_DGTZ_Success;
+}
+void
+CDppEventDecoder::freeEvents(void** events)
+{
+    for (int i = 0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
+        free(events[i]);
+        events[i] = nullptr;
+    }
+}
+/**
+ * mallocWaveforms
+ *    The waveform struct is allocated along with traces big enough for
+ *    the longest trace the format can describe, so decoding never needs to
+ *    know what the record length was at allocation time.
+ *
+ * @param psd           - PSD rather than PHA structs.
+ * @param waveforms     - Receives the struct pointer.
+ * @param allocatedSize - Receives the bytes allocated.
+ */
+CAEN_DGTZ_ErrorCode
+CDppEventDecoder::mallocWaveforms(bool psd, void** waveforms, uint32_t* allocatedSize)
+{
+    if (!psd) {
+        size_t size = sizeof(CAEN_DGTZ_DPP_PHA_Waveforms_t) + MAX_SAMPLES*(2*sizeof(int16_t) + 2);
+        char* p = static_cast<char*>(calloc(1, size));
+        if (!p) return CAEN_DGTZ_OutOfMemory;
+        CAEN_DGTZ_DPP_PHA_Waveforms_t* pWf = reinterpret_cast<CAEN_DGTZ_DPP_PHA_Waveforms_t*>(p);
+        pWf->Trace1  = reinterpret_cast<int16_t*>(p + sizeof(CAEN_DGTZ_DPP_PHA_Waveforms_t));
+        pWf->Trace2  = pWf->Trace1 + MAX_SAMPLES;
+        pWf->DTrace1 = reinterpret_cast<uint8_t*>(pWf->Trace2 + MAX_SAMPLES);
+        pWf->DTrace2 = pWf->DTrace1 + MAX_SAMPLES;
+        *waveforms     = pWf;
+        *allocatedSize = size;
+    } else {
+        size_t size = sizeof(CAEN_DGTZ_DPP_PSD_Waveforms_t) + MAX_SAMPLES*(2*sizeof(uint16_t) + 4);
+        char* p = static_cast<char*>(calloc(1, size));
+        if (!p) return CAEN_DGTZ_OutOfMemory;
+        CAEN_DGTZ_DPP_PSD_Waveforms_t* pWf = reinterpret_cast<CAEN_DGTZ_DPP_PSD_Waveforms_t*>(p);
+        pWf->Trace1  = reinterpret_cast<uint16_t*>(p + sizeof(CAEN_DGTZ_DPP_PSD_Waveforms_t));
+        pWf->Trace2  = pWf->Trace1 + MAX_SAMPLES;
+        pWf->DTrace1 = reinterpret_cast<uint8_t*>(pWf->Trace2 + MAX_SAMPLES);
+        pWf->DTrace2 = pWf->DTrace1 + MAX_SAMPLES;
+        pWf->DTrace3 = pWf->DTrace2 + MAX_SAMPLES;
+        pWf->DTrace4 = pWf->DTrace3 + MAX_SAMPLES;
+        *waveforms     = pWf;
+        *allocatedSize = size;
+    }
+    return CAEN_DGTZ_Success;
+}
+void
+CDppEventDecoder::freeWaveforms(void* waveforms)
+{
+    free(waveforms);
+}
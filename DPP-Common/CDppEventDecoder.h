@@ -0,0 +1,50 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CDppEventDecoder.h
+# @brief Decode DPP-PHA/PSD readout buffers into the CAEN library structs.
+
+*/
+#ifndef CDPPEVENTDECODER_H
+#define CDPPEVENTDECODER_H
+
+#include <stdint.h>
+#include <CAENDigitizerType.h>
+
+/**
+ * @class CDppEventDecoder
+ *    Does what CAEN_DGTZ_GetDPPEvents and CAEN_DGTZ_DecodeDPPWaveforms do,
+ *    and allocates the structs they fill, without needing an open board.
+ *    The buffers are parsed per DppAggregateFormat.h.  Backends with no
+ *    hardware behind them (CSimulatedDigitizer, CReplayDigitizer) use this
+ *    to hand the drivers the structs they'd get from the CAEN library.
+ *
+ *    psd selects CAEN_DGTZ_DPP_PSD_Event_t/Waveforms_t rather than the
+ *    PHA structs throughout.
+ */
+class CDppEventDecoder
+{
+public:
+    static bool isPsd(const CAEN_DGTZ_BoardInfo_t& info);
+
+    static CAEN_DGTZ_ErrorCode getEvents(
+        bool psd, const char* buffer, uint32_t bufferSize,
+        void** events, uint32_t* numEvents, uint32_t capacity
+    );
+    static CAEN_DGTZ_ErrorCode decodeWaveforms(bool psd, const void* event, void* waveforms);
+
+    static CAEN_DGTZ_ErrorCode mallocEvents(
+        bool psd, uint32_t capacity, void** events, uint32_t* allocatedSize
+    );
+    static void                freeEvents(void** events);
+    static CAEN_DGTZ_ErrorCode mallocWaveforms(bool psd, void** waveforms, uint32_t* allocatedSize);
+    static void                freeWaveforms(void* waveforms);
+};
+
+#endif
@@ -0,0 +1,177 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CDppHitStore.cpp
+# @brief Implement the per board hit store.
+
+*/
+#include "CDppHitStore.h"
+#include <algorithm>
+
+/**
+ * constructor
+ *
+ * @param psd       - The board runs DPP-PSD rather than DPP-PHA firmware.
+ * @param nsPerTick - Nanoseconds per time tag tick.
+ */
+CDppHitStore::CDppHitStore(bool psd, unsigned nsPerTick) :
+    m_pParser(new CDppAggregateParser(psd)),
+    m_unwrapper(nsPerTick),
+    m_newest(0)
+{
+    m_merger.reserve(CAEN_DGTZ_MAX_CHANNEL);
+    reset();
+}
+/**
+ * destructor
+ */
+CDppHitStore::~CDppHitStore()
+{
+    delete m_pParser;
+}
+/**
+ * reset
+ *    Forget the buffered hits and the time tag rollovers, e.g. at the
+ *    start of a run.
+ */
+void
+CDppHitStore::reset()
+{
+    discard();
+    m_unwrapper.reset();
+}
+/**
+ * discard
+ *    Forget the undelivered hits.  The time tag rollovers are kept.
+ */
+void
+CDppHitStore::discard()
+{
+    m_merger.clear();
+}
+/**
+ * useLibrary
+ *    Decode buffers with the board's backend, or in tree (see
+ *    CDppAggregateParser::useLibrary).  The buffered hits are discarded.
+ *
+ * @param pBackend - The board's backend, nullptr to decode in tree.
+ * @param handle   - The board's handle.
+ * @return CAEN_DGTZ_ErrorCode - failure to allocate the backend's event arrays.
+ */
+CAEN_DGTZ_ErrorCode
+CDppHitStore::useLibrary(CDigitizerBackend* pBackend, int handle)
+{
+    discard();
+    return m_pParser->useLibrary(pBackend, handle);
+}
+/**
+ * load
+ *    Parse a readout buffer, replacing whatever hits were buffered.
+ *
+ * @param buffer - The buffer (from ReadData).
+ * @param nBytes - Bytes of data in the buffer.
+ * @return CAEN_DGTZ_ErrorCode - CAEN_DGTZ_InvalidEvent if the buffer could
+ *                 not be parsed.  The store is then empty.
+ */
+CAEN_DGTZ_ErrorCode
+CDppHitStore::load(const char* buffer, uint32_t nBytes)
+{
+    discard();
+    CAEN_DGTZ_ErrorCode status = m_pParser->parse(buffer, nBytes);
+    if (status != CAEN_DGTZ_Success) return status;
+    loadMerger();
+    return CAEN_DGTZ_Success;
+}
+/**
+ * load
+ *    Take the hits of a buffer some other thread parsed (see
+ *    CDppReadoutThread), replacing whatever hits were buffered.  The
+ *    parsers are exchanged, not copied.
+ *
+ * @param pParser - The parser holding the hits.  On return it's the
+ *                  parser we were using, for reuse.  Both must be for the
+ *                  same firmware.
+ */
+void
+CDppHitStore::load(CDppAggregateParser*& pParser)
+{
+    discard();
+    std::swap(m_pParser, pParser);
+    loadMerger();
+}
+/**
+ * decodeWaveforms
+ *    Unpack the traces of the hit at the cursor.
+ *
+ * @param waveforms - CAEN_DGTZ_DPP_PHA/PSD_Waveforms_t for the firmware.
+ */
+CAEN_DGTZ_ErrorCode
+CDppHitStore::decodeWaveforms(void* waveforms) const
+{
+    int channel = m_merger.top();
+    return m_pParser->decodeWaveforms(channel, m_next[channel], waveforms);
+}
+/**
+ * next
+ *    Move the cursor to the next oldest hit.
+ */
+void
+CDppHitStore::next()
+{
+    int      channel = m_merger.top();
+    uint32_t i       = ++m_next[channel];
+    if (i < m_pParser->hits(channel)) {
+        m_merger.replaceTop(m_stamps[channel][i]);
+    } else {
+        m_merger.pop();
+    }
+}
+/*-------------------------------------------------------------------
+ * Private methods.
+ */
+
+/**
+ * extendTimestamps
+ *    Compute the 64 bit ps timestamps of all of a channel's hits.
+ */
+void
+CDppHitStore::extendTimestamps(int channel)
+{
+    const DppHitColumns& c(m_pParser->channel(channel));
+    std::vector<uint64_t>& stamps(m_stamps[channel]);
+    if (stamps.size() < c.s_nHits) {
+        stamps.resize(std::max<size_t>(c.s_nHits, 2*stamps.size()));
+    }
+
+    m_unwrapper.unwrap(
+        channel, c.s_nHits, c.s_timeTag.data(), c.s_extras2.data(), c.s_format.data(),
+        stamps.data()
+    );
+}
+/**
+ * loadMerger
+ *    After the parser has been filled, extend the timestamps of each
+ *    channel with hits and put it in the merger keyed by its first hit.
+ *    Each channel's hits are in time order so its last is its newest.
+ */
+void
+CDppHitStore::loadMerger()
+{
+    m_merger.clear();
+    m_newest = 0;
+    for (int i = 0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
+        m_next[i] = 0;
+        uint32_t n = m_pParser->hits(i);
+        if (n) {
+            extendTimestamps(i);
+            m_merger.push(m_stamps[i][0], i);
+            m_newest = std::max(m_newest, m_stamps[i][n - 1]);
+        }
+    }
+}
@@ -0,0 +1,106 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CDppHitStore.h
+# @brief Per board store of the hits from a readout buffer, read oldest first.
+
+*/
+#ifndef CDPPHITSTORE_H
+#define CDPPHITSTORE_H
+
+#include <stdint.h>
+#include <vector>
+#include <CAENDigitizerType.h>
+#include "CDppAggregateParser.h"
+#include "CTimeOrderedMerger.h"
+#include "CTimestampUnwrapper.h"
+
+/**
+ * @class CDppHitStore
+ *    Holds the hits of one board's readout buffer for the PHA and PSD
+ *    drivers.  A buffer is decoded into per channel columns by a
+ *    CDppAggregateParser (DppHitColumns), with the board's GetDPPEvents
+ *    after useLibrary(), otherwise in tree.  When it's loaded, each channel's
+ *    31 bit time tags are extended to 64 bit ps timestamps (see
+ *    CTimestampUnwrapper) in a column of their own, in one pass per channel
+ *    rather than as each hit is delivered.  The time tag rollover state
+ *    carries over from buffer to buffer until reset().  timestamp() is in
+ *    ns, as the event segments stamp their events, timestampPs() keeps the
+ *    fine time if that's enabled and picoseconds() is what timestamp()
+ *    leaves out of it.
+ *
+ *    A cursor then visits the hits of all channels oldest first:
+ *
+ *    \verbatim
+ *    while (!store.empty()) {
+ *        int      chan  = store.channel();
+ *        uint64_t stamp = store.timestamp();
+ *        uint16_t e     = store.energy();
+ *        ...
+ *        store.next();
+ *    }
+ *    \endverbatim
+ *
+ *    Waveform samples are left in the readout buffer, which must not be
+ *    reused until the store has been emptied or loaded again.
+ */
+class CDppHitStore
+{
+private:
+    CDppAggregateParser*    m_pParser;
+    CTimestampUnwrapper     m_unwrapper;
+    std::vector<uint64_t>   m_stamps[CAEN_DGTZ_MAX_CHANNEL];   // ps.
+    uint32_t                m_next[CAEN_DGTZ_MAX_CHANNEL];     // Next undelivered hit.
+    CTimeOrderedMerger<int> m_merger;   // Channels with undelivered hits by next timestamp.
+    uint64_t                m_newest;   // Latest timestamp in the buffer, ps.
+
+public:
+    CDppHitStore(bool psd, unsigned nsPerTick = 4);
+    ~CDppHitStore();
+
+    void setNsPerTick(unsigned nsPerTick) { m_unwrapper.setNsPerTick(nsPerTick); }
+    void setFineTime(bool enable)         { m_unwrapper.setFineTime(enable); }
+    bool fineTime() const                 { return m_unwrapper.fineTime(); }
+    uint64_t rollovers(int channel) const { return m_unwrapper.rollovers(channel); }
+    void reset();
+    void discard();
+    CAEN_DGTZ_ErrorCode useLibrary(CDigitizerBackend* pBackend, int handle);
+
+    CAEN_DGTZ_ErrorCode load(const char* buffer, uint32_t nBytes);
+    void                load(CDppAggregateParser*& pParser);
+
+    // The cursor - all but empty() require there to be an undelivered hit:
+
+    bool                 empty() const     { return m_merger.empty(); }
+    int                  channel() const   { return m_merger.top(); }
+    uint32_t             index() const     { return m_next[m_merger.top()]; }
+    uint64_t             timestamp() const   { return timestampPs()/CTimestampUnwrapper::PS_PER_NS; }
+    uint64_t             timestampPs() const { return m_merger.topTimestamp(); }
+    uint16_t             picoseconds() const { return timestampPs() % CTimestampUnwrapper::PS_PER_NS; }
+    uint64_t             newestTimestamp() const { return m_newest/CTimestampUnwrapper::PS_PER_NS; }
+    uint16_t             energy() const     { return current().s_energy[index()]; }
+    uint16_t             chargeLong() const { return current().s_chargeLong[index()]; }
+    uint16_t             extras() const     { return current().s_extras[index()]; }
+    uint32_t             extras2() const    { return current().s_extras2[index()]; }
+    bool                 hasWaveforms() const { return current().s_waveforms[index()] != nullptr; }
+    CAEN_DGTZ_ErrorCode  decodeWaveforms(void* waveforms) const;
+    void                 next();
+
+    // Bulk access to the buffered hits:
+
+    const DppHitColumns& columns(int channel) const { return m_pParser->channel(channel); }
+    const uint64_t*      timestamps(int channel) const { return m_stamps[channel].data(); }  // ps.
+
+private:
+    const DppHitColumns& current() const { return m_pParser->channel(m_merger.top()); }
+    void extendTimestamps(int channel);
+    void loadMerger();
+};
+
+#endif
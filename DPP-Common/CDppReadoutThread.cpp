@@ -0,0 +1,278 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CDppReadoutThread.cpp
+# @brief Implement the background block transfer/decode thread.
+
+*/
+#include "CDppReadoutThread.h"
+#include "CDigitizerBackend.h"
+#include "CDppAggregateParser.h"
+#include "CDppHitStore.h"
+#include <stdexcept>
+#include <sstream>
+#include <chrono>
+#include <string.h>
+
+/**
+ * constructor
+ *    Allocate the block ring.  The thread is not started.
+ *
+ * @param pBackend         - Digitizer backend the board was opened with.
+ * @param handle           - Backend handle open on the board.  The board
+ *                           must already be set up so that the backend sizes
+ *                           the buffers correctly.
+ * @param psd              - The board runs DPP-PSD rather than DPP-PHA firmware.
+ * @param inTree           - Decode blocks in tree rather than with the
+ *                           backend's GetDPPEvents.
+ * @param nBlocks          - Number of blocks in the ring (at least 2).
+ * @param pollMicroseconds - How long to wait before reading again when
+ *                           the board had no data.
+ * @throw std::runtime_error - if the backend can't allocate a buffer.
+ */
+CDppReadoutThread::CDppReadoutThread(
+    CDigitizerBackend* pBackend, int handle, bool psd, bool inTree,
+    unsigned nBlocks, unsigned pollMicroseconds
+) :
+    m_pBackend(pBackend), m_handle(handle), m_psd(psd), m_inTree(inTree),
+    m_pollMicroseconds(pollMicroseconds), m_pThread(nullptr),
+    m_running(false), m_status(CAEN_DGTZ_Success),
+    m_nBlocks(0), m_nBytes(0), m_nStalls(0), m_nDecodeFailures(0)
+{
+    if (nBlocks < 2) nBlocks = 2;
+    try {
+        allocateBlocks(nBlocks);
+    }
+    catch (...) {
+        freeBlocks();
+        throw;
+    }
+}
+/**
+ * destructor
+ *    Stop the thread if it's running and free the blocks we hold.
+ */
+CDppReadoutThread::~CDppReadoutThread()
+{
+    stop();
+    freeBlocks();
+}
+/**
+ * start
+ *    Start the acquisition thread.  Any blocks filled by a previous
+ *    run are discarded.
+ */
+void
+CDppReadoutThread::start()
+{
+    if (m_pThread) return;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        while (!m_filled.empty()) {
+            m_free.push_back(m_filled.front());
+            m_filled.pop_front();
+        }
+    }
+    m_status  = CAEN_DGTZ_Success;
+    m_running = true;
+    m_pThread = new std::thread(&CDppReadoutThread::readLoop, this);
+}
+/**
+ * stop
+ *    Stop the acquisition thread and wait for it to exit.
+ *    Filled blocks are retained.
+ */
+void
+CDppReadoutThread::stop()
+{
+    if (!m_pThread) return;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_running = false;
+    }
+    m_freeAvailable.notify_all();
+    m_pThread->join();
+    delete m_pThread;
+    m_pThread = nullptr;
+}
+/**
+ * exchange
+ *    If there's a filled block, swap the caller's raw buffer and hit store
+ *    parser for it.
+ *
+ * @param rawBuffer - Reference to the caller's raw buffer pointer. On success
+ *                    this points to the raw data of the filled block.
+ * @param hits      - The caller's hit store.  On success it holds the
+ *                    block's hits.
+ * @return bool     - true if a block was exchanged, false if none are ready.
+ * @note the caller must be done with all hits in its store.
+ */
+bool
+CDppReadoutThread::exchange(char*& rawBuffer, CDppHitStore& hits)
+{
+    Block* pBlock;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        if (m_filled.empty()) return false;
+        pBlock = m_filled.front();
+        m_filled.pop_front();
+    }
+    std::swap(rawBuffer, pBlock->s_rawBuffer);
+    hits.load(pBlock->s_pParser);
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_free.push_back(pBlock);
+    }
+    m_freeAvailable.notify_one();
+    return true;
+}
+/**
+ * backlog
+ * @return double - the fraction of the blocks that are filled and waiting
+ *         for exchange().  Near 1 the consumer isn't keeping up.
+ */
+double
+CDppReadoutThread::backlog()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    return m_blocks.empty() ? 0.0 : double(m_filled.size())/m_blocks.size();
+}
+/**
+ * status
+ * @return CAEN_DGTZ_ErrorCode - CAEN_DGTZ_Success or the error from the
+ *         backend that stopped the thread.
+ */
+CAEN_DGTZ_ErrorCode
+CDppReadoutThread::status() const
+{
+    return static_cast<CAEN_DGTZ_ErrorCode>(m_status.load());
+}
+
+/*------------------------------------------------------------------------------
+ * private utilities.
+ */
+
+/**
+ * allocateBlocks
+ *    Allocate the raw buffers and parsers for the ring.
+ *
+ * @param nBlocks - number of blocks.
+ * @throw std::runtime_error - allocation failed.
+ */
+void
+CDppReadoutThread::allocateBlocks(unsigned nBlocks)
+{
+    for (unsigned b = 0; b < nBlocks; b++) {
+        Block* pBlock = new Block;
+        memset(pBlock, 0, sizeof(Block));
+        m_blocks.push_back(pBlock);
+
+        uint32_t size;
+        CAEN_DGTZ_ErrorCode status =
+            m_pBackend->mallocReadoutBuffer(m_handle, &pBlock->s_rawBuffer, &size);
+        if (status != CAEN_DGTZ_Success) {
+            std::stringstream msg;
+            msg << "CDppReadoutThread - Failed to malloc readout buffer: " << status;
+            throw std::runtime_error(msg.str());
+        }
+        pBlock->s_pParser = new CDppAggregateParser(m_psd);
+        if (!m_inTree) {
+            status = pBlock->s_pParser->useLibrary(m_pBackend, m_handle);
+            if (status != CAEN_DGTZ_Success) {
+                std::stringstream msg;
+                msg << "CDppReadoutThread - Failed to malloc DPP events: " << status;
+                throw std::runtime_error(msg.str());
+            }
+        }
+        m_free.push_back(pBlock);
+    }
+}
+/**
+ * freeBlocks
+ *    Return the raw buffers to the backend and delete the parsers, which
+ *    return their event arrays.
+ */
+void
+CDppReadoutThread::freeBlocks()
+{
+    for (size_t b = 0; b < m_blocks.size(); b++) {
+        Block* pBlock = m_blocks[b];
+        if (pBlock->s_rawBuffer) m_pBackend->freeReadoutBuffer(&pBlock->s_rawBuffer);
+        delete pBlock->s_pParser;
+        delete pBlock;
+    }
+    m_blocks.clear();
+    m_free.clear();
+    m_filled.clear();
+}
+/**
+ * nextFreeBlock
+ *    Wait for a free block.
+ *
+ * @return Block* - the block or nullptr if we've been asked to stop.
+ */
+CDppReadoutThread::Block*
+CDppReadoutThread::nextFreeBlock()
+{
+    std::unique_lock<std::mutex> guard(m_lock);
+    if (m_free.empty()) m_nStalls++;            // Consumer is behind.
+    while (m_running && m_free.empty()) {
+        m_freeAvailable.wait(guard);
+    }
+    if (!m_running) return nullptr;
+    Block* pBlock = m_free.front();
+    m_free.pop_front();
+    return pBlock;
+}
+/**
+ * readLoop
+ *    Thread entry:  Read and parse blocks from the board into free blocks
+ *    until stopped or the CAEN library fails a read.  A block that can't be
+ *    parsed is counted and its buffer reused.
+ */
+void
+CDppReadoutThread::readLoop()
+{
+    while (m_running) {
+        Block* pBlock = nextFreeBlock();
+        if (!pBlock) break;
+
+        CAEN_DGTZ_ErrorCode status = m_pBackend->readData(
+            m_handle, CAEN_DGTZ_SLAVE_TERMINATED_READOUT_MBLT, pBlock->s_rawBuffer,
+            &pBlock->s_nBytes
+        );
+        bool parsed = false;
+        if (status == CAEN_DGTZ_Success && pBlock->s_nBytes > 0) {
+            parsed = pBlock->s_pParser->parse(pBlock->s_rawBuffer, pBlock->s_nBytes)
+                == CAEN_DGTZ_Success;
+            if (!parsed) m_nDecodeFailures++;
+        }
+        bool haveHits = (status == CAEN_DGTZ_Success) && parsed;
+        bool empty    = (status == CAEN_DGTZ_Success) && (pBlock->s_nBytes == 0);
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            if (haveHits) {
+                m_filled.push_back(pBlock);
+            } else {
+                m_free.push_front(pBlock);
+            }
+        }
+        if (status != CAEN_DGTZ_Success) {
+            m_status  = status;
+            m_running = false;
+            break;
+        }
+        if (haveHits) {
+            m_nBlocks++;
+            m_nBytes += pBlock->s_nBytes;
+        } else if (empty) {
+            std::this_thread::sleep_for(std::chrono::microseconds(m_pollMicroseconds));
+        }
+    }
+}
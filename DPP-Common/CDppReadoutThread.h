@@ -0,0 +1,118 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CDppReadoutThread.h
+# @brief Background block transfer/decode thread for a DPP digitizer.
+
+*/
+#ifndef CDPPREADOUTTHREAD_H
+#define CDPPREADOUTTHREAD_H
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <CAENDigitizerType.h>
+
+class CDigitizerBackend;
+class CDppAggregateParser;
+class CDppHitStore;
+
+/**
+ * @class CDppReadoutThread
+ *    Runs ReadData and decodes the blocks read (CDppAggregateParser, with
+ *    the backend's GetDPPEvents unless told to decode in tree) for one
+ *    board in a thread of its own so that the next block transfer overlaps
+ *    formatting of the hits from the previous one.
+ *
+ *    The thread owns a ring of blocks, each a raw readout buffer allocated
+ *    by the board's digitizer backend and a parser.  The consumer (the
+ *    readout driver) owns one raw buffer and a CDppHitStore.  When it has
+ *    used up its hits, exchange() swaps its buffer and the store's parser
+ *    for those of the oldest filled block so no hits are ever copied.  The
+ *    driver's buffer and parser become a free block for the thread to fill.
+ *
+ *    The driver's own buffer must have been allocated with
+ *    mallocReadoutBuffer of the same backend for the same board so the
+ *    buffers are interchangeable, and its store must decode the same way.
+ *    Since the driver and thread swap buffers, the thread must be stopped
+ *    before the driver frees its buffer.
+ *
+ *    A block that can't be parsed is dropped and counted (decodeFailures);
+ *    only a failed ReadData stops the thread (status).
+ *
+ *    The thread and the consumer call the backend for the same board from
+ *    different threads.  The backends serialize those calls themselves
+ *    (CCAENDigitizerBackend holds a lock per link, the simulated and
+ *    replay boards one per board).  While the thread runs the consumer
+ *    should still limit itself to the register accesses needed to
+ *    start/stop the board, since each one waits for a block transfer on
+ *    the link to finish.
+ */
+class CDppReadoutThread
+{
+private:
+    struct Block {
+        char*                s_rawBuffer;
+        uint32_t             s_nBytes;
+        CDppAggregateParser* s_pParser;
+    };
+
+    CDigitizerBackend*       m_pBackend;
+    int                      m_handle;
+    bool                     m_psd;
+    bool                     m_inTree;          // Decode without the backend.
+    unsigned                 m_pollMicroseconds;
+    std::vector<Block*>      m_blocks;          // All blocks we own.
+    std::deque<Block*>       m_free;
+    std::deque<Block*>       m_filled;
+    std::mutex               m_lock;
+    std::condition_variable  m_freeAvailable;
+    std::thread*             m_pThread;
+    std::atomic<bool>        m_running;
+    std::atomic<int>         m_status;           // CAEN_DGTZ_ErrorCode that stopped us.
+
+    // Statistics:
+
+    std::atomic<uint64_t>    m_nBlocks;           // Non empty blocks read.
+    std::atomic<uint64_t>    m_nBytes;
+    std::atomic<uint64_t>    m_nStalls;           // Waits for the consumer to free a block.
+    std::atomic<uint64_t>    m_nDecodeFailures;   // Blocks dropped as undecodable.
+
+public:
+    CDppReadoutThread(
+        CDigitizerBackend* pBackend, int handle, bool psd, bool inTree,
+        unsigned nBlocks = 4, unsigned pollMicroseconds = 100
+    );
+    virtual ~CDppReadoutThread();
+
+    void start();
+    void stop();
+    bool running() const { return m_running; }
+
+    bool exchange(char*& rawBuffer, CDppHitStore& hits);
+    CAEN_DGTZ_ErrorCode status() const;
+
+    uint64_t blocksRead() const { return m_nBlocks; }
+    uint64_t bytesRead() const  { return m_nBytes; }
+    uint64_t stalls() const     { return m_nStalls; }
+    uint64_t decodeFailures() const { return m_nDecodeFailures; }
+    double   backlog();
+
+private:
+    void allocateBlocks(unsigned nBlocks);
+    void freeBlocks();
+    void readLoop();
+    Block* nextFreeBlock();
+};
+
+#endif
@@ -0,0 +1,226 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CFeatureExtractor.cpp
+# @brief Implement the trace feature extraction.
+
+*/
+#include "CFeatureExtractor.h"
+#include <algorithm>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * Settings constructor
+ *    Defaults that suit the pulses of the x725/x730 boards.
+ */
+CFeatureExtractor::Settings::Settings() :
+    s_baselineSamples(16), s_cfdFraction(0.25), s_cfdDelay(4), s_tailStart(10)
+{}
+
+/**
+ * constructor
+ */
+CFeatureExtractor::CFeatureExtractor()
+{}
+/**
+ * setSettings
+ *
+ * @param settings - The new settings.
+ */
+void
+CFeatureExtractor::setSettings(const Settings& settings)
+{
+    m_settings = settings;
+}
+/**
+ * extract
+ *    Work out the features of a trace.
+ *
+ * @param features - Receives them.
+ * @param pTrace   - The trace.
+ * @param samples  - Its length, at least 1.
+ */
+void
+CFeatureExtractor::extract(
+    DppFragment::Features& features, const uint16_t* pTrace, uint32_t samples
+) const
+{
+    uint32_t nBaseline = std::min(std::max(m_settings.s_baselineSamples, 1u), samples);
+    double   baselineSum = 0.0, sumSquares = 0.0;
+    for (uint32_t i = 0; i < nBaseline; i++) {
+        baselineSum += pTrace[i];
+        sumSquares  += double(pTrace[i])*pTrace[i];
+    }
+    double baseline = baselineSum/nBaseline;
+    double variance = sumSquares/nBaseline - baseline*baseline;
+
+    uint16_t low, high;
+    extrema(pTrace, samples, low, high);
+    bool     negative  = (baseline - low) > (high - baseline);
+    double   sign      = negative ? -1.0 : 1.0;
+    double   amplitude = negative ? (baseline - low) : (high - baseline);
+    uint32_t peak      = find(pTrace, samples, negative ? low : high);
+
+    features.s_baseline    = baseline;
+    features.s_baselineRms = sqrt(std::max(variance, 0.0));
+    features.s_amplitude   = amplitude;
+    features.s_riseTime    = 0.0;
+    features.s_cfdTime     = 0.0;
+    features.s_peak        = std::min(peak, uint32_t(UINT16_MAX));
+    features.s_status      = negative ? DppFragment::FEATURE_NEGATIVE : 0;
+
+    // Integrals - the tail is part of the total:
+
+    uint32_t tailFrom = std::max(std::min(peak + m_settings.s_tailStart, samples), nBaseline);
+    uint64_t head     = sum(pTrace, nBaseline, tailFrom);
+    uint64_t tail     = sum(pTrace, tailFrom, samples);
+    features.s_totalIntegral = sign*(double(head + tail) - (samples - nBaseline)*baseline);
+    features.s_tailIntegral  = sign*(double(tail) - (samples - tailFrom)*baseline);
+
+    if (amplitude <= 0.0) return;                    // Flat - no edge to time.
+
+    // The pulse above the baseline, and where it crosses a level between
+    // samples i and i+1:
+
+    auto pulse = [&](uint32_t i) { return sign*(pTrace[i] - baseline); };
+    auto crossing = [&](uint32_t i, double level) {
+        return i + (level - pulse(i))/(pulse(i + 1) - pulse(i));
+    };
+
+    // Rise time - walk back from the peak through 90% then 10%:
+
+    uint32_t j = peak;
+    double   level90 = 0.9*amplitude, level10 = 0.1*amplitude;
+    while (j && (pulse(j - 1) >= level90)) j--;
+    double t90 = j ? crossing(j - 1, level90) : -1.0;
+    while (j && (pulse(j - 1) >= level10)) j--;
+    if (j && (t90 >= 0.0)) {
+        features.s_riseTime = t90 - crossing(j - 1, level10);
+        features.s_status  |= DppFragment::FEATURE_RISE;
+    }
+
+    // CFD - the first + to - crossing from the 10% point:
+
+    double   fraction = m_settings.s_cfdFraction;
+    unsigned delay    = m_settings.s_cfdDelay;
+    auto cfd = [&](uint32_t i) {
+        return fraction*pulse(i) - ((i >= delay) ? pulse(i - delay) : 0.0);
+    };
+    uint32_t end   = std::min(peak + delay, samples - 1);
+    double   prior = cfd(j);
+    for (uint32_t i = j + 1; i <= end; i++) {
+        double c = cfd(i);
+        if ((prior > 0.0) && (c <= 0.0)) {
+            features.s_cfdTime = (i - 1) + prior/(prior - c);
+            features.s_status |= DppFragment::FEATURE_CFD;
+            break;
+        }
+        prior = c;
+    }
+}
+/*-------------------------------------------------------------------
+ * Private member functions.
+ */
+
+/**
+ * sum
+ * @return uint64_t - the sum of samples [from, to).
+ */
+uint64_t
+CFeatureExtractor::sum(const uint16_t* pTrace, uint32_t from, uint32_t to)
+{
+    uint64_t result = 0;
+    uint32_t i      = from;
+#ifdef __SSE2__
+    // Four 32 bit sums, folded into the result before they can overflow:
+
+    const uint32_t CHUNK = 8*8192;
+    const __m128i  zero  = _mm_setzero_si128();
+    while ((i < to) && ((to - i) >= 8)) {
+        uint32_t chunkEnd = i + std::min((to - i) & ~7u, CHUNK);
+        __m128i  sums     = zero;
+        for (; i < chunkEnd; i += 8) {
+            __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pTrace + i));
+            sums = _mm_add_epi32(
+                sums, _mm_add_epi32(_mm_unpacklo_epi16(s, zero), _mm_unpackhi_epi16(s, zero))
+            );
+        }
+        uint32_t lanes[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), sums);
+        result += uint64_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+    }
+#endif
+    for (; i < to; i++) {
+        result += pTrace[i];
+    }
+    return result;
+}
+/**
+ * extrema
+ *    Find the smallest and largest samples.
+ */
+void
+CFeatureExtractor::extrema(const uint16_t* pTrace, uint32_t samples, uint16_t& low, uint16_t& high)
+{
+    low  = UINT16_MAX;
+    high = 0;
+    uint32_t i = 0;
+#ifdef __SSE2__
+    // SSE2 only compares signed 16 bit values so flip the sign bits:
+
+    if (samples >= 8) {
+        const __m128i flip = _mm_set1_epi16(static_cast<short>(0x8000));
+        __m128i lows  = _mm_set1_epi16(INT16_MAX);
+        __m128i highs = _mm_set1_epi16(INT16_MIN);
+        for (; (samples - i) >= 8; i += 8) {
+            __m128i s = _mm_xor_si128(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(pTrace + i)), flip
+            );
+            lows  = _mm_min_epi16(lows, s);
+            highs = _mm_max_epi16(highs, s);
+        }
+        uint16_t l[8], h[8];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(l), _mm_xor_si128(lows, flip));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(h), _mm_xor_si128(highs, flip));
+        for (unsigned k = 0; k < 8; k++) {
+            low  = std::min(low, l[k]);
+            high = std::max(high, h[k]);
+        }
+    }
+#endif
+    for (; i < samples; i++) {
+        low  = std::min(low, pTrace[i]);
+        high = std::max(high, pTrace[i]);
+    }
+}
+/**
+ * find
+ * @return uint32_t - index of the first sample equal to value, samples if none.
+ */
+uint32_t
+CFeatureExtractor::find(const uint16_t* pTrace, uint32_t samples, uint16_t value)
+{
+    uint32_t i = 0;
+#ifdef __SSE2__
+    const __m128i target = _mm_set1_epi16(static_cast<short>(value));
+    for (; (samples - i) >= 8; i += 8) {
+        int matches = _mm_movemask_epi8(_mm_cmpeq_epi16(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(pTrace + i)), target
+        ));
+        if (matches) return i + __builtin_ctz(matches)/2;
+    }
+#endif
+    for (; i < samples; i++) {
+        if (pTrace[i] == value) return i;
+    }
+    return samples;
+}
@@ -0,0 +1,68 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CFeatureExtractor.h
+# @brief Work out the usual pulse shape numbers from a trace.
+
+*/
+#ifndef CFEATUREEXTRACTOR_H
+#define CFEATUREEXTRACTOR_H
+
+#include <stdint.h>
+#include "DppFragmentFormat.h"
+
+/**
+ * @class CFeatureExtractor
+ *    Traces are mostly kept to recompute a few numbers offline.  This
+ *    works them out in the readout so that a hit can carry them (a
+ *    DppFragment::Features block) alongside or instead of its traces:
+ *
+ *    - the mean and RMS of the baseline, the first baseline samples,
+ *    - the pulse's amplitude and peak sample.  The polarity is whichever
+ *      of the largest and smallest sample is further from the baseline,
+ *    - its 10-90% rise time, walking back from the peak,
+ *    - the zero crossing of a software CFD, fraction*pulse(t) -
+ *      pulse(t - delay), from the 10% point onwards,
+ *    - the integral from the end of the baseline to the end of the trace
+ *      and of the tail, from tailStart samples after the peak.
+ *
+ *    Times are in samples, interpolated between them.  The passes over the
+ *    whole trace (extrema, peak search, integrals) use SSE2 where it's
+ *    available.
+ */
+class CFeatureExtractor
+{
+public:
+    struct Settings {
+        unsigned s_baselineSamples;     // Samples averaged for the baseline.
+        double   s_cfdFraction;
+        unsigned s_cfdDelay;            // In samples.
+        unsigned s_tailStart;           // Samples after the peak.
+
+        Settings();
+    };
+
+private:
+    Settings m_settings;
+
+public:
+    CFeatureExtractor();
+
+    void setSettings(const Settings& settings);
+    const Settings& settings() const { return m_settings; }
+
+    void extract(DppFragment::Features& features, const uint16_t* pTrace, uint32_t samples) const;
+
+private:
+    static uint64_t sum(const uint16_t* pTrace, uint32_t from, uint32_t to);
+    static void     extrema(const uint16_t* pTrace, uint32_t samples, uint16_t& low, uint16_t& high);
+    static uint32_t find(const uint16_t* pTrace, uint32_t samples, uint16_t value);
+};
+
+#endif
@@ -0,0 +1,185 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CForwardingDigitizer.cpp
+# @brief Pass each backend call on to the wrapped backend.
+
+*/
+#include "CForwardingDigitizer.h"
+
+/**
+ * constructor
+ * @param pBackend - The backend calls are passed on to.  nullptr means
+ *                   CDigitizerBackend::getDefault() at the time of construction.
+ *                   The caller retains ownership.
+ */
+CForwardingDigitizer::CForwardingDigitizer(CDigitizerBackend* pBackend) :
+    m_pBackend(pBackend ? pBackend : CDigitizerBackend::getDefault())
+{}
+
+/*------------------------------------------------------------------------------
+ *  Each method just calls the wrapped backend:
+ */
+
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::openDigitizer(CAEN_DGTZ_ConnectionType linkType, int linkNum, int conetNode,
+    uint32_t vmeBase, int* handle)
+{
+    return m_pBackend->openDigitizer(linkType, linkNum, conetNode, vmeBase, handle);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::closeDigitizer(int handle)
+{
+    return m_pBackend->closeDigitizer(handle);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::getInfo(int handle, CAEN_DGTZ_BoardInfo_t* info)
+{
+    return m_pBackend->getInfo(handle, info);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::reset(int handle)
+{
+    return m_pBackend->reset(handle);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::calibrate(int handle)
+{
+    return m_pBackend->calibrate(handle);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::readRegister(int handle, uint32_t address, uint32_t* data)
+{
+    return m_pBackend->readRegister(handle, address, data);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::writeRegister(int handle, uint32_t address, uint32_t data)
+{
+    return m_pBackend->writeRegister(handle, address, data);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::setRecordLength(int handle, uint32_t size, int channel)
+{
+    return m_pBackend->setRecordLength(handle, size, channel);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::setAcquisitionMode(int handle, CAEN_DGTZ_AcqMode_t mode)
+{
+    return m_pBackend->setAcquisitionMode(handle, mode);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::setDPPAcquisitionMode(int handle, CAEN_DGTZ_DPP_AcqMode_t mode, CAEN_DGTZ_DPP_SaveParam_t param)
+{
+    return m_pBackend->setDPPAcquisitionMode(handle, mode, param);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::setChannelEnableMask(int handle, uint32_t mask)
+{
+    return m_pBackend->setChannelEnableMask(handle, mask);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::setChannelDCOffset(int handle, uint32_t channel, uint32_t value)
+{
+    return m_pBackend->setChannelDCOffset(handle, channel, value);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::setChannelPulsePolarity(int handle, uint32_t channel, CAEN_DGTZ_PulsePolarity_t polarity)
+{
+    return m_pBackend->setChannelPulsePolarity(handle, channel, polarity);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::setDPPParameters(int handle, uint32_t channelMask, void* params)
+{
+    return m_pBackend->setDPPParameters(handle, channelMask, params);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::setDPPPreTriggerSize(int handle, int channel, uint32_t samples)
+{
+    return m_pBackend->setDPPPreTriggerSize(handle, channel, samples);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::setIOLevel(int handle, CAEN_DGTZ_IOLevel_t level)
+{
+    return m_pBackend->setIOLevel(handle, level);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::setDPPEventAggregation(int handle, int threshold, int maxsize)
+{
+    return m_pBackend->setDPPEventAggregation(handle, threshold, maxsize);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::setMaxNumAggregatesBLT(int handle, uint32_t numAggr)
+{
+    return m_pBackend->setMaxNumAggregatesBLT(handle, numAggr);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::setRunSynchronizationMode(int handle, CAEN_DGTZ_RunSyncMode_t mode)
+{
+    return m_pBackend->setRunSynchronizationMode(handle, mode);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::swStartAcquisition(int handle)
+{
+    return m_pBackend->swStartAcquisition(handle);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::swStopAcquisition(int handle)
+{
+    return m_pBackend->swStopAcquisition(handle);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::clearData(int handle)
+{
+    return m_pBackend->clearData(handle);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::mallocReadoutBuffer(int handle, char** buffer, uint32_t* size)
+{
+    return m_pBackend->mallocReadoutBuffer(handle, buffer, size);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::freeReadoutBuffer(char** buffer)
+{
+    return m_pBackend->freeReadoutBuffer(buffer);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::mallocDPPEvents(int handle, void** events, uint32_t* allocatedSize)
+{
+    return m_pBackend->mallocDPPEvents(handle, events, allocatedSize);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::freeDPPEvents(int handle, void** events)
+{
+    return m_pBackend->freeDPPEvents(handle, events);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::mallocDPPWaveforms(int handle, void** waveforms, uint32_t* allocatedSize)
+{
+    return m_pBackend->mallocDPPWaveforms(handle, waveforms, allocatedSize);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::freeDPPWaveforms(int handle, void* waveforms)
+{
+    return m_pBackend->freeDPPWaveforms(handle, waveforms);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::readData(int handle, CAEN_DGTZ_ReadMode_t mode, char* buffer, uint32_t* bufferSize)
+{
+    return m_pBackend->readData(handle, mode, buffer, bufferSize);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::getDPPEvents(int handle, char* buffer, uint32_t bufferSize, void** events, uint32_t* numEvents)
+{
+    return m_pBackend->getDPPEvents(handle, buffer, bufferSize, events, numEvents);
+}
+CAEN_DGTZ_ErrorCode
+CForwardingDigitizer::decodeDPPWaveforms(int handle, void* event, void* waveforms)
+{
+    return m_pBackend->decodeDPPWaveforms(handle, event, waveforms);
+}
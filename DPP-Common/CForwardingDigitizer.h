@@ -0,0 +1,82 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CForwardingDigitizer.h
+# @brief Digitizer backend that passes everything on to another backend.
+
+*/
+#ifndef CFORWARDINGDIGITIZER_H
+#define CFORWARDINGDIGITIZER_H
+
+#include "CDigitizerBackend.h"
+
+/**
+ * @class CForwardingDigitizer
+ *    Base class for backends that sit in front of another backend
+ *    (e.g. CRecordingDigitizer).  Every method just calls the same method
+ *    of the wrapped backend; derived classes override those they need to
+ *    watch or modify.
+ */
+class CForwardingDigitizer : public CDigitizerBackend
+{
+protected:
+    CDigitizerBackend* m_pBackend;
+public:
+    CForwardingDigitizer(CDigitizerBackend* pBackend);
+
+    virtual CAEN_DGTZ_ErrorCode openDigitizer(
+        CAEN_DGTZ_ConnectionType linkType, int linkNum, int conetNode,
+        uint32_t vmeBase, int* handle
+    );
+    virtual CAEN_DGTZ_ErrorCode closeDigitizer(int handle);
+    virtual CAEN_DGTZ_ErrorCode getInfo(int handle, CAEN_DGTZ_BoardInfo_t* info);
+    virtual CAEN_DGTZ_ErrorCode reset(int handle);
+    virtual CAEN_DGTZ_ErrorCode calibrate(int handle);
+
+    virtual CAEN_DGTZ_ErrorCode readRegister(int handle, uint32_t address, uint32_t* data);
+    virtual CAEN_DGTZ_ErrorCode writeRegister(int handle, uint32_t address, uint32_t data);
+
+    virtual CAEN_DGTZ_ErrorCode setRecordLength(int handle, uint32_t size, int channel = -1);
+    virtual CAEN_DGTZ_ErrorCode setAcquisitionMode(int handle, CAEN_DGTZ_AcqMode_t mode);
+    virtual CAEN_DGTZ_ErrorCode setDPPAcquisitionMode(
+        int handle, CAEN_DGTZ_DPP_AcqMode_t mode, CAEN_DGTZ_DPP_SaveParam_t param
+    );
+    virtual CAEN_DGTZ_ErrorCode setChannelEnableMask(int handle, uint32_t mask);
+    virtual CAEN_DGTZ_ErrorCode setChannelDCOffset(int handle, uint32_t channel, uint32_t value);
+    virtual CAEN_DGTZ_ErrorCode setChannelPulsePolarity(
+        int handle, uint32_t channel, CAEN_DGTZ_PulsePolarity_t polarity
+    );
+    virtual CAEN_DGTZ_ErrorCode setDPPParameters(int handle, uint32_t channelMask, void* params);
+    virtual CAEN_DGTZ_ErrorCode setDPPPreTriggerSize(int handle, int channel, uint32_t samples);
+    virtual CAEN_DGTZ_ErrorCode setIOLevel(int handle, CAEN_DGTZ_IOLevel_t level);
+    virtual CAEN_DGTZ_ErrorCode setDPPEventAggregation(int handle, int threshold, int maxsize);
+    virtual CAEN_DGTZ_ErrorCode setMaxNumAggregatesBLT(int handle, uint32_t numAggr);
+    virtual CAEN_DGTZ_ErrorCode setRunSynchronizationMode(int handle, CAEN_DGTZ_RunSyncMode_t mode);
+
+    virtual CAEN_DGTZ_ErrorCode swStartAcquisition(int handle);
+    virtual CAEN_DGTZ_ErrorCode swStopAcquisition(int handle);
+    virtual CAEN_DGTZ_ErrorCode clearData(int handle);
+
+    virtual CAEN_DGTZ_ErrorCode mallocReadoutBuffer(int handle, char** buffer, uint32_t* size);
+    virtual CAEN_DGTZ_ErrorCode freeReadoutBuffer(char** buffer);
+    virtual CAEN_DGTZ_ErrorCode mallocDPPEvents(int handle, void** events, uint32_t* allocatedSize);
+    virtual CAEN_DGTZ_ErrorCode freeDPPEvents(int handle, void** events);
+    virtual CAEN_DGTZ_ErrorCode mallocDPPWaveforms(int handle, void** waveforms, uint32_t* allocatedSize);
+    virtual CAEN_DGTZ_ErrorCode freeDPPWaveforms(int handle, void* waveforms);
+
+    virtual CAEN_DGTZ_ErrorCode readData(
+        int handle, CAEN_DGTZ_ReadMode_t mode, char* buffer, uint32_t* bufferSize
+    );
+    virtual CAEN_DGTZ_ErrorCode getDPPEvents(
+        int handle, char* buffer, uint32_t bufferSize, void** events, uint32_t* numEvents
+    );
+    virtual CAEN_DGTZ_ErrorCode decodeDPPWaveforms(int handle, void* event, void* waveforms);
+};
+
+#endif
@@ -0,0 +1,118 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CHitFilter.cpp
+# @brief Implement the software hit cuts.
+
+*/
+#include "CHitFilter.h"
+
+/**
+ * Cuts constructor
+ *    No cuts - every hit passes.
+ */
+CHitFilter::Cuts::Cuts() :
+    s_energyCut(false), s_energyLow(0), s_energyHigh(0xffff),
+    s_rejectPileup(false),
+    s_psdCut(false), s_psdLow(0.0), s_psdHigh(1.0),
+    s_lowPriority(false)
+{}
+
+/**
+ * constructor
+ *    Start with no cuts and zero counters.
+ */
+CHitFilter::CHitFilter()
+{
+    clearCuts();
+    resetCounters();
+}
+/**
+ * setCuts
+ *    Set the cuts for a channel.
+ *
+ * @param chan - The channel.
+ * @param cuts - Its cuts.
+ */
+void
+CHitFilter::setCuts(unsigned chan, const Cuts& cuts)
+{
+    m_cuts[chan]   = cuts;
+    m_active[chan] = cuts.any();
+}
+/**
+ * clearCuts
+ *    Accept all hits from all channels.
+ */
+void
+CHitFilter::clearCuts()
+{
+    for (unsigned i = 0; i < CHANNELS; i++) {
+        setCuts(i, Cuts());
+    }
+}
+/**
+ * resetCounters
+ *    Zero the accepted/dropped counters e.g. at the start of a run.
+ */
+void
+CHitFilter::resetCounters()
+{
+    for (unsigned i = 0; i < CHANNELS; i++) {
+        m_accepted[i].store(0, std::memory_order_relaxed);
+        m_dropped[i].store(0, std::memory_order_relaxed);
+    }
+}
+/**
+ * counters
+ *    Snapshot a channel's counters.
+ *
+ * @param chan   - The channel.
+ * @param result - Its accepted and dropped hits.
+ */
+void
+CHitFilter::counters(unsigned chan, Counters& result) const
+{
+    result.s_accepted = m_accepted[chan].load(std::memory_order_relaxed);
+    result.s_dropped  = m_dropped[chan].load(std::memory_order_relaxed);
+}
+/*-------------------------------------------------------------------
+ * Private member functions.
+ */
+
+/**
+ * passPha
+ *    Apply a channel's cuts to a PHA hit.
+ */
+bool
+CHitFilter::passPha(const Cuts& cuts, uint16_t energy)
+{
+    if (cuts.s_rejectPileup && (energy & PHA_PILEUP_BIT)) return false;
+    uint32_t e = energy & PHA_ENERGY;
+    return !cuts.s_energyCut || ((e >= cuts.s_energyLow) && (e <= cuts.s_energyHigh));
+}
+/**
+ * passPsd
+ *    Apply a channel's cuts to a PSD hit.  A hit with no long charge has
+ *    no PSD ratio so fails a PSD cut.
+ */
+bool
+CHitFilter::passPsd(const Cuts& cuts, uint16_t qShort, uint16_t qLong, bool pileup)
+{
+    if (cuts.s_rejectPileup && pileup) return false;
+    if (cuts.s_energyCut && ((qLong < cuts.s_energyLow) || (qLong > cuts.s_energyHigh))) {
+        return false;
+    }
+    if (cuts.s_psdCut) {
+        if (!qLong) return false;
+        double psd = (double(qLong) - double(qShort))/qLong;
+        if ((psd < cuts.s_psdLow) || (psd > cuts.s_psdHigh)) return false;
+    }
+    return true;
+}
@@ -0,0 +1,120 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CHitFilter.h
+# @brief Per channel software cuts that drop hits before they're formatted.
+
+*/
+#ifndef CHITFILTER_H
+#define CHITFILTER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <CAENDigitizerType.h>
+
+/**
+ * @class CHitFilter
+ *    The event segments ask us about each hit before formatting it.  Hits
+ *    that fail their channel's cuts are dropped in the readout, so they
+ *    never cost ring, event builder or disk bandwidth.  The cuts are
+ *    read from the Compass configuration (the DAQ_PARAM_CH_* keys, see
+ *    CompassProject and PSDParameters):
+ *
+ *    - An energy window: PHA energy, PSD long gate charge.
+ *    - Rejection of hits the board flagged as piled up.
+ *    - PSD only: a window on the ratio (long - short)/long of the charges.
+ *
+ *    The Cuts also mark low priority channels, whose hits are the first
+ *    dropped when the readout is overloaded (see COverloadController).
+ *
+ *    Channels with no cuts accept everything at the cost of one test.
+ *    Accepted and dropped hits are counted per channel.  Only the readout
+ *    thread counts, with relaxed atomics, so counters() may be called from
+ *    any thread (e.g. the scalers).
+ */
+class CHitFilter
+{
+public:
+    static const unsigned CHANNELS = CAEN_DGTZ_MAX_CHANNEL;
+
+    struct Cuts {
+        bool     s_energyCut;        // Keep energies in [s_energyLow, s_energyHigh].
+        uint32_t s_energyLow;
+        uint32_t s_energyHigh;
+        bool     s_rejectPileup;     // Drop piled up hits.
+        bool     s_psdCut;           // Keep PSD ratios in [s_psdLow, s_psdHigh].
+        double   s_psdLow;
+        double   s_psdHigh;
+        bool     s_lowPriority;      // Shed first under overload.
+
+        Cuts();
+        bool any() const { return s_energyCut || s_rejectPileup || s_psdCut; }
+    };
+    struct Counters {
+        uint64_t s_accepted;
+        uint64_t s_dropped;
+    };
+    static const uint16_t PHA_PILEUP_BIT = 0x8000;  // In the PHA energy word.
+    static const uint16_t PHA_ENERGY     = 0x7fff;
+
+private:
+    Cuts     m_cuts[CHANNELS];
+    bool     m_active[CHANNELS];
+    std::atomic<uint64_t> m_accepted[CHANNELS];
+    std::atomic<uint64_t> m_dropped[CHANNELS];
+
+public:
+    CHitFilter();
+
+    void setCuts(unsigned chan, const Cuts& cuts);
+    void clearCuts();
+    void resetCounters();
+
+    const Cuts&     cuts(unsigned chan) const     { return m_cuts[chan]; }
+    void            counters(unsigned chan, Counters& result) const;
+
+    /**
+     * acceptPha
+     *
+     * @param chan   - Channel the hit came from.
+     * @param energy - Its energy word, bit 15 the pile up flag.
+     * @return bool  - true to keep the hit.
+     */
+    bool acceptPha(unsigned chan, uint16_t energy)
+    {
+        bool keep = !m_active[chan] || passPha(m_cuts[chan], energy);
+        return count(chan, keep);
+    }
+    /**
+     * acceptPsd
+     *
+     * @param chan    - Channel the hit came from.
+     * @param qShort  - Its short gate charge.
+     * @param qLong   - Its long gate charge.
+     * @param pileup  - Its pile up flag.
+     * @return bool   - true to keep the hit.
+     */
+    bool acceptPsd(unsigned chan, uint16_t qShort, uint16_t qLong, bool pileup)
+    {
+        bool keep = !m_active[chan] || passPsd(m_cuts[chan], qShort, qLong, pileup);
+        return count(chan, keep);
+    }
+
+private:
+    bool count(unsigned chan, bool keep)
+    {
+        std::atomic<uint64_t>& c(keep ? m_accepted[chan] : m_dropped[chan]);
+        c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return keep;
+    }
+    static bool passPha(const Cuts& cuts, uint16_t energy);
+    static bool passPsd(const Cuts& cuts, uint16_t qShort, uint16_t qLong, bool pileup);
+};
+
+#endif
@@ -0,0 +1,159 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file COverloadController.cpp
+# @brief Implement the tiered overload shedding.
+
+*/
+#include "COverloadController.h"
+
+/**
+ * Settings constructor
+ *    Shed traces at half load, low priority channels at 3/4 and prescale
+ *    1 in 10 from 90%.
+ */
+COverloadController::Settings::Settings() :
+    s_hysteresis(0.2), s_smoothing(0.25), s_prescale(10)
+{
+    s_thresholds[DROP_TRACES - 1]       = 0.5;
+    s_thresholds[DROP_LOW_PRIORITY - 1] = 0.75;
+    s_thresholds[PRESCALE - 1]          = 0.9;
+}
+
+/**
+ * constructor
+ *    Disabled until told otherwise: nothing is ever shed.
+ */
+COverloadController::COverloadController() :
+    m_enabled(false)
+{
+    reset();
+}
+/**
+ * setEnabled
+ *
+ * @param enable - true to shed data as the load rises.
+ */
+void
+COverloadController::setEnabled(bool enable)
+{
+    m_enabled = enable;
+    if (!enable) setTier(NORMAL);
+}
+/**
+ * setSettings
+ *
+ * @param settings - The new thresholds, hysteresis, smoothing and prescale.
+ */
+void
+COverloadController::setSettings(const Settings& settings)
+{
+    m_settings = settings;
+    if (!m_settings.s_prescale) m_settings.s_prescale = 1;
+}
+/**
+ * reset
+ *    Back to no load and zero counters e.g. at the start of a run.
+ */
+void
+COverloadController::reset()
+{
+    m_load = 0.0;
+    m_tier = NORMAL;
+    for (unsigned i = 0; i < CHANNELS; i++) {
+        m_countdown[i] = 0;
+    }
+    m_publishedTier   = NORMAL;
+    m_highestTier     = NORMAL;
+    m_escalations     = 0;
+    m_tracesShed      = 0;
+    m_lowPriorityShed = 0;
+    m_prescaled       = 0;
+}
+/**
+ * counters
+ *    Get the tier and shed counts.
+ *
+ * @param result - Receives them.
+ */
+void
+COverloadController::counters(Counters& result) const
+{
+    result.s_tier            = m_publishedTier.load(std::memory_order_relaxed);
+    result.s_highestTier     = m_highestTier.load(std::memory_order_relaxed);
+    result.s_escalations     = m_escalations.load(std::memory_order_relaxed);
+    result.s_tracesShed      = m_tracesShed.load(std::memory_order_relaxed);
+    result.s_lowPriorityShed = m_lowPriorityShed.load(std::memory_order_relaxed);
+    result.s_prescaled       = m_prescaled.load(std::memory_order_relaxed);
+}
+/**
+ * sample
+ *    Fold in the load of a block transfer and move between tiers.  Empty
+ *    transfers count too, so the tiers relax when the board goes quiet.
+ *
+ * @param load - 0 (nothing waiting) to 1 (the readout is full).
+ */
+void
+COverloadController::sample(double load)
+{
+    if (!m_enabled) return;
+    m_load += m_settings.s_smoothing*(load - m_load);
+
+    unsigned tier = m_tier;
+    while ((tier < PRESCALE) && (m_load >= m_settings.s_thresholds[tier])) {
+        tier++;
+    }
+    while ((tier > NORMAL) &&
+           (m_load < m_settings.s_thresholds[tier - 1] - m_settings.s_hysteresis)) {
+        tier--;
+    }
+    setTier(tier);
+}
+
+/*-------------------------------------------------------------------
+ * Private member functions.
+ */
+
+/**
+ * acceptOverloaded
+ *    accept() for the tiers that drop hits.
+ */
+bool
+COverloadController::acceptOverloaded(unsigned chan, bool lowPriority)
+{
+    if (lowPriority) {
+        m_lowPriorityShed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (m_tier < PRESCALE) return true;
+    if (m_countdown[chan]) {
+        m_countdown[chan]--;
+        m_prescaled.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    m_countdown[chan] = m_settings.s_prescale - 1;
+    return true;
+}
+/**
+ * setTier
+ *    Change tiers, counting escalations.
+ */
+void
+COverloadController::setTier(unsigned tier)
+{
+    if (tier == m_tier) return;
+    if (tier > m_tier) {
+        m_escalations.fetch_add(tier - m_tier, std::memory_order_relaxed);
+        if (tier > m_highestTier.load(std::memory_order_relaxed)) {
+            m_highestTier.store(tier, std::memory_order_relaxed);
+        }
+    }
+    m_tier = tier;
+    m_publishedTier.store(tier, std::memory_order_relaxed);
+}
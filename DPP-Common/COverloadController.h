@@ -0,0 +1,122 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file COverloadController.h
+# @brief Shed data in tiers when a board's readout can't keep up.
+
+*/
+#ifndef COVERLOADCONTROLLER_H
+#define COVERLOADCONTROLLER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <CAENDigitizerType.h>
+
+/**
+ * @class COverloadController
+ *    When the ring backs up Readout stalls and the board's memory fills
+ *    until it loses triggers.  The drivers give us the load of each block
+ *    transfer they take, the fraction of the readout buffer it filled or,
+ *    with a background reader, the fraction of its ring of blocks waiting
+ *    to be formatted.  The load is smoothed and, as it rises past each
+ *    threshold, we go up a tier, shedding more data:
+ *
+ *    - DROP_TRACES       - hits go out without their traces.
+ *    - DROP_LOW_PRIORITY - hits from low priority channels are dropped too
+ *                          (DAQ_PARAM_CH_LOW_PRIORITY, see CHitFilter).
+ *    - PRESCALE          - and only 1 in prescale hits of each of the other
+ *                          channels is kept.
+ *
+ *    A tier is left when the load falls hysteresis below its threshold.
+ *    The tier and what's been shed are counted so the scalers can report
+ *    them; counters() may be called from any thread.
+ */
+class COverloadController
+{
+public:
+    static const unsigned CHANNELS = CAEN_DGTZ_MAX_CHANNEL;
+
+    enum Tier { NORMAL, DROP_TRACES, DROP_LOW_PRIORITY, PRESCALE, TIERS };
+
+    struct Settings {
+        double   s_thresholds[TIERS - 1]; // Load to enter DROP_TRACES...PRESCALE.
+        double   s_hysteresis;            // Below a threshold to leave its tier.
+        double   s_smoothing;             // Weight of each new load sample.
+        unsigned s_prescale;              // PRESCALE keeps 1 in this many hits.
+
+        Settings();
+    };
+    struct Counters {
+        uint32_t s_tier;                  // Current tier.
+        uint32_t s_highestTier;           // This run.
+        uint64_t s_escalations;           // Times a tier was entered.
+        uint64_t s_tracesShed;            // Hits whose traces were dropped.
+        uint64_t s_lowPriorityShed;       // Low priority hits dropped.
+        uint64_t s_prescaled;             // Hits dropped by the prescale.
+    };
+
+private:
+    Settings m_settings;
+    bool     m_enabled;
+    double   m_load;                      // Smoothed.
+    unsigned m_tier;
+    unsigned m_countdown[CHANNELS];       // Hits to drop before the next kept one.
+
+    std::atomic<uint32_t> m_publishedTier;
+    std::atomic<uint32_t> m_highestTier;
+    std::atomic<uint64_t> m_escalations;
+    std::atomic<uint64_t> m_tracesShed;
+    std::atomic<uint64_t> m_lowPriorityShed;
+    std::atomic<uint64_t> m_prescaled;
+
+public:
+    COverloadController();
+
+    void setEnabled(bool enable);
+    void setSettings(const Settings& settings);
+    void reset();
+
+    bool            enabled() const  { return m_enabled; }
+    const Settings& settings() const { return m_settings; }
+    Tier            tier() const     { return static_cast<Tier>(m_tier); }
+    void            counters(Counters& result) const;
+
+    void sample(double load);
+
+    /**
+     * keepTrace
+     *    Asked about each hit whose trace would otherwise be kept.
+     *
+     * @return bool - false if traces are being shed.
+     */
+    bool keepTrace()
+    {
+        if (m_tier < DROP_TRACES) return true;
+        m_tracesShed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    /**
+     * accept
+     *    Asked once for each hit that passed its channel's cuts.
+     *
+     * @param chan        - Channel the hit came from.
+     * @param lowPriority - The channel is shed before the others.
+     * @return bool       - false to drop the hit.
+     */
+    bool accept(unsigned chan, bool lowPriority)
+    {
+        return (m_tier < DROP_LOW_PRIORITY) || acceptOverloaded(chan, lowPriority);
+    }
+
+private:
+    bool acceptOverloaded(unsigned chan, bool lowPriority);
+    void setTier(unsigned tier);
+};
+
+#endif
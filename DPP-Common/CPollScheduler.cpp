@@ -0,0 +1,93 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CPollScheduler.cpp
+# @brief Implement the trigger poll scheduler.
+
+*/
+#include "CPollScheduler.h"
+#include <algorithm>
+
+// Weight of the newest poll in the occupancy moving average:
+
+static const double OCCUPANCY_WEIGHT = 1.0/64;
+
+/**
+ * constructor
+ *
+ * @param maxLatencyUs - Longest an idle board goes unpolled, us.
+ *                       0 polls every board every time.
+ */
+CPollScheduler::CPollScheduler(unsigned maxLatencyUs) :
+    m_maxLatency(maxLatencyUs)
+{}
+/**
+ * addBoard
+ *    Add a board.  Boards are numbered in the order they're added.
+ */
+void
+CPollScheduler::addBoard()
+{
+    Board b;
+    m_boards.push_back(b);
+    reset();
+}
+/**
+ * setMaxLatency
+ *    Change the longest time an idle board goes unpolled.
+ *
+ * @param maxLatencyUs - us, 0 to poll every board every time.
+ */
+void
+CPollScheduler::setMaxLatency(unsigned maxLatencyUs)
+{
+    m_maxLatency = std::chrono::microseconds(maxLatencyUs);
+}
+/**
+ * reset
+ *    Make all boards due and zero the statistics, e.g. at the start of a run.
+ */
+void
+CPollScheduler::reset()
+{
+    for (size_t i = 0; i < m_boards.size(); i++) {
+        Board& b(m_boards[i]);
+        b.s_stats.s_polls     = 0;
+        b.s_stats.s_found     = 0;
+        b.s_stats.s_skipped   = 0;
+        b.s_stats.s_occupancy = 0.0;
+        b.s_stats.s_backoffUs = 0;
+        b.s_due               = Clock::time_point();
+    }
+}
+/**
+ * record
+ *    Note the outcome of polling a board and schedule its next poll.
+ *
+ * @param board - Board index.
+ * @param found - true if the poll found data.
+ * @param now   - When the board was polled.
+ */
+void
+CPollScheduler::record(size_t board, bool found, Clock::time_point now)
+{
+    Board&      b(m_boards[board]);
+    Statistics& s(b.s_stats);
+    s.s_polls++;
+    s.s_occupancy += OCCUPANCY_WEIGHT*((found ? 1.0 : 0.0) - s.s_occupancy);
+    if (found) {
+        s.s_found++;
+        s.s_backoffUs = 0;
+        b.s_due       = now;
+        return;
+    }
+    unsigned maxUs = m_maxLatency.count();
+    s.s_backoffUs  = std::min(maxUs, s.s_backoffUs ? 2*s.s_backoffUs : INITIAL_BACKOFF);
+    b.s_due        = now + std::chrono::microseconds(s.s_backoffUs);
+}
@@ -0,0 +1,94 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CPollScheduler.h
+# @brief Decide which boards a trigger should poll for data.
+
+*/
+#ifndef CPOLLSCHEDULER_H
+#define CPOLLSCHEDULER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <chrono>
+
+/**
+ * @class CPollScheduler
+ *    A board's checkTrigger costs a block transfer (ReadData) whenever
+ *    nothing is buffered, even if the board is idle.  On a daisy chained
+ *    optical link those transfers take link time the busy boards need.
+ *    The triggers (CompassTrigger, CPsdTrigger) ask us whether each board
+ *    is due to be polled and tell us what the poll found:
+ *
+ *    - A poll that finds data makes the board due again at once.
+ *    - Each poll in a row that finds nothing doubles the time until the
+ *      board is next due, from INITIAL_BACKOFF up to the maximum latency.
+ *
+ *    So busy boards are polled every time round and idle ones back off
+ *    exponentially, yet a hit on an idle board waits at most the maximum
+ *    latency to be noticed.  A maximum latency of 0 (the default) polls
+ *    every board every time, as the triggers always have.
+ *
+ *    Per board statistics are kept for tuning: polls made and skipped,
+ *    polls that found data, and an estimate of the board's occupancy -
+ *    the fraction of recent polls that found data.
+ */
+class CPollScheduler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Statistics {
+        uint64_t s_polls;          // checkTrigger calls.
+        uint64_t s_found;          // ... that found data.
+        uint64_t s_skipped;        // Polls skipped as the board was backing off.
+        double   s_occupancy;      // Moving average of found/polls.
+        unsigned s_backoffUs;      // Current time between polls.
+    };
+    static const unsigned INITIAL_BACKOFF = 10;    // us.
+
+private:
+    struct Board {
+        Statistics        s_stats;
+        Clock::time_point s_due;
+    };
+    std::vector<Board>        m_boards;
+    std::chrono::microseconds m_maxLatency;
+
+public:
+    CPollScheduler(unsigned maxLatencyUs = 0);
+
+    void addBoard();
+    void setMaxLatency(unsigned maxLatencyUs);
+    void reset();
+
+    /**
+     * due
+     *    Inline as it's asked for each board on every trigger check.
+     *
+     * @param board - Board index (order of addBoard).
+     * @param now   - The time of the trigger check.
+     * @return bool - true if the board should be polled now.  If not, the
+     *                skip is counted.
+     */
+    bool due(size_t board, Clock::time_point now)
+    {
+        Board& b(m_boards[board]);
+        if (now >= b.s_due) return true;
+        b.s_stats.s_skipped++;
+        return false;
+    }
+    void record(size_t board, bool found, Clock::time_point now);
+
+    size_t            size() const               { return m_boards.size(); }
+    const Statistics& statistics(size_t board) const { return m_boards[board].s_stats; }
+};
+
+#endif
@@ -0,0 +1,221 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CRecordingDigitizer.cpp
+# @brief Implement the raw block capture backend.
+
+*/
+#include "CRecordingDigitizer.h"
+#include "DppCaptureFormat.h"
+#include <iostream>
+#include <chrono>
+#include <string.h>
+
+/**
+ * wallClock
+ * @return uint64_t - ns since the epoch.
+ */
+static uint64_t
+wallClock()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+}
+
+/**
+ * constructor
+ *
+ * @param pBackend - Backend that really accesses the boards (nullptr for the
+ *                   current default).
+ * @param prefix   - Path prefix of the capture files.
+ */
+CRecordingDigitizer::CRecordingDigitizer(CDigitizerBackend* pBackend, const std::string& prefix) :
+    CForwardingDigitizer(pBackend), m_prefix(prefix)
+{}
+/**
+ * destructor
+ *    Finish any captures still open.
+ */
+CRecordingDigitizer::~CRecordingDigitizer()
+{
+    for (auto p = m_captures.begin(); p != m_captures.end(); p++) {
+        endCapture(*p->second);
+        delete p->second;
+    }
+}
+
+/**
+ * openDigitizer
+ *    Open the board and remember where it is and what it is for the
+ *    capture file headers.
+ */
+CAEN_DGTZ_ErrorCode
+CRecordingDigitizer::openDigitizer(
+    CAEN_DGTZ_ConnectionType linkType, int linkNum, int conetNode,
+    uint32_t vmeBase, int* handle
+)
+{
+    CAEN_DGTZ_ErrorCode status =
+        m_pBackend->openDigitizer(linkType, linkNum, conetNode, vmeBase, handle);
+    if (status != CAEN_DGTZ_Success) return status;
+
+    Capture* pCapture   = new Capture;
+    pCapture->s_linkNum = linkNum;
+    pCapture->s_node    = conetNode;
+    pCapture->s_nBlocks = 0;
+    pCapture->s_nBytes  = 0;
+    status = m_pBackend->getInfo(*handle, &pCapture->s_info);
+    if (status != CAEN_DGTZ_Success) {
+        delete pCapture;
+        m_pBackend->closeDigitizer(*handle);
+        return status;
+    }
+    std::lock_guard<std::mutex> guard(m_lock);
+    delete m_captures[*handle];
+    m_captures[*handle] = pCapture;
+    return CAEN_DGTZ_Success;
+}
+CAEN_DGTZ_ErrorCode
+CRecordingDigitizer::closeDigitizer(int handle)
+{
+    Capture* pCapture = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        auto p = m_captures.find(handle);
+        if (p != m_captures.end()) {
+            pCapture = p->second;
+            m_captures.erase(p);
+        }
+    }
+    if (pCapture) {
+        endCapture(*pCapture);
+        delete pCapture;
+    }
+    return m_pBackend->closeDigitizer(handle);
+}
+/**
+ * swStartAcquisition
+ *    Start a new capture file for the board then start it.
+ */
+CAEN_DGTZ_ErrorCode
+CRecordingDigitizer::swStartAcquisition(int handle)
+{
+    Capture* pCapture = findCapture(handle);
+    if (pCapture) {
+        unsigned run;
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            run = m_runs[std::make_pair(pCapture->s_linkNum, pCapture->s_node)]++;
+        }
+        std::lock_guard<std::mutex> guard(pCapture->s_lock);
+        endCapture(*pCapture);
+
+        pCapture->s_filename =
+            DppCapture::fileName(m_prefix, pCapture->s_linkNum, pCapture->s_node, run);
+        pCapture->s_file.open(pCapture->s_filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!pCapture->s_file) {
+            std::cerr << "Unable to create capture file " << pCapture->s_filename << std::endl;
+            pCapture->s_file.clear();
+            return CAEN_DGTZ_GenericError;
+        }
+        DppCapture::FileHeader header;
+        memset(&header, 0, sizeof(header));
+        header.s_magic     = DppCapture::MAGIC;
+        header.s_version   = DppCapture::VERSION;
+        header.s_infoSize  = sizeof(CAEN_DGTZ_BoardInfo_t);
+        header.s_linkNum   = pCapture->s_linkNum;
+        header.s_node      = pCapture->s_node;
+        header.s_run       = run;
+        header.s_startTime = wallClock();
+        pCapture->s_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        pCapture->s_file.write(
+            reinterpret_cast<const char*>(&pCapture->s_info), sizeof(CAEN_DGTZ_BoardInfo_t)
+        );
+        pCapture->s_nBlocks = 0;
+        pCapture->s_nBytes  = 0;
+    }
+    return m_pBackend->swStartAcquisition(handle);
+}
+/**
+ * swStopAcquisition
+ *    Stop the board and close its capture.  Blocks read after the stop
+ *    (draining the board) are not captured.
+ */
+CAEN_DGTZ_ErrorCode
+CRecordingDigitizer::swStopAcquisition(int handle)
+{
+    CAEN_DGTZ_ErrorCode status = m_pBackend->swStopAcquisition(handle);
+    Capture* pCapture = findCapture(handle);
+    if (pCapture) {
+        std::lock_guard<std::mutex> guard(pCapture->s_lock);
+        endCapture(*pCapture);
+    }
+    return status;
+}
+/**
+ * readData
+ *    Read and, if anything was read, capture the block.
+ */
+CAEN_DGTZ_ErrorCode
+CRecordingDigitizer::readData(
+    int handle, CAEN_DGTZ_ReadMode_t mode, char* buffer, uint32_t* bufferSize
+)
+{
+    CAEN_DGTZ_ErrorCode status = m_pBackend->readData(handle, mode, buffer, bufferSize);
+    if ((status != CAEN_DGTZ_Success) || (*bufferSize == 0)) return status;
+
+    Capture* pCapture = findCapture(handle);
+    if (!pCapture) return status;
+    std::lock_guard<std::mutex> guard(pCapture->s_lock);
+    if (!pCapture->s_file.is_open()) return status;
+
+    DppCapture::BlockHeader header;
+    header.s_nBytes    = *bufferSize;
+    header.s_unused    = 0;
+    header.s_wallClock = wallClock();
+    pCapture->s_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    pCapture->s_file.write(buffer, *bufferSize);
+    if (!pCapture->s_file) {
+        std::cerr << "Write to capture file " << pCapture->s_filename
+                  << " failed - capture ended\n";
+        pCapture->s_file.close();
+        pCapture->s_file.clear();
+    } else {
+        pCapture->s_nBlocks++;
+        pCapture->s_nBytes += *bufferSize;
+    }
+    return status;
+}
+
+/*------------------------------------------------------------------------------
+ * private utilities.
+ */
+
+CRecordingDigitizer::Capture*
+CRecordingDigitizer::findCapture(int handle)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    auto p = m_captures.find(handle);
+    return (p == m_captures.end()) ? nullptr : p->second;
+}
+/**
+ * endCapture
+ *    Close a capture's file if open, reporting what it holds.
+ *    The caller must hold the capture's lock (or own it outright).
+ */
+void
+CRecordingDigitizer::endCapture(Capture& capture)
+{
+    if (capture.s_file.is_open()) {
+        capture.s_file.close();
+        std::cout << "Captured " << capture.s_nBlocks << " blocks ("
+                  << capture.s_nBytes << " bytes) in " << capture.s_filename << std::endl;
+    }
+}
@@ -0,0 +1,80 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CRecordingDigitizer.h
+# @brief Backend that captures every raw readout block to file.
+
+*/
+#ifndef CRECORDINGDIGITIZER_H
+#define CRECORDINGDIGITIZER_H
+
+#include "CForwardingDigitizer.h"
+#include <string>
+#include <map>
+#include <mutex>
+#include <fstream>
+
+/**
+ * @class CRecordingDigitizer
+ *    Sits in front of the backend that really talks to the boards and
+ *    tees each non-empty block ReadData returns, with its size and the wall
+ *    clock time it was read, into a capture file (see DppCaptureFormat.h).
+ *    Since the drivers' fillBuffers/fillBuffer (or their background
+ *    CDppReadoutThread) all read through the backend, every block of every
+ *    board opened through us is captured.
+ *
+ *    Each run of each board gets its own file, named by
+ *    DppCapture::fileName(prefix, link, node, run) where run counts the
+ *    board's swStartAcquisition calls from 0.  CReplayDigitizer plays the
+ *    files back.
+ *
+ *    A capture file that can't be created fails swStartAcquisition with
+ *    CAEN_DGTZ_GenericError.  A write failure is reported and ends that
+ *    capture but the data still go to the driver.
+ */
+class CRecordingDigitizer : public CForwardingDigitizer
+{
+private:
+    struct Capture {
+        int                   s_linkNum;
+        int                   s_node;
+        CAEN_DGTZ_BoardInfo_t s_info;
+        std::mutex            s_lock;
+        std::ofstream         s_file;
+        std::string           s_filename;
+        uint64_t              s_nBlocks;
+        uint64_t              s_nBytes;
+    };
+
+    std::string            m_prefix;
+    std::mutex             m_lock;
+    std::map<int, Capture*> m_captures;          // By handle.
+    std::map<std::pair<int, int>, unsigned> m_runs;  // Starts per link/node.
+
+public:
+    CRecordingDigitizer(CDigitizerBackend* pBackend, const std::string& prefix);
+    virtual ~CRecordingDigitizer();
+
+    virtual CAEN_DGTZ_ErrorCode openDigitizer(
+        CAEN_DGTZ_ConnectionType linkType, int linkNum, int conetNode,
+        uint32_t vmeBase, int* handle
+    );
+    virtual CAEN_DGTZ_ErrorCode closeDigitizer(int handle);
+    virtual CAEN_DGTZ_ErrorCode swStartAcquisition(int handle);
+    virtual CAEN_DGTZ_ErrorCode swStopAcquisition(int handle);
+    virtual CAEN_DGTZ_ErrorCode readData(
+        int handle, CAEN_DGTZ_ReadMode_t mode, char* buffer, uint32_t* bufferSize
+    );
+
+private:
+    Capture* findCapture(int handle);
+    void     endCapture(Capture& capture);
+};
+
+#endif
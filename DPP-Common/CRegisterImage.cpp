@@ -0,0 +1,243 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CRegisterImage.cpp
+# @brief Read, write and apply register images.
+
+*/
+#include "CRegisterImage.h"
+#include "CDigitizerBackend.h"
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string.h>
+
+/**
+ * constructor
+ *    An empty image.
+ */
+CRegisterImage::CRegisterImage() :
+    m_flags(0), m_configHash(0)
+{}
+
+/**
+ * read
+ *    Replace the image with the one in a file.
+ *
+ * @param filename - The image.
+ * @throw std::string - the file can't be read, isn't an image or its
+ *                      checksum is wrong.
+ */
+void
+CRegisterImage::read(const std::string& filename)
+{
+    std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!in) {
+        throw std::string("Unable to open register image ") + filename;
+    }
+    std::string contents(
+        (std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>()
+    );
+    clear();
+
+    uint64_t checksum;
+    FileHeader header;
+    if (contents.size() < sizeof(header) + sizeof(checksum)) {
+        throw filename + " is too short to be a register image";
+    }
+    size_t nBytes = contents.size() - sizeof(checksum);
+    memcpy(&checksum, contents.data() + nBytes, sizeof(checksum));
+    memcpy(&header, contents.data(), sizeof(header));
+    if (header.s_magic != MAGIC || header.s_version != VERSION) {
+        throw filename + " is not a version 1 register image";
+    }
+    if (checksum != hash(contents.data(), nBytes)) {
+        throw filename + ": register image checksum mismatch";
+    }
+
+    size_t offset = sizeof(header);
+    for (uint32_t i = 0; i < header.s_nBoards; i++) {
+        BoardHeader board;
+        if (offset + sizeof(board) > nBytes) break;
+        memcpy(&board, contents.data() + offset, sizeof(board));
+        offset += sizeof(board);
+        if (offset + board.s_nWrites*sizeof(Write) > nBytes) break;
+
+        Board& b(addBoard(board));
+        b.s_writes.resize(board.s_nWrites);
+        memcpy(b.s_writes.data(), contents.data() + offset, board.s_nWrites*sizeof(Write));
+        offset += board.s_nWrites*sizeof(Write);
+    }
+    if ((m_boards.size() != header.s_nBoards) || (offset != nBytes)) {
+        clear();
+        throw filename + ": register image sizes are inconsistent";
+    }
+    m_flags      = header.s_flags;
+    m_configHash = header.s_configHash;
+}
+/**
+ * write
+ *
+ * @param filename - Where.
+ * @throw std::string - the file can't be written.
+ */
+void
+CRegisterImage::write(const std::string& filename) const
+{
+    FileHeader header = {MAGIC, VERSION, uint32_t(m_boards.size()), m_flags, m_configHash};
+    std::string contents(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (size_t i = 0; i < m_boards.size(); i++) {
+        BoardHeader board = m_boards[i].s_header;
+        board.s_nWrites   = m_boards[i].s_writes.size();
+        contents.append(reinterpret_cast<const char*>(&board), sizeof(board));
+        contents.append(
+            reinterpret_cast<const char*>(m_boards[i].s_writes.data()),
+            board.s_nWrites*sizeof(Write)
+        );
+    }
+    uint64_t checksum = hash(contents.data(), contents.size());
+    contents.append(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+
+    std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::string("Unable to create register image ") + filename;
+    }
+    out.write(contents.data(), contents.size());
+    if (!out) {
+        throw std::string("Failed writing register image ") + filename;
+    }
+}
+/**
+ * clear
+ *    Forget all boards.
+ */
+void
+CRegisterImage::clear()
+{
+    m_flags      = 0;
+    m_configHash = 0;
+    m_boards.clear();
+}
+/**
+ * addBoard
+ *
+ * @param header - The board's identification (s_nWrites is ignored).
+ * @return Board& - The new board, to which to add the writes.
+ */
+CRegisterImage::Board&
+CRegisterImage::addBoard(const BoardHeader& header)
+{
+    m_boards.push_back(Board());
+    m_boards.back().s_header = header;
+    return m_boards.back();
+}
+/**
+ * find
+ * @param serial  - A board's serial number.
+ * @return const Board* - Its image, nullptr if there's none.
+ */
+const CRegisterImage::Board*
+CRegisterImage::find(uint32_t serial) const
+{
+    for (size_t i = 0; i < m_boards.size(); i++) {
+        if (m_boards[i].s_header.s_serial == serial) return &m_boards[i];
+    }
+    return nullptr;
+}
+/**
+ * hashFiles
+ *    Hash what an image is compiled from.
+ *
+ * @param configFile - The Compass XML.
+ * @param pCheatFile - The cheat file, nullptr if none.  As the drivers
+ *                     skip one they can't open, it then hashes as empty.
+ * @return uint64_t
+ * @throw std::string - the configuration can't be read.
+ */
+uint64_t
+CRegisterImage::hashFiles(const std::string& configFile, const char* pCheatFile)
+{
+    std::ifstream config(configFile.c_str(), std::ios::in | std::ios::binary);
+    if (!config) {
+        throw std::string("Unable to open configuration ") + configFile;
+    }
+    std::string contents(
+        (std::istreambuf_iterator<char>(config)), std::istreambuf_iterator<char>()
+    );
+    uint64_t result = hash(contents.data(), contents.size());
+
+    if (pCheatFile) {
+        std::ifstream cheat(pCheatFile, std::ios::in | std::ios::binary);
+        std::string cheats(
+            (std::istreambuf_iterator<char>(cheat)), std::istreambuf_iterator<char>()
+        );
+        result = hash("\0", 1, result);          // No cheat file differs from an empty one.
+        result = hash(cheats.data(), cheats.size(), result);
+    }
+    return result;
+}
+/**
+ * hash
+ *    64 bit FNV-1a.
+ *
+ * @param pData  - Bytes to hash.
+ * @param nBytes - How many.
+ * @param seed   - Hash of what precedes them, if anything.
+ * @return uint64_t
+ */
+uint64_t
+CRegisterImage::hash(const void* pData, size_t nBytes, uint64_t seed)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(pData);
+    for (size_t i = 0; i < nBytes; i++) {
+        seed = (seed ^ p[i]) * 0x100000001b3ULL;
+    }
+    return seed;
+}
+/**
+ * isDcOffset
+ * @param address - A register.
+ * @return bool - true if it's a channel's DC offset, whose write loads a DAC.
+ */
+bool
+CRegisterImage::isDcOffset(uint32_t address)
+{
+    return ((address & 0xf0ff) == 0x1098);
+}
+/**
+ * apply
+ *    Do a board's writes.  As the library does, a DC offset isn't written
+ *    while its channel's DAC is still busy with a prior one (channel status
+ *    bit 2).
+ *
+ * @param pBackend - Through which.
+ * @param handle   - The board.
+ * @param board    - Its image.
+ * @return CAEN_DGTZ_ErrorCode - of the first access that failed.
+ */
+CAEN_DGTZ_ErrorCode
+CRegisterImage::apply(CDigitizerBackend* pBackend, int handle, const Board& board)
+{
+    const std::vector<Write>& writes(board.s_writes);
+    for (size_t i = 0; i < writes.size(); i++) {
+        CAEN_DGTZ_ErrorCode status;
+        if (isDcOffset(writes[i].s_address)) {
+            uint32_t statusRegister = (writes[i].s_address & 0xff00) | 0x88;
+            uint32_t channelStatus;
+            int      tries = 1000;
+            do {
+                status = pBackend->readRegister(handle, statusRegister, &channelStatus);
+                if (status != CAEN_DGTZ_Success) return status;
+            } while ((channelStatus & 4) && --tries);
+        }
+        status = pBackend->writeRegister(handle, writes[i].s_address, writes[i].s_value);
+        if (status != CAEN_DGTZ_Success) return status;
+    }
+    return CAEN_DGTZ_Success;
+}
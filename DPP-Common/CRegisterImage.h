@@ -0,0 +1,105 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CRegisterImage.h
+# @brief Compiled register settings of the boards of a Compass configuration.
+
+*/
+#ifndef CREGISTERIMAGE_H
+#define CREGISTERIMAGE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <CAENDigitizerType.h>
+
+class CDigitizerBackend;
+
+/**
+ * @class CRegisterImage
+ *    A setup from a Compass configuration goes from the XML through the
+ *    parameter structs, the library's Set* calls and their conversions,
+ *    and the cheat file, to the boards' registers.  dppregcompile does that
+ *    once and saves the configuration registers it produced on each board.
+ *    A driver given the image then sets the board up by writing them in a
+ *    tight loop (see apply).
+ *
+ *    The image holds a hash of the XML and cheat file it was compiled from
+ *    (hashFiles) so a stale one can be recognized, and the options of the
+ *    driver that change registers (FINE_TIMESTAMPS).  Boards are found by
+ *    serial number.
+ *
+ *    The file is, all values host (little endian) order:
+ *
+ *    \verbatim
+ *    FileHeader
+ *    For each board:
+ *       BoardHeader
+ *       BoardHeader::s_nWrites Writes, in the order they're to be done.
+ *    uint64_t FNV-1a hash of all that precedes it.
+ *    \endverbatim
+ */
+class CRegisterImage
+{
+public:
+    static const uint32_t MAGIC   = 0x4d495244;     // "DRIM"
+    static const uint32_t VERSION = 1;
+    static const uint32_t FINE_TIMESTAMPS = 1;      // Flag: compiled with them.
+
+    struct FileHeader {
+        uint32_t s_magic;
+        uint32_t s_version;
+        uint32_t s_nBoards;
+        uint32_t s_flags;
+        uint64_t s_configHash;                      // hashFiles of the source.
+    };
+    struct BoardHeader {
+        int32_t  s_linkType;                        // CAEN_DGTZ_ConnectionType.
+        int32_t  s_linkNum;
+        int32_t  s_node;
+        uint32_t s_base;
+        uint32_t s_serial;
+        uint32_t s_nWrites;
+    };
+    struct Write {
+        uint32_t s_address;
+        uint32_t s_value;
+    };
+    struct Board {
+        BoardHeader        s_header;
+        std::vector<Write> s_writes;
+    };
+
+private:
+    uint32_t           m_flags;
+    uint64_t           m_configHash;
+    std::vector<Board> m_boards;
+
+public:
+    CRegisterImage();
+
+    void read(const std::string& filename);
+    void write(const std::string& filename) const;
+
+    void     clear();
+    void     setFlags(uint32_t flags)        { m_flags = flags; }
+    uint32_t flags() const                   { return m_flags; }
+    void     setConfigHash(uint64_t hash)    { m_configHash = hash; }
+    uint64_t configHash() const              { return m_configHash; }
+    Board&   addBoard(const BoardHeader& header);
+    const Board* find(uint32_t serial) const;
+    const std::vector<Board>& boards() const { return m_boards; }
+
+    static uint64_t hashFiles(const std::string& configFile, const char* pCheatFile);
+    static uint64_t hash(const void* pData, size_t nBytes, uint64_t seed = 0xcbf29ce484222325ULL);
+    static bool     isDcOffset(uint32_t address);
+    static CAEN_DGTZ_ErrorCode apply(CDigitizerBackend* pBackend, int handle, const Board& board);
+};
+
+#endif
@@ -0,0 +1,153 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CReorderWindow.cpp
+# @brief Implement the cross board reorder window.
+
+*/
+#include "CReorderWindow.h"
+#include "CTimeOrderedSource.h"
+#include <algorithm>
+
+/**
+ * constructor
+ *
+ * @param windowNs  - How much older than the newest buffered hit the
+ *                    oldest must be to be emitted while some source has
+ *                    nothing buffered.
+ * @param maxHoldMs - Longest the oldest hit is held, ms.
+ */
+CReorderWindow::CReorderWindow(uint64_t windowNs, unsigned maxHoldMs) :
+    m_polled(false), m_windowNs(windowNs), m_maxHold(maxHoldMs), m_holding(false)
+{}
+/**
+ * addSource
+ *    Add a source.  select returns sources by the order they were added.
+ *
+ * @param pSource - The source, which must live as long as we do.
+ */
+void
+CReorderWindow::addSource(CTimeOrderedSource* pSource)
+{
+    m_sources.push_back(pSource);
+    m_ready.push_back(false);
+}
+/**
+ * setWindow
+ *    Change the window (see the constructor).
+ */
+void
+CReorderWindow::setWindow(uint64_t windowNs, unsigned maxHoldMs)
+{
+    m_windowNs = windowNs;
+    m_maxHold  = std::chrono::milliseconds(maxHoldMs);
+}
+/**
+ * reset
+ *    Forget what we know about the sources, e.g. at the start of a run.
+ */
+void
+CReorderWindow::reset()
+{
+    std::fill(m_ready.begin(), m_ready.end(), false);
+    m_polled  = false;
+    m_holding = false;
+}
+/**
+ * poll
+ *    Ask the sources not known to have a hit buffered whether they do.
+ *
+ * @return bool - true if any source has a hit buffered.
+ */
+bool
+CReorderWindow::poll()
+{
+    bool any = false;
+    for (size_t i = 0; i < m_sources.size(); i++) {
+        if (!m_ready[i]) m_ready[i] = m_sources[i]->checkTrigger();
+        any = any || m_ready[i];
+    }
+    m_polled = true;
+    return any;
+}
+/**
+ * nextTimestamp
+ *    Only valid after poll returned true.
+ * @return uint64_t - the oldest next timestamp of the sources.
+ */
+uint64_t
+CReorderWindow::nextTimestamp() const
+{
+    uint64_t result = UINT64_MAX;
+    for (size_t i = 0; i < m_sources.size(); i++) {
+        if (m_ready[i]) result = std::min(result, m_sources[i]->nextTimestamp());
+    }
+    return result;
+}
+/**
+ * newestTimestamp
+ *    Only valid after poll returned true.
+ * @return uint64_t - the newest hit buffered by any source.
+ */
+uint64_t
+CReorderWindow::newestTimestamp() const
+{
+    uint64_t result = 0;
+    for (size_t i = 0; i < m_sources.size(); i++) {
+        if (m_ready[i]) result = std::max(result, m_sources[i]->newestTimestamp());
+    }
+    return result;
+}
+/**
+ * select
+ *    Choose the source to read next.  Polls the sources unless poll was
+ *    just called.  The caller must read the source selected.
+ *
+ * @return int - index of the source whose next hit is the oldest buffered
+ *               if it may be emitted.
+ * @retval -1  - No source has data, or the oldest hit is being held.
+ */
+int
+CReorderWindow::select()
+{
+    if (!m_polled) poll();
+    m_polled = false;                       // A hold must look again next time.
+
+    int      oldest   = -1;
+    uint64_t stamp    = UINT64_MAX;
+    uint64_t newest   = 0;
+    bool     allReady = true;
+    for (size_t i = 0; i < m_sources.size(); i++) {
+        if (!m_ready[i]) {
+            allReady = false;
+            continue;
+        }
+        uint64_t next = m_sources[i]->nextTimestamp();
+        if (next < stamp) {
+            stamp  = next;
+            oldest = i;
+        }
+        newest = std::max(newest, m_sources[i]->newestTimestamp());
+    }
+    if (oldest < 0) return -1;
+
+    bool release = allReady || (stamp + m_windowNs <= newest);
+    if (!release) {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (!m_holding) {
+            m_holding   = true;
+            m_holdStart = now;
+            return -1;
+        }
+        if ((now - m_holdStart) < m_maxHold) return -1;
+    }
+    m_holding       = false;
+    m_ready[oldest] = false;                // Must be asked again after the read.
+    return oldest;
+}
@@ -0,0 +1,71 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CReorderWindow.h
+# @brief Choose which of several time ordered sources to read next.
+
+*/
+#ifndef CREORDERWINDOW_H
+#define CREORDERWINDOW_H
+
+#include <stdint.h>
+#include <vector>
+#include <chrono>
+
+class CTimeOrderedSource;
+
+/**
+ * @class CReorderWindow
+ *    Used by the compound event segments to emit the hits of several
+ *    boards in timestamp order rather than round robin.  Each board's hits
+ *    are time ordered, so the oldest buffered hit of all boards is safe to
+ *    emit unless a board with nothing buffered has an older hit still in
+ *    its digitizer.  The window bounds how long we wait to find out:
+ *
+ *    - If every source has a hit buffered, the oldest is emitted.
+ *    - Otherwise the oldest is emitted once it's at least windowNs older
+ *      than the newest hit buffered by any source, or once it has been
+ *      held for maxHoldMs of wall clock time (quiet boards, end of run).
+ *
+ *    A window of 0 never holds; the oldest buffered hit is emitted at once.
+ *    That's what a compound segment inside another time ordered compound
+ *    segment should use, leaving the holding to the outer one.
+ *
+ *    There are only a few boards and a source's next timestamp changes
+ *    under us when it's a compound segment that refills, so sources are
+ *    compared by a scan each time rather than kept in a CTimeOrderedMerger.
+ *    Whether a source has data is remembered until it's read so that a
+ *    board that's known to have data isn't asked again.
+ */
+class CReorderWindow
+{
+private:
+    std::vector<CTimeOrderedSource*> m_sources;
+    std::vector<bool>                m_ready;      // Hit buffered, not read since.
+    bool                             m_polled;     // m_ready is current.
+    uint64_t                         m_windowNs;
+    std::chrono::milliseconds        m_maxHold;
+    bool                             m_holding;
+    std::chrono::steady_clock::time_point m_holdStart;
+
+public:
+    CReorderWindow(uint64_t windowNs = 0, unsigned maxHoldMs = 100);
+
+    void   addSource(CTimeOrderedSource* pSource);
+    size_t size() const { return m_sources.size(); }
+    void   setWindow(uint64_t windowNs, unsigned maxHoldMs);
+    void   reset();
+
+    bool     poll();
+    uint64_t nextTimestamp() const;
+    uint64_t newestTimestamp() const;
+    int      select();
+};
+
+#endif
@@ -0,0 +1,449 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CReplayDigitizer.cpp
+# @brief Implement the capture file replay backend.
+
+*/
+#include "CReplayDigitizer.h"
+#include "CDppEventDecoder.h"
+#include "DppCaptureFormat.h"
+#include <fstream>
+#include <algorithm>
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * constructor
+ */
+CReplayDigitizer::CReplayDigitizer() :
+    m_nextHandle(0)
+{}
+/**
+ * destructor
+ *    Release any boards the drivers left open.
+ */
+CReplayDigitizer::~CReplayDigitizer()
+{
+    for (auto p = m_boards.begin(); p != m_boards.end(); p++) {
+        delete p->second;
+    }
+}
+/**
+ * addBoard
+ *    Associate a capture file with a link/node.  Opening link/node pairs
+ *    with no capture fails with CAEN_DGTZ_DigitizerNotFound.
+ *
+ * @param linkNum   - link number the driver opens.
+ * @param conetNode - node in the CONET daisy chain the driver opens.
+ * @param filename  - capture file (see DppCapture::fileName).
+ * @param realTime  - Deliver blocks at the pace they were captured rather
+ *                    than as fast as they're read.
+ */
+void
+CReplayDigitizer::addBoard(int linkNum, int conetNode, const std::string& filename, bool realTime)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    Source& source(m_sources[std::make_pair(linkNum, conetNode)]);
+    source.s_filename = filename;
+    source.s_realTime = realTime;
+}
+/**
+ * exhausted
+ * @return bool - true if every open, started board has delivered all
+ *                of its blocks.
+ */
+bool
+CReplayDigitizer::exhausted()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    for (auto p = m_boards.begin(); p != m_boards.end(); p++) {
+        std::lock_guard<std::mutex> boardGuard(p->second->s_lock);
+        if (p->second->s_next < p->second->s_sizes.size()) return false;
+    }
+    return true;
+}
+/**
+ * blocksReplayed
+ * @return uint64_t - blocks delivered by the open boards.
+ */
+uint64_t
+CReplayDigitizer::blocksReplayed()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    uint64_t result = 0;
+    for (auto p = m_boards.begin(); p != m_boards.end(); p++) {
+        std::lock_guard<std::mutex> boardGuard(p->second->s_lock);
+        result += p->second->s_next;
+    }
+    return result;
+}
+
+/*------------------------------------------------------------------------------
+ * Connection and identification:
+ */
+
+/**
+ * openDigitizer
+ *    Load the capture associated with the link/node.
+ */
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::openDigitizer(
+    CAEN_DGTZ_ConnectionType linkType, int linkNum, int conetNode,
+    uint32_t vmeBase, int* handle
+)
+{
+    Source source;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        auto p = m_sources.find(std::make_pair(linkNum, conetNode));
+        if (p == m_sources.end()) return CAEN_DGTZ_DigitizerNotFound;
+        source = p->second;
+    }
+    Board* pBoard = new Board;
+    pBoard->s_filename = source.s_filename;
+    pBoard->s_realTime = source.s_realTime;
+    CAEN_DGTZ_ErrorCode status = load(*pBoard);
+    if (status != CAEN_DGTZ_Success) {
+        delete pBoard;
+        return status;
+    }
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    *handle = m_nextHandle++;
+    m_boards[*handle] = pBoard;
+    return CAEN_DGTZ_Success;
+}
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::closeDigitizer(int handle)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    auto p = m_boards.find(handle);
+    if (p == m_boards.end()) return CAEN_DGTZ_InvalidHandle;
+    delete p->second;
+    m_boards.erase(p);
+    return CAEN_DGTZ_Success;
+}
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::getInfo(int handle, CAEN_DGTZ_BoardInfo_t* info)
+{
+    Board* pBoard = findBoard(handle);
+    if (!pBoard) return CAEN_DGTZ_InvalidHandle;
+    *info = pBoard->s_info;
+    return CAEN_DGTZ_Success;
+}
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::reset(int handle)
+{
+    Board* pBoard = findBoard(handle);
+    if (!pBoard) return CAEN_DGTZ_InvalidHandle;
+    std::lock_guard<std::mutex> guard(pBoard->s_lock);
+    pBoard->s_registers.clear();
+    return CAEN_DGTZ_Success;
+}
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::calibrate(int handle)
+{
+    return findBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+
+/*------------------------------------------------------------------------------
+ * Registers just remember what was written so read-modify-writes work:
+ */
+
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::readRegister(int handle, uint32_t address, uint32_t* data)
+{
+    Board* pBoard = findBoard(handle);
+    if (!pBoard) return CAEN_DGTZ_InvalidHandle;
+    std::lock_guard<std::mutex> guard(pBoard->s_lock);
+    auto p = pBoard->s_registers.find(address);
+    *data = (p == pBoard->s_registers.end()) ? 0 : p->second;
+    return CAEN_DGTZ_Success;
+}
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::writeRegister(int handle, uint32_t address, uint32_t data)
+{
+    Board* pBoard = findBoard(handle);
+    if (!pBoard) return CAEN_DGTZ_InvalidHandle;
+    std::lock_guard<std::mutex> guard(pBoard->s_lock);
+    pBoard->s_registers[address] = data;
+    return CAEN_DGTZ_Success;
+}
+
+/*------------------------------------------------------------------------------
+ * The setup helpers don't affect captured data:
+ */
+
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::setRecordLength(int handle, uint32_t size, int channel)
+{
+    return findBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::setAcquisitionMode(int handle, CAEN_DGTZ_AcqMode_t mode)
+{
+    return findBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::setDPPAcquisitionMode(
+    int handle, CAEN_DGTZ_DPP_AcqMode_t mode, CAEN_DGTZ_DPP_SaveParam_t param
+)
+{
+    return findBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::setChannelEnableMask(int handle, uint32_t mask)
+{
+    return findBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::setChannelDCOffset(int handle, uint32_t channel, uint32_t value)
+{
+    return findBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::setChannelPulsePolarity(
+    int handle, uint32_t channel, CAEN_DGTZ_PulsePolarity_t polarity
+)
+{
+    return findBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::setDPPParameters(int handle, uint32_t channelMask, void* params)
+{
+    return findBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::setDPPPreTriggerSize(int handle, int channel, uint32_t samples)
+{
+    return findBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::setIOLevel(int handle, CAEN_DGTZ_IOLevel_t level)
+{
+    return findBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::setDPPEventAggregation(int handle, int threshold, int maxsize)
+{
+    return findBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::setMaxNumAggregatesBLT(int handle, uint32_t numAggr)
+{
+    return findBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::setRunSynchronizationMode(int handle, CAEN_DGTZ_RunSyncMode_t mode)
+{
+    return findBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+
+/*------------------------------------------------------------------------------
+ * Acquisition control - a start replays the capture from the beginning:
+ */
+
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::swStartAcquisition(int handle)
+{
+    Board* pBoard = findBoard(handle);
+    if (!pBoard) return CAEN_DGTZ_InvalidHandle;
+    std::lock_guard<std::mutex> guard(pBoard->s_lock);
+    pBoard->s_next      = 0;
+    pBoard->s_running   = true;
+    pBoard->s_startTime = std::chrono::steady_clock::now();
+    return CAEN_DGTZ_Success;
+}
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::swStopAcquisition(int handle)
+{
+    Board* pBoard = findBoard(handle);
+    if (!pBoard) return CAEN_DGTZ_InvalidHandle;
+    std::lock_guard<std::mutex> guard(pBoard->s_lock);
+    pBoard->s_running = false;
+    return CAEN_DGTZ_Success;
+}
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::clearData(int handle)
+{
+    return findBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;  // A start rewinds.
+}
+
+/*------------------------------------------------------------------------------
+ * Buffers - sized to the capture:
+ */
+
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::mallocReadoutBuffer(int handle, char** buffer, uint32_t* size)
+{
+    Board* pBoard = findBoard(handle);
+    if (!pBoard) return CAEN_DGTZ_InvalidHandle;
+    uint32_t nBytes = pBoard->s_maxBlock ? pBoard->s_maxBlock : sizeof(uint32_t);
+    *buffer = static_cast<char*>(malloc(nBytes));
+    if (!*buffer) return CAEN_DGTZ_OutOfMemory;
+    *size = nBytes;
+    return CAEN_DGTZ_Success;
+}
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::freeReadoutBuffer(char** buffer)
+{
+    free(*buffer);
+    *buffer = nullptr;
+    return CAEN_DGTZ_Success;
+}
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::mallocDPPEvents(int handle, void** events, uint32_t* allocatedSize)
+{
+    Board* pBoard = findBoard(handle);
+    if (!pBoard) return CAEN_DGTZ_InvalidHandle;
+    uint32_t capacity = pBoard->s_maxHits ? pBoard->s_maxHits : 1;
+    return CDppEventDecoder::mallocEvents(pBoard->s_psd, capacity, events, allocatedSize);
+}
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::freeDPPEvents(int handle, void** events)
+{
+    CDppEventDecoder::freeEvents(events);
+    return CAEN_DGTZ_Success;
+}
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::mallocDPPWaveforms(int handle, void** waveforms, uint32_t* allocatedSize)
+{
+    Board* pBoard = findBoard(handle);
+    if (!pBoard) return CAEN_DGTZ_InvalidHandle;
+    return CDppEventDecoder::mallocWaveforms(pBoard->s_psd, waveforms, allocatedSize);
+}
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::freeDPPWaveforms(int handle, void* waveforms)
+{
+    CDppEventDecoder::freeWaveforms(waveforms);
+    return CAEN_DGTZ_Success;
+}
+
+/*------------------------------------------------------------------------------
+ * Data:
+ */
+
+/**
+ * readData
+ *    Deliver the next captured block if it's due.
+ */
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::readData(
+    int handle, CAEN_DGTZ_ReadMode_t mode, char* buffer, uint32_t* bufferSize
+)
+{
+    Board* pBoard = findBoard(handle);
+    if (!pBoard) return CAEN_DGTZ_InvalidHandle;
+    std::lock_guard<std::mutex> guard(pBoard->s_lock);
+    Board& b(*pBoard);
+
+    *bufferSize = 0;
+    if (!b.s_running || (b.s_next >= b.s_sizes.size())) return CAEN_DGTZ_Success;
+    if (b.s_realTime) {
+        uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - b.s_startTime
+        ).count();
+        if (b.s_stamps[b.s_next] - b.s_stamps[0] > elapsed) return CAEN_DGTZ_Success;
+    }
+    memcpy(buffer, &b.s_data[b.s_offsets[b.s_next]], b.s_sizes[b.s_next]);
+    *bufferSize = b.s_sizes[b.s_next];
+    b.s_next++;
+    return CAEN_DGTZ_Success;
+}
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::getDPPEvents(
+    int handle, char* buffer, uint32_t bufferSize, void** events, uint32_t* numEvents
+)
+{
+    Board* pBoard = findBoard(handle);
+    if (!pBoard) return CAEN_DGTZ_InvalidHandle;
+    return CDppEventDecoder::getEvents(
+        pBoard->s_psd, buffer, bufferSize, events, numEvents, pBoard->s_maxHits
+    );
+}
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::decodeDPPWaveforms(int handle, void* event, void* waveforms)
+{
+    Board* pBoard = findBoard(handle);
+    if (!pBoard) return CAEN_DGTZ_InvalidHandle;
+    return CDppEventDecoder::decodeWaveforms(pBoard->s_psd, event, waveforms);
+}
+
+/*------------------------------------------------------------------------------
+ * private utilities.
+ */
+
+CReplayDigitizer::Board*
+CReplayDigitizer::findBoard(int handle)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    auto p = m_boards.find(handle);
+    return (p == m_boards.end()) ? nullptr : p->second;
+}
+/**
+ * load
+ *    Read a board's capture file into memory and size the buffers the
+ *    drivers will need to hold its blocks.
+ *
+ * @param board - board with s_filename filled in.
+ * @return CAEN_DGTZ_ErrorCode - CAEN_DGTZ_DigitizerNotFound if the file can't
+ *              be read, CAEN_DGTZ_InvalidEvent if it's not a valid capture.
+ */
+CAEN_DGTZ_ErrorCode
+CReplayDigitizer::load(Board& b)
+{
+    std::ifstream in(b.s_filename.c_str(), std::ios::in | std::ios::binary);
+    if (!in) {
+        std::cerr << "Unable to open capture file " << b.s_filename << std::endl;
+        return CAEN_DGTZ_DigitizerNotFound;
+    }
+    DppCapture::FileHeader header;
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in || (header.s_magic != DppCapture::MAGIC) || (header.s_version != DppCapture::VERSION)) {
+        std::cerr << b.s_filename << " is not a capture file\n";
+        return CAEN_DGTZ_InvalidEvent;
+    }
+    memset(&b.s_info, 0, sizeof(b.s_info));
+    std::vector<char> info(header.s_infoSize);
+    in.read(info.data(), info.size());
+    memcpy(&b.s_info, info.data(), std::min(info.size(), sizeof(b.s_info)));
+    b.s_psd = CDppEventDecoder::isPsd(b.s_info);
+
+    b.s_maxBlock = 0;
+    b.s_maxHits  = 0;
+    b.s_next     = 0;
+    b.s_running  = false;
+    DppCapture::BlockHeader block;
+    while (in.read(reinterpret_cast<char*>(&block), sizeof(block))) {
+        size_t offset = b.s_data.size();
+        b.s_data.resize(offset + block.s_nBytes);
+        if (!in.read(&b.s_data[offset], block.s_nBytes)) {
+            std::cerr << "Truncated block at the end of " << b.s_filename << " ignored\n";
+            b.s_data.resize(offset);
+            break;
+        }
+        uint32_t nHits[CAEN_DGTZ_MAX_CHANNEL];
+        if (CDppEventDecoder::getEvents(
+                b.s_psd, &b.s_data[offset], block.s_nBytes, nullptr, nHits, 0
+            ) != CAEN_DGTZ_Success) {
+            std::cerr << "Invalid block " << b.s_sizes.size() << " in " << b.s_filename << std::endl;
+            return CAEN_DGTZ_InvalidEvent;
+        }
+        for (int i = 0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
+            if (nHits[i] > b.s_maxHits) b.s_maxHits = nHits[i];
+        }
+        if (block.s_nBytes > b.s_maxBlock) b.s_maxBlock = block.s_nBytes;
+        b.s_offsets.push_back(offset);
+        b.s_sizes.push_back(block.s_nBytes);
+        b.s_stamps.push_back(block.s_wallClock);
+    }
+    return CAEN_DGTZ_Success;
+}
@@ -0,0 +1,136 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CReplayDigitizer.h
+# @brief Backend that plays captured readout blocks back to the drivers.
+
+*/
+#ifndef CREPLAYDIGITIZER_H
+#define CREPLAYDIGITIZER_H
+
+#include "CDigitizerBackend.h"
+#include <string>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <utility>
+
+/**
+ * @class CReplayDigitizer
+ *    Plays capture files written by CRecordingDigitizer back through
+ *    the drivers.  Each capture file is associated with the link and node
+ *    the driver opens.  The board reports the CAEN_DGTZ_BoardInfo_t that
+ *    was captured so the drivers set themselves up as they did for the run;
+ *    register writes and the setup helpers are accepted and otherwise
+ *    ignored.
+ *
+ *    After swStartAcquisition, ReadData hands out the captured blocks in
+ *    order either as fast as they're asked for (throughput benchmarks) or
+ *    no sooner than they were read relative to the start of the run
+ *    (realTime).  Once the capture is exhausted the board is idle.
+ *    GetDPPEvents/DecodeDPPWaveforms decode with CDppEventDecoder.
+ *
+ *    The capture is loaded into memory when the board is opened so file I/O
+ *    does not perturb timing.
+ */
+class CReplayDigitizer : public CDigitizerBackend
+{
+private:
+    struct Board {
+        std::string           s_filename;
+        bool                  s_realTime;
+        CAEN_DGTZ_BoardInfo_t s_info;
+        bool                  s_psd;
+        std::vector<char>     s_data;            // All blocks back to back.
+        std::vector<size_t>   s_offsets;         // Where each block starts in s_data.
+        std::vector<uint32_t> s_sizes;
+        std::vector<uint64_t> s_stamps;          // Wall clock ns of each block.
+        uint32_t              s_maxBlock;        // Bytes in the biggest block.
+        uint32_t              s_maxHits;         // Most hits in a channel in one block.
+        size_t                s_next;            // Next block to deliver.
+        bool                  s_running;
+        std::chrono::steady_clock::time_point s_startTime;
+        std::mutex            s_lock;
+        std::map<uint32_t, uint32_t> s_registers;
+    };
+    struct Source {
+        std::string s_filename;
+        bool        s_realTime;
+    };
+
+    std::mutex                             m_lock;
+    std::map<std::pair<int, int>, Source>  m_sources;     // By link, node.
+    std::map<int, Board*>                  m_boards;      // By handle.
+    int                                    m_nextHandle;
+
+public:
+    CReplayDigitizer();
+    virtual ~CReplayDigitizer();
+
+    void addBoard(int linkNum, int conetNode, const std::string& filename, bool realTime = false);
+    bool exhausted();
+    uint64_t blocksReplayed();
+
+    // The backend interface:
+
+    virtual CAEN_DGTZ_ErrorCode openDigitizer(
+        CAEN_DGTZ_ConnectionType linkType, int linkNum, int conetNode,
+        uint32_t vmeBase, int* handle
+    );
+    virtual CAEN_DGTZ_ErrorCode closeDigitizer(int handle);
+    virtual CAEN_DGTZ_ErrorCode getInfo(int handle, CAEN_DGTZ_BoardInfo_t* info);
+    virtual CAEN_DGTZ_ErrorCode reset(int handle);
+    virtual CAEN_DGTZ_ErrorCode calibrate(int handle);
+
+    virtual CAEN_DGTZ_ErrorCode readRegister(int handle, uint32_t address, uint32_t* data);
+    virtual CAEN_DGTZ_ErrorCode writeRegister(int handle, uint32_t address, uint32_t data);
+
+    virtual CAEN_DGTZ_ErrorCode setRecordLength(int handle, uint32_t size, int channel = -1);
+    virtual CAEN_DGTZ_ErrorCode setAcquisitionMode(int handle, CAEN_DGTZ_AcqMode_t mode);
+    virtual CAEN_DGTZ_ErrorCode setDPPAcquisitionMode(
+        int handle, CAEN_DGTZ_DPP_AcqMode_t mode, CAEN_DGTZ_DPP_SaveParam_t param
+    );
+    virtual CAEN_DGTZ_ErrorCode setChannelEnableMask(int handle, uint32_t mask);
+    virtual CAEN_DGTZ_ErrorCode setChannelDCOffset(int handle, uint32_t channel, uint32_t value);
+    virtual CAEN_DGTZ_ErrorCode setChannelPulsePolarity(
+        int handle, uint32_t channel, CAEN_DGTZ_PulsePolarity_t polarity
+    );
+    virtual CAEN_DGTZ_ErrorCode setDPPParameters(int handle, uint32_t channelMask, void* params);
+    virtual CAEN_DGTZ_ErrorCode setDPPPreTriggerSize(int handle, int channel, uint32_t samples);
+    virtual CAEN_DGTZ_ErrorCode setIOLevel(int handle, CAEN_DGTZ_IOLevel_t level);
+    virtual CAEN_DGTZ_ErrorCode setDPPEventAggregation(int handle, int threshold, int maxsize);
+    virtual CAEN_DGTZ_ErrorCode setMaxNumAggregatesBLT(int handle, uint32_t numAggr);
+    virtual CAEN_DGTZ_ErrorCode setRunSynchronizationMode(int handle, CAEN_DGTZ_RunSyncMode_t mode);
+
+    virtual CAEN_DGTZ_ErrorCode swStartAcquisition(int handle);
+    virtual CAEN_DGTZ_ErrorCode swStopAcquisition(int handle);
+    virtual CAEN_DGTZ_ErrorCode clearData(int handle);
+
+    virtual CAEN_DGTZ_ErrorCode mallocReadoutBuffer(int handle, char** buffer, uint32_t* size);
+    virtual CAEN_DGTZ_ErrorCode freeReadoutBuffer(char** buffer);
+    virtual CAEN_DGTZ_ErrorCode mallocDPPEvents(int handle, void** events, uint32_t* allocatedSize);
+    virtual CAEN_DGTZ_ErrorCode freeDPPEvents(int handle, void** events);
+    virtual CAEN_DGTZ_ErrorCode mallocDPPWaveforms(int handle, void** waveforms, uint32_t* allocatedSize);
+    virtual CAEN_DGTZ_ErrorCode freeDPPWaveforms(int handle, void* waveforms);
+
+    virtual CAEN_DGTZ_ErrorCode readData(
+        int handle, CAEN_DGTZ_ReadMode_t mode, char* buffer, uint32_t* bufferSize
+    );
+    virtual CAEN_DGTZ_ErrorCode getDPPEvents(
+        int handle, char* buffer, uint32_t bufferSize, void** events, uint32_t* numEvents
+    );
+    virtual CAEN_DGTZ_ErrorCode decodeDPPWaveforms(int handle, void* event, void* waveforms);
+
+private:
+    Board*              findBoard(int handle);
+    CAEN_DGTZ_ErrorCode load(Board& board);
+};
+
+#endif
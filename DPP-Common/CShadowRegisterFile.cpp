@@ -0,0 +1,392 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CShadowRegisterFile.cpp
+# @brief Implement the register shadow that coalesces setup writes.
+
+*/
+#include "CShadowRegisterFile.h"
+
+/**
+ * firstError
+ *    A barrier call has two statuses, the writes held and the call itself.
+ *
+ * @return CAEN_DGTZ_ErrorCode - the first that isn't success.
+ */
+static CAEN_DGTZ_ErrorCode
+firstError(CAEN_DGTZ_ErrorCode held, CAEN_DGTZ_ErrorCode call)
+{
+    return (held != CAEN_DGTZ_Success) ? held : call;
+}
+
+/**
+ * constructor
+ * @param pBackend - The backend calls are passed on to (see CForwardingDigitizer).
+ */
+CShadowRegisterFile::CShadowRegisterFile(CDigitizerBackend* pBackend) :
+    CForwardingDigitizer(pBackend),
+    m_composing(false), m_handle(-1),
+    m_reads(0), m_writes(0), m_boardReads(0), m_boardWrites(0)
+{}
+/**
+ * destructor
+ *    Writes still held are dropped.
+ */
+CShadowRegisterFile::~CShadowRegisterFile()
+{}
+
+/**
+ * begin
+ *    Start holding writes of configuration registers.
+ */
+void
+CShadowRegisterFile::begin()
+{
+    m_composing = true;
+}
+/**
+ * flush
+ *    Write each register held once and stop holding writes.
+ *
+ * @return CAEN_DGTZ_ErrorCode - the first write that failed, if any.
+ */
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::flush()
+{
+    CAEN_DGTZ_ErrorCode status = barrier();
+    m_composing = false;
+    return status;
+}
+/**
+ * abandon
+ *    Drop the writes held and stop holding writes.
+ */
+void
+CShadowRegisterFile::abandon()
+{
+    m_shadow.clear();
+    m_order.clear();
+    m_composing = false;
+}
+/**
+ * clearCounters
+ */
+void
+CShadowRegisterFile::clearCounters()
+{
+    m_reads       = 0;
+    m_writes      = 0;
+    m_boardReads  = 0;
+    m_boardWrites = 0;
+}
+/**
+ * isStorage
+ *    Whether a register just stores what's written to it, so only the
+ *    last of several writes matters and it reads back as written.  These
+ *    are the channel registers (0x1n00-0x1nff) except the DC offset, whose
+ *    write loads the DAC, and the board configuration registers setups
+ *    write.
+ *
+ * @param address - the register.
+ * @return bool
+ */
+bool
+CShadowRegisterFile::isStorage(uint32_t address)
+{
+    if ((address & 0xf000) == 0x1000) {
+        return (address & 0xff) != 0x98;
+    }
+    switch (address) {
+    case 0x8000:                 // Board configuration (not its 0x8004/0x8008 set/clear).
+    case 0x800c:                 // Aggregate organization.
+    case 0x810c:                 // Global trigger mask.
+    case 0x8110:                 // Front panel TRG-OUT enable mask.
+    case 0x811c:                 // Front panel I/O control.
+    case 0x8120:                 // Channel enable mask.
+    case 0x8170:                 // Run start/stop delay.
+    case 0x81a0:                 // LVDS I/O.
+        return true;
+    default:
+        return false;
+    }
+}
+
+/*------------------------------------------------------------------------------
+ *  Registers:
+ */
+
+/**
+ * readRegister
+ *    A register we hold a write of reads back as written, anything else
+ *    is read from the board.
+ */
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::readRegister(int handle, uint32_t address, uint32_t* data)
+{
+    m_reads++;
+    if (m_composing && (handle == m_handle)) {
+        auto p = m_shadow.find(address);
+        if (p != m_shadow.end()) {
+            *data = p->second;
+            return CAEN_DGTZ_Success;
+        }
+    }
+    m_boardReads++;
+    return m_pBackend->readRegister(handle, address, data);
+}
+/**
+ * writeRegister
+ *    Hold writes of storage registers while composing, anything else is
+ *    a barrier.
+ */
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::writeRegister(int handle, uint32_t address, uint32_t data)
+{
+    m_writes++;
+    if (!m_composing || !isStorage(address)) {
+        CAEN_DGTZ_ErrorCode status = barrier();
+        m_boardWrites++;
+        return firstError(status, m_pBackend->writeRegister(handle, address, data));
+    }
+
+    CAEN_DGTZ_ErrorCode status = CAEN_DGTZ_Success;
+    if (!m_order.empty() && (handle != m_handle)) {
+        status = barrier();                    // Another board's.
+    }
+    m_handle = handle;
+    if (m_shadow.find(address) == m_shadow.end()) {
+        m_order.push_back(address);
+    }
+    m_shadow[address] = data;
+    return status;
+}
+
+/*------------------------------------------------------------------------------
+ *  Everything else that goes to the board is a barrier:
+ */
+
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::openDigitizer(CAEN_DGTZ_ConnectionType linkType, int linkNum, int conetNode,
+    uint32_t vmeBase, int* handle)
+{
+    CAEN_DGTZ_ErrorCode status = barrier();
+    return firstError(status, m_pBackend->openDigitizer(linkType, linkNum, conetNode, vmeBase, handle));
+}
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::closeDigitizer(int handle)
+{
+    CAEN_DGTZ_ErrorCode status = barrier();
+    return firstError(status, m_pBackend->closeDigitizer(handle));
+}
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::getInfo(int handle, CAEN_DGTZ_BoardInfo_t* info)
+{
+    CAEN_DGTZ_ErrorCode status = barrier();
+    return firstError(status, m_pBackend->getInfo(handle, info));
+}
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::reset(int handle)
+{
+    CAEN_DGTZ_ErrorCode status = barrier();
+    return firstError(status, m_pBackend->reset(handle));
+}
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::calibrate(int handle)
+{
+    CAEN_DGTZ_ErrorCode status = barrier();
+    return firstError(status, m_pBackend->calibrate(handle));
+}
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::setRecordLength(int handle, uint32_t size, int channel)
+{
+    CAEN_DGTZ_ErrorCode status = barrier();
+    return firstError(status, m_pBackend->setRecordLength(handle, size, channel));
+}
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::setAcquisitionMode(int handle, CAEN_DGTZ_AcqMode_t mode)
+{
+    CAEN_DGTZ_ErrorCode status = barrier();
+    return firstError(status, m_pBackend->setAcquisitionMode(handle, mode));
+}
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::setDPPAcquisitionMode(int handle, CAEN_DGTZ_DPP_AcqMode_t mode,
+    CAEN_DGTZ_DPP_SaveParam_t param)
+{
+    CAEN_DGTZ_ErrorCode status = barrier();
+    return firstError(status, m_pBackend->setDPPAcquisitionMode(handle, mode, param));
+}
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::setChannelEnableMask(int handle, uint32_t mask)
+{
+    CAEN_DGTZ_ErrorCode status = barrier();
+    return firstError(status, m_pBackend->setChannelEnableMask(handle, mask));
+}
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::setChannelDCOffset(int handle, uint32_t channel, uint32_t value)
+{
+    CAEN_DGTZ_ErrorCode status = barrier();
+    return firstError(status, m_pBackend->setChannelDCOffset(handle, channel, value));
+}
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::setChannelPulsePolarity(int handle, uint32_t channel,
+    CAEN_DGTZ_PulsePolarity_t polarity)
+{
+    CAEN_DGTZ_ErrorCode status = barrier();
+    return firstError(status, m_pBackend->setChannelPulsePolarity(handle, channel, polarity));
+}
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::setDPPParameters(int handle, uint32_t channelMask, void* params)
+{
+    CAEN_DGTZ_ErrorCode status = barrier();
+    return firstError(status, m_pBackend->setDPPParameters(handle, channelMask, params));
+}
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::setDPPPreTriggerSize(int handle, int channel, uint32_t samples)
+{
+    CAEN_DGTZ_ErrorCode status = barrier();
+    return firstError(status, m_pBackend->setDPPPreTriggerSize(handle, channel, samples));
+}
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::setIOLevel(int handle, CAEN_DGTZ_IOLevel_t level)
+{
+    CAEN_DGTZ_ErrorCode status = barrier();
+    return firstError(status, m_pBackend->setIOLevel(handle, level));
+}
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::setDPPEventAggregation(int handle, int threshold, int maxsize)
+{
+    CAEN_DGTZ_ErrorCode status = barrier();
+    return firstError(status, m_pBackend->setDPPEventAggregation(handle, threshold, maxsize));
+}
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::setMaxNumAggregatesBLT(int handle, uint32_t numAggr)
+{
+    CAEN_DGTZ_ErrorCode status = barrier();
+    return firstError(status, m_pBackend->setMaxNumAggregatesBLT(handle, numAggr));
+}
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::setRunSynchronizationMode(int handle, CAEN_DGTZ_RunSyncMode_t mode)
+{
+    CAEN_DGTZ_ErrorCode status = barrier();
+    return firstError(status, m_pBackend->setRunSynchronizationMode(handle, mode));
+}
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::swStartAcquisition(int handle)
+{
+    CAEN_DGTZ_ErrorCode status = barrier();
+    return firstError(status, m_pBackend->swStartAcquisition(handle));
+}
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::swStopAcquisition(int handle)
+{
+    CAEN_DGTZ_ErrorCode status = barrier();
+    return firstError(status, m_pBackend->swStopAcquisition(handle));
+}
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::clearData(int handle)
+{
+    CAEN_DGTZ_ErrorCode status = barrier();
+    return firstError(status, m_pBackend->clearData(handle));
+}
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::mallocReadoutBuffer(int handle, char** buffer, uint32_t* size)
+{
+    CAEN_DGTZ_ErrorCode status = barrier();       // The size depends on the setup.
+    return firstError(status, m_pBackend->mallocReadoutBuffer(handle, buffer, size));
+}
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::mallocDPPEvents(int handle, void** events, uint32_t* allocatedSize)
+{
+    CAEN_DGTZ_ErrorCode status = barrier();
+    return firstError(status, m_pBackend->mallocDPPEvents(handle, events, allocatedSize));
+}
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::mallocDPPWaveforms(int handle, void** waveforms, uint32_t* allocatedSize)
+{
+    CAEN_DGTZ_ErrorCode status = barrier();
+    return firstError(status, m_pBackend->mallocDPPWaveforms(handle, waveforms, allocatedSize));
+}
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::readData(int handle, CAEN_DGTZ_ReadMode_t mode, char* buffer,
+    uint32_t* bufferSize)
+{
+    CAEN_DGTZ_ErrorCode status = barrier();
+    return firstError(status, m_pBackend->readData(handle, mode, buffer, bufferSize));
+}
+
+/*------------------------------------------------------------------------------
+ *  Private utilities:
+ */
+
+/**
+ * barrier
+ *    Do the writes held, each register once in the order first written,
+ *    and forget the shadow since what's next may change the registers.
+ *
+ * @return CAEN_DGTZ_ErrorCode - the first write that failed, if any.
+ */
+CAEN_DGTZ_ErrorCode
+CShadowRegisterFile::barrier()
+{
+    CAEN_DGTZ_ErrorCode result = CAEN_DGTZ_Success;
+    for (size_t i = 0; i < m_order.size(); i++) {
+        m_boardWrites++;
+        CAEN_DGTZ_ErrorCode status =
+            m_pBackend->writeRegister(m_handle, m_order[i], m_shadow[m_order[i]]);
+        result = firstError(result, status);
+    }
+    m_shadow.clear();
+    m_order.clear();
+    return result;
+}
+
+/*------------------------------------------------------------------------------
+ *  CShadowRegisterScope
+ */
+
+/**
+ * constructor
+ *
+ * @param rBackend - The driver's backend pointer, pointed at the shadow.
+ * @param enable   - false to leave it alone.
+ */
+CShadowRegisterScope::CShadowRegisterScope(CDigitizerBackend*& rBackend, bool enable) :
+    m_rBackend(rBackend), m_pSaved(rBackend), m_shadow(rBackend),
+    m_enabled(enable), m_active(enable)
+{
+    if (m_active) {
+        m_shadow.begin();
+        m_rBackend = &m_shadow;
+    }
+}
+/**
+ * destructor
+ *    Abandon writes still held and restore the backend.
+ */
+CShadowRegisterScope::~CShadowRegisterScope()
+{
+    if (m_active) {
+        m_shadow.abandon();
+        m_rBackend = m_pSaved;
+    }
+}
+/**
+ * finish
+ *    Do the writes held and restore the backend.
+ *
+ * @return CAEN_DGTZ_ErrorCode - the first write that failed, if any.
+ */
+CAEN_DGTZ_ErrorCode
+CShadowRegisterScope::finish()
+{
+    if (!m_active) return CAEN_DGTZ_Success;
+    m_active   = false;
+    m_rBackend = m_pSaved;
+    return m_shadow.flush();
+}
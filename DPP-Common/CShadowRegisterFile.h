@@ -0,0 +1,148 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CShadowRegisterFile.h
+# @brief Backend that composes register writes in memory during a setup.
+
+*/
+#ifndef CSHADOWREGISTERFILE_H
+#define CSHADOWREGISTERFILE_H
+
+#include "CForwardingDigitizer.h"
+#include <map>
+#include <vector>
+
+/**
+ * @class CShadowRegisterFile
+ *    Board setup is mostly read/modify/write of bit fields (e.g.
+ *    CAENPha::setRegisterBits, which does it per channel for broadcast
+ *    addresses), so the same register is read and written several times.
+ *    Over an optical link each access is a round trip.
+ *
+ *    Between begin() and flush() writes of configuration registers are
+ *    held in a shadow of the board's registers instead of being done:
+ *    reads of registers in the shadow are answered from it, so fields are
+ *    composed in memory, and flush() writes each address once with its
+ *    final value, in the order the addresses were first written.  Reads of
+ *    registers that weren't written go to the board (status registers
+ *    aren't cached).
+ *
+ *    To keep the board's view in order, anything else that goes to the
+ *    board is a barrier:  the writes held are done, the shadow forgotten
+ *    (the library may have changed registers) and then the call is passed
+ *    on.  That includes every library call (e.g. setDPPParameters) and
+ *    writes of registers that act rather than store (see isStorage:  set/
+ *    clear bit registers, broadcasts, triggers, resets, the acquisition
+ *    control, the DC offset DACs).
+ *
+ *    Write errors are only seen when the writes are done, so they're
+ *    returned by flush() (or the barrier call).
+ *
+ *    CShadowRegisterScope puts one in front of a driver's backend for the
+ *    length of a setup.
+ */
+class CShadowRegisterFile : public CForwardingDigitizer
+{
+private:
+    bool                         m_composing;
+    int                          m_handle;       // Of the board written.
+    std::map<uint32_t, uint32_t> m_shadow;       // Written registers by address.
+    std::vector<uint32_t>        m_order;        // Addresses in first write order.
+    uint64_t                     m_reads;        // Requested.
+    uint64_t                     m_writes;
+    uint64_t                     m_boardReads;   // Done.
+    uint64_t                     m_boardWrites;
+
+public:
+    CShadowRegisterFile(CDigitizerBackend* pBackend);
+    virtual ~CShadowRegisterFile();
+
+    void                begin();
+    CAEN_DGTZ_ErrorCode flush();
+    void                abandon();
+    bool                composing() const { return m_composing; }
+
+    uint64_t reads() const        { return m_reads; }
+    uint64_t writes() const       { return m_writes; }
+    uint64_t boardAccesses() const { return m_boardReads + m_boardWrites; }
+    uint64_t saved() const        { return m_reads + m_writes - boardAccesses(); }
+    void     clearCounters();
+
+    static bool isStorage(uint32_t address);
+
+    virtual CAEN_DGTZ_ErrorCode openDigitizer(
+        CAEN_DGTZ_ConnectionType linkType, int linkNum, int conetNode,
+        uint32_t vmeBase, int* handle
+    );
+    virtual CAEN_DGTZ_ErrorCode closeDigitizer(int handle);
+    virtual CAEN_DGTZ_ErrorCode getInfo(int handle, CAEN_DGTZ_BoardInfo_t* info);
+    virtual CAEN_DGTZ_ErrorCode reset(int handle);
+    virtual CAEN_DGTZ_ErrorCode calibrate(int handle);
+
+    virtual CAEN_DGTZ_ErrorCode readRegister(int handle, uint32_t address, uint32_t* data);
+    virtual CAEN_DGTZ_ErrorCode writeRegister(int handle, uint32_t address, uint32_t data);
+
+    virtual CAEN_DGTZ_ErrorCode setRecordLength(int handle, uint32_t size, int channel = -1);
+    virtual CAEN_DGTZ_ErrorCode setAcquisitionMode(int handle, CAEN_DGTZ_AcqMode_t mode);
+    virtual CAEN_DGTZ_ErrorCode setDPPAcquisitionMode(
+        int handle, CAEN_DGTZ_DPP_AcqMode_t mode, CAEN_DGTZ_DPP_SaveParam_t param
+    );
+    virtual CAEN_DGTZ_ErrorCode setChannelEnableMask(int handle, uint32_t mask);
+    virtual CAEN_DGTZ_ErrorCode setChannelDCOffset(int handle, uint32_t channel, uint32_t value);
+    virtual CAEN_DGTZ_ErrorCode setChannelPulsePolarity(
+        int handle, uint32_t channel, CAEN_DGTZ_PulsePolarity_t polarity
+    );
+    virtual CAEN_DGTZ_ErrorCode setDPPParameters(int handle, uint32_t channelMask, void* params);
+    virtual CAEN_DGTZ_ErrorCode setDPPPreTriggerSize(int handle, int channel, uint32_t samples);
+    virtual CAEN_DGTZ_ErrorCode setIOLevel(int handle, CAEN_DGTZ_IOLevel_t level);
+    virtual CAEN_DGTZ_ErrorCode setDPPEventAggregation(int handle, int threshold, int maxsize);
+    virtual CAEN_DGTZ_ErrorCode setMaxNumAggregatesBLT(int handle, uint32_t numAggr);
+    virtual CAEN_DGTZ_ErrorCode setRunSynchronizationMode(int handle, CAEN_DGTZ_RunSyncMode_t mode);
+
+    virtual CAEN_DGTZ_ErrorCode swStartAcquisition(int handle);
+    virtual CAEN_DGTZ_ErrorCode swStopAcquisition(int handle);
+    virtual CAEN_DGTZ_ErrorCode clearData(int handle);
+
+    virtual CAEN_DGTZ_ErrorCode mallocReadoutBuffer(int handle, char** buffer, uint32_t* size);
+    virtual CAEN_DGTZ_ErrorCode mallocDPPEvents(int handle, void** events, uint32_t* allocatedSize);
+    virtual CAEN_DGTZ_ErrorCode mallocDPPWaveforms(int handle, void** waveforms, uint32_t* allocatedSize);
+
+    virtual CAEN_DGTZ_ErrorCode readData(
+        int handle, CAEN_DGTZ_ReadMode_t mode, char* buffer, uint32_t* bufferSize
+    );
+
+private:
+    CAEN_DGTZ_ErrorCode barrier();
+};
+
+/**
+ * @class CShadowRegisterScope
+ *    Points a driver's backend pointer at a CShadowRegisterFile in front of
+ *    it until finish() or destruction.  finish() does the writes held,
+ *    destruction without it (e.g. the setup threw) abandons them.
+ *    Disabled, it does nothing.
+ */
+class CShadowRegisterScope
+{
+private:
+    CDigitizerBackend*& m_rBackend;
+    CDigitizerBackend*  m_pSaved;
+    CShadowRegisterFile m_shadow;
+    bool                m_enabled;
+    bool                m_active;       // m_rBackend is &m_shadow.
+public:
+    CShadowRegisterScope(CDigitizerBackend*& rBackend, bool enable);
+    ~CShadowRegisterScope();
+
+    CAEN_DGTZ_ErrorCode        finish();
+    bool                       enabled() const { return m_enabled; }
+    const CShadowRegisterFile& shadow() const  { return m_shadow; }
+};
+
+#endif
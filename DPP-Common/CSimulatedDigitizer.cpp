@@ -0,0 +1,736 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CSimulatedDigitizer.cpp
+# @brief Implement the simulated x725/x730 digitizer backend.
+
+*/
+#include "CSimulatedDigitizer.h"
+#include "DppAggregateFormat.h"
+#include "CDppEventDecoder.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+using namespace DppFormat;
+
+// Largest trace the format word can describe and a few shaping constants:
+
+static const uint32_t MAX_SAMPLES    = FMT_NS_MASK*FMT_NS_UNIT;
+static const double   BASELINE       = 1000.0;        // ADC counts.
+static const double   RISE_SAMPLES   = 4.0;
+static const double   DECAY_SAMPLES  = 60.0;
+
+/**
+ * BoardConfig constructor
+ *    Defaults: a V1730 running DPP-PHA, 1kHz on every channel,
+ *    paced by the wall clock.
+ */
+CSimulatedDigitizer::BoardConfig::BoardConfig() :
+    s_modelName("V1730"), s_serialNumber(0), s_is730(true), s_firmware(PHA),
+    s_traceSamples(0), s_dualTrace(false), s_fakeRollover(true),
+    s_pileupFraction(0.01), s_realTime(true), s_hitsPerRead(256),
+    s_maxHitsPerChannel(8192), s_startTick(0), s_seed(1)
+{
+    for (int i = 0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
+        s_rate[i] = 1000.0;
+    }
+}
+
+/**
+ * constructor
+ *
+ * @param readoutBufferBytes - Size of the readout buffers we hand out
+ *                             and hence the largest block a ReadData returns.
+ */
+CSimulatedDigitizer::CSimulatedDigitizer(uint32_t readoutBufferBytes) :
+    m_nextHandle(0), m_readoutBufferSize(readoutBufferBytes)
+{}
+/**
+ * destructor
+ *    Close any boards the drivers left open.
+ */
+CSimulatedDigitizer::~CSimulatedDigitizer()
+{
+    for (auto p = m_boards.begin(); p != m_boards.end(); p++) {
+        delete p->second;
+    }
+}
+/**
+ * addBoard
+ *    Declare a board on a link.  Opening link/node pairs not declared
+ *    fails with CAEN_DGTZ_DigitizerNotFound as it would with no board there.
+ *
+ * @param linkNum   - link (e.g. A3818 fibre) number.
+ * @param conetNode - node in the CONET daisy chain.
+ * @param config    - How the board behaves.
+ */
+void
+CSimulatedDigitizer::addBoard(int linkNum, int conetNode, const BoardConfig& config)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_configs[std::make_pair(linkNum, conetNode)] = config;
+}
+
+/*------------------------------------------------------------------------------
+ * Connection and identification:
+ */
+
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::openDigitizer(
+    CAEN_DGTZ_ConnectionType linkType, int linkNum, int conetNode,
+    uint32_t vmeBase, int* handle
+)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        auto p = m_configs.find(std::make_pair(linkNum, conetNode));
+        if (p == m_configs.end()) return CAEN_DGTZ_DigitizerNotFound;
+
+        Board* pBoard = new Board;
+        pBoard->s_config = p->second;
+        pBoard->s_random.seed(p->second.s_seed);
+        pBoard->s_aggregateCounter = 0;
+        *handle = m_nextHandle++;
+        m_boards[*handle] = pBoard;
+    }
+    return reset(*handle);                // Power up state.  Takes the locks itself.
+}
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::closeDigitizer(int handle)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    auto p = m_boards.find(handle);
+    if (p == m_boards.end()) return CAEN_DGTZ_InvalidHandle;
+    delete p->second;
+    m_boards.erase(p);
+    return CAEN_DGTZ_Success;
+}
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::getInfo(int handle, CAEN_DGTZ_BoardInfo_t* info)
+{
+    Board* pBoard = findBoard(handle);
+    if (!pBoard) return CAEN_DGTZ_InvalidHandle;
+    const BoardConfig& c(pBoard->s_config);
+
+    memset(info, 0, sizeof(CAEN_DGTZ_BoardInfo_t));
+    strncpy(info->ModelName, c.s_modelName.c_str(), sizeof(info->ModelName) - 1);
+    info->Model        = c.s_is730 ? CAEN_DGTZ_V1730 : CAEN_DGTZ_V1725;
+    info->Channels     = CAEN_DGTZ_MAX_CHANNEL;
+    info->FamilyCode   = c.s_is730 ? CAEN_DGTZ_XX730_FAMILY_CODE : CAEN_DGTZ_XX725_FAMILY_CODE;
+    info->SerialNumber = c.s_serialNumber;
+    info->ADC_NBits    = 14;
+    info->CommHandle   = handle;
+    strcpy(info->ROC_FirmwareRel, "4.22 - Simulated");
+    strcpy(info->AMC_FirmwareRel, c.s_firmware == PHA ? "139.16 - Simulated" : "136.22 - Simulated");
+    return CAEN_DGTZ_Success;
+}
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::reset(int handle)
+{
+    Board* pBoard = findBoard(handle);
+    if (!pBoard) return CAEN_DGTZ_InvalidHandle;
+    std::lock_guard<std::mutex> guard(pBoard->s_lock);
+    pBoard->s_registers.clear();
+    pBoard->s_enableMask = 0;
+    pBoard->s_listMode   = false;
+    pBoard->s_running    = false;
+    for (int i = 0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
+        pBoard->s_recordLength[i] = 0;
+    }
+    return CAEN_DGTZ_Success;
+}
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::calibrate(int handle)
+{
+    return findBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+
+/*------------------------------------------------------------------------------
+ * Registers:  0x8004/0x8008 are the bit set/clear addresses of the board
+ * configuration register, and the other 0x80nn addresses broadcast to
+ * the 0x1cnn registers of every channel c.
+ */
+
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::readRegister(int handle, uint32_t address, uint32_t* data)
+{
+    Board* pBoard = findBoard(handle);
+    if (!pBoard) return CAEN_DGTZ_InvalidHandle;
+    std::lock_guard<std::mutex> guard(pBoard->s_lock);
+    auto p = pBoard->s_registers.find(address);
+    *data = (p == pBoard->s_registers.end()) ? 0 : p->second;
+    return CAEN_DGTZ_Success;
+}
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::writeRegister(int handle, uint32_t address, uint32_t data)
+{
+    Board* pBoard = findBoard(handle);
+    if (!pBoard) return CAEN_DGTZ_InvalidHandle;
+    std::lock_guard<std::mutex> guard(pBoard->s_lock);
+    std::map<uint32_t, uint32_t>& regs(pBoard->s_registers);
+
+    if (address == 0x8004) {
+        regs[0x8000] |= data;
+    } else if (address == 0x8008) {
+        regs[0x8000] &= ~data;
+    } else if ((address & 0xff00) == 0x8000) {
+        regs[address] = data;
+        for (uint32_t ch = 0; ch < CAEN_DGTZ_MAX_CHANNEL; ch++) {
+            regs[0x1000 | (ch << 8) | (address & 0xff)] = data;
+        }
+    } else if (address == 0x8120) {
+        regs[address] = data;
+        pBoard->s_enableMask = data;
+    } else {
+        regs[address] = data;
+    }
+    return CAEN_DGTZ_Success;
+}
+
+/*------------------------------------------------------------------------------
+ * Library setup helpers.  Only those that shape the data matter.
+ */
+
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::setRecordLength(int handle, uint32_t size, int channel)
+{
+    Board* pBoard = findBoard(handle);
+    if (!pBoard) return CAEN_DGTZ_InvalidHandle;
+    if (channel >= CAEN_DGTZ_MAX_CHANNEL) return CAEN_DGTZ_InvalidParam;
+    std::lock_guard<std::mutex> guard(pBoard->s_lock);
+    for (int i = 0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
+        if ((channel < 0) || (channel == i)) pBoard->s_recordLength[i] = size;
+    }
+    return CAEN_DGTZ_Success;
+}
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::setAcquisitionMode(int handle, CAEN_DGTZ_AcqMode_t mode)
+{
+    return findBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::setDPPAcquisitionMode(
+    int handle, CAEN_DGTZ_DPP_AcqMode_t mode, CAEN_DGTZ_DPP_SaveParam_t param
+)
+{
+    Board* pBoard = findBoard(handle);
+    if (!pBoard) return CAEN_DGTZ_InvalidHandle;
+    std::lock_guard<std::mutex> guard(pBoard->s_lock);
+    pBoard->s_listMode = (mode == CAEN_DGTZ_DPP_ACQ_MODE_List);
+    return CAEN_DGTZ_Success;
+}
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::setChannelEnableMask(int handle, uint32_t mask)
+{
+    return writeRegister(handle, 0x8120, mask);
+}
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::setChannelDCOffset(int handle, uint32_t channel, uint32_t value)
+{
+    if (channel >= CAEN_DGTZ_MAX_CHANNEL) return CAEN_DGTZ_InvalidParam;
+    return writeRegister(handle, 0x1098 | (channel << 8), value);
+}
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::setChannelPulsePolarity(
+    int handle, uint32_t channel, CAEN_DGTZ_PulsePolarity_t polarity
+)
+{
+    return findBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::setDPPParameters(int handle, uint32_t channelMask, void* params)
+{
+    return findBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::setDPPPreTriggerSize(int handle, int channel, uint32_t samples)
+{
+    return findBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::setIOLevel(int handle, CAEN_DGTZ_IOLevel_t level)
+{
+    return findBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::setDPPEventAggregation(int handle, int threshold, int maxsize)
+{
+    return findBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::setMaxNumAggregatesBLT(int handle, uint32_t numAggr)
+{
+    return findBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::setRunSynchronizationMode(int handle, CAEN_DGTZ_RunSyncMode_t mode)
+{
+    return findBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+
+/*------------------------------------------------------------------------------
+ * Acquisition control:
+ */
+
+/**
+ * swStartAcquisition
+ *    Start simulated time at the configured start tick and schedule the
+ *    first hit of each channel.
+ */
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::swStartAcquisition(int handle)
+{
+    Board* pBoard = findBoard(handle);
+    if (!pBoard) return CAEN_DGTZ_InvalidHandle;
+    std::lock_guard<std::mutex> guard(pBoard->s_lock);
+    Board& b(*pBoard);
+
+    b.s_tick      = b.s_config.s_startTick;
+    b.s_startTime = std::chrono::steady_clock::now();
+    for (int i = 0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
+        b.s_epoch[i]    = b.s_tick >> 31;
+        b.s_triggers[i] = 0;
+        b.s_nextHit[i]  = b.s_tick + nextInterval(b, i);
+    }
+
+    // Unit amplitude pulse the traces are scaled from:
+
+    uint32_t ns = 0;
+    for (int i = 0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
+        uint32_t n = traceSamples(b, i);
+        if (n > ns) ns = n;
+    }
+    b.s_pulseShape.assign(ns, 0.0);
+    double peak = 0.0;
+    for (uint32_t i = ns/5; i < ns; i++) {
+        double t = i - ns/5;
+        b.s_pulseShape[i] = exp(-t/DECAY_SAMPLES) - exp(-t/RISE_SAMPLES);
+        if (b.s_pulseShape[i] > peak) peak = b.s_pulseShape[i];
+    }
+    for (uint32_t i = 0; (i < ns) && (peak > 0); i++) {
+        b.s_pulseShape[i] /= peak;
+    }
+    b.s_running = true;
+    return CAEN_DGTZ_Success;
+}
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::swStopAcquisition(int handle)
+{
+    Board* pBoard = findBoard(handle);
+    if (!pBoard) return CAEN_DGTZ_InvalidHandle;
+    std::lock_guard<std::mutex> guard(pBoard->s_lock);
+    pBoard->s_running = false;
+    return CAEN_DGTZ_Success;
+}
+/**
+ * clearData
+ *    Hits are made as they're read and a start begins afresh, so there's
+ *    nothing buffered to drop.
+ */
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::clearData(int handle)
+{
+    return findBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+
+/*------------------------------------------------------------------------------
+ * Buffers:
+ */
+
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::mallocReadoutBuffer(int handle, char** buffer, uint32_t* size)
+{
+    if (!findBoard(handle)) return CAEN_DGTZ_InvalidHandle;
+    *buffer = static_cast<char*>(malloc(m_readoutBufferSize));
+    if (!*buffer) return CAEN_DGTZ_OutOfMemory;
+    *size = m_readoutBufferSize;
+    return CAEN_DGTZ_Success;
+}
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::freeReadoutBuffer(char** buffer)
+{
+    free(*buffer);
+    *buffer = nullptr;
+    return CAEN_DGTZ_Success;
+}
+/**
+ * mallocDPPEvents
+ *    Allocate s_maxHitsPerChannel events of the board's firmware type
+ *    for each channel.
+ */
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::mallocDPPEvents(int handle, void** events, uint32_t* allocatedSize)
+{
+    Board* pBoard = findBoard(handle);
+    if (!pBoard) return CAEN_DGTZ_InvalidHandle;
+    return CDppEventDecoder::mallocEvents(
+        pBoard->s_config.s_firmware == PSD, pBoard->s_config.s_maxHitsPerChannel,
+        events, allocatedSize
+    );
+}
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::freeDPPEvents(int handle, void** events)
+{
+    CDppEventDecoder::freeEvents(events);
+    return CAEN_DGTZ_Success;
+}
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::mallocDPPWaveforms(int handle, void** waveforms, uint32_t* allocatedSize)
+{
+    Board* pBoard = findBoard(handle);
+    if (!pBoard) return CAEN_DGTZ_InvalidHandle;
+    return CDppEventDecoder::mallocWaveforms(
+        pBoard->s_config.s_firmware == PSD, waveforms, allocatedSize
+    );
+}
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::freeDPPWaveforms(int handle, void* waveforms)
+{
+    CDppEventDecoder::freeWaveforms(waveforms);
+    return CAEN_DGTZ_Success;
+}
+
+/*------------------------------------------------------------------------------
+ * Data:
+ */
+
+/**
+ * readData
+ *    Produce a board aggregate with the hits that occurred since the last
+ *    read.  For real time boards that's determined by the wall clock;
+ *    otherwise simulated time advances far enough that the busiest
+ *    channel has s_hitsPerRead hits.  Hits that don't fit in the buffer
+ *    are delivered by the next read.
+ */
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::readData(
+    int handle, CAEN_DGTZ_ReadMode_t mode, char* buffer, uint32_t* bufferSize
+)
+{
+    Board* pBoard = findBoard(handle);
+    if (!pBoard) return CAEN_DGTZ_InvalidHandle;
+    std::lock_guard<std::mutex> guard(pBoard->s_lock);
+    Board& b(*pBoard);
+
+    *bufferSize = 0;
+    if (!b.s_running) return CAEN_DGTZ_Success;
+
+    // Figure out how far simulated time goes:
+
+    uint64_t tickEnd;
+    double   ticksPerSecond = 1.0e9/nsPerTick(b);
+    if (b.s_config.s_realTime) {
+        double ns = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - b.s_startTime
+        ).count();
+        tickEnd = b.s_config.s_startTick + static_cast<uint64_t>(ns/nsPerTick(b));
+    } else {
+        double maxRate = 0.0;
+        for (int i = 0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
+            if ((b.s_enableMask & (1 << i)) && (b.s_config.s_rate[i] > maxRate)) {
+                maxRate = b.s_config.s_rate[i];
+            }
+        }
+        if (maxRate <= 0.0) return CAEN_DGTZ_Success;
+        tickEnd = b.s_tick + 1 + static_cast<uint64_t>(ticksPerSecond*b.s_config.s_hitsPerRead/maxRate);
+    }
+
+    uint32_t* pBase = reinterpret_cast<uint32_t*>(buffer);
+    uint32_t* pEnd  = pBase + m_readoutBufferSize/sizeof(uint32_t);
+    uint32_t* p     = pBase + BOARD_HEADER_WORDS;
+    uint32_t  mask  = 0;
+    stageHits(b, tickEnd, static_cast<uint32_t>(pEnd - p));
+    for (int c = 0; c < CAEN_DGTZ_MAX_CHANNEL/2; c++) {
+        if (b.s_staged[c].empty()) continue;
+        p     = putCouple(b, p, c);
+        mask |= (1 << c);
+    }
+
+    // Hits still pending hold back simulated time so none are skipped:
+
+    if (!b.s_config.s_realTime) {
+        for (int i = 0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
+            if ((b.s_enableMask & (1 << i)) && (b.s_nextHit[i] < tickEnd)) {
+                tickEnd = b.s_nextHit[i];
+            }
+        }
+    }
+    b.s_tick = tickEnd;
+    if (!mask) return CAEN_DGTZ_Success;
+
+    pBase[0] = BOARD_TYPE | static_cast<uint32_t>(p - pBase);
+    pBase[1] = mask;
+    pBase[2] = (b.s_aggregateCounter++) & BOARD_COUNTER_MASK;
+    pBase[3] = static_cast<uint32_t>(tickEnd);
+    *bufferSize = static_cast<uint32_t>((p - pBase)*sizeof(uint32_t));
+    return CAEN_DGTZ_Success;
+}
+/**
+ * getDPPEvents
+ *    Decode the board aggregates in a buffer into per channel arrays of
+ *    CAEN_DGTZ_DPP_PHA_Event_t or CAEN_DGTZ_DPP_PSD_Event_t.
+ */
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::getDPPEvents(
+    int handle, char* buffer, uint32_t bufferSize, void** events, uint32_t* numEvents
+)
+{
+    Board* pBoard = findBoard(handle);
+    if (!pBoard) return CAEN_DGTZ_InvalidHandle;
+    return CDppEventDecoder::getEvents(
+        pBoard->s_config.s_firmware == PSD, buffer, bufferSize,
+        events, numEvents, pBoard->s_config.s_maxHitsPerChannel
+    );
+}
+CAEN_DGTZ_ErrorCode
+CSimulatedDigitizer::decodeDPPWaveforms(int handle, void* event, void* waveforms)
+{
+    Board* pBoard = findBoard(handle);
+    if (!pBoard) return CAEN_DGTZ_InvalidHandle;
+    return CDppEventDecoder::decodeWaveforms(
+        pBoard->s_config.s_firmware == PSD, event, waveforms
+    );
+}
+
+/*------------------------------------------------------------------------------
+ * private utilities.
+ */
+
+/**
+ * findBoard
+ * @param handle - handle returned by openDigitizer.
+ * @return Board* - nullptr if the handle is not open.
+ */
+CSimulatedDigitizer::Board*
+CSimulatedDigitizer::findBoard(int handle)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    auto p = m_boards.find(handle);
+    return (p == m_boards.end()) ? nullptr : p->second;
+}
+/**
+ * nsPerTick
+ * @return uint32_t - ns per time tag tick: 2 for the 730, 4 for the 725.
+ */
+uint32_t
+CSimulatedDigitizer::nsPerTick(const Board& board) const
+{
+    return board.s_config.s_is730 ? 2 : 4;
+}
+/**
+ * traceSamples
+ *    Number of samples in each trace a channel's hits carry - none in list
+ *    mode.  The format word counts samples in units of 8 for both traces
+ *    together so this is rounded up to fit.
+ */
+uint32_t
+CSimulatedDigitizer::traceSamples(const Board& board, int channel) const
+{
+    if (board.s_listMode) return 0;
+    uint32_t n    = board.s_config.s_traceSamples ?
+        board.s_config.s_traceSamples : board.s_recordLength[channel];
+    uint32_t unit = board.s_config.s_dualTrace ? FMT_NS_UNIT/2 : FMT_NS_UNIT;
+    n = ((n + unit - 1)/unit)*unit;
+    uint32_t max  = board.s_config.s_dualTrace ? MAX_SAMPLES/2 : MAX_SAMPLES;
+    return (n > max) ? max : n;
+}
+/**
+ * formatWord
+ *    The couple aggregate format word for a channel:  time tag, energy/charge,
+ *    extras (option 2: extended time stamp and fine time) and samples
+ *    when traces are being taken.
+ */
+uint32_t
+CSimulatedDigitizer::formatWord(const Board& board, int channel) const
+{
+    uint32_t format = FMT_ENERGY | FMT_TIMETAG | FMT_EXTRAS | (2 << FMT_EXTRAS_OPT_SHIFT);
+    uint32_t ns     = traceSamples(board, channel);
+    if (ns) {
+        uint32_t total = board.s_config.s_dualTrace ? 2*ns : ns;
+        format |= FMT_SAMPLES | (total/FMT_NS_UNIT);
+        if (board.s_config.s_dualTrace) format |= FMT_DUAL_TRACE;
+    }
+    return format;
+}
+/**
+ * nextInterval
+ *    Ticks until a channel's next hit: exponentially distributed for the
+ *    channel's rate.
+ */
+uint64_t
+CSimulatedDigitizer::nextInterval(Board& board, int channel)
+{
+    double rate = board.s_config.s_rate[channel];
+    if (rate <= 0.0) return UINT64_C(1) << 62;           // Never.
+    std::exponential_distribution<double> interval(rate*nsPerTick(board)*1.0e-9);
+    return 1 + static_cast<uint64_t>(interval(board.s_random));
+}
+/**
+ * stageHits
+ *    Decide which hits go in this read:  all hits before tickEnd in time
+ *    order across the board, stopping early if the buffer or a channel's
+ *    event array would overflow.  Stopping at a single cutoff time for the
+ *    whole board means the hits a read leaves behind are all later than the
+ *    ones it delivers, just as the drivers expect.
+ *
+ * @param b       - the board.
+ * @param tickEnd - Hits before this tick are staged.
+ * @param nWords  - Room in the buffer for couple aggregates.
+ */
+void
+CSimulatedDigitizer::stageHits(Board& b, uint64_t tickEnd, uint32_t nWords)
+{
+    uint32_t eventSize[CAEN_DGTZ_MAX_CHANNEL/2];
+    for (int c = 0; c < CAEN_DGTZ_MAX_CHANNEL/2; c++) {
+        b.s_staged[c].clear();
+        eventSize[c] = eventWords(formatWord(b, 2*c));
+        if (nWords >= COUPLE_HEADER_WORDS) nWords -= COUPLE_HEADER_WORDS;
+        else nWords = 0;
+    }
+    for (int i = 0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
+        b.s_hitsThisRead[i] = 0;
+    }
+
+    for (;;) {
+        // Earliest pending item - a fake rollover event comes before
+        // the first hit of a new time tag epoch:
+
+        int      ch   = -1;
+        uint64_t tick = 0;
+        bool     fake = false;
+        for (int c = 0; c < CAEN_DGTZ_MAX_CHANNEL; c++) {
+            if (!(b.s_enableMask & (1 << c))) continue;
+            uint64_t t = b.s_nextHit[c];
+            bool     f = false;
+            if (b.s_config.s_fakeRollover && ((t >> 31) > b.s_epoch[c])) {
+                t = (b.s_epoch[c] + 1) << 31;
+                f = true;
+            }
+            if ((t < tickEnd) && ((ch < 0) || (t < tick))) {
+                ch = c; tick = t; fake = f;
+            }
+        }
+        if (ch < 0) break;
+        if (b.s_hitsThisRead[ch] >= b.s_config.s_maxHitsPerChannel) break;
+        if (eventSize[ch/2] > nWords) break;          // Buffer full.
+
+        Hit hit = {ch, tick, fake};
+        b.s_staged[ch/2].push_back(hit);
+        b.s_hitsThisRead[ch]++;
+        nWords -= eventSize[ch/2];
+        if (fake) {
+            b.s_epoch[ch]++;
+        } else {
+            b.s_epoch[ch]   = tick >> 31;
+            b.s_nextHit[ch] = tick + nextInterval(b, ch);
+        }
+    }
+}
+/**
+ * putCouple
+ *    Put the couple aggregate for the hits staged for a couple.
+ *
+ * @param b       - the board.
+ * @param p       - Where the aggregate goes.
+ * @param couple  - Couple number.
+ * @return uint32_t* - after the aggregate.
+ */
+uint32_t*
+CSimulatedDigitizer::putCouple(Board& b, uint32_t* p, int couple)
+{
+    uint32_t* q = p + COUPLE_HEADER_WORDS;
+    const std::vector<Hit>& hits(b.s_staged[couple]);
+    for (size_t i = 0; i < hits.size(); i++) {
+        q = putHit(b, q, hits[i].s_channel, hits[i].s_tick, hits[i].s_fake);
+    }
+    p[0] = COUPLE_HEADER_BIT | static_cast<uint32_t>(q - p);
+    p[1] = formatWord(b, 2*couple);
+    return q;
+}
+/**
+ * putHit
+ *    Put one event into a couple aggregate.
+ *
+ * @param b       - The board.
+ * @param p       - Where the event goes.
+ * @param channel - Channel of the hit.
+ * @param tick    - 64 bit time of the hit in ticks.
+ * @param fake    - True for a fake rollover event.
+ * @return uint32_t* - after the event.
+ */
+uint32_t*
+CSimulatedDigitizer::putHit(Board& b, uint32_t* p, int channel, uint64_t tick, bool fake)
+{
+    uint32_t format = formatWord(b, channel);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::normal_distribution<double>       normal(0.0, 1.0);
+
+    // Pick the physics: two lines on an exponential background and for PSD
+    // a gamma or neutron like short/long charge ratio:
+
+    double energy = 0.0;
+    double ratio  = 0.0;
+    if (!fake) {
+        double r = uniform(b.s_random);
+        if (r < 0.35) {
+            energy = 1200.0 + 15.0*normal(b.s_random);
+        } else if (r < 0.6) {
+            energy = 3000.0 + 25.0*normal(b.s_random);
+        } else {
+            std::exponential_distribution<double> bkg(1.0/800.0);
+            energy = bkg(b.s_random);
+        }
+        if (energy < 0.0)     energy = 0.0;
+        if (energy > 32767.0) energy = 32767.0;
+        ratio = (uniform(b.s_random) < 0.7) ?
+            0.85 + 0.02*normal(b.s_random) : 0.70 + 0.03*normal(b.s_random);
+    }
+    bool pileup = !fake && (uniform(b.s_random) < b.s_config.s_pileupFraction);
+    bool count128 = false;
+    if (!fake) {
+        count128 = (++b.s_triggers[channel] % 128) == 0;
+    }
+
+    *p++ = ((channel & 1) ? EVT_ODD_CHANNEL : 0) | static_cast<uint32_t>(tick & EVT_TIMETAG_MASK);
+
+    if (format & FMT_SAMPLES) {
+        uint32_t  ns     = samplesPerTrace(format);
+        bool      dual   = (format & FMT_DUAL_TRACE) != 0;
+        uint16_t* pS     = reinterpret_cast<uint16_t*>(p);
+        double    amp    = energy*(12000.0/32768.0);
+        for (uint32_t i = 0; i < ns; i++) {
+            double   shape = (i < b.s_pulseShape.size()) ? b.s_pulseShape[i] : 0.0;
+            uint16_t s     = static_cast<uint16_t>(BASELINE + amp*shape) & SAMPLE_MASK;
+            if (shape > 0.5) s |= 0x4000;                  // Digital probe: gate.
+            *pS++ = s;
+            if (dual) {
+                *pS++ = static_cast<uint16_t>(BASELINE + 0.5*amp*shape) & SAMPLE_MASK;
+            }
+        }
+        p += (dual ? 2*ns : ns)/2;
+    }
+
+    uint32_t fineTime = static_cast<uint32_t>(uniform(b.s_random)*1024.0) & 0x3ff;
+    uint32_t extended = static_cast<uint32_t>((tick >> 31) & 0xffff) << 16;
+    if (b.s_config.s_firmware == PHA) {
+        *p++ = extended | fineTime;                       // Extras2.
+        uint32_t extras = fake ? 0xa : (count128 ? 0x40 : 0);
+        uint32_t e      = static_cast<uint32_t>(energy) & 0x7fff;
+        if (pileup) e |= 0x8000;
+        *p++ = (extras << PHA_EXTRAS_SHIFT) | e;
+    } else {
+        uint32_t flags  = count128 ? 0x2000 : 0;
+        *p++ = extended | flags | fineTime;               // Extras.
+        uint32_t qLong  = static_cast<uint32_t>(energy) & 0xffff;
+        uint32_t qShort = static_cast<uint32_t>(energy*ratio) & PSD_SHORT_MASK;
+        *p++ = (qLong << PSD_LONG_SHIFT) | (pileup ? PSD_PUR_BIT : 0) | qShort;
+    }
+    return p;
+}
@@ -0,0 +1,176 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CSimulatedDigitizer.h
+# @brief Digitizer backend simulating x725/x730 boards with DPP-PHA/PSD firmware.
+
+*/
+#ifndef CSIMULATEDDIGITIZER_H
+#define CSIMULATEDDIGITIZER_H
+
+#include "CDigitizerBackend.h"
+#include <string>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <random>
+#include <chrono>
+#include <utility>
+
+/**
+ * @class CSimulatedDigitizer
+ *    A digitizer backend with no hardware behind it.  Boards are
+ *    declared with addBoard() keyed by the link number and CONET node
+ *    the drivers will open.  Each simulated board:
+ *    - Reports the model, serial number, family and firmware it was
+ *      configured with so the Compass configuration matching works.
+ *    - Keeps a register file so that register read-modify-writes and
+ *      the setup helpers behave.
+ *    - Once started, synthesizes hits on each enabled channel at a configurable
+ *      rate, with 31 bit rolling time tags, optional fake rollover
+ *      events, the 128 trigger flags, pile up flags and traces of the record
+ *      length the driver programmed.
+ *    - Packs them in ReadData into genuine board/couple aggregates (see
+ *      DppAggregateFormat.h) that GetDPPEvents and DecodeDPPWaveforms decode
+ *      into the CAEN library structs.
+ *
+ *    Hits are paced either by the wall clock (realistic rates for
+ *    Readout tests) or produced as fast as they are read (for benchmarking the
+ *    readout chain).
+ */
+class CSimulatedDigitizer : public CDigitizerBackend
+{
+public:
+    typedef enum _Firmware {
+        PHA, PSD
+    } Firmware;
+
+    /**
+     *  Description of one simulated board.  The constructor supplies
+     *  defaults for a 730 running PHA at 1kHz/channel.
+     */
+    struct BoardConfig {
+        std::string s_modelName;
+        uint32_t    s_serialNumber;
+        bool        s_is730;             // false means 725.
+        Firmware    s_firmware;
+        double      s_rate[CAEN_DGTZ_MAX_CHANNEL];  // Hits/s for each channel.
+        uint32_t    s_traceSamples;      // 0 - use the programmed record length.
+        bool        s_dualTrace;
+        bool        s_fakeRollover;      // Emit fake events at time tag rollovers.
+        double      s_pileupFraction;
+        bool        s_realTime;          // Pace hits by the wall clock.
+        uint32_t    s_hitsPerRead;       // !realTime - hits/channel per ReadData at the max rate.
+        uint32_t    s_maxHitsPerChannel; // Per ReadData (DPP event array size).
+        uint64_t    s_startTick;         // Initial time - lets rollovers come sooner.
+        unsigned    s_seed;
+
+        BoardConfig();
+    };
+
+private:
+    struct Hit {                         // A hit staged for a couple aggregate.
+        int      s_channel;
+        uint64_t s_tick;
+        bool     s_fake;
+    };
+    struct Board {
+        BoardConfig                     s_config;
+        std::mutex                      s_lock;
+        std::map<uint32_t, uint32_t>    s_registers;
+        uint32_t                        s_enableMask;
+        uint32_t                        s_recordLength[CAEN_DGTZ_MAX_CHANNEL];
+        bool                            s_listMode;
+        bool                            s_running;
+        std::chrono::steady_clock::time_point s_startTime;
+        uint64_t                        s_tick;              // Time simulated so far.
+        uint64_t                        s_nextHit[CAEN_DGTZ_MAX_CHANNEL];
+        uint64_t                        s_epoch[CAEN_DGTZ_MAX_CHANNEL];     // tick >> 31 of last hit.
+        uint32_t                        s_triggers[CAEN_DGTZ_MAX_CHANNEL];
+        uint32_t                        s_hitsThisRead[CAEN_DGTZ_MAX_CHANNEL];
+        uint32_t                        s_aggregateCounter;
+        std::mt19937                    s_random;
+        std::vector<double>             s_pulseShape;
+        std::vector<Hit>                s_staged[CAEN_DGTZ_MAX_CHANNEL/2];
+    };
+
+    std::mutex                               m_lock;
+    std::map<std::pair<int, int>, BoardConfig> m_configs;
+    std::map<int, Board*>                    m_boards;       // By handle.
+    int                                      m_nextHandle;
+    uint32_t                                 m_readoutBufferSize;
+
+public:
+    CSimulatedDigitizer(uint32_t readoutBufferBytes = 8*1024*1024);
+    virtual ~CSimulatedDigitizer();
+
+    void addBoard(int linkNum, int conetNode, const BoardConfig& config);
+
+    // The backend interface:
+
+    virtual CAEN_DGTZ_ErrorCode openDigitizer(
+        CAEN_DGTZ_ConnectionType linkType, int linkNum, int conetNode,
+        uint32_t vmeBase, int* handle
+    );
+    virtual CAEN_DGTZ_ErrorCode closeDigitizer(int handle);
+    virtual CAEN_DGTZ_ErrorCode getInfo(int handle, CAEN_DGTZ_BoardInfo_t* info);
+    virtual CAEN_DGTZ_ErrorCode reset(int handle);
+    virtual CAEN_DGTZ_ErrorCode calibrate(int handle);
+
+    virtual CAEN_DGTZ_ErrorCode readRegister(int handle, uint32_t address, uint32_t* data);
+    virtual CAEN_DGTZ_ErrorCode writeRegister(int handle, uint32_t address, uint32_t data);
+
+    virtual CAEN_DGTZ_ErrorCode setRecordLength(int handle, uint32_t size, int channel = -1);
+    virtual CAEN_DGTZ_ErrorCode setAcquisitionMode(int handle, CAEN_DGTZ_AcqMode_t mode);
+    virtual CAEN_DGTZ_ErrorCode setDPPAcquisitionMode(
+        int handle, CAEN_DGTZ_DPP_AcqMode_t mode, CAEN_DGTZ_DPP_SaveParam_t param
+    );
+    virtual CAEN_DGTZ_ErrorCode setChannelEnableMask(int handle, uint32_t mask);
+    virtual CAEN_DGTZ_ErrorCode setChannelDCOffset(int handle, uint32_t channel, uint32_t value);
+    virtual CAEN_DGTZ_ErrorCode setChannelPulsePolarity(
+        int handle, uint32_t channel, CAEN_DGTZ_PulsePolarity_t polarity
+    );
+    virtual CAEN_DGTZ_ErrorCode setDPPParameters(int handle, uint32_t channelMask, void* params);
+    virtual CAEN_DGTZ_ErrorCode setDPPPreTriggerSize(int handle, int channel, uint32_t samples);
+    virtual CAEN_DGTZ_ErrorCode setIOLevel(int handle, CAEN_DGTZ_IOLevel_t level);
+    virtual CAEN_DGTZ_ErrorCode setDPPEventAggregation(int handle, int threshold, int maxsize);
+    virtual CAEN_DGTZ_ErrorCode setMaxNumAggregatesBLT(int handle, uint32_t numAggr);
+    virtual CAEN_DGTZ_ErrorCode setRunSynchronizationMode(int handle, CAEN_DGTZ_RunSyncMode_t mode);
+
+    virtual CAEN_DGTZ_ErrorCode swStartAcquisition(int handle);
+    virtual CAEN_DGTZ_ErrorCode swStopAcquisition(int handle);
+    virtual CAEN_DGTZ_ErrorCode clearData(int handle);
+
+    virtual CAEN_DGTZ_ErrorCode mallocReadoutBuffer(int handle, char** buffer, uint32_t* size);
+    virtual CAEN_DGTZ_ErrorCode freeReadoutBuffer(char** buffer);
+    virtual CAEN_DGTZ_ErrorCode mallocDPPEvents(int handle, void** events, uint32_t* allocatedSize);
+    virtual CAEN_DGTZ_ErrorCode freeDPPEvents(int handle, void** events);
+    virtual CAEN_DGTZ_ErrorCode mallocDPPWaveforms(int handle, void** waveforms, uint32_t* allocatedSize);
+    virtual CAEN_DGTZ_ErrorCode freeDPPWaveforms(int handle, void* waveforms);
+
+    virtual CAEN_DGTZ_ErrorCode readData(
+        int handle, CAEN_DGTZ_ReadMode_t mode, char* buffer, uint32_t* bufferSize
+    );
+    virtual CAEN_DGTZ_ErrorCode getDPPEvents(
+        int handle, char* buffer, uint32_t bufferSize, void** events, uint32_t* numEvents
+    );
+    virtual CAEN_DGTZ_ErrorCode decodeDPPWaveforms(int handle, void* event, void* waveforms);
+
+private:
+    Board*   findBoard(int handle);
+    uint32_t nsPerTick(const Board& board) const;
+    uint32_t traceSamples(const Board& board, int channel) const;
+    uint32_t formatWord(const Board& board, int channel) const;
+    uint64_t nextInterval(Board& board, int channel);
+    uint32_t* putHit(Board& board, uint32_t* p, int channel, uint64_t tick, bool fake);
+    void      stageHits(Board& board, uint64_t tickEnd, uint32_t nWords);
+    uint32_t* putCouple(Board& board, uint32_t* p, int couple);
+};
+
+#endif
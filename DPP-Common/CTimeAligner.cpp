@@ -0,0 +1,136 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CTimeAligner.cpp
+# @brief Implement the time difference histograms and their peak fits.
+
+*/
+#include "CTimeAligner.h"
+#include <algorithm>
+#include <cmath>
+
+/**
+ * Settings constructor
+ *    +/- 500ns in 2ns bins, the centroid over +/- 5 bins.
+ */
+CTimeAligner::Settings::Settings() :
+    s_windowNs(500), s_binNs(2), s_fitBins(5), s_minCounts(10)
+{}
+
+/**
+ * constructor
+ */
+CTimeAligner::CTimeAligner(const Settings& settings) :
+    m_settings(settings)
+{
+    if (!m_settings.s_binNs)    m_settings.s_binNs    = 1;
+    if (!m_settings.s_windowNs) m_settings.s_windowNs = m_settings.s_binNs;
+}
+/**
+ * clear
+ *    Forget the hits.
+ */
+void
+CTimeAligner::clear()
+{
+    m_reference.clear();
+    m_hits.clear();
+}
+/**
+ * sources
+ * @return std::vector<int> - source ids with hits.
+ */
+std::vector<int>
+CTimeAligner::sources() const
+{
+    std::vector<int> result;
+    for (auto p = m_hits.begin(); p != m_hits.end(); p++) {
+        result.push_back(p->first);
+    }
+    return result;
+}
+/**
+ * histogram
+ *    Bin i counts board - reference differences in
+ *    [-window + i*bin, -window + (i+1)*bin).
+ *
+ * @param sourceId - The board.
+ * @return std::vector<uint64_t> - the histogram.
+ */
+std::vector<uint64_t>
+CTimeAligner::histogram(int sourceId)
+{
+    int64_t window = m_settings.s_windowNs;
+    int64_t bin    = m_settings.s_binNs;
+    std::vector<uint64_t> result((2*window + bin - 1)/bin, 0);
+
+    std::vector<uint64_t>& hits(m_hits[sourceId]);
+    std::sort(m_reference.begin(), m_reference.end());
+    std::sort(hits.begin(), hits.end());
+
+    // Both sorted, so the reference hits in the window of each hit start
+    // no earlier than those of the one before:
+
+    size_t first = 0;
+    for (size_t i = 0; i < hits.size(); i++) {
+        int64_t t = hits[i];
+        while ((first < m_reference.size()) &&
+               (t - static_cast<int64_t>(m_reference[first]) >= window)) {
+            first++;
+        }
+        for (size_t r = first; r < m_reference.size(); r++) {
+            int64_t diff = t - static_cast<int64_t>(m_reference[r]);
+            if (diff <= -window) break;
+            result[(diff + window)/bin]++;
+        }
+    }
+    return result;
+}
+/**
+ * fit
+ *    Find the coincidence peak of a board's histogram.
+ *
+ * @param sourceId - The board.
+ * @return Result - s_ok false if there are no hits or no peak stands out.
+ */
+CTimeAligner::Result
+CTimeAligner::fit(int sourceId)
+{
+    Result result = {false, 0.0, 0.0, 0, 0, 0.0};
+    std::vector<uint64_t> h = histogram(sourceId);
+    if (h.empty()) return result;
+    for (size_t i = 0; i < h.size(); i++) result.s_pairs += h[i];
+
+    std::vector<uint64_t> sorted(h);
+    std::nth_element(sorted.begin(), sorted.begin() + sorted.size()/2, sorted.end());
+    result.s_background = sorted[sorted.size()/2];
+
+    size_t peak = std::max_element(h.begin(), h.end()) - h.begin();
+    result.s_peakCounts = h[peak];
+    if (h[peak] < result.s_background + m_settings.s_minCounts) return result;
+
+    size_t first = (peak > m_settings.s_fitBins) ? peak - m_settings.s_fitBins : 0;
+    size_t last  = std::min(peak + m_settings.s_fitBins, h.size() - 1);
+    double sumW = 0.0, sumX = 0.0, sumXX = 0.0;
+    for (size_t i = first; i <= last; i++) {
+        double w = h[i] - result.s_background;
+        if (w <= 0.0) continue;
+
+        // Differences are whole ns, so a bin's mean is (bin - 1)/2 past its low edge:
+        double x = -static_cast<double>(m_settings.s_windowNs) + i*m_settings.s_binNs +
+                   0.5*(m_settings.s_binNs - 1);
+        sumW  += w;
+        sumX  += w*x;
+        sumXX += w*x*x;
+    }
+    result.s_peakNs  = sumX/sumW;
+    result.s_sigmaNs = std::sqrt(std::max(0.0, sumXX/sumW - result.s_peakNs*result.s_peakNs));
+    result.s_ok      = true;
+    return result;
+}
@@ -0,0 +1,84 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CTimeAligner.h
+# @brief Measure the timestamp offsets between boards from coincident hits.
+
+*/
+#ifndef CTIMEALIGNER_H
+#define CTIMEALIGNER_H
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+
+/**
+ * @class CTimeAligner
+ *    Given the hits of a reference channel on the reference board and of a
+ *    channel on each other board that see the same signals (e.g. a pulser
+ *    fanned out to all boards), histograms the time differences between
+ *    each board's hits and the reference hits within +/- the window.
+ *    Coincidences make a peak over the flat background of random pairs,
+ *    fit() finds it:  the background is the histogram's median, the peak
+ *    position the background subtracted centroid of the bins around the
+ *    largest.  Adding offset() to a board's timestamps aligns it with the
+ *    reference (see CTimeOffsetTable).
+ *
+ *    Timestamps are ns.  Hits are kept until clear() and histogrammed when
+ *    fit, so they may be added in any order.
+ */
+class CTimeAligner
+{
+public:
+    struct Settings {
+        uint64_t s_windowNs;      // Pair hits closer than this.
+        unsigned s_binNs;         // Histogram bin width.
+        unsigned s_fitBins;       // The centroid is over the peak bin +/- this many.
+        uint64_t s_minCounts;     // Peak bin counts over background for a fit.
+
+        Settings();
+    };
+    struct Result {
+        bool     s_ok;            // A peak was found.
+        double   s_peakNs;        // Board - reference time difference.
+        double   s_sigmaNs;       // Width of the peak.
+        uint64_t s_pairs;         // Pairs histogrammed.
+        uint64_t s_peakCounts;    // In the peak bin.
+        double   s_background;    // Counts per bin.
+    };
+
+private:
+    Settings                             m_settings;
+    std::vector<uint64_t>                m_reference;
+    std::map<int, std::vector<uint64_t>> m_hits;      // By source id.
+
+public:
+    CTimeAligner(const Settings& settings = Settings());
+
+    void addReference(uint64_t ns)          { m_reference.push_back(ns); }
+    void addHit(int sourceId, uint64_t ns)  { m_hits[sourceId].push_back(ns); }
+    void clear();
+
+    const Settings&       settings() const { return m_settings; }
+    std::vector<int>      sources() const;
+    std::vector<uint64_t> histogram(int sourceId);
+    Result                fit(int sourceId);
+
+    /**
+     * offset
+     * @return int64_t - ns to add to the board's timestamps.
+     */
+    static int64_t offset(const Result& result)
+    {
+        double ns = -result.s_peakNs;
+        return static_cast<int64_t>(ns < 0 ? ns - 0.5 : ns + 0.5);
+    }
+};
+
+#endif
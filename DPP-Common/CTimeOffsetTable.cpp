@@ -0,0 +1,91 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CTimeOffsetTable.cpp
+# @brief Read and write timestamp offset tables.
+
+*/
+#include "CTimeOffsetTable.h"
+#include <fstream>
+#include <sstream>
+
+/**
+ * read
+ *    Replace the offsets with those of a file.
+ *
+ * @param filename - The table.
+ * @throw std::string - the file can't be read or has a bad line.
+ */
+void
+CTimeOffsetTable::read(const std::string& filename)
+{
+    std::ifstream in(filename.c_str());
+    if (!in) {
+        throw std::string("Unable to open timestamp offset table ") + filename;
+    }
+    m_offsets.clear();
+
+    std::string line;
+    unsigned    lineNo = 0;
+    while (std::getline(in, line)) {
+        lineNo++;
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream fields(line);
+        int     sourceId;
+        int64_t ns;
+        std::string extra;
+        if (!(fields >> sourceId)) {
+            if (line.find_first_not_of(" \t\r") == std::string::npos) continue;  // Blank.
+        } else if ((fields >> ns) && !(fields >> extra)) {
+            m_offsets[sourceId] = ns;
+            continue;
+        }
+        std::ostringstream msg;
+        msg << filename << " line " << lineNo << ": expected 'source-id offset-ns'";
+        throw msg.str();
+    }
+}
+/**
+ * write
+ *
+ * @param filename - Where.
+ * @param comment  - Written first, each line as a # comment.
+ * @throw std::string - the file can't be written.
+ */
+void
+CTimeOffsetTable::write(const std::string& filename, const std::string& comment) const
+{
+    std::ofstream out(filename.c_str());
+    if (!out) {
+        throw std::string("Unable to create timestamp offset table ") + filename;
+    }
+    std::istringstream lines(comment);
+    std::string        line;
+    while (std::getline(lines, line)) {
+        out << "# " << line << '\n';
+    }
+    out << "# source-id  offset-ns\n";
+    for (auto p = m_offsets.begin(); p != m_offsets.end(); p++) {
+        out << p->first << ' ' << p->second << '\n';
+    }
+    if (!out) {
+        throw std::string("Failed writing timestamp offset table ") + filename;
+    }
+}
+/**
+ * offset
+ * @return int64_t - ns to add to the timestamps of sourceId, 0 if not in the table.
+ */
+int64_t
+CTimeOffsetTable::offset(int sourceId) const
+{
+    auto p = m_offsets.find(sourceId);
+    return (p == m_offsets.end()) ? 0 : p->second;
+}
@@ -0,0 +1,55 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CTimeOffsetTable.h
+# @brief Per source id timestamp offsets that align the boards' clocks.
+
+*/
+#ifndef CTIMEOFFSETTABLE_H
+#define CTIMEOFFSETTABLE_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+
+/**
+ * @class CTimeOffsetTable
+ *    The boards share a clock but each sees its start and the signals with
+ *    its own cable and trigger delays.  The ns offset for a source id is
+ *    added to the timestamps of its events so that coincident hits on
+ *    different boards get the same timestamp, letting the event builder's
+ *    window be small.  dpptimealign measures them (see CTimeAligner) and
+ *    writes the table; the event segments read it at initialize.
+ *
+ *    The file is text, a source id and its offset per line, # comments:
+ *
+ *    \verbatim
+ *    # source-id  offset-ns
+ *    0            0
+ *    1          -54
+ *    \endverbatim
+ *
+ *    Source ids not in the table have no offset.
+ */
+class CTimeOffsetTable
+{
+private:
+    std::map<int, int64_t> m_offsets;
+
+public:
+    void read(const std::string& filename);
+    void write(const std::string& filename, const std::string& comment = "") const;
+
+    void    clear()                          { m_offsets.clear(); }
+    void    setOffset(int sourceId, int64_t ns) { m_offsets[sourceId] = ns; }
+    int64_t offset(int sourceId) const;
+    const std::map<int, int64_t>& offsets() const { return m_offsets; }
+};
+
+#endif
@@ -0,0 +1,175 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CTimeOrderedMerger.h
+# @brief k-way merge of time ordered hit sources (channels or boards).
+
+*/
+#ifndef CTIMEORDEREDMERGER_H
+#define CTIMEORDEREDMERGER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <functional>
+#include <stdexcept>
+
+/**
+ * @class CTimeOrderedMerger
+ *    Each source (a digitizer channel, or a whole board) delivers hits
+ *    in time order.  The merger holds the timestamp of the next undelivered
+ *    hit of each source with data in a binary min-heap so that
+ *    the source with the earliest hit is found in O(1) and replacing it
+ *    with that source's next hit costs O(log k) rather than the O(k)
+ *    scan over all sources.
+ *
+ *    Typical use:
+ *    - clear() and push() the head of each source with data after a buffer fill.
+ *    - top() gives the source to read.
+ *    - After consuming its hit, replaceTop() with the next hit's
+ *      timestamp or pop() if that source is exhausted.
+ *
+ *    Ties are broken by the smaller source (std::less<Source>) so that
+ *    e.g. the lower channel number wins as it did with the linear scans.
+ *
+ * @tparam Source - identifies a source.  Must be copyable and ordered by
+ *                  std::less (ints, pointers...).
+ */
+template <typename Source>
+class CTimeOrderedMerger
+{
+private:
+    struct Entry {
+        uint64_t s_timestamp;
+        Source   s_source;
+    };
+    std::vector<Entry> m_heap;
+
+public:
+    /**
+     * clear
+     *    Remove all sources.  Storage is retained for the next fill.
+     */
+    void clear() { m_heap.clear(); }
+    /**
+     * empty
+     * @return bool - true if no source has undelivered hits.
+     */
+    bool empty() const { return m_heap.empty(); }
+    /**
+     * size
+     * @return size_t - number of sources with undelivered hits.
+     */
+    size_t size() const { return m_heap.size(); }
+    /**
+     * reserve
+     *    Pre-size the heap so pushes in the hot path don't allocate.
+     * @param nSources - Maximum number of sources expected.
+     */
+    void reserve(size_t nSources) { m_heap.reserve(nSources); }
+
+    /**
+     * push
+     *    Add a source whose next hit has the timestamp given.
+     * @param timestamp - timestamp of the source's next hit.
+     * @param source    - the source.
+     */
+    void push(uint64_t timestamp, const Source& source)
+    {
+        Entry e = {timestamp, source};
+        m_heap.push_back(e);
+        siftUp(m_heap.size() - 1);
+    }
+    /**
+     * top
+     * @return const Source& - the source with the earliest next hit.
+     * @throw std::logic_error - if there are no sources.
+     */
+    const Source& top() const
+    {
+        if (m_heap.empty()) {
+            throw std::logic_error("CTimeOrderedMerger::top - no sources with data !!");
+        }
+        return m_heap[0].s_source;
+    }
+    /**
+     * topTimestamp
+     * @return uint64_t - the timestamp of the earliest next hit.
+     * @throw std::logic_error - if there are no sources.
+     */
+    uint64_t topTimestamp() const
+    {
+        if (m_heap.empty()) {
+            throw std::logic_error("CTimeOrderedMerger::topTimestamp - no sources with data !!");
+        }
+        return m_heap[0].s_timestamp;
+    }
+    /**
+     * pop
+     *    Remove the earliest source - normally because it has no more
+     *    buffered hits.
+     */
+    void pop()
+    {
+        if (m_heap.empty()) return;
+        m_heap[0] = m_heap.back();
+        m_heap.pop_back();
+        if (!m_heap.empty()) siftDown(0);
+    }
+    /**
+     * replaceTop
+     *    The earliest source has delivered its hit and has another.
+     *    Re-key it with the timestamp of that next hit.  This is a single
+     *    sift down rather than a pop followed by a push.
+     *
+     * @param timestamp - timestamp of the top source's next hit.
+     */
+    void replaceTop(uint64_t timestamp)
+    {
+        if (m_heap.empty()) {
+            throw std::logic_error("CTimeOrderedMerger::replaceTop - no sources with data !!");
+        }
+        m_heap[0].s_timestamp = timestamp;
+        siftDown(0);
+    }
+
+private:
+    static bool earlier(const Entry& a, const Entry& b)
+    {
+        if (a.s_timestamp != b.s_timestamp) return a.s_timestamp < b.s_timestamp;
+        return std::less<Source>()(a.s_source, b.s_source);
+    }
+    void siftUp(size_t i)
+    {
+        Entry e = m_heap[i];
+        while (i > 0) {
+            size_t parent = (i - 1)/2;
+            if (!earlier(e, m_heap[parent])) break;
+            m_heap[i] = m_heap[parent];
+            i = parent;
+        }
+        m_heap[i] = e;
+    }
+    void siftDown(size_t i)
+    {
+        size_t n = m_heap.size();
+        Entry  e = m_heap[i];
+        for (;;) {
+            size_t child = 2*i + 1;
+            if (child >= n) break;
+            if ((child + 1 < n) && earlier(m_heap[child + 1], m_heap[child])) child++;
+            if (!earlier(m_heap[child], e)) break;
+            m_heap[i] = m_heap[child];
+            i = child;
+        }
+        m_heap[i] = e;
+    }
+};
+
+#endif
@@ -0,0 +1,52 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CTimeOrderedSource.h
+# @brief Interface to event segments whose buffered hits have known timestamps.
+
+*/
+#ifndef CTIMEORDEREDSOURCE_H
+#define CTIMEORDEREDSOURCE_H
+
+#include <stdint.h>
+
+/**
+ * @class CTimeOrderedSource
+ *    Implemented by the event segments that read digitizer hits (the board
+ *    segments and the compound segments that contain them) so a
+ *    CReorderWindow can choose which of several to read next by timestamp.
+ *    A source's reads come out in time order.
+ */
+class CTimeOrderedSource
+{
+public:
+    virtual ~CTimeOrderedSource() {}
+
+    /**
+     * checkTrigger
+     *    Make sure there's a buffered hit if the hardware has any,
+     *    transferring data from the digitizer(s) if nothing is buffered.
+     * @return bool - true if the next read will find data.
+     */
+    virtual bool checkTrigger() = 0;
+    /**
+     * nextTimestamp
+     *    Only valid after checkTrigger returned true with no read since.
+     * @return uint64_t - ns timestamp of the event the next read returns.
+     */
+    virtual uint64_t nextTimestamp() = 0;
+    /**
+     * newestTimestamp
+     *    Only valid after checkTrigger returned true with no read since.
+     * @return uint64_t - ns timestamp of the latest hit buffered.
+     */
+    virtual uint64_t newestTimestamp() = 0;
+};
+
+#endif
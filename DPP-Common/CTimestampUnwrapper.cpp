@@ -0,0 +1,97 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CTimestampUnwrapper.cpp
+# @brief Implement the time tag to timestamp extension.
+
+*/
+#include "CTimestampUnwrapper.h"
+#include "DppAggregateFormat.h"
+
+using namespace DppFormat;
+
+// The extended time tag is 16 bits; it too rolls over:
+
+static const uint64_t EXTENDED_MASK = 0xffff;
+static const uint64_t EXTENDED_WRAP = EXTENDED_MASK + 1;
+
+/**
+ * constructor
+ *
+ * @param nsPerTick - Nanoseconds per time tag tick.
+ */
+CTimestampUnwrapper::CTimestampUnwrapper(unsigned nsPerTick) :
+    m_psPerTick(nsPerTick*PS_PER_NS),
+    m_fineTime(false)
+{
+    reset();
+}
+/**
+ * reset
+ *    Forget the rollovers, e.g. at the start of a run.
+ */
+void
+CTimestampUnwrapper::reset()
+{
+    for (int i = 0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
+        m_channels[i].s_upper   = 0;
+        m_channels[i].s_lastTag = 0;
+    }
+}
+/**
+ * unwrap
+ *    Compute the timestamps of a block of a channel's hits, which must
+ *    follow the channel's previous block.
+ *
+ * @param channel  - The channel.
+ * @param nHits    - Hits in the block.
+ * @param timeTags - Their 31 bit time tags.
+ * @param extras   - Their PHA extras2 / PSD extras words (0 if not read out).
+ * @param formats  - Their couple aggregate format words.
+ * @param ps       - Receives their timestamps in ps.
+ */
+void
+CTimestampUnwrapper::unwrap(
+    int channel, uint32_t nHits, const uint32_t* timeTags,
+    const uint32_t* extras, const uint32_t* formats, uint64_t* ps
+)
+{
+    Channel& c(m_channels[channel]);
+    uint64_t upper     = c.s_upper;
+    uint32_t last      = c.s_lastTag;
+    uint64_t psPerTick = m_psPerTick;
+    uint64_t fineMask  = m_fineTime ? FINE_TIME_MASK : 0;
+
+    for (uint32_t i = 0; i < nHits; i++) {
+        uint32_t tag    = timeTags[i];
+        uint32_t x      = extras[i];
+        uint32_t format = formats[i];
+        uint32_t option = (format >> FMT_EXTRAS_OPT_SHIFT) & FMT_EXTRAS_OPT_MASK;
+        uint64_t hasTag = -static_cast<uint64_t>(
+            ((format & FMT_EXTRAS) != 0) & (option <= EXTRAS_OPT_FINE_TIME)
+        );
+        uint64_t hasFine = -static_cast<uint64_t>(
+            ((format & FMT_EXTRAS) != 0) & (option == EXTRAS_OPT_FINE_TIME)
+        );
+
+        // Upper bits by counting rollovers and from the extended tag:
+
+        uint64_t counted  = upper + (tag < last);
+        uint64_t extended = (upper & ~EXTENDED_MASK) | (x >> EXTENDED_TAG_SHIFT);
+        extended         += static_cast<uint64_t>(extended < upper) * EXTENDED_WRAP;
+        upper             = (extended & hasTag) | (counted & ~hasTag);
+        last              = tag;
+
+        uint64_t tick = (upper << 31) | tag;
+        uint64_t fine = x & fineMask & hasFine;
+        ps[i] = tick*psPerTick + ((fine*psPerTick) >> FINE_TIME_BITS);
+    }
+    c.s_upper   = upper;
+    c.s_lastTag = last;
+}
@@ -0,0 +1,67 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CTimestampUnwrapper.h
+# @brief Extend the 31 bit time tags of a board's channels to 64 bit ps timestamps.
+
+*/
+#ifndef CTIMESTAMPUNWRAPPER_H
+#define CTIMESTAMPUNWRAPPER_H
+
+#include <stdint.h>
+#include <CAENDigitizerType.h>
+
+/**
+ * @class CTimestampUnwrapper
+ *    The one place the PHA and PSD drivers turn time tags into timestamps
+ *    (via CDppHitStore).  A channel's time tags are extended a block at a
+ *    time with a loop free of data dependent branches:
+ *
+ *    - If the hit's format word says its extras (PSD) or extras2 (PHA) word
+ *      holds the extended time tag (extras options 0-2, see
+ *      DppAggregateFormat.h) that supplies time tag bits [46:31].  The
+ *      timestamp is then exact however long the channel was quiet.
+ *    - Otherwise a time tag smaller than the last one means the 31 bit
+ *      counter rolled over, as the drivers have always assumed.
+ *    - With fine time enabled, hits whose extras word carries it (extras
+ *      option 2) have it added, in 1/1024 ticks.
+ *
+ *    Timestamps are in ps so the fine time isn't lost.  The rollover state
+ *    of each channel carries over from block to block until reset().
+ */
+class CTimestampUnwrapper
+{
+public:
+    static const uint64_t PS_PER_NS = 1000;
+
+private:
+    struct Channel {
+        uint64_t s_upper;                   // Time tag bits 31 up of the last hit.
+        uint32_t s_lastTag;
+    };
+    Channel  m_channels[CAEN_DGTZ_MAX_CHANNEL];
+    uint64_t m_psPerTick;
+    bool     m_fineTime;
+
+public:
+    CTimestampUnwrapper(unsigned nsPerTick = 4);
+
+    void setNsPerTick(unsigned nsPerTick) { m_psPerTick = nsPerTick*PS_PER_NS; }
+    void setFineTime(bool enable)         { m_fineTime = enable; }
+    bool fineTime() const                 { return m_fineTime; }
+    uint64_t rollovers(int channel) const { return m_channels[channel].s_upper; }  // Of the time tag.
+    void reset();
+
+    void unwrap(
+        int channel, uint32_t nHits, const uint32_t* timeTags,
+        const uint32_t* extras, const uint32_t* formats, uint64_t* ps
+    );
+};
+
+#endif
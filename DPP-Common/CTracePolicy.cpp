@@ -0,0 +1,74 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CTracePolicy.cpp
+# @brief Implement the per channel trace policies.
+
+*/
+#include "CTracePolicy.h"
+
+/**
+ * Policy constructor
+ *    The board's prescale with no conditions.
+ */
+CTracePolicy::Policy::Policy() :
+    s_prescale(DEFAULT_PRESCALE),
+    s_energyWindow(false), s_energyLow(0), s_energyHigh(0xffff),
+    s_pileupOnly(false)
+{}
+
+/**
+ * constructor
+ *    Every channel keeps every trace until told otherwise.
+ */
+CTracePolicy::CTracePolicy()
+{
+    setPrescale(1);
+    reset();
+}
+/**
+ * setPolicy
+ *    Set a channel's policy.
+ *
+ * @param chan            - The channel.
+ * @param policy          - Its policy.
+ * @param defaultPrescale - Prescale to use if the policy says DEFAULT_PRESCALE.
+ */
+void
+CTracePolicy::setPolicy(unsigned chan, const Policy& policy, unsigned defaultPrescale)
+{
+    m_policies[chan] = policy;
+    if (policy.s_prescale == DEFAULT_PRESCALE) {
+        m_policies[chan].s_prescale = defaultPrescale;
+    }
+}
+/**
+ * setPrescale
+ *    Give all channels the same prescale and no conditions.
+ *
+ * @param prescale - 1 keeps every trace, 0 none.
+ */
+void
+CTracePolicy::setPrescale(unsigned prescale)
+{
+    for (unsigned i = 0; i < CHANNELS; i++) {
+        setPolicy(i, Policy(), prescale);
+    }
+}
+/**
+ * reset
+ *    Restart the prescale counts e.g. at the start of a run.
+ */
+void
+CTracePolicy::reset()
+{
+    for (unsigned i = 0; i < CHANNELS; i++) {
+        m_matched[i] = 0;
+    }
+}
@@ -0,0 +1,101 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CTracePolicy.h
+# @brief Per channel choice of the hits whose traces are kept.
+
+*/
+#ifndef CTRACEPOLICY_H
+#define CTRACEPOLICY_H
+
+#include <stdint.h>
+#include <CAENDigitizerType.h>
+
+/**
+ * @class CTracePolicy
+ *    When a board takes waveforms every hit carries them, which can
+ *    triple the size of the hit records.  The drivers ask us which hits
+ *    keep their traces; the others go out in the compact no trace format
+ *    and their waveforms are never decoded.  Per channel a hit's trace is
+ *    kept if:
+ *
+ *    - it meets the channel's conditions: its energy (PSD: long charge)
+ *      is in a window and/or it was flagged as piled up, and
+ *    - it's 1 in prescale of the hits that met them.  A prescale of 0
+ *      keeps no traces.
+ *
+ *    The conditions and prescale come from the Compass configuration (the
+ *    DAQ_PARAM_CH_TRACE_* keys).  A channel that sets no prescale uses the
+ *    board's default (setTracePrescale on the event segments).
+ *
+ *    want() may be asked about a hit any number of times; next() must be
+ *    called once as each hit is consumed.
+ */
+class CTracePolicy
+{
+public:
+    static const unsigned CHANNELS         = CAEN_DGTZ_MAX_CHANNEL;
+    static const unsigned DEFAULT_PRESCALE = ~0u;   // Use the board's.
+
+    struct Policy {
+        unsigned s_prescale;         // Keep 1 in this many matching hits.
+        bool     s_energyWindow;     // Only energies in [s_energyLow, s_energyHigh].
+        uint32_t s_energyLow;
+        uint32_t s_energyHigh;
+        bool     s_pileupOnly;       // Only piled up hits.
+
+        Policy();
+    };
+
+private:
+    Policy   m_policies[CHANNELS];
+    uint64_t m_matched[CHANNELS];    // Hits that met the conditions.
+
+public:
+    CTracePolicy();
+
+    void setPolicy(unsigned chan, const Policy& policy, unsigned defaultPrescale);
+    void setPrescale(unsigned prescale);
+    void reset();
+
+    const Policy& policy(unsigned chan) const { return m_policies[chan]; }
+
+    /**
+     * want
+     *
+     * @param chan   - Channel the hit came from.
+     * @param energy - Its energy (PSD long charge).
+     * @param pileup - Its pile up flag.
+     * @return bool  - true to keep its trace.
+     */
+    bool want(unsigned chan, uint32_t energy, bool pileup) const
+    {
+        const Policy& p(m_policies[chan]);
+        return p.s_prescale && matches(p, energy, pileup) &&
+            ((m_matched[chan] % p.s_prescale) == 0);
+    }
+    /**
+     * next
+     *    Count a consumed hit towards its channel's prescale.
+     */
+    void next(unsigned chan, uint32_t energy, bool pileup)
+    {
+        if (matches(m_policies[chan], energy, pileup)) m_matched[chan]++;
+    }
+
+private:
+    static bool matches(const Policy& p, uint32_t energy, bool pileup)
+    {
+        if (p.s_pileupOnly && !pileup) return false;
+        return !p.s_energyWindow ||
+            ((energy >= p.s_energyLow) && (energy <= p.s_energyHigh));
+    }
+};
+
+#endif
@@ -0,0 +1,186 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CTriggerRateMeter.cpp
+# @brief Implement the trigger rate meter.
+
+*/
+#include "CTriggerRateMeter.h"
+#include <string.h>
+
+/**
+ * constructor
+ *
+ * @param windowNs - Digitizer time the rates are averaged over.
+ */
+CTriggerRateMeter::CTriggerRateMeter(uint64_t windowNs) :
+    m_sequence(0)
+{
+    setWindow(windowNs);
+}
+/**
+ * setWindow
+ *    Change the rate window and start counting over.
+ *
+ * @param windowNs - Digitizer time the rates are averaged over.
+ */
+void
+CTriggerRateMeter::setWindow(uint64_t windowNs)
+{
+    m_bucketNs = windowNs/BUCKETS;
+    if (!m_bucketNs) m_bucketNs = 1;
+    reset();
+}
+/**
+ * reset
+ *    Zero the totals and rates e.g. at the start of a run.  Counting starts
+ *    from the next hit recorded.
+ */
+void
+CTriggerRateMeter::reset()
+{
+    memset(m_channels, 0, sizeof(m_channels));
+    m_start       = 0;
+    m_bucketStart = 0;
+    m_bucket      = 0;
+    m_started     = false;
+    publish(0);
+}
+/**
+ * snapshot
+ *    Take a consistent copy of the most recently published counts and
+ *    compute the rates from them.  Safe from any thread; if the readout
+ *    publishes while we copy we just copy again.
+ *
+ * @param result - Receives the totals and rates.
+ */
+void
+CTriggerRateMeter::snapshot(Snapshot& result) const
+{
+    uint64_t words[PUB_WORDS];
+    uint32_t before;
+    uint32_t after;
+    do {
+        before = m_sequence.load(std::memory_order_acquire);
+        for (unsigned i = 0; i < PUB_WORDS; i++) {
+            words[i] = m_published[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = m_sequence.load(std::memory_order_relaxed);
+    } while ((before & 1) || (before != after));
+
+    result.s_timestamp  = words[PUB_NOW];
+    result.s_windowSecs = words[PUB_SPAN]*1.0e-9;
+    for (unsigned i = 0; i < CHANNELS; i++) {
+        const uint64_t* c = words + PUB_CHANNELS + i*PUB_WORDS_PER_CHANNEL;
+        ChannelRates&   r(result.s_channels[i]);
+        r.s_counted     = c[0];
+        r.s_lost        = c[1];
+        r.s_countedRate = result.s_windowSecs > 0 ? c[2]/result.s_windowSecs : 0.0;
+        r.s_lostRate    = result.s_windowSecs > 0 ? c[3]/result.s_windowSecs : 0.0;
+        r.s_liveFraction = 1.0;
+        if (c[2]) {
+            r.s_liveFraction = c[3] >= c[2] ? 0.0 : 1.0 - double(c[3])/c[2];
+        }
+    }
+}
+/*-------------------------------------------------------------------
+ * Private member functions.
+ */
+
+/**
+ * flag
+ *    Count a hit's flags in the current bucket, moving the window on
+ *    first if the hit is past it.
+ *
+ * @param chan    - Channel the hit came from.
+ * @param ns      - Its timestamp.
+ * @param counted - Its 'triggers counted' flag.
+ * @param lost    - Its 'triggers lost' flag.
+ */
+void
+CTriggerRateMeter::flag(unsigned chan, uint64_t ns, bool counted, bool lost)
+{
+    if (!m_started) {
+        m_start       = ns;
+        m_bucketStart = ns;
+        m_started     = true;
+    }
+    if (ns >= m_bucketStart + m_bucketNs) {
+        advance(ns);
+        publish(ns);
+    }
+    Channel& c(m_channels[chan]);
+    if (counted) {
+        c.s_counted += TRIGGERS_PER_FLAG;
+        c.s_countedFlags[m_bucket]++;
+    }
+    if (lost) {
+        c.s_lost += TRIGGERS_PER_FLAG;
+        c.s_lostFlags[m_bucket]++;
+    }
+}
+/**
+ * advance
+ *    Make the bucket ns falls in current, emptying the buckets the window
+ *    moves past.
+ *
+ * @param ns - A timestamp past the current bucket.
+ */
+void
+CTriggerRateMeter::advance(uint64_t ns)
+{
+    uint64_t steps = (ns - m_bucketStart)/m_bucketNs;
+    unsigned clear = steps < BUCKETS ? steps : BUCKETS;
+    for (unsigned i = 0; i < clear; i++) {
+        m_bucket = (m_bucket + 1) % BUCKETS;
+        for (unsigned ch = 0; ch < CHANNELS; ch++) {
+            m_channels[ch].s_countedFlags[m_bucket] = 0;
+            m_channels[ch].s_lostFlags[m_bucket]    = 0;
+        }
+    }
+    m_bucketStart += steps*m_bucketNs;
+}
+/**
+ * publish
+ *    Publish the totals and window counts for snapshot().
+ *
+ * @param ns - Timestamp of the newest hit.
+ */
+void
+CTriggerRateMeter::publish(uint64_t ns)
+{
+    // The window is the full buckets before the current one and as much
+    // of the current one as has passed, but no earlier than the start:
+
+    uint64_t span = (BUCKETS - 1)*m_bucketNs + (ns - m_bucketStart);
+    if (span > ns - m_start) span = ns - m_start;
+
+    uint32_t seq = m_sequence.load(std::memory_order_relaxed);
+    m_sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    m_published[PUB_NOW].store(ns, std::memory_order_relaxed);
+    m_published[PUB_SPAN].store(span, std::memory_order_relaxed);
+    for (unsigned i = 0; i < CHANNELS; i++) {
+        const Channel& c(m_channels[i]);
+        uint64_t countedFlags = 0;
+        uint64_t lostFlags    = 0;
+        for (unsigned b = 0; b < BUCKETS; b++) {
+            countedFlags += c.s_countedFlags[b];
+            lostFlags    += c.s_lostFlags[b];
+        }
+        std::atomic<uint64_t>* p = m_published + PUB_CHANNELS + i*PUB_WORDS_PER_CHANNEL;
+        p[0].store(c.s_counted, std::memory_order_relaxed);
+        p[1].store(c.s_lost, std::memory_order_relaxed);
+        p[2].store(countedFlags*TRIGGERS_PER_FLAG, std::memory_order_relaxed);
+        p[3].store(lostFlags*TRIGGERS_PER_FLAG, std::memory_order_relaxed);
+    }
+    m_sequence.store(seq + 2, std::memory_order_release);
+}
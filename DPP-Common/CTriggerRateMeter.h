@@ -0,0 +1,111 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file CTriggerRateMeter.h
+# @brief Trigger and lost trigger totals and rates from a board's hit flags.
+
+*/
+#ifndef CTRIGGERRATEMETER_H
+#define CTRIGGERRATEMETER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <CAENDigitizerType.h>
+
+/**
+ * @class CTriggerRateMeter
+ *    The boards flag a hit each time a channel counts another
+ *    TRIGGERS_PER_FLAG triggers and each time it loses that many.  The
+ *    event segments pass each hit's flags and timestamp to record(), which
+ *    keeps, per channel:
+ *
+ *    - Cumulative counted and lost trigger totals for the run.
+ *    - The counted and lost triggers in a sliding window of digitizer time
+ *      (BUCKETS buckets, the oldest dropped as time moves on), from which
+ *      rates and the live time fraction, 1 - lost/counted, follow.
+ *
+ *    All time comes from the hit timestamps so there are no clock calls in
+ *    the readout.  Every window/BUCKETS ns of digitizer time the counts are
+ *    published through a sequence lock; snapshot() takes a consistent copy
+ *    without locking the readout out, from any thread (e.g. the scalers).
+ */
+class CTriggerRateMeter
+{
+public:
+    static const unsigned TRIGGERS_PER_FLAG = 128;
+    static const unsigned BUCKETS           = 16;
+    static const unsigned CHANNELS          = CAEN_DGTZ_MAX_CHANNEL;
+
+    struct ChannelRates {
+        uint64_t s_counted;        // Triggers counted this run.
+        uint64_t s_lost;           // Triggers lost this run.
+        double   s_countedRate;    // Triggers/s over the window.
+        double   s_lostRate;       // Lost triggers/s over the window.
+        double   s_liveFraction;   // 1 - lost/counted over the window.
+    };
+    struct Snapshot {
+        uint64_t     s_timestamp;  // ns, newest hit when published.
+        double       s_windowSecs; // Time the rates are averaged over.
+        ChannelRates s_channels[CHANNELS];
+    };
+
+private:
+    struct Channel {
+        uint64_t s_counted;
+        uint64_t s_lost;
+        uint32_t s_countedFlags[BUCKETS];
+        uint32_t s_lostFlags[BUCKETS];
+    };
+    // Published counts; the per channel words are: counted, lost,
+    // counted in window, lost in window.
+
+    enum { PUB_NOW, PUB_SPAN, PUB_CHANNELS, PUB_WORDS_PER_CHANNEL = 4 };
+    static const unsigned PUB_WORDS = PUB_CHANNELS + CHANNELS*PUB_WORDS_PER_CHANNEL;
+
+    Channel  m_channels[CHANNELS];
+    uint64_t m_bucketNs;           // Width of a bucket.
+    uint64_t m_start;              // Timestamp the counting started.
+    uint64_t m_bucketStart;        // Start of the current bucket.
+    unsigned m_bucket;             // Index of the current bucket.
+    bool     m_started;
+
+    std::atomic<uint32_t> m_sequence;             // Odd while publishing.
+    std::atomic<uint64_t> m_published[PUB_WORDS];
+
+public:
+    CTriggerRateMeter(uint64_t windowNs = 1000000000);
+
+    void setWindow(uint64_t windowNs);
+    void reset();
+
+    /**
+     * record
+     *    Inline as it's called for every hit; only hits with a flag or that
+     *    cross a bucket boundary go further.
+     *
+     * @param chan    - Channel the hit came from.
+     * @param ns      - Its timestamp.
+     * @param counted - Its 'triggers counted' flag.
+     * @param lost    - Its 'triggers lost' flag.
+     */
+    void record(unsigned chan, uint64_t ns, bool counted, bool lost)
+    {
+        if (counted || lost || ns >= m_bucketStart + m_bucketNs || !m_started) {
+            flag(chan, ns, counted, lost);
+        }
+    }
+    void snapshot(Snapshot& result) const;
+
+private:
+    void flag(unsigned chan, uint64_t ns, bool counted, bool lost);
+    void advance(uint64_t ns);
+    void publish(uint64_t ns);
+};
+
+#endif
@@ -0,0 +1,142 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file DppAggregateFormat.h
+# @brief Layout of the x725/x730 DPP-PHA and DPP-PSD readout buffers.
+
+*/
+#ifndef DPPAGGREGATEFORMAT_H
+#define DPPAGGREGATEFORMAT_H
+
+#include <stdint.h>
+
+/**
+ *   A block read by CAEN_DGTZ_ReadData is a sequence of board aggregates:
+ *
+ *   Board aggregate header (4 words):
+ *   |  [31:28] 0xA  | [27:0] aggregate size in 32 bit words (self inclusive) |
+ *   |  [31:27] board id | [26] board fail | [23:8] LVDS pattern | [7:0] couple mask |
+ *   |  [22:0] aggregate counter                                             |
+ *   |  [31:0] board aggregate time tag                                      |
+ *
+ *   Followed by one channel (couple) aggregate for each bit set in the
+ *   couple mask.  Couple n holds channels 2n and 2n+1:
+ *   |  [31] 1 | [21:0] couple aggregate size in words (self inclusive) |
+ *   |  format word (below)                                             |
+ *   |  events...                                                       |
+ *
+ *   Format word:
+ *     PHA: [31] dual trace [30] energy [29] time tag [28] extras2 [27] samples
+ *          [26:24] extras option [23:22] analog probe 1 [21:20] analog probe 2
+ *          [19:16] digital probe [15:0] samples/8
+ *     PSD: [31] dual trace [30] charge [29] time tag [28] extras [27] samples
+ *          [26:24] extras option [23:22] analog probe [21:19] digital probe 2
+ *          [18:16] digital probe 1 [15:0] samples/8
+ *
+ *   Each event is:
+ *   |  [31] odd channel of the couple | [30:0] trigger time tag |
+ *   |  samples/2 waveform words if samples enabled  - two 16 bit samples per
+ *   |     word, even sample in the low half.  [13:0] ADC, [14] [15] digital probes.
+ *   |     Dual trace samples alternate trace 1, trace 2.                     |
+ *   |  PHA: extras2 word if enabled, then [25:16] extras [15:0] energy       |
+ *   |  PSD: extras word if enabled, then [31:16] long charge [15] pile up
+ *   |       [14:0] short charge                                              |
+ *
+ *   The time tag is 31 bits; that's why the drivers' rollover adjustments are
+ *   2^31 ticks.  With extras options 0-2 the PHA extras2 and PSD extras
+ *   words are [31:16] extended time tag (time tag bits [46:31]) and, for
+ *   option 2, [9:0] fine time in 1/1024 ticks.
+ */
+namespace DppFormat {
+
+    // Board aggregate header:
+
+    const uint32_t BOARD_HEADER_WORDS     = 4;
+    const uint32_t BOARD_TYPE_MASK        = 0xf0000000;
+    const uint32_t BOARD_TYPE             = 0xa0000000;
+    const uint32_t BOARD_SIZE_MASK        = 0x0fffffff;
+    const uint32_t BOARD_ID_SHIFT         = 27;
+    const uint32_t BOARD_FAIL_BIT         = 0x04000000;
+    const uint32_t BOARD_PATTERN_SHIFT    = 8;
+    const uint32_t BOARD_PATTERN_MASK     = 0xffff;
+    const uint32_t BOARD_COUPLE_MASK      = 0xff;
+    const uint32_t BOARD_COUNTER_MASK     = 0x7fffff;
+
+    // Channel (couple) aggregate header:
+
+    const uint32_t COUPLE_HEADER_WORDS    = 2;
+    const uint32_t COUPLE_HEADER_BIT      = 0x80000000;
+    const uint32_t COUPLE_SIZE_MASK       = 0x3fffff;
+
+    // Format word:
+
+    const uint32_t FMT_DUAL_TRACE         = 0x80000000;
+    const uint32_t FMT_ENERGY             = 0x40000000;      // PSD: charge.
+    const uint32_t FMT_TIMETAG            = 0x20000000;
+    const uint32_t FMT_EXTRAS             = 0x10000000;      // PHA: extras2
+    const uint32_t FMT_SAMPLES            = 0x08000000;
+    const uint32_t FMT_EXTRAS_OPT_SHIFT   = 24;
+    const uint32_t FMT_EXTRAS_OPT_MASK    = 0x7;
+    const uint32_t FMT_NS_MASK            = 0xffff;
+    const uint32_t FMT_PROBE1_SHIFT       = 22;              // PHA VProbe1, PSD anlgProbe.
+    const uint32_t FMT_PROBE1_MASK        = 0x3;
+    const uint32_t PHA_FMT_PROBE2_SHIFT   = 20;              // VProbe2.
+    const uint32_t PHA_FMT_PROBE2_MASK    = 0x3;
+    const uint32_t PHA_FMT_DPROBE_SHIFT   = 16;              // VDProbe.
+    const uint32_t PHA_FMT_DPROBE_MASK    = 0xf;
+    const uint32_t PSD_FMT_DPROBE2_SHIFT  = 19;
+    const uint32_t PSD_FMT_DPROBE1_SHIFT  = 16;
+    const uint32_t PSD_FMT_DPROBE_MASK    = 0x7;
+    const uint32_t FMT_NS_UNIT            = 8;
+
+    // Event words:
+
+    const uint32_t EVT_ODD_CHANNEL        = 0x80000000;
+    const uint32_t EVT_TIMETAG_MASK       = 0x7fffffff;
+    const uint64_t TIMETAG_WRAP           = UINT64_C(0x80000000);  // Ticks per rollover.
+    const uint32_t SAMPLE_MASK            = 0x3fff;
+
+    const uint32_t EXTRAS_OPT_FINE_TIME   = 2;                    // Highest with the extended tag.
+    const uint32_t EXTENDED_TAG_SHIFT     = 16;
+    const uint32_t FINE_TIME_MASK         = 0x3ff;
+    const uint32_t FINE_TIME_BITS         = 10;
+
+    const uint32_t PHA_ENERGY_MASK        = 0xffff;               // Includes pile up.
+    const uint32_t PHA_EXTRAS_SHIFT       = 16;
+    const uint32_t PHA_EXTRAS_MASK        = 0x3ff;
+
+    const uint32_t PSD_SHORT_MASK         = 0x7fff;
+    const uint32_t PSD_PUR_BIT            = 0x8000;
+    const uint32_t PSD_LONG_SHIFT         = 16;
+
+    /**
+     * samplesPerTrace
+     *    Number of samples in each trace of an event from the format word.
+     */
+    inline uint32_t samplesPerTrace(uint32_t format)
+    {
+        if (!(format & FMT_SAMPLES)) return 0;
+        uint32_t ns = (format & FMT_NS_MASK) * FMT_NS_UNIT;
+        return (format & FMT_DUAL_TRACE) ? ns/2 : ns;
+    }
+    /**
+     * eventWords
+     *    Number of 32 bit words in each event of a couple aggregate given
+     *    its format word.  The format is the same for PHA and PSD.
+     */
+    inline uint32_t eventWords(uint32_t format)
+    {
+        uint32_t words = 2;                          // Time tag and energy/charge.
+        if (format & FMT_SAMPLES) words += (format & FMT_NS_MASK) * FMT_NS_UNIT/2;
+        if (format & FMT_EXTRAS) words++;
+        return words;
+    }
+}
+
+#endif
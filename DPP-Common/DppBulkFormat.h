@@ -0,0 +1,70 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file DppBulkFormat.h
+# @brief Layout of multi-hit (bulk) event fragments.
+
+*/
+#ifndef DPPBULKFORMAT_H
+#define DPPBULKFORMAT_H
+
+#include <stdint.h>
+#include "DppFragmentFormat.h"
+
+/**
+ *   In bulk mode CompassEventSegment and CDPpPsdEventSegment pack every
+ *   hit buffered from one digitizer read into a single event rather than
+ *   emitting one event per hit.  The body header timestamp is that of the
+ *   earliest (first) hit.  The event body is:
+ *
+ *   Header
+ *   Header::s_nHits hit records, in time order, each laid out as in
+ *   DppFragmentFormat.h (so each carries its own 64 bit ns timestamp).
+ *   Unlike single hit PHA events, PHA records here are whole.
+ *
+ *   Header::s_marker can't be mistaken for the size longword that starts a
+ *   single hit event, so decoders can tell the two apart.
+ */
+namespace DppBulk {
+
+    const uint32_t MARKER = 0x4b4c5542;         // "BULK"
+    const uint16_t PHA    = 0;
+    const uint16_t PSD    = 1;
+
+    struct Header {
+        uint32_t s_marker;
+        uint32_t s_nBytes;                      // Self inclusive event size.
+        uint16_t s_firmware;                    // PHA or PSD.
+        uint16_t s_unused;
+        uint32_t s_nHits;
+    };
+
+    /**
+     * isBulk
+     * @param pBody - first longword of a segment's event body.
+     * @return bool - true if it starts a bulk event.
+     */
+    inline bool isBulk(const void* pBody)
+    {
+        return *static_cast<const uint32_t*>(pBody) == MARKER;
+    }
+    /**
+     * recordBytes
+     * @param firmware - PHA or PSD.
+     * @param pRecord  - a hit record.
+     * @return uint32_t - bytes in the record (the distance to the next one).
+     */
+    inline uint32_t recordBytes(uint16_t firmware, const void* pRecord)
+    {
+        return (firmware == PHA) ?
+            DppFragment::PhaView(pRecord).bytes() : DppFragment::PsdView(pRecord).bytes();
+    }
+}
+
+#endif
@@ -0,0 +1,67 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file DppCaptureFormat.h
+# @brief Layout of raw readout block capture files.
+
+*/
+#ifndef DPPCAPTUREFORMAT_H
+#define DPPCAPTUREFORMAT_H
+
+#include <stdint.h>
+#include <string>
+#include <sstream>
+
+/**
+ *   A capture file holds the raw blocks ReadData returned for one board
+ *   during one run (swStartAcquisition to swStopAcquisition), written by
+ *   CRecordingDigitizer and fed back by CReplayDigitizer:
+ *
+ *   FileHeader
+ *   CAEN_DGTZ_BoardInfo_t of the board (FileHeader::s_infoSize bytes)
+ *   For each non empty block:
+ *      BlockHeader
+ *      BlockHeader::s_nBytes of data exactly as ReadData returned them.
+ *
+ *   All values are host (little endian) order.
+ */
+namespace DppCapture {
+
+    const uint32_t MAGIC   = 0x50414344;        // "DCAP"
+    const uint32_t VERSION = 1;
+
+    struct FileHeader {
+        uint32_t s_magic;
+        uint32_t s_version;
+        uint32_t s_infoSize;                    // sizeof(CAEN_DGTZ_BoardInfo_t) when written.
+        int32_t  s_linkNum;
+        int32_t  s_node;
+        uint32_t s_run;                         // Start count of the recorder for this board.
+        uint64_t s_startTime;                   // Wall clock ns since the epoch at start.
+    };
+    struct BlockHeader {
+        uint32_t s_nBytes;
+        uint32_t s_unused;
+        uint64_t s_wallClock;                   // Wall clock ns since the epoch of the read.
+    };
+
+    /**
+     * fileName
+     *    The name of the capture file for a board and run:
+     *    prefix-l<link>-n<node>-r<run>.dppraw
+     */
+    inline std::string fileName(const std::string& prefix, int linkNum, int node, unsigned run)
+    {
+        std::stringstream s;
+        s << prefix << "-l" << linkNum << "-n" << node << "-r" << run << ".dppraw";
+        return s.str();
+    }
+}
+
+#endif
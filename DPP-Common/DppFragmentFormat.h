@@ -0,0 +1,693 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file DppFragmentFormat.h
+# @brief Layout of the PHA and PSD hit records, with their writers and readers.
+
+*/
+#ifndef DPPFRAGMENTFORMAT_H
+#define DPPFRAGMENTFORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "DppTraceCodec.h"
+
+/**
+ *   Each hit CompassEventSegment (PHA) and CDPpPsdEventSegment (PSD) read
+ *   is written as a record whose layout is defined here, once, for both the
+ *   readout (Pha::write, Psd::write) and the analyzers (PhaView, PsdView).
+ *   A field is a type at a byte offset, each following the previous one, so
+ *   the records are packed and their fields aren't aligned.  Fields are
+ *   accessed with a fixed size memcpy, which the compiler makes a single
+ *   load or store.
+ *
+ *   PHA record:
+ *   |  32 bit size in bytes, not counting the channel longword          |
+ *   |  32 bit channel (16*source id + board channel)                    |
+ *   |  64 bit timestamp in ns                                           |
+ *   |  16 bit energy                                                    |
+ *   |  16 bit extras                                                    |
+ *   |  32 bit extras2                                                   |
+ *   |  32 bit number of samples                                         |
+ *   |  16 bit trace flags: DUAL_TRACE, TRACES_PACKED, TRACE_FEATURES,   |
+ *   |                      FINE_TIME                                    |
+ *   |  16 bit ps past the timestamp if FINE_TIME                        |
+ *   |  feature block if TRACE_FEATURES                                  |
+ *   |  trace 1 if samples, trace 2 if also dual trace, samples*16 bits  |
+ *
+ *   A single hit PHA event body is only the first 'size' bytes of the
+ *   record, so its last longword is cut off.  The analyzers tell PHA from
+ *   PSD events by their size, so that can't change.  Bulk events (see
+ *   DppBulkFormat.h) hold whole records.
+ *
+ *   PSD record:
+ *   |  32 bit self inclusive size in bytes                              |
+ *   |  64 bit timestamp in ns                                           |
+ *   |  16 bit board channel                                             |
+ *   |  32 bit short gate charge                                         |
+ *   |  32 bit long gate charge                                          |
+ *   |  32 bit extras                                                    |
+ *   |  32 bit bytes of trace data including this longword, 4 if none   |
+ *   |  if there are traces, features or fine time:                      |
+ *   |    32 bit number of samples, 0 if none                            |
+ *   |    8 bit trace flags: DUAL_TRACE, TRACES_PACKED, TRACE_FEATURES,  |
+ *   |                       FINE_TIME                                   |
+ *   |    8 bit analog probe                                             |
+ *   |    16 bit ps past the timestamp if FINE_TIME                      |
+ *   |    feature block if TRACE_FEATURES                                |
+ *   |    trace 1, trace 2 if dual trace, samples*16 bits each           |
+ *
+ *   If the flags have TRACES_PACKED the traces are instead packed one
+ *   after the other (see DppTraceCodec.h) and padded to an even number of
+ *   bytes.  The feature block (FeatureBlock below) holds the numbers
+ *   CFeatureExtractor works out from trace 1; the traces themselves may
+ *   then be left out.  PHA records with packed traces, features or fine
+ *   time end in an extra longword of padding, so a single hit event, cut
+ *   off as above, still holds all of them.  The views' traces() unpacks
+ *   either form.
+ *
+ *   The timestamp is in ns.  When the readout folds the boards' fine time
+ *   into it (setFineTimestamps) the ps it leaves out are kept in the
+ *   record as FINE_TIME, so the hit's time is timestamp*1000 + picoseconds()
+ *   ps.  Those records are bigger, so the analyzers register their sizes
+ *   too.
+ */
+namespace DppFragment {
+
+    /**
+     * Field
+     *    A record field: a T at byte offset OFFSET of the record.
+     */
+    template <typename T, size_t OFFSET>
+    struct Field {
+        typedef T type;
+        static const size_t offset = OFFSET;
+        static const size_t end    = OFFSET + sizeof(T);    // Offset of the next field.
+
+        static T get(const uint8_t* pRecord)
+        {
+            T value;
+            memcpy(&value, pRecord + OFFSET, sizeof(T));
+            return value;
+        }
+        static void put(uint8_t* pRecord, T value)
+        {
+            memcpy(pRecord + OFFSET, &value, sizeof(T));
+        }
+    };
+
+    static const uint8_t DUAL_TRACE     = 0x01; // Trace flags.
+    static const uint8_t FINE_TIME      = 0x02;
+    static const uint8_t TRACE_FEATURES = 0x40;
+    static const uint8_t TRACES_PACKED  = 0x80;
+
+    static const uint16_t FEATURE_NEGATIVE = 0x01;  // Feature status: pulse goes down.
+    static const uint16_t FEATURE_RISE     = 0x02;  // Rise time found.
+    static const uint16_t FEATURE_CFD      = 0x04;  // CFD zero crossing found.
+
+    /**
+     * Features
+     *    What CFeatureExtractor works out from a trace.  Times are in
+     *    samples from the start of the trace, amplitude and integrals are
+     *    relative to the baseline and positive whatever the pulse polarity.
+     */
+    struct Features {
+        float    s_baseline;                    // Mean of the first samples.
+        float    s_baselineRms;
+        float    s_amplitude;                   // Peak height.
+        float    s_riseTime;                    // 10-90%, if FEATURE_RISE.
+        float    s_cfdTime;                     // If FEATURE_CFD.
+        float    s_tailIntegral;                // From a little after the peak.
+        float    s_totalIntegral;               // From the end of the baseline.
+        uint16_t s_peak;                        // Sample of the peak.
+        uint16_t s_status;                      // FEATURE_* bits.
+    };
+    /**
+     * FeatureBlock
+     *    Layout of the Features in a record.
+     */
+    struct FeatureBlock {
+        typedef Field<float, 0>                         Baseline;
+        typedef Field<float, Baseline::end>             BaselineRms;
+        typedef Field<float, BaselineRms::end>          Amplitude;
+        typedef Field<float, Amplitude::end>            RiseTime;
+        typedef Field<float, RiseTime::end>             CfdTime;
+        typedef Field<float, CfdTime::end>              TailIntegral;
+        typedef Field<float, TailIntegral::end>         TotalIntegral;
+        typedef Field<uint16_t, TotalIntegral::end>     Peak;
+        typedef Field<uint16_t, Peak::end>              Status;
+
+        static const size_t BYTES = Status::end;
+
+        static void write(uint8_t* p, const Features& f)
+        {
+            Baseline::put(p, f.s_baseline);
+            BaselineRms::put(p, f.s_baselineRms);
+            Amplitude::put(p, f.s_amplitude);
+            RiseTime::put(p, f.s_riseTime);
+            CfdTime::put(p, f.s_cfdTime);
+            TailIntegral::put(p, f.s_tailIntegral);
+            TotalIntegral::put(p, f.s_totalIntegral);
+            Peak::put(p, f.s_peak);
+            Status::put(p, f.s_status);
+        }
+        static Features read(const uint8_t* p)
+        {
+            Features f;
+            f.s_baseline      = Baseline::get(p);
+            f.s_baselineRms   = BaselineRms::get(p);
+            f.s_amplitude     = Amplitude::get(p);
+            f.s_riseTime      = RiseTime::get(p);
+            f.s_cfdTime       = CfdTime::get(p);
+            f.s_tailIntegral  = TailIntegral::get(p);
+            f.s_totalIntegral = TotalIntegral::get(p);
+            f.s_peak          = Peak::get(p);
+            f.s_status        = Status::get(p);
+            return f;
+        }
+    };
+
+    /**
+     * FineTime
+     *    The ps a hit is past its ns timestamp, ahead of its features.
+     */
+    typedef Field<uint16_t, 0> FineTime;
+
+    /**
+     * Traces
+     *    The waveforms a hit carries.  s_samples is 0 if it carries none.
+     *    The hit's fine time goes with them, as it's written ahead of them.
+     */
+    struct Traces {
+        uint32_t    s_samples;
+        uint8_t     s_dual;                     // Nonzero if dual trace.
+        uint8_t     s_probe;                    // PSD only.
+        const void* s_trace1;
+        const void* s_trace2;                   // Only if s_dual.
+        const void* s_packed;                   // Both packed, if s_packedBytes.
+        uint32_t    s_packedBytes;              // 0 to write them as is.
+        const Features* s_features;             // Written ahead of them if not null.
+        bool        s_fineTime;                 // Write s_picoseconds ahead of those.
+        uint16_t    s_picoseconds;
+    };
+    /**
+     * sampleBytes
+     * @return size_t - bytes of samples the traces occupy unpacked.
+     */
+    inline size_t sampleBytes(const Traces& traces)
+    {
+        return traces.s_samples * sizeof(uint16_t) * (traces.s_dual ? 2 : 1);
+    }
+    /**
+     * dataBytes
+     * @return size_t - bytes the traces and features occupy in the record.
+     */
+    inline size_t dataBytes(const Traces& traces)
+    {
+        return (traces.s_fineTime ? FineTime::end : 0) +
+            (traces.s_features ? FeatureBlock::BYTES : 0) +
+            (traces.s_packedBytes ? traces.s_packedBytes : sampleBytes(traces));
+    }
+    /**
+     * traceFlags
+     * @return uint8_t - the value of the trace flags field.
+     */
+    inline uint8_t traceFlags(const Traces& traces)
+    {
+        return (traces.s_dual ? DUAL_TRACE : 0) | (traces.s_packedBytes ? TRACES_PACKED : 0) |
+            (traces.s_features ? TRACE_FEATURES : 0) | (traces.s_fineTime ? FINE_TIME : 0);
+    }
+    /**
+     * hasData
+     * @return bool - true if there are traces, features or fine time to write.
+     */
+    inline bool hasData(const Traces& traces)
+    {
+        return traces.s_samples || traces.s_features || traces.s_fineTime;
+    }
+    /**
+     * putSamples
+     *    Copy the fine time and features, if any, then trace 1 and (if
+     *    dual) trace 2, or their packed form, to pDest.
+     */
+    inline void putSamples(uint8_t* pDest, const Traces& traces)
+    {
+        if (traces.s_fineTime) {
+            FineTime::put(pDest, traces.s_picoseconds);
+            pDest += FineTime::end;
+        }
+        if (traces.s_features) {
+            FeatureBlock::write(pDest, *traces.s_features);
+            pDest += FeatureBlock::BYTES;
+        }
+        if (traces.s_packedBytes) {
+            memcpy(pDest, traces.s_packed, traces.s_packedBytes);
+            return;
+        }
+        size_t nBytes = traces.s_samples * sizeof(uint16_t);
+        if (!nBytes) return;
+        memcpy(pDest, traces.s_trace1, nBytes);
+        if (traces.s_dual) memcpy(pDest + nBytes, traces.s_trace2, nBytes);
+    }
+    /**
+     * maxPackedBytes
+     * @return size_t - the scratch space pack() needs for the traces.
+     */
+    inline size_t maxPackedBytes(const Traces& traces)
+    {
+        return DppTrace::maxBytes(traces.s_samples) * (traces.s_dual ? 2 : 1) + 1;
+    }
+    /**
+     * pack
+     *    Pack the traces into pScratch and have traces refer to that
+     *    rather than the samples.  Traces that don't get smaller are left
+     *    as they are.
+     *
+     * @param traces   - The traces, modified.
+     * @param pScratch - At least maxPackedBytes(traces) bytes.
+     */
+    inline void pack(Traces& traces, uint8_t* pScratch)
+    {
+        traces.s_packedBytes = 0;
+        if (!traces.s_samples) return;
+
+        const uint16_t* pTrace1 = static_cast<const uint16_t*>(traces.s_trace1);
+        const uint16_t* pTrace2 = static_cast<const uint16_t*>(traces.s_trace2);
+        size_t nBytes = DppTrace::encode(pScratch, pTrace1, traces.s_samples);
+        if (traces.s_dual) {
+            nBytes += DppTrace::encode(pScratch + nBytes, pTrace2, traces.s_samples);
+        }
+        if (nBytes & 1) pScratch[nBytes++] = 0;
+        if (nBytes < sampleBytes(traces)) {
+            traces.s_packed      = pScratch;
+            traces.s_packedBytes = nBytes;
+        }
+    }
+    /**
+     * getPicoseconds
+     *    Get a record's fine time.
+     *
+     * @param flags    - The trace flags.
+     * @param p        - Start of the trace data.
+     * @param pEnd     - End of the data that's there.
+     * @return uint16_t - ps past the timestamp, 0 if it isn't there.
+     */
+    inline uint16_t getPicoseconds(uint8_t flags, const uint8_t* p, const uint8_t* pEnd)
+    {
+        if (!(flags & FINE_TIME)) return 0;
+        if ((pEnd - p) < static_cast<ptrdiff_t>(FineTime::end)) return 0;
+        return FineTime::get(p);
+    }
+    /**
+     * getFeatures
+     *    Get a record's features.
+     *
+     * @param features - Receives them.
+     * @param flags    - The trace flags.
+     * @param p        - Start of the trace data.
+     * @param pEnd     - End of the data that's there.
+     * @return bool    - false if there are none or they aren't all there.
+     */
+    inline bool getFeatures(
+        Features& features, uint8_t flags, const uint8_t* p, const uint8_t* pEnd
+    )
+    {
+        if (!(flags & TRACE_FEATURES)) return false;
+        if (flags & FINE_TIME) p += FineTime::end;
+        if ((pEnd - p) < static_cast<ptrdiff_t>(FeatureBlock::BYTES)) return false;
+        features = FeatureBlock::read(p);
+        return true;
+    }
+    /**
+     * getSamples
+     *    Get a record's traces in either form.
+     *
+     * @param pTrace1  - Receives trace 1, samples long.
+     * @param pTrace2  - Receives trace 2 if dual trace, samples long.
+     * @param samples  - Samples in each trace.
+     * @param flags    - The trace flags.
+     * @param p        - Start of the trace data (fine time and features first if any).
+     * @param pEnd     - End of the data that's there.
+     * @return bool    - false if the traces aren't all there.
+     */
+    inline bool getSamples(
+        uint16_t* pTrace1, uint16_t* pTrace2, uint32_t samples, uint8_t flags,
+        const uint8_t* p, const uint8_t* pEnd
+    )
+    {
+        if (!samples) return true;
+        if (flags & FINE_TIME) p += FineTime::end;
+        if (flags & TRACE_FEATURES) p += FeatureBlock::BYTES;
+        if (p > pEnd) return false;
+        bool dual = (flags & DUAL_TRACE) != 0;
+        if (flags & TRACES_PACKED) {
+            p = DppTrace::decode(pTrace1, samples, p, pEnd);
+            if (p && dual) p = DppTrace::decode(pTrace2, samples, p, pEnd);
+            return p != nullptr;
+        }
+        size_t nBytes = samples * sizeof(uint16_t);
+        if ((pEnd - p) < static_cast<ptrdiff_t>(nBytes * (dual ? 2 : 1))) return false;
+        memcpy(pTrace1, p, nBytes);
+        if (dual) memcpy(pTrace2, p + nBytes, nBytes);
+        return true;
+    }
+
+    /**
+     * PhaHit
+     *    What Pha::write needs besides the traces.
+     */
+    struct PhaHit {
+        uint32_t s_channel;
+        uint64_t s_timestamp;
+        uint16_t s_energy;
+        uint16_t s_extras;
+        uint32_t s_extras2;
+    };
+    struct Pha {
+        typedef Field<uint32_t, 0>                Size;
+        typedef Field<uint32_t, Size::end>        Channel;
+        typedef Field<uint64_t, Channel::end>     Timestamp;
+        typedef Field<uint16_t, Timestamp::end>   Energy;
+        typedef Field<uint16_t, Energy::end>      Extras;
+        typedef Field<uint32_t, Extras::end>      Extras2;
+        typedef Field<uint32_t, Extras2::end>     Samples;
+        typedef Field<uint16_t, Samples::end>     DualTrace;
+
+        static const size_t HEADER_BYTES = DualTrace::end;          // Traces start here.
+        static const size_t UNCOUNTED    = Channel::end - Size::end; // Size leaves out the channel.
+        static const size_t TAIL_PAD     = UNCOUNTED;               // After packed traces/features.
+
+        /**
+         * padded
+         * @return bool - true if the record ends in TAIL_PAD.
+         */
+        static bool padded(const Traces& traces)
+        {
+            return traces.s_packedBytes || traces.s_features || traces.s_fineTime;
+        }
+        /**
+         * bytes
+         * @return size_t - bytes in the record of a hit carrying traces.
+         */
+        static size_t bytes(const Traces& traces)
+        {
+            return HEADER_BYTES + dataBytes(traces) + (padded(traces) ? TAIL_PAD : 0);
+        }
+        /**
+         * write
+         *    Write a hit's record.
+         * @param pDest - Where the record goes, with at least bytes(traces) free.
+         * @return size_t - bytes written, bytes(traces).
+         */
+        static size_t write(void* pDest, const PhaHit& hit, const Traces& traces)
+        {
+            uint8_t* p      = static_cast<uint8_t*>(pDest);
+            size_t   nBytes = bytes(traces);
+            Size::put(p, nBytes - UNCOUNTED);
+            Channel::put(p, hit.s_channel);
+            Timestamp::put(p, hit.s_timestamp);
+            Energy::put(p, hit.s_energy);
+            Extras::put(p, hit.s_extras);
+            Extras2::put(p, hit.s_extras2);
+            Samples::put(p, traces.s_samples);
+            DualTrace::put(p, traceFlags(traces));
+            putSamples(p + HEADER_BYTES, traces);
+            if (padded(traces)) {
+                memset(p + nBytes - TAIL_PAD, 0, TAIL_PAD);
+            }
+            return nBytes;
+        }
+    };
+
+    /**
+     * PsdHit
+     *    What Psd::write needs besides the traces.
+     */
+    struct PsdHit {
+        uint64_t s_timestamp;
+        uint16_t s_channel;
+        uint32_t s_chargeShort;
+        uint32_t s_chargeLong;
+        uint32_t s_extras;
+    };
+    struct Psd {
+        typedef Field<uint32_t, 0>                  Size;
+        typedef Field<uint64_t, Size::end>          Timestamp;
+        typedef Field<uint16_t, Timestamp::end>     Channel;
+        typedef Field<uint32_t, Channel::end>       ChargeShort;
+        typedef Field<uint32_t, ChargeShort::end>   ChargeLong;
+        typedef Field<uint32_t, ChargeLong::end>    Extras;
+        typedef Field<uint32_t, Extras::end>        TraceBytes;
+        typedef Field<uint32_t, TraceBytes::end>    Samples;    // Only if there are traces.
+        typedef Field<uint8_t,  Samples::end>       DualTrace;
+        typedef Field<uint8_t,  DualTrace::end>     Probe;
+
+        static const size_t HEADER_BYTES = TraceBytes::end;         // Record without traces.
+        static const size_t TRACE_BYTES  = Probe::end;              // Samples start here.
+
+        /**
+         * traceBytes
+         * @return uint32_t - the value of the TraceBytes field.
+         */
+        static uint32_t traceBytes(const Traces& traces)
+        {
+            return hasData(traces) ?
+                (TRACE_BYTES - TraceBytes::offset) + dataBytes(traces) :
+                sizeof(TraceBytes::type);
+        }
+        /**
+         * bytes
+         * @return size_t - bytes in the record of a hit carrying traces.
+         */
+        static size_t bytes(const Traces& traces)
+        {
+            return TraceBytes::offset + traceBytes(traces);
+        }
+        /**
+         * write
+         *    Write a hit's record.
+         * @param pDest - Where the record goes, with at least bytes(traces) free.
+         * @return size_t - bytes written, bytes(traces).
+         */
+        static size_t write(void* pDest, const PsdHit& hit, const Traces& traces)
+        {
+            uint8_t* p      = static_cast<uint8_t*>(pDest);
+            uint32_t nTrace = traceBytes(traces);
+            size_t   nBytes = TraceBytes::offset + nTrace;
+            Size::put(p, nBytes);
+            Timestamp::put(p, hit.s_timestamp);
+            Channel::put(p, hit.s_channel);
+            ChargeShort::put(p, hit.s_chargeShort);
+            ChargeLong::put(p, hit.s_chargeLong);
+            Extras::put(p, hit.s_extras);
+            TraceBytes::put(p, nTrace);
+            if (hasData(traces)) {
+                Samples::put(p, traces.s_samples);
+                DualTrace::put(p, traceFlags(traces));
+                Probe::put(p, traces.s_probe);
+                putSamples(p + TRACE_BYTES, traces);
+            }
+            return nBytes;
+        }
+    };
+
+    /**
+     * PhaView
+     *    Reads the fields of a PHA record in place.
+     */
+    class PhaView {
+        const uint8_t* m_p;
+    public:
+        explicit PhaView(const void* pRecord) :
+            m_p(static_cast<const uint8_t*>(pRecord)) {}
+
+        uint32_t size() const       { return Pha::Size::get(m_p); }
+        size_t   bytes() const      { return size() + Pha::UNCOUNTED; }   // Whole record.
+        uint32_t channel() const    { return Pha::Channel::get(m_p); }
+        uint64_t timestamp() const  { return Pha::Timestamp::get(m_p); }
+        uint16_t energy() const     { return Pha::Energy::get(m_p); }
+        uint16_t extras() const     { return Pha::Extras::get(m_p); }
+        uint32_t extras2() const    { return Pha::Extras2::get(m_p); }
+
+        // Only in whole records (not single hit events):
+
+        uint32_t samples() const    { return Pha::Samples::get(m_p); }
+        bool     dualTrace() const  { return (Pha::DualTrace::get(m_p) & DUAL_TRACE) != 0; }
+        bool     packed() const     { return (Pha::DualTrace::get(m_p) & TRACES_PACKED) != 0; }
+        bool     hasFeatures() const { return (Pha::DualTrace::get(m_p) & TRACE_FEATURES) != 0; }
+        bool     hasFineTime() const { return (Pha::DualTrace::get(m_p) & FINE_TIME) != 0; }
+
+        /**
+         * picoseconds
+         * @param available - Bytes of the record that are there, as for traces().
+         * @return uint16_t - ps the hit is past timestamp(), 0 if not recorded.
+         */
+        uint16_t picoseconds(size_t available) const
+        {
+            if (available < Pha::HEADER_BYTES) return 0;
+            return getPicoseconds(
+                Pha::DualTrace::get(m_p), m_p + Pha::HEADER_BYTES, m_p + available
+            );
+        }
+
+        /**
+         * features
+         *    Get the hit's features.
+         *
+         * @param result    - Receives them.
+         * @param available - Bytes of the record that are there, as for traces().
+         * @return bool     - false if it has none.
+         */
+        bool features(Features& result, size_t available) const
+        {
+            if (available < Pha::HEADER_BYTES) return false;
+            return getFeatures(
+                result, Pha::DualTrace::get(m_p), m_p + Pha::HEADER_BYTES, m_p + available
+            );
+        }
+
+        /**
+         * traces
+         *    Get the hit's traces, unpacking them if need be.
+         *
+         * @param pTrace1   - Receives trace 1, samples() long.
+         * @param pTrace2   - Receives trace 2 if dualTrace(), samples() long.
+         * @param available - Bytes of the record that are there: size() of a
+         *                    single hit event, else bytes().
+         * @return bool     - false if the traces aren't all there (the
+         *                    unpacked traces of single hit events never are).
+         */
+        bool traces(uint16_t* pTrace1, uint16_t* pTrace2, size_t available) const
+        {
+            if (available < Pha::HEADER_BYTES) return false;
+            return getSamples(
+                pTrace1, pTrace2, samples(), Pha::DualTrace::get(m_p),
+                m_p + Pha::HEADER_BYTES, m_p + available
+            );
+        }
+
+        /**
+         * isEvent
+         * @param available - bytes in a single hit event body.
+         * @return bool - true if the body is exactly this (cut off) record.
+         */
+        bool isEvent(size_t available) const
+        {
+            return (available >= Pha::Extras2::end) && (size() == available);
+        }
+        /**
+         * fits
+         * @param available - bytes from the record to the end of the event.
+         * @return bool - true if the whole record is there.
+         */
+        bool fits(size_t available) const
+        {
+            return (available >= Pha::HEADER_BYTES) && (bytes() <= available) &&
+                (bytes() >= Pha::HEADER_BYTES);
+        }
+    };
+
+    /**
+     * PsdView
+     *    Reads the fields of a PSD record in place.
+     */
+    class PsdView {
+        const uint8_t* m_p;
+    public:
+        explicit PsdView(const void* pRecord) :
+            m_p(static_cast<const uint8_t*>(pRecord)) {}
+
+        uint32_t size() const        { return Psd::Size::get(m_p); }
+        size_t   bytes() const       { return size(); }
+        uint64_t timestamp() const   { return Psd::Timestamp::get(m_p); }
+        uint16_t channel() const     { return Psd::Channel::get(m_p); }
+        uint32_t chargeShort() const { return Psd::ChargeShort::get(m_p); }
+        uint32_t chargeLong() const  { return Psd::ChargeLong::get(m_p); }
+        uint32_t extras() const      { return Psd::Extras::get(m_p); }
+        uint32_t traceBytes() const  { return Psd::TraceBytes::get(m_p); }
+        bool     hasTraces() const   { return traceBytes() > sizeof(Psd::TraceBytes::type); }
+
+        // Only if hasTraces():
+
+        uint32_t samples() const     { return Psd::Samples::get(m_p); }
+        bool     dualTrace() const   { return (Psd::DualTrace::get(m_p) & DUAL_TRACE) != 0; }
+        bool     packed() const      { return (Psd::DualTrace::get(m_p) & TRACES_PACKED) != 0; }
+        bool     hasFeatures() const { return (Psd::DualTrace::get(m_p) & TRACE_FEATURES) != 0; }
+        bool     hasFineTime() const { return (Psd::DualTrace::get(m_p) & FINE_TIME) != 0; }
+        uint8_t  probe() const       { return Psd::Probe::get(m_p); }
+
+        /**
+         * picoseconds
+         * @return uint16_t - ps the hit is past timestamp(), 0 if not recorded.
+         */
+        uint16_t picoseconds() const
+        {
+            if (!hasTraces() || (bytes() < Psd::TRACE_BYTES)) return 0;
+            return getPicoseconds(
+                Psd::DualTrace::get(m_p), m_p + Psd::TRACE_BYTES, m_p + bytes()
+            );
+        }
+
+        /**
+         * features
+         *    Get the hit's features.
+         *
+         * @param result   - Receives them.
+         * @return bool    - false if it has none.
+         */
+        bool features(Features& result) const
+        {
+            if (!hasTraces() || (bytes() < Psd::TRACE_BYTES)) return false;
+            return getFeatures(
+                result, Psd::DualTrace::get(m_p), m_p + Psd::TRACE_BYTES, m_p + bytes()
+            );
+        }
+
+        /**
+         * traces
+         *    Get the hit's traces, unpacking them if need be.
+         *
+         * @param pTrace1   - Receives trace 1, samples() long.
+         * @param pTrace2   - Receives trace 2 if dualTrace(), samples() long.
+         * @return bool     - false if the traces aren't all in the record.
+         */
+        bool traces(uint16_t* pTrace1, uint16_t* pTrace2) const
+        {
+            if (!hasTraces()) return true;
+            if (bytes() < Psd::TRACE_BYTES) return false;
+            return getSamples(
+                pTrace1, pTrace2, samples(), Psd::DualTrace::get(m_p),
+                m_p + Psd::TRACE_BYTES, m_p + bytes()
+            );
+        }
+
+        /**
+         * isEvent
+         * @param available - bytes in a single hit event body.
+         * @return bool - true if the body is exactly this record.
+         */
+        bool isEvent(size_t available) const
+        {
+            return (available >= Psd::HEADER_BYTES) && (size() == available);
+        }
+        /**
+         * fits
+         * @param available - bytes from the record to the end of the event.
+         * @return bool - true if the whole record is there.
+         */
+        bool fits(size_t available) const
+        {
+            return (available >= Psd::HEADER_BYTES) && (bytes() <= available) &&
+                (bytes() >= Psd::HEADER_BYTES);
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,214 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file DppTraceCodec.h
+# @brief Lossless packing of waveform traces.
+
+*/
+#ifndef DPPTRACECODEC_H
+#define DPPTRACECODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ *   Successive samples of a trace differ by little more than the noise, so
+ *   a trace is stored as the differences between them:
+ *
+ *   |  16 bit first sample                                              |
+ *   |  a block for each BLOCK samples, the last padded with zero deltas |
+ *
+ *   The deltas are taken modulo 2^16, so any trace (digital probes too)
+ *   round trips exactly, and zigzag coded (0, -1, 1, -2... become 0, 1, 2,
+ *   3...) so small deltas of either sign have few significant bits.  A
+ *   block is:
+ *
+ *   |  8 bit width, w: bits in its largest zigzagged delta (0-16)       |
+ *   |  w bytes, byte b holding bit b of the block's deltas, delta j in  |
+ *   |  bit j                                                            |
+ *
+ *   A block takes 1 + w bytes rather than 16, and its bits are sliced so
+ *   the decoder unpacks all of its deltas at once with SSE2 (a portable
+ *   version is used without).  A trace whose noise is a few counts packs
+ *   around 3 to 1; the worst case, maxBytes(), is slightly bigger than the
+ *   raw samples.
+ */
+namespace DppTrace {
+
+    static const unsigned BLOCK = 8;                // Samples in a block.
+
+    /**
+     * maxBytes
+     * @param samples - samples in a trace.
+     * @return size_t - most bytes encode() can take for it.
+     */
+    inline size_t maxBytes(uint32_t samples)
+    {
+        return sizeof(uint16_t) + ((samples + BLOCK - 1)/BLOCK)*(1 + 2*BLOCK);
+    }
+
+    namespace detail {
+        inline uint16_t zigzag(uint16_t delta)
+        {
+            return (delta << 1) ^ (0 - (delta >> 15));
+        }
+        inline unsigned width(uint16_t bits)
+        {
+            unsigned w = 0;
+            while (bits) {
+                w++;
+                bits >>= 1;
+            }
+            return w;
+        }
+        /**
+         * sliceBlock
+         *    Write the w bytes of a block's deltas, byte b holding their bit b.
+         */
+        inline void sliceBlock(uint8_t* pDest, const uint16_t* pDeltas, unsigned w)
+        {
+#ifdef __SSE2__
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pDeltas));
+            for (unsigned b = 0; b < w; b++) {
+                __m128i top = _mm_slli_epi16(d, 15 - b);      // bit b to the sign.
+                pDest[b] = _mm_movemask_epi8(_mm_packs_epi16(top, top)) & 0xff;
+            }
+#else
+            for (unsigned b = 0; b < w; b++) {
+                uint8_t byte = 0;
+                for (unsigned j = 0; j < BLOCK; j++) {
+                    byte |= ((pDeltas[j] >> b) & 1) << j;
+                }
+                pDest[b] = byte;
+            }
+#endif
+        }
+        /**
+         * unsliceBlock
+         *    Rebuild a block's samples from its w bytes of deltas.
+         *
+         * @param pDest  - BLOCK samples.
+         * @param pBits  - The block's bytes.
+         * @param w      - Their number.
+         * @param prior  - The sample before the block.
+         */
+        inline void unsliceBlock(uint16_t* pDest, const uint8_t* pBits, unsigned w, uint16_t prior)
+        {
+#ifdef __SSE2__
+            const __m128i lanes = _mm_set_epi16(128, 64, 32, 16, 8, 4, 2, 1);
+            __m128i d = _mm_setzero_si128();
+            for (unsigned b = 0; b < w; b++) {
+                __m128i set = _mm_cmpeq_epi16(_mm_and_si128(_mm_set1_epi16(pBits[b]), lanes), lanes);
+                d = _mm_or_si128(d, _mm_and_si128(set, _mm_set1_epi16(static_cast<short>(1u << b))));
+            }
+            // Unzigzag then a prefix sum of the deltas:
+
+            d = _mm_xor_si128(
+                _mm_srli_epi16(d, 1),
+                _mm_sub_epi16(_mm_setzero_si128(), _mm_and_si128(d, _mm_set1_epi16(1)))
+            );
+            d = _mm_add_epi16(d, _mm_slli_si128(d, 2));
+            d = _mm_add_epi16(d, _mm_slli_si128(d, 4));
+            d = _mm_add_epi16(d, _mm_slli_si128(d, 8));
+            d = _mm_add_epi16(d, _mm_set1_epi16(static_cast<short>(prior)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pDest), d);
+#else
+            // Spread each byte's bits over the bytes of a 64 bit word:
+            // low holds the low bytes of the deltas, high the high ones.
+
+            uint64_t low = 0, high = 0;
+            for (unsigned b = 0; b < w; b++) {
+                uint64_t spread = (pBits[b] * 0x0101010101010101ULL) & 0x8040201008040201ULL;
+                spread = ((spread + 0x7f7f7f7f7f7f7f7fULL) >> 7) & 0x0101010101010101ULL;
+                if (b < 8) low |= spread << b; else high |= spread << (b - 8);
+            }
+            for (unsigned j = 0; j < BLOCK; j++) {
+                uint16_t d = ((low >> 8*j) & 0xff) | (((high >> 8*j) & 0xff) << 8);
+                prior += (d >> 1) ^ (0 - (d & 1));
+                pDest[j] = prior;
+            }
+#endif
+        }
+    }
+
+    /**
+     * encode
+     *    Pack a trace.
+     *
+     * @param pDest    - Where the packed trace goes, maxBytes(samples) free.
+     * @param pSamples - The trace.
+     * @param samples  - Its length, at least 1.
+     * @return size_t  - Bytes written.
+     */
+    inline size_t encode(uint8_t* pDest, const uint16_t* pSamples, uint32_t samples)
+    {
+        uint8_t* p     = pDest;
+        uint16_t prior = pSamples[0];
+        memcpy(p, &prior, sizeof(prior));
+        p += sizeof(prior);
+
+        for (uint32_t i = 0; i < samples; i += BLOCK) {
+            uint16_t deltas[BLOCK];
+            uint16_t bits = 0;
+            for (unsigned j = 0; j < BLOCK; j++) {
+                uint16_t sample = (i + j < samples) ? pSamples[i + j] : prior;
+                deltas[j] = detail::zigzag(sample - prior);
+                bits     |= deltas[j];
+                prior     = sample;
+            }
+            unsigned w = detail::width(bits);
+            *p++ = w;
+            detail::sliceBlock(p, deltas, w);
+            p += w;
+        }
+        return p - pDest;
+    }
+    /**
+     * decode
+     *    Unpack a trace.
+     *
+     * @param pDest   - Where its samples go.
+     * @param samples - How many there are, at least 1.
+     * @param p       - The packed trace.
+     * @param pEnd    - End of the data it may occupy.
+     * @return const uint8_t* - just past the packed trace, nullptr if it
+     *                  would run past pEnd or isn't valid.
+     */
+    inline const uint8_t*
+    decode(uint16_t* pDest, uint32_t samples, const uint8_t* p, const uint8_t* pEnd)
+    {
+        uint16_t prior;
+        if ((pEnd - p) < static_cast<ptrdiff_t>(sizeof(prior))) return nullptr;
+        memcpy(&prior, p, sizeof(prior));
+        p += sizeof(prior);
+
+        for (uint32_t i = 0; i < samples; i += BLOCK) {
+            if (p >= pEnd) return nullptr;
+            unsigned w = *p++;
+            if ((w > 16) || ((pEnd - p) < static_cast<ptrdiff_t>(w))) return nullptr;
+
+            if (samples - i >= BLOCK) {
+                detail::unsliceBlock(pDest + i, p, w, prior);
+            } else {
+                uint16_t last[BLOCK];
+                detail::unsliceBlock(last, p, w, prior);
+                memcpy(pDest + i, last, (samples - i)*sizeof(uint16_t));
+            }
+            prior = pDest[i + ((samples - i >= BLOCK) ? BLOCK : samples - i) - 1];
+            p += w;
+        }
+        return p;
+    }
+}
+
+#endif
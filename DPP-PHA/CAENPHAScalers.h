@@ -43,8 +43,13 @@ class CAENPHAScalers : public CScaler
 private:
     CompassEventSegment*  m_pSegment;
     int                   m_nSourceId;
+    bool                  m_filter;         // Append the hit filter's counts.
+    bool                  m_diagnostics;    // Append the segment's diagnostic counts.
 public:
-    CAENPHAScalers(CompassEventSegment* pEventSegment, int srcid = 0);
+    CAENPHAScalers(
+        CompassEventSegment* pEventSegment, int srcid = 0, bool filter = false,
+        bool diagnostics = false
+    );
     virtual std::vector<uint32_t> read();
     virtual int sourceId() {return m_nSourceId;}
 };
@@ -23,6 +23,10 @@
 *
 */
 #include "CAENPha.h"
+#include "CDppReadoutThread.h"
+#include "COverloadController.h"
+#include "CDppDiagnostics.h"
+#include "CShadowRegisterFile.h"
 #include <vector>
 #include <stdexcept>
 #include <CAENDigitizerType.h>
@@ -59,38 +63,49 @@ static std::string trim( std::string str )
  * @param trgout  - True if GPO is triggerout else it's synch.
  * @parm  delay   - start delay for clock synchronization.
  * @param pCheatCFile - Pointer to register cheat file - nullptr means don't cheat.
+ * @param pBackend - Digitizer backend - nullptr means CDigitizerBackend::getDefault().
  */
 CAENPha::CAENPha(
     CAENPhaParameters& config, CAEN_DGTZ_ConnectionType linkType, int linknum,
     int node, uint32_t base,
-    CAEN_DGTZ_AcqMode_t startMode, bool trgout, unsigned delay, const char* pCheatFile
+    CAEN_DGTZ_AcqMode_t startMode, bool trgout, unsigned delay, const char* pCheatFile,
+    CDigitizerBackend* pBackend
   ) :
-  m_configuration(config),
+  m_pConfiguration(&config),
+  m_pBackend(pBackend ? pBackend : CDigitizerBackend::getDefault()),
   m_startMode(startMode),
   m_trgout(trgout),
   m_startDelay(delay),
   m_rawBuffer(0),
   m_rawSize(0),
-  m_dppSize(0),
+  m_hits(false),
   m_pWaveforms(0),
   m_wfSize(0),
-  m_pCheatFile(pCheatFile)
+  m_pCheatFile(pCheatFile),
+  m_nAsyncBlocks(0),
+  m_pReader(0),
+  m_inTreeDecode(false),
+  m_readerStopped(false),
+  m_readerFailures(0),
+  m_waveformsDecoded(false),
+  m_tracesEnabled(false),
+  m_tracePrescale(1),
+  m_fineTime(false),
+  m_appliedFineTime(false),
+  m_pOverload(0),
+  m_diagnostics("PHA board"),
+  m_pDiagnostics(&m_diagnostics),
+  m_coalesce(false),
+  m_pImage(0)
   
 {
-  CAEN_DGTZ_ErrorCode status = CAEN_DGTZ_OpenDigitizer(linkType, linknum, node, base, &m_handle);
+  CAEN_DGTZ_ErrorCode status = m_pBackend->openDigitizer(linkType, linknum, node, base, &m_handle);
   if (status != CAEN_DGTZ_Success) {
     throw std::pair<std::string, int>("Open failed", status);
   }
   conet_node = node;
-  for (int i =0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
-    m_dppBuffer[i]  = 0;
-    m_nDppEvents[i] = 0;
-    m_nOffsets[i]   = 1;
-    m_nTimestampAdjusts[i] = 0;
-    m_nLastTimestamp[i]    = 0;
-  }
   
-  status = CAEN_DGTZ_GetInfo(m_handle, &m_info);
+  status = m_pBackend->getInfo(m_handle, &m_info);
   if (status != CAEN_DGTZ_Success) {
     throw std::pair<std::string, int>("GetBoardInfo failed", status);
   }
@@ -100,27 +115,35 @@ CAENPha::CAENPha(
  */
 CAENPha::~CAENPha()
 {
-  CAEN_DGTZ_CloseDigitizer(m_handle);
+  delete m_pReader;
+  try {
+    freeBuffers();
+  }
+  catch (...) {}                  // Closing the board frees them anyway.
+  m_pBackend->closeDigitizer(m_handle);
 }
 
 /**
  * setup
  *   This is the monster method.  Initialize the DPP-PHA mode for the
  *   module (assumed where needed to be a 725).
+ *
+ * @param startNow - false to leave starting to a later start(), e.g. so
+ *                   several boards set up at once can be started in order.
  */
 void
-CAENPha::setup()
+CAENPha::setup(bool startNow)
 {
   CAEN_DGTZ_ErrorCode status;
   CAEN_DGTZ_BoardInfo_t boardInfo;
+  CShadowRegisterScope  shadow(m_pBackend, m_coalesce);
 
-
-  status = CAEN_DGTZ_GetInfo(m_handle, &boardInfo);
+  status = m_pBackend->getInfo(m_handle, &boardInfo);
   if (status != CAEN_DGTZ_Success) {
     throw std::pair<std::string, int>("Get info failed", status);
   }
 
-  status = CAEN_DGTZ_Reset(m_handle);
+  status = m_pBackend->reset(m_handle);
   if (status != CAEN_DGTZ_Success) {
     throw std::pair<std::string, int>("Board Reset failed", status);
   }
@@ -137,22 +160,73 @@ CAENPha::setup()
   } else {
     throw std::pair<std::string, int>("Un supported digitizer family", boardInfo.FamilyCode);
   }
+  m_hits.setNsPerTick(m_nsPerTick);
+  m_hits.setFineTime(m_fineTime);
+  m_hits.reset();
+
+  const CRegisterImage::Board* pImage = m_pImage ? m_pImage->find(boardInfo.SerialNumber) : 0;
+  if (m_pImage && !pImage) {
+    std::cerr << "\nPHA: board " << boardInfo.SerialNumber
+              << " is not in the register image, setting it up from the configuration";
+  }
+  if (pImage) {
+    loadImage(*pImage);
+  } else {
+    program();
+  }
+  
+  // Allocate data buffers and start the digitizer.  Buffers from a prior
+  // setup may be the wrong size now:
+  
+  freeBuffers();
+  status = m_pBackend->mallocReadoutBuffer(m_handle, &m_rawBuffer, &m_rawSize);
+  if (status != CAEN_DGTZ_Success) {
+    throw std::pair<std::string, int>("Failed to malloc readout buffer", status);
+  }
+  status = m_pBackend->mallocDPPWaveforms(m_handle, (void**)&m_pWaveforms, &m_wfSize);
+  if (status != CAEN_DGTZ_Success) {
+    throw std::pair<std::string, int>("Failed to malloc DPP Waveform storage", status);
+  }
+  status = m_hits.useLibrary(m_inTreeDecode ? 0 : m_pBackend, m_handle);
+  if (status != CAEN_DGTZ_Success) {
+    throw std::pair<std::string, int>("Failed to malloc DPP events", status);
+  }
+  // In list mode the board takes no waveforms so there's never anything
+  // to decode; hits then carry the empty waveform.
+
+  m_tracesEnabled = m_pConfiguration->acqMode != 1;
+  setTracePolicies();
+  m_pWaveforms->Ns        = 0;
+  m_pWaveforms->DualTrace = 0;
+  m_appliedFineTime       = m_fineTime;
+  if (!pImage) processCheatFile();   // The image has its effects.
+  finishRegisters(shadow);
+  if (startNow) start();
+}
+/**
+ * program
+ *   Program the board from the configuration:  the bulk of setup.
+ */
+void
+CAENPha::program()
+{
+  CAEN_DGTZ_ErrorCode status;
 
   m_enableMask = setChannelMask();
   
   // Set individual trigger, mb1, propagate triggers, TRG validation(?)
 
-  CAEN_DGTZ_WriteRegister(m_handle, 0x8008, 0xffffffff);    // Clear all bits.
-  status = CAEN_DGTZ_WriteRegister(m_handle, 0x8004, 0x0100e0115);
- // status = CAEN_DGTZ_WriteRegister(m_handle, 0x8004, 0x14e0105);
+  m_pBackend->writeRegister(m_handle, 0x8008, 0xffffffff);    // Clear all bits.
+  status = m_pBackend->writeRegister(m_handle, 0x8004, 0x0100e0115);
+ // status = m_pBackend->writeRegister(m_handle, 0x8004, 0x14e0105);
   if (status != CAEN_DGTZ_Success) {
     throw std::pair<std::string, int>("Write board config register failed", status);
   }
   // Acquisition mode is either Mixed or list - 0 for mixed, 1 for list.
 
-  status = CAEN_DGTZ_SetDPPAcquisitionMode(
+  status = m_pBackend->setDPPAcquisitionMode(
      m_handle,
-     m_configuration.acqMode == 1 ?
+     m_pConfiguration->acqMode == 1 ?
         CAEN_DGTZ_DPP_ACQ_MODE_List : CAEN_DGTZ_DPP_ACQ_MODE_Mixed, 
      CAEN_DGTZ_DPP_SAVE_PARAM_EnergyAndTime
      );
@@ -161,13 +235,13 @@ CAENPha::setup()
   }
   // Waveform acquisition window length:  TODO:   Make division board independent.
 
-  uint32_t rlen = m_configuration.recordLength/m_nsPerTick; // Reclen in ticks from ns.
-  status = CAEN_DGTZ_SetRecordLength(m_handle, rlen);
+  uint32_t rlen = m_pConfiguration->recordLength/m_nsPerTick; // Reclen in ticks from ns.
+  status = m_pBackend->setRecordLength(m_handle, rlen);
   if (status != CAEN_DGTZ_Success) {
     throw std::pair<std::string, int>("Set record length failed", status);
   }
   // Enable data flush for slow rates: (bit set register)
-  //status = CAEN_DGTZ_WriteRegister(m_handle, 0x8004, 1);
+  //status = m_pBackend->writeRegister(m_handle, 0x8004, 1);
   //if (status != CAEN_DGTZ_Success) {
   //  throw std::pair<std::string, int>("Enable flush mode failed", status);
   //}
@@ -178,11 +252,11 @@ CAENPha::setup()
  // setPerChannelParameters();
   
   // Use a pretty generic buffer organization for now:
-  status = CAEN_DGTZ_SetDPPEventAggregation(m_handle, 0, 0);  // Let board/lib figure it out
+  status = m_pBackend->setDPPEventAggregation(m_handle, 0, 0);  // Let board/lib figure it out
   if (status != CAEN_DGTZ_Success) {
     throw std::pair<std::string, int>("Set DPP Event aggregation failed", status);
   }
-  status = CAEN_DGTZ_SetMaxNumAggregatesBLT(m_handle, 255);   // max Buffers/read.
+  status = m_pBackend->setMaxNumAggregatesBLT(m_handle, 255);   // max Buffers/read.
   if (status != CAEN_DGTZ_Success) {
     throw std::pair<std::string, int>("Set max transfer aggregation failed", status);
   }
@@ -191,35 +265,249 @@ CAENPha::setup()
   setCoincidenceTriggers(); //Does not really set coincidences : Sudarsan B. 
   setPerChannelParameters();
   calibrate();
-  
-  // Allocate data buffers and start the digitizer:
-  
-  status = CAEN_DGTZ_MallocReadoutBuffer(m_handle, &m_rawBuffer, &m_rawSize);
+}
+/**
+ * loadImage
+ *   Program the board from its compiled register image (see
+ *   CRegisterImage and dppregcompile) rather than the configuration.
+ *   The library is first told the acquisition mode and record length,
+ *   which it needs to size the readout buffers, then the image is written
+ *   (overwriting what those calls wrote) and the ADCs calibrated.
+ *
+ * @param image - The board's image.
+ */
+void
+CAENPha::loadImage(const CRegisterImage::Board& image)
+{
+  CAEN_DGTZ_ErrorCode status;
+
+  m_enableMask = enabledChannels();
+  status = m_pBackend->setDPPAcquisitionMode(
+     m_handle,
+     m_pConfiguration->acqMode == 1 ?
+        CAEN_DGTZ_DPP_ACQ_MODE_List : CAEN_DGTZ_DPP_ACQ_MODE_Mixed,
+     CAEN_DGTZ_DPP_SAVE_PARAM_EnergyAndTime
+     );
   if (status != CAEN_DGTZ_Success) {
-    throw std::pair<std::string, int>("Failed to malloc readout buffer", status);
+    throw std::pair<std::string, int>("Could not set acquisition mode", status);
   }
-  status = CAEN_DGTZ_MallocDPPEvents(m_handle, (void**)m_dppBuffer, &m_dppSize);
+  status = m_pBackend->setRecordLength(m_handle, m_pConfiguration->recordLength/m_nsPerTick);
   if (status != CAEN_DGTZ_Success) {
-    throw std::pair<std::string, int>("Failed to allocate DPP Event struct", status);  
+    throw std::pair<std::string, int>("Set record length failed", status);
   }
-  status = CAEN_DGTZ_MallocDPPWaveforms(m_handle, (void**)&m_pWaveforms, &m_wfSize);
+  status = CRegisterImage::apply(m_pBackend, m_handle, image);
   if (status != CAEN_DGTZ_Success) {
-    throw std::pair<std::string, int>("Failed to malloc DPP Waveform storage", status);
+    throw std::pair<std::string, int>("Writing the register image failed", status);
+  }
+  calibrate();
+  std::cout << "\nPHA: Loaded " << image.s_writes.size() << " registers from the register image";
+}
+/**
+ * reconfigure
+ *   Apply a new configuration to a board that was setup and then shut
+ *   down, e.g. resuming after thresholds were tweaked during a pause.  If
+ *   only channel parameters changed, just the channels whose parameters
+ *   changed are reprogrammed:  no reset, calibration, settling sleep or
+ *   buffer allocation.  Then what the board buffered is cleared and
+ *   acquisition is started as setup() does.
+ *
+ * @param config   - The new configuration.  As with the one we were
+ *                   constructed with, it must outlive its use by us.
+ * @param startNow - As for setup().
+ * @return bool    - false, having done nothing, if a full setup() is needed
+ *                   (always with a register image, which makes setup fast).
+ */
+bool
+CAENPha::reconfigure(CAENPhaParameters& config, bool startNow)
+{
+  if (!m_rawBuffer || m_pImage || !config.sameBoardSettings(*m_pConfiguration)) return false;
+
+  // sameBoardSettings means both have the same channels in the same order:
+
+  uint32_t changed  = 0;
+  unsigned nChanged = 0;
+  for (int i = 0; i < config.m_channelParameters.size(); i++) {
+    if ((m_fineTime != m_appliedFineTime) ||
+        !config.m_channelParameters[i].second->sameRegisterSettings(
+          *(m_pConfiguration->m_channelParameters[i].second)
+        )) {
+      changed |= 1 << config.m_channelParameters[i].first;
+      nChanged++;
+    }
+  }
+  m_pConfiguration = &config;
+  if (changed) {
+    CShadowRegisterScope shadow(m_pBackend, m_coalesce);
+    setPerChannelParameters(changed);
+    processCheatFile();                 // It may override what we just wrote.
+    finishRegisters(shadow);
+  }
+  m_appliedFineTime = m_fineTime;
+  std::cout << "\nPHA: Reprogrammed " << nChanged << " changed channel(s), no reset";
+
+  // Hits left from the last run would look like a time tag rollover to
+  // the first of this one:
+
+  CAEN_DGTZ_ErrorCode status = m_pBackend->clearData(m_handle);
+  if (status != CAEN_DGTZ_Success) {
+    throw std::pair<std::string, int>("Unable to clear the board's data", status);
+  }
+  m_hits.setFineTime(m_fineTime);
+  m_hits.reset();
+  setTracePolicies();
+  if (startNow) start();
+  return true;
+}
+/**
+ * start
+ *   Start (or, synchronized, arm) acquisition on a board that's been
+ *   setup, with a background reader if asked for.
+ */
+void
+CAENPha::start()
+{
+  CAEN_DGTZ_ErrorCode status;
+
+  // The background reader allocates its own ring of buffers now that the
+  // library knows how big they must be:
+  
+  delete m_pReader;
+  m_pReader = 0;
+  m_readerStopped  = false;
+  m_readerFailures = 0;
+  if (m_nAsyncBlocks) {
+    try {
+      m_pReader = new CDppReadoutThread(
+        m_pBackend, m_handle, false, m_inTreeDecode, m_nAsyncBlocks
+      );
+    }
+    catch (std::exception& e) {
+      throw std::pair<std::string, int>(e.what(), m_nAsyncBlocks);
+    }
   }
-  processCheatFile();
   
   // If in unsynchronized mode, this starts acquisition. If in synchronized mode,
   // this arms acquisition.
   
-  status = CAEN_DGTZ_SWStartAcquisition(m_handle);
+  status = m_pBackend->swStartAcquisition(m_handle);
   if (status != CAEN_DGTZ_Success) {
     throw std::pair<std::string, int>("Failed to start or arm acquisition", status);
   }
+  if (m_pReader) m_pReader->start();
 
   std::cout << "\nWaiting for acquisition run..";
 
 }
 
+/**
+ * setAsyncReadout
+ *    Select whether block transfers are done by fillBuffers, in line with
+ *    event formatting, or by a background CDppReadoutThread that keeps
+ *    a ring of transferred/parsed blocks ready for us.
+ *    Takes effect at the next setup().
+ *
+ * @param nBlocks - number of blocks in the reader's ring. 0 means
+ *                  read synchronously (the default).
+ */
+void
+CAENPha::setAsyncReadout(unsigned nBlocks)
+{
+  m_nAsyncBlocks = nBlocks;
+}
+/**
+ * setInTreeDecode
+ *    Select whether readout buffers are decoded by CAEN_DGTZ_GetDPPEvents
+ *    (the default) or by the in tree CDppAggregateParser, which skips the
+ *    library's event structs.  The parser has only been checked against
+ *    CDppEventDecoder, not against the library on real boards, so it stays
+ *    off unless asked for.  Takes effect at the next setup().
+ *
+ * @param enable - true to decode in tree.
+ */
+void
+CAENPha::setInTreeDecode(bool enable)
+{
+  m_inTreeDecode = enable;
+}
+/**
+ * setTracePrescale
+ *    When the board is taking waveforms, keep them for only 1 in prescale
+ *    hits of each channel.  The others go out with an empty waveform and
+ *    are never decoded.  Channels whose configuration sets a trace
+ *    prescale (DAQ_PARAM_CH_TRACE_PRESCALE) use theirs instead.  Takes
+ *    effect at the next setup().
+ *
+ * @param prescale - 1 (the default) keeps every trace, 0 keeps none.
+ */
+void
+CAENPha::setTracePrescale(unsigned prescale)
+{
+  m_tracePrescale = prescale;
+}
+/**
+ * setFineTimestamps
+ *    Have the board put the fine time in the extras2 word (extras option 2
+ *    rather than 0) and fold it into the hit timestamps (see
+ *    CTimestampUnwrapper).  Takes effect at the next setup.
+ *
+ * @param enable - true for fine timestamps; off by default.
+ */
+void
+CAENPha::setFineTimestamps(bool enable)
+{
+  m_fineTime = enable;
+}
+/**
+ * setOverloadController
+ *    Tell the controller the load of each block transfer and ask it
+ *    before keeping a hit's traces (see COverloadController).
+ *
+ * @param pController - The controller, nullptr (the default) for none.
+ */
+void
+CAENPha::setOverloadController(COverloadController* pController)
+{
+  m_pOverload = pController;
+}
+/**
+ * setDiagnostics
+ *    Count comm errors, decode failures and time tag rollovers in
+ *    pDiagnostics rather than in the driver's own counters.
+ *
+ * @param pDiagnostics - The counters, nullptr (the default) for the driver's.
+ */
+void
+CAENPha::setDiagnostics(CDppDiagnostics* pDiagnostics)
+{
+  m_pDiagnostics = pDiagnostics ? pDiagnostics : &m_diagnostics;
+}
+/**
+ * setRegisterCoalescing
+ *    Have setup and reconfigure compose their register writes in a
+ *    CShadowRegisterFile and write each register once, rather than a
+ *    read and a write per bit field (per channel for broadcasts).
+ *
+ * @param enable - true to coalesce; off by default.
+ */
+void
+CAENPha::setRegisterCoalescing(bool enable)
+{
+  m_coalesce = enable;
+}
+/**
+ * setRegisterImage
+ *    Have setup program the board from its compiled register image if
+ *    it's in one (see loadImage).  The caller is responsible for the image
+ *    matching our configuration (CRegisterImage::hashFiles) and options.
+ *
+ * @param pImage - The image, which must outlive its use by us; nullptr (the
+ *                 default) to program from the configuration.
+ */
+void
+CAENPha::setRegisterImage(const CRegisterImage* pImage)
+{
+  m_pImage = pImage;
+}
 /**
  * shutdown
  *   Turn off data taking in the digitizer.
@@ -227,36 +515,63 @@ CAENPha::setup()
 void
 CAENPha::shutdown()
 {
-  CAEN_DGTZ_ErrorCode status = CAEN_DGTZ_SWStopAcquisition(m_handle);
+  // The reader thread must be done with the board and with our buffers
+  // before we stop them.  The buffers are kept for a reconfigure():
+  
+  if (m_pReader) m_pReader->stop();
+  delete m_pReader;
+  m_pReader = 0;
+  
+  CAEN_DGTZ_ErrorCode status = m_pBackend->swStopAcquisition(m_handle);
   if (status != CAEN_DGTZ_Success) {
     throw std::pair<std::string, int>("Failed to stop acquisition", status);
   }
-  // Free the data buffers allocated when the digitizer was setup.
-  
-  status = CAEN_DGTZ_FreeReadoutBuffer(&m_rawBuffer);
+  m_hits.reset();
+}
+/**
+ * freeBuffers
+ *   Free the data buffers allocated when the digitizer was setup, if any.
+ */
+void
+CAENPha::freeBuffers()
+{
+  if (!m_rawBuffer) return;
+  m_hits.reset();                   // Its hits are in the buffer.
+  m_hits.useLibrary(0, m_handle);   // Its events need the board open.
+
+  CAEN_DGTZ_ErrorCode status = m_pBackend->freeReadoutBuffer(&m_rawBuffer);
   if (status != CAEN_DGTZ_Success) {
     throw std::pair<std::string, int>("Failed to free readout bufer", status);
   }
   m_rawBuffer = 0;
 #ifdef FREE_WAVEFORMS  
-  status = CAEN_DGTZ_FreeDPPWaveforms(m_handle, &m_pWaveforms);
+  status = m_pBackend->freeDPPWaveforms(m_handle, &m_pWaveforms);
   if (status != CAEN_DGTZ_Success) {
     throw std::pair<std::string, int>("Failed to free DPP waveform storage", status);
   }
 #endif
   m_pWaveforms = 0;
-  
-  status = CAEN_DGTZ_FreeDPPEvents(m_handle, reinterpret_cast<void**>(&m_dppBuffer));
+}
+/**
+ * finishRegisters
+ *   Do the register writes a setup composed in its shadow, if it did,
+ *   and say how many accesses that saved.
+ *
+ * @param shadow - The setup's shadow.
+ */
+void
+CAENPha::finishRegisters(CShadowRegisterScope& shadow)
+{
+  if (!shadow.enabled()) return;
+
+  CAEN_DGTZ_ErrorCode status = shadow.finish();
   if (status != CAEN_DGTZ_Success) {
-    throw std::pair<std::string, int>("Failed to free dpp events buffer", status);
-  }
-  for (int i=0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
-    m_dppBuffer[i] = 0;
-    m_nDppEvents[i] = 0;
-    m_nOffsets[i]  =1;
-    m_nTimestampAdjusts[i] = 0;
-    m_nLastTimestamp[i]    = 0;
+    throw std::pair<std::string, int>("Coalesced register writes failed", status);
   }
+  const CShadowRegisterFile& registers(shadow.shadow());
+  std::cout << "\nPHA: " << registers.boardAccesses() << " register accesses for "
+            << registers.reads() + registers.writes() << " requested, "
+            << registers.saved() << " saved";
 }
 /**
  * haveData
@@ -270,7 +585,7 @@ CAENPha::haveData()
   // CAEN (Alberto) Says I should just try the read... 
  /*     uint32_t statusRegister;
   
-      status= CAEN_DGTZ_ReadRegister(m_handle,CAEN_DGTZ_ACQ_STATUS_ADD , &statusRegister);
+      status= m_pBackend->readRegister(m_handle,CAEN_DGTZ_ACQ_STATUS_ADD , &statusRegister);
   if (status != CAEN_DGTZ_Success) {
     throw std::pair<std::string, int>("Unable to read status register to see if there are events", status);
   }
@@ -288,64 +603,53 @@ CAENPha::haveData()
   
 }
 /**
- * Read
- *    Return the event not yet returned with the earliest timestamp.
+ * waveforms
+ *    Decode the traces of the hit at the cursor of hits() - the buffered
+ *    hit with the earliest timestamp.  They're decoded once however often
+ *    this is called before next().  Hits that carry no trace (or whose
+ *    trace the channel's trace policy or the overload controller drops)
+ *    get an empty waveform.
  *
- * @return std::tuple<int, const CAEN_DGTZ_DPP_PHA_Event_t*, CAEN_DGTZ_DPP_PHA_Waveforms_t>
- *    - The first item of the pair is a channel number and the second item
- *      is a pointer to the event struct, third are the decoded waveforms from
- *      the event.
- * @note it is possible for the event pointer to be null.  This means that
- *       although the digitizer showed there was data, fillBuffer
- *       was not able to either read anything or decode any dpp events from it.
- *       In that case, invoke haveData again to check for data and, retry
- *       the read/decode.  Naturally, in that case, the channel number is
- *       meaningless.
+ * @return const CAEN_DGTZ_DPP_PHA_Waveforms_t* - the traces, nullptr if
+ *         there is no buffered hit.
  */
-//Version borrowed from DPP-PHA4
-std::tuple<int, const CAEN_DGTZ_DPP_PHA_Event_t*, const CAEN_DGTZ_DPP_PHA_Waveforms_t*>
-CAENPha::Read()
+const CAEN_DGTZ_DPP_PHA_Waveforms_t*
+CAENPha::waveforms()
 {
-  if (!dataBuffered()) {
-    
-    return std::make_tuple(
-      0,
-      reinterpret_cast<CAEN_DGTZ_DPP_PHA_Event_t*>(0),
-      reinterpret_cast<CAEN_DGTZ_DPP_PHA_Waveforms_t*>(0)
-    );  // no data.
-  }
-  // Get the channel with the lowest timestamp:
-  
-  int channel = findEarliest();
-  
-  // Get the pointer to the data and do necessary book keeping:
-  
-  int offset  = m_nOffsets[channel];
-  CAEN_DGTZ_DPP_PHA_Event_t* pData = &(m_dppBuffer[channel][offset]);
-  CAEN_DGTZ_DecodeDPPWaveforms(m_handle, pData, m_pWaveforms);
-  offset++;
-  m_nOffsets[channel] = offset;
-  
-  // Adjust the 32 bit timestamp into a 64 bit one:
-  //std::cout<< '\n' << pData->TimeTag << '\t' << pData->TimeTag*m_nsPerTick;
-  pData->TimeTag = pData->TimeTag*m_nsPerTick; //pre-process, convert to ns
-  
-
-  if (pData->TimeTag < m_nLastTimestamp[channel]) {
-    if(m_nsPerTick == 2) m_nTimestampAdjusts[channel] += 0x100000000;
-    else m_nTimestampAdjusts[channel] += 0x200000000;  //Why does this work? 
-	// Rolled over (hopefully only once).
-    // m_nTimestampAdjusts[channel] += 0x00000000;
+  if (!dataBuffered()) return nullptr;
+  if (!m_waveformsDecoded) {
+    uint16_t energy = m_hits.energy();
+    if (m_tracesEnabled && m_tracePolicy.want(
+          m_hits.channel(), energy & CHitFilter::PHA_ENERGY,
+          (energy & CHitFilter::PHA_PILEUP_BIT) != 0) &&
+        (!m_pOverload || m_pOverload->keepTrace())) {
+      if (m_hits.decodeWaveforms(m_pWaveforms) != CAEN_DGTZ_Success) {
+        m_pDiagnostics->count(CDppDiagnostics::DECODE_FAILURES, m_hits.channel());
+        m_pWaveforms->Ns        = 0;
+        m_pWaveforms->DualTrace = 0;
+      }
+    } else {
+      m_pWaveforms->Ns        = 0;
+      m_pWaveforms->DualTrace = 0;
+    }
+    m_waveformsDecoded = true;
   }
-  m_nLastTimestamp[channel] = pData->TimeTag;
-  pData->TimeTag |= m_nTimestampAdjusts[channel]; // Fold in the wraps.
-  
-  //pData->TimeTag *= m_nsPerTick;
-  //std::cout << "\tTimetag:"<<pData->TimeTag;
-  
-  // Construct/return the result:
-  
-  return std::make_tuple(channel,  pData, m_pWaveforms);
+  return m_pWaveforms;
+}
+/**
+ * next
+ *    Done with the hit at the cursor; move on to the next oldest.
+ */
+void
+CAENPha::next()
+{
+  uint16_t energy = m_hits.energy();
+  m_tracePolicy.next(
+    m_hits.channel(), energy & CHitFilter::PHA_ENERGY,
+    (energy & CHitFilter::PHA_PILEUP_BIT) != 0
+  );
+  m_waveformsDecoded = false;
+  m_hits.next();
 }
 
 
@@ -355,6 +659,22 @@ CAENPha::Read()
 /*------------------------------------------------------------------------------
  * private utilities.
 
+/**
+ * enabledChannels
+ *   Compute the channel mask:
+ *   Modify only if the enabled flag is true (for compass).
+ */
+int
+CAENPha::enabledChannels()
+{
+  int enableMask = 0;
+  for (int i =0; i < m_pConfiguration->m_channelParameters.size(); i++) {
+    if (m_pConfiguration->m_channelParameters[i].second->enabled)  {
+      enableMask |= (1 << m_pConfiguration->m_channelParameters[i].first);
+    }
+  }
+  return enableMask;
+}
 /**
  * setChannelMask
  *   Compute the channel mask and set it:
@@ -364,18 +684,31 @@ CAENPha::Read()
 int
 CAENPha::setChannelMask()
 {
-  int enableMask = 0;
-  for (int i =0; i < m_configuration.m_channelParameters.size(); i++) {
-    if (m_configuration.m_channelParameters[i].second->enabled)  {
-      enableMask |= (1 << m_configuration.m_channelParameters[i].first);
-    }
-  }
-  int status = CAEN_DGTZ_SetChannelEnableMask(m_handle, enableMask);
+  int enableMask = enabledChannels();
+  int status = m_pBackend->setChannelEnableMask(m_handle, enableMask);
   if (status != CAEN_DGTZ_Success) {
     throw std::pair<std::string, int>("Failed to set channel enables", status);
   }
   return enableMask;
 }
+/**
+ * setTracePolicies
+ *    Give each configured channel its trace policy, the others the
+ *    board's prescale, and restart the prescale counts.
+ */
+void
+CAENPha::setTracePolicies()
+{
+  m_tracePolicy.setPrescale(m_tracePrescale);
+  for (int i = 0; i < m_pConfiguration->m_channelParameters.size(); i++) {
+    m_tracePolicy.setPolicy(
+      m_pConfiguration->m_channelParameters[i].first,
+      m_pConfiguration->m_channelParameters[i].second->tracePolicy,
+      m_tracePrescale
+    );
+  }
+  m_tracePolicy.reset();
+}
 
 /**
  * setTriggerAndSyncModes
@@ -385,7 +718,7 @@ CAENPha::setChannelMask()
 void
 CAENPha::setTriggerAndSyncMode()
 {
-  int status = CAEN_DGTZ_SetIOLevel(m_handle, static_cast<CAEN_DGTZ_IOLevel_t>(m_configuration.IOLevel));
+  int status = m_pBackend->setIOLevel(m_handle, static_cast<CAEN_DGTZ_IOLevel_t>(m_pConfiguration->IOLevel));
   if (status != CAEN_DGTZ_Success) {
     throw std::pair<std::string, int>("Failed to set I/O level", status);
   }
@@ -395,7 +728,7 @@ CAENPha::setTriggerAndSyncMode()
   
   // Regardless, the start mode is the m_startMode:
   
-  status = CAEN_DGTZ_SetAcquisitionMode(m_handle, m_startMode);
+  status = m_pBackend->setAcquisitionMode(m_handle, m_startMode);
   if (status != CAEN_DGTZ_Success) {
     throw std::pair<std::string, int>("Failed to set acq mode to sw controlled", status);
   }
@@ -403,11 +736,11 @@ CAENPha::setTriggerAndSyncMode()
   switch (m_startMode) {
   case CAEN_DGTZ_SW_CONTROLLED :
     std::cout << "\nPHA Start Mode: Software";
-    status = CAEN_DGTZ_SetRunSynchronizationMode(m_handle, CAEN_DGTZ_RUN_SYNC_Disabled);
+    status = m_pBackend->setRunSynchronizationMode(m_handle, CAEN_DGTZ_RUN_SYNC_Disabled);
     if (status != CAEN_DGTZ_Success) {
       throw std::pair<std::string, int>("Failed to set run sync mode to Disabled", status);
     }
-    status = CAEN_DGTZ_WriteRegister(m_handle, 0x8170, 2*m_startDelay/m_nsPerTrigger);
+    status = m_pBackend->writeRegister(m_handle, 0x8170, 2*m_startDelay/m_nsPerTrigger);
     if (status != CAEN_DGTZ_Success) {
       throw std::pair<std::string, int>("Failed to set run sync mode to Disabled", status);
     }
@@ -415,22 +748,22 @@ CAENPha::setTriggerAndSyncMode()
     break;
   case CAEN_DGTZ_FIRST_TRG_CONTROLLED :
     std::cout << "\nPHA Start Mode: FIRST_TRG ";
-    status = CAEN_DGTZ_SetRunSynchronizationMode(m_handle, CAEN_DGTZ_RUN_SYNC_TrgOutTrgInDaisyChain);
+    status = m_pBackend->setRunSynchronizationMode(m_handle, CAEN_DGTZ_RUN_SYNC_TrgOutTrgInDaisyChain);
     if (status != CAEN_DGTZ_Success) {
       throw std::pair<std::string, int>("Failed to set run sync mode to Disabled", status);
     }
-    status = CAEN_DGTZ_WriteRegister(m_handle, 0x8170, 2*m_startDelay/m_nsPerTrigger);
+    status = m_pBackend->writeRegister(m_handle, 0x8170, 2*m_startDelay/m_nsPerTrigger);
     if (status != CAEN_DGTZ_Success) {
       throw std::pair<std::string, int>("Failed to set run sync mode to Disabled", status);
     }
     break;
   case CAEN_DGTZ_S_IN_CONTROLLED:
     std::cout << "\nPHA Start Mode: Sync_in ";
-    status = CAEN_DGTZ_SetRunSynchronizationMode(m_handle, CAEN_DGTZ_RUN_SYNC_TrgOutSinDaisyChain);
+    status = m_pBackend->setRunSynchronizationMode(m_handle, CAEN_DGTZ_RUN_SYNC_TrgOutSinDaisyChain);
     if (status != CAEN_DGTZ_Success) {
       throw std::pair<std::string, int>("Failed to set run start on SIN", status);
     }
-    status = CAEN_DGTZ_WriteRegister(m_handle, 0x8170, 2*m_startDelay / m_nsPerTrigger);
+    status = m_pBackend->writeRegister(m_handle, 0x8170, 2*m_startDelay / m_nsPerTrigger);
     if (status != CAEN_DGTZ_Success) {
       throw std::pair<std::string, int>("Failed to set start delay", status);
     }    
@@ -441,10 +774,10 @@ CAENPha::setTriggerAndSyncMode()
   }
   // Set internal/external trigger mode:
 
-  switch (m_configuration.triggerSource) {
+  switch (m_pConfiguration->triggerSource) {
   case CAENPhaParameters::internal:
     std::cout << "\nPHA: Internal trigger on this board";
-    status = CAEN_DGTZ_WriteRegister(m_handle, CAEN_DGTZ_TRIGGER_SRC_ENABLE_ADD, 0x800000FF);
+    status = m_pBackend->writeRegister(m_handle, CAEN_DGTZ_TRIGGER_SRC_ENABLE_ADD, 0x800000FF);
     if (status != CAEN_DGTZ_Success) {
       throw std::pair<std::string, int>("Unable to enable internal trigger source", status);
     }
@@ -454,8 +787,8 @@ CAENPha::setTriggerAndSyncMode()
     setRegisterBits(0x8080, 24, 24, 1);	// supposed to fall through. This disables per channel triggers.
   case CAENPhaParameters::both:
     std::cout << "\nPHA: Both trigger on this board";
-    status = CAEN_DGTZ_WriteRegister(m_handle, CAEN_DGTZ_TRIGGER_SRC_ENABLE_ADD, 0xc00000ff); // internal/external.
-    //status = CAEN_DGTZ_WriteRegister(m_handle, CAEN_DGTZ_TRIGGER_SRC_ENABLE_ADD, 0x80000000); // internal/external.
+    status = m_pBackend->writeRegister(m_handle, CAEN_DGTZ_TRIGGER_SRC_ENABLE_ADD, 0xc00000ff); // internal/external.
+    //status = m_pBackend->writeRegister(m_handle, CAEN_DGTZ_TRIGGER_SRC_ENABLE_ADD, 0x80000000); // internal/external.
     if (status != CAEN_DGTZ_Success) {
       throw std::pair<std::string, int>("Unable to set external trigger", status);
     }
@@ -467,7 +800,7 @@ CAENPha::setTriggerAndSyncMode()
   // Trigger output mode:
   
   if (m_trgout) {
-    status = CAEN_DGTZ_WriteRegister(m_handle, 0x8110, 0xFF&m_enableMask);
+    status = m_pBackend->writeRegister(m_handle, 0x8110, 0xFF&m_enableMask);
     std::cout << "\nTrg Out Enable mask:" << std::hex << m_enableMask << std::dec;
   } else {
     setRegisterBits(0x811c, 16, 17, 0x3);     // Note status must be CAEN_DGTZ_Success from last.
@@ -478,36 +811,36 @@ CAENPha::setTriggerAndSyncMode()
 
   //Not sure if this works
   // Set the Front Panel I/O control register.
-  status = CAEN_DGTZ_WriteRegister(m_handle, 0x811c, m_configuration.ioctlmask); //
+  status = m_pBackend->writeRegister(m_handle, 0x811c, m_pConfiguration->ioctlmask); //
   if (status != CAEN_DGTZ_Success) {
     throw std::pair<std::string, int>("Unable to set GPO mode", status);
   }  
 
  uint32_t currentValue; 
- if(m_configuration.s_startMode == CAEN_DGTZ_S_IN_CONTROLLED)
+ if(m_pConfiguration->s_startMode == CAEN_DGTZ_S_IN_CONTROLLED)
 	currentValue = 0x30000;
- if(m_configuration.s_startMode == CAEN_DGTZ_SW_CONTROLLED)
+ if(m_pConfiguration->s_startMode == CAEN_DGTZ_SW_CONTROLLED)
 	currentValue = 0xC100;
 
 
-  if(m_configuration.OnboardCoinc == CAENPhaParameters::TrgInGated)
+  if(m_pConfiguration->OnboardCoinc == CAENPhaParameters::TrgInGated)
   {
 	currentValue |= 0x0d00;
   }
-  else if(m_configuration.OnboardCoinc == CAENPhaParameters::TrgInVeto)
+  else if(m_pConfiguration->OnboardCoinc == CAENPhaParameters::TrgInVeto)
   {
 	currentValue |= 0x0d00;
   }
    else
 	currentValue |= 0x10100;
 
-    status = CAEN_DGTZ_WriteRegister(m_handle,0x811c, currentValue);
+    status = m_pBackend->writeRegister(m_handle,0x811c, currentValue);
 
     if (status != CAEN_DGTZ_Success) {
       throw std::pair<std::string, int>("Unable to set external trigger", status);
     }
 
-    switch(m_configuration.trgoutmode)
+    switch(m_pConfiguration->trgoutmode)
     {
 	case CAENPhaParameters::TRGOUT_MODE_LEVEL0:     setRegisterBits(0x811c,14, 14, 0x0); 
 							setRegisterBits(0x811c,15, 15, 0x1);
@@ -578,8 +911,8 @@ CAENPha::setCoincidenceTriggers()
   // If there's no channels with coincidence enabled we have no work to do:
   
   bool useCoincidenceTrigger(false);
-  for (int i =0; i < m_configuration.coincidenceSettings.size(); i++) {
-    if (m_configuration.coincidenceSettings[i].s_enabled) {
+  for (int i =0; i < m_pConfiguration->coincidenceSettings.size(); i++) {
+    if (m_pConfiguration->coincidenceSettings[i].s_enabled) {
       useCoincidenceTrigger = true;
       break;                                // Only need one.
     }
@@ -602,25 +935,25 @@ CAENPha::setCoincidenceTriggers()
   uint32_t ChTrgMask = 0;
   uint32_t majLevel  = 1000;             // No board with 1000 channels.
   int      status;
-  for (int i =0; i < m_configuration.coincidenceSettings.size(); i++) {
-    int ch = m_configuration.coincidenceSettings[i].s_channel;
+  for (int i =0; i < m_pConfiguration->coincidenceSettings.size(); i++) {
+    int ch = m_pConfiguration->coincidenceSettings[i].s_channel;
     
     if ((m_enableMask & (1 << ch)) != 0) {
       ChTrgMask |= 1 << (ch/2);
     }
-    int chLevel = m_configuration.coincidenceSettings[i].s_majorityLevel;
+    int chLevel = m_pConfiguration->coincidenceSettings[i].s_majorityLevel;
     if (chLevel < majLevel)   majLevel  = chLevel;
   }
   // Now make the individual channel settings:
   
-  for (int item = 0; item < m_configuration.coincidenceSettings.size(); item++) {
+  for (int item = 0; item < m_pConfiguration->coincidenceSettings.size(); item++) {
     int i;                                  // Compatible with code lifted from digiTES
-    i = m_configuration.coincidenceSettings[item].s_channel;
+    i = m_pConfiguration->coincidenceSettings[item].s_channel;
     int maskindex = i/2;                                    // Mask bit # for ch.
-    int CoincWindow = m_configuration.coincidenceSettings[item].s_window;
+    int CoincWindow = m_pConfiguration->coincidenceSettings[item].s_window;
     
-    status  = CAEN_DGTZ_WriteRegister(m_handle, 0x1070 + (i << 8), CoincWindow);
-    status |= CAEN_DGTZ_WriteRegister(m_handle, 0x106c + (i << 8), 10);
+    status  = m_pBackend->writeRegister(m_handle, 0x1070 + (i << 8), CoincWindow);
+    status |= m_pBackend->writeRegister(m_handle, 0x106c + (i << 8), 10);
     if (status != CAEN_DGTZ_Success) {
       throw std::pair<std::string, int>("Failed to set channel coincidence window", status);
     }
@@ -643,12 +976,12 @@ CAENPha::setCoincidenceTriggers()
     // COINC_MAJORITY and COINC_AND_ALL.
     //
     
-    if (m_configuration.coincidenceSettings[item].s_operation == CAENPhaParameters::Majority) {
-      status = CAEN_DGTZ_WriteRegister(m_handle, 0x8180 + maskindex*4, 0x200 | ChTrgMask | ((majLevel - 1) << 10 ));
+    if (m_pConfiguration->coincidenceSettings[item].s_operation == CAENPhaParameters::Majority) {
+      status = m_pBackend->writeRegister(m_handle, 0x8180 + maskindex*4, 0x200 | ChTrgMask | ((majLevel - 1) << 10 ));
      std::cout << "\nMajority";
         
-    } else if (m_configuration.coincidenceSettings[item].s_operation == CAENPhaParameters::And) {
-      status = CAEN_DGTZ_WriteRegister(m_handle, 0x8180 + maskindex * 4 , 0x100 | ChTrgMask);
+    } else if (m_pConfiguration->coincidenceSettings[item].s_operation == CAENPhaParameters::And) {
+      status = m_pBackend->writeRegister(m_handle, 0x8180 + maskindex * 4 , 0x100 | ChTrgMask);
      std::cout << "\nAnd";
     }
 else  std::cout << "\nElse";
@@ -668,12 +1001,15 @@ else  std::cout << "\nElse";
  *    There's a common pretrigger.
 
 Updated by Sudarsan B : sbalak2@lsu.edu
+
+ * @param channels - Mask of the channels to program (reconfigure does only
+ *                   those that changed), default all.
  */
 void
-CAENPha::setPerChannelParameters()
+CAENPha::setPerChannelParameters(uint32_t channels)
 {
   std::vector<std::pair<unsigned, CAENPhaChannelParameters*> >&
-    chParams(m_configuration.m_channelParameters);
+    chParams(m_pConfiguration->m_channelParameters);
 
   // Now the DPP Parameters:
   CAEN_DGTZ_DPP_PHA_Params_t dppParams;
@@ -683,6 +1019,7 @@ CAENPha::setPerChannelParameters()
   // Fill in the elements present in chParams:
   for (unsigned i = 0; i < chParams.size(); i++) {
     int ch = chParams[i].first;
+    if (!(channels & (1 << ch))) continue;
     CAENPhaChannelParameters& params(*(chParams[i].second));
 
 //Edits made by hand to be numbered as indicated below: B.Sudarsan, Jan 2018.
@@ -691,7 +1028,7 @@ CAENPha::setPerChannelParameters()
   uint32_t preTrigSamples = static_cast<uint32_t>(params.preTrigger/(m_nsPerTick));
 //no.of.samples = time-in-ns/(4*m_nsPerTick) according to manual, but it doesn't work. This form above, does.
 
-  status = CAEN_DGTZ_SetDPPPreTriggerSize(m_handle, ch, preTrigSamples);
+  status = m_pBackend->setDPPPreTriggerSize(m_handle, ch, preTrigSamples);
 //  setRegisterBits(0x1038 + (ch << 8), 0,8,preTrigSamples*4);
   if (status != CAEN_DGTZ_Success) {
     throw std::pair<std::string, int> ("Failed to set DPP Pre trigger size", status);
@@ -705,7 +1042,7 @@ CAENPha::setPerChannelParameters()
     if(params.polarity == CAENPhaChannelParameters::positive)
 	dcoffset_fixed = 65535 - dcoffset_fixed;
 
-    status = CAEN_DGTZ_SetChannelDCOffset(m_handle, ch, dcoffset_fixed);  // Offset comes in units of % of max range
+    status = m_pBackend->setChannelDCOffset(m_handle, ch, dcoffset_fixed);  // Offset comes in units of % of max range
     if(status != CAEN_DGTZ_Success) {
       throw std::pair<std::string, int>("Failed to set channel dc offset", status);
     }
@@ -752,7 +1089,7 @@ CAENPha::setPerChannelParameters()
 	polarity = 1;
 
     //Set polarity using DPP Algo register at 0x1n80 bit 16
-   status = CAEN_DGTZ_SetChannelPulsePolarity(m_handle,ch,static_cast<CAEN_DGTZ_PulsePolarity_t>(polarity));
+   status = m_pBackend->setChannelPulsePolarity(m_handle,ch,static_cast<CAEN_DGTZ_PulsePolarity_t>(polarity));
     if (status != CAEN_DGTZ_Success) {
       throw std::pair<std::string, int>("Failed to write channel polarity", status);
     }
@@ -768,26 +1105,30 @@ CAENPha::setPerChannelParameters()
       throw std::pair<std::string, int>("Input range value not compatible with supported digitizers", params.range);
     }
     uint32_t rangeAddr = 0x1028 | (ch << 8);
-    status = CAEN_DGTZ_WriteRegister(m_handle, rangeAddr, rangeReg);
+    status = m_pBackend->writeRegister(m_handle, rangeAddr, rangeReg);
     if (status != CAEN_DGTZ_Success) {
       throw std::pair<std::string, int>("Failed to write range register", status);
     }
 
-    status = CAEN_DGTZ_WriteRegister(m_handle, 0x10a0 + (ch << 8), 0x10000);
-    //status = CAEN_DGTZ_WriteRegister(m_handle, 0x10a0 + (ch << 8), 0x0);
+    status = m_pBackend->writeRegister(
+      m_handle, 0x10a0 + (ch << 8), m_fineTime ? 0x10200 : 0x10000    // [10:8] extras2 option.
+    );
+    //status = m_pBackend->writeRegister(m_handle, 0x10a0 + (ch << 8), 0x0);
     if (status != CAEN_DGTZ_Success) {
       throw std::pair<std::string, int>("Failed to write DPP control 2 register", status);
     }
 
     int fgRegisterValue = fineGainRegister(params.fineGain, dppParams.k[ch], dppParams.M[ch]);
-    status = CAEN_DGTZ_WriteRegister(m_handle, 0x104c | (ch << 8), fgRegisterValue);
+    status = m_pBackend->writeRegister(m_handle, 0x104c | (ch << 8), fgRegisterValue);
     if (status != CAEN_DGTZ_Success) {
       throw std::pair<std::string, int>("Failed to write fine gain register", status);
     }
   }
-  status = CAEN_DGTZ_SetDPPParameters(m_handle, m_enableMask, &dppParams);
-  if (status != CAEN_DGTZ_Success) {
-    throw std::pair<std::string, int>("Unable to set dpp parameters", status);
+  if (m_enableMask & channels) {
+    status = m_pBackend->setDPPParameters(m_handle, m_enableMask & channels, &dppParams);
+    if (status != CAEN_DGTZ_Success) {
+      throw std::pair<std::string, int>("Unable to set dpp parameters", status);
+    }
   }
 
 
@@ -796,6 +1137,7 @@ CAENPha::setPerChannelParameters()
 for (unsigned i = 0; i < chParams.size(); i++)
 {
     int ch = chParams[i].first;
+    if (!(channels & (1 << ch))) continue;
 
 
    //By default, the rollover event is turned 'ON' by Compass 1.3.0
@@ -818,11 +1160,11 @@ for (unsigned i = 0; i < chParams.size(); i++)
    setRegisterBits(0x1080 | (ch<<8), 27, 27, 0);
 
 
-  uint32_t ShapedTriggerWidth = ((uint32_t)m_configuration.shapTrgWidth/(4*m_nsPerTick)) & 0x3ff;  
+  uint32_t ShapedTriggerWidth = ((uint32_t)m_pConfiguration->shapTrgWidth/(4*m_nsPerTick)) & 0x3ff;  
   setRegisterBits(0x1084 | (ch<<8), 0,9,ShapedTriggerWidth);
  // setRegisterBits(0x1084 | (ch<<8), 0,9,ShapedTriggerWidth);
  
-  switch(m_configuration.OnboardCoinc)
+  switch(m_pConfiguration->OnboardCoinc)
   {
 	case CAENPhaParameters::TrgInGated: setRegisterBits(0x1080 | (ch<<8), 18, 19, 0x1); //Setup coincidence mode
 					    setRegisterBits(0x10a0 | (ch<<8), 14, 15, 0x0); //Unset veto, if any
@@ -853,7 +1195,7 @@ for (unsigned i = 0; i < chParams.size(); i++)
  */
 void CAENPha::calibrate()
 {
-  CAEN_DGTZ_ErrorCode status = CAEN_DGTZ_Calibrate(m_handle);
+  CAEN_DGTZ_ErrorCode status = m_pBackend->calibrate(m_handle);
   if (status != CAEN_DGTZ_Success) {
     throw std::pair<std::string, int>("Calibration of board failed", status);
   }
@@ -886,16 +1228,16 @@ CAENPha::setRegisterBits(uint16_t addr, int start_bit, int end_bit, int val)
 
   if (((addr & 0xFF00) == 0x8000) && (addr != 0x8000) && (addr != 0x8004) && (addr != 0x8008)) { // broadcast access to channel individual registers (loop over channels)
     for(int ch = 0; ch < m_info.Channels; ch++) {
-      ret = CAEN_DGTZ_ReadRegister(m_handle, 0x1000 | (addr & 0xFF) | (ch << 8), &reg);
+      ret = m_pBackend->readRegister(m_handle, 0x1000 | (addr & 0xFF) | (ch << 8), &reg);
       reg = (reg & ~mask) | field;
-      ret |= CAEN_DGTZ_WriteRegister(m_handle, 0x1000 | (addr & 0xFF) | (ch << 8), reg);   
+      ret |= m_pBackend->writeRegister(m_handle, 0x1000 | (addr & 0xFF) | (ch << 8), reg);   
     }
   } else {
     // Individual register:
 
-    ret = CAEN_DGTZ_ReadRegister(m_handle, addr, &reg);
+    ret = m_pBackend->readRegister(m_handle, addr, &reg);
     reg = (reg & ~mask) | field;
-    ret |= CAEN_DGTZ_WriteRegister(m_handle, addr, reg);  
+    ret |= m_pBackend->writeRegister(m_handle, addr, reg);  
   
   }
 
@@ -912,11 +1254,7 @@ CAENPha::setRegisterBits(uint16_t addr, int start_bit, int end_bit, int val)
 bool
 CAENPha::dataBuffered()
 {
-  for (int i = 0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
-    if ((m_nDppEvents[i] - m_nOffsets[i]) > 0)
-      return true;                       // This channel has undelivered events.
-  }
-  return false;                          // All channels are empty.
+  return !m_hits.empty();
 }
 /**
  * fillBuffers
@@ -925,65 +1263,66 @@ CAENPha::dataBuffered()
 void
 CAENPha::fillBuffers()
 {
-  for (int i = 0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
-    m_nDppEvents[i]  = 0;
-    m_nOffsets[i]    = 0;
+  m_hits.discard();
+  m_waveformsDecoded = false;
+  if (m_pReader) {
+    
+    // Trade the buffers we've used up for the next block the
+    // reader thread has transferred and parsed.  The blocks waiting
+    // for us are the load:
+    
+    if (m_pOverload) m_pOverload->sample(m_pReader->backlog());
+    for (uint64_t n = m_pReader->decodeFailures(); m_readerFailures < n; m_readerFailures++) {
+      m_pDiagnostics->count(CDppDiagnostics::DECODE_FAILURES);
+    }
+    if (m_pReader->exchange(m_rawBuffer, m_hits)) {
+      countRollovers();
+    } else if (!m_readerStopped && (m_pReader->status() != CAEN_DGTZ_Success)) {
+      
+      // The reader quit on a failed read.  Say so once, not every poll:
+      
+      m_readerStopped = true;
+      m_pDiagnostics->report(
+        CDppDiagnostics::COMM_ERRORS, CDppDiagnostics::BOARD,
+        "Background reader stopped on a failed read.. it's likely all over"
+      );
+    }
+    return;
   }
   CAEN_DGTZ_ErrorCode status;
   uint32_t             nRead;
-  status = CAEN_DGTZ_ReadData(
+  status = m_pBackend->readData(
       m_handle, CAEN_DGTZ_SLAVE_TERMINATED_READOUT_MBLT, m_rawBuffer, &nRead
   );
   if (status == CAEN_DGTZ_CommError) {
-     std::cout << "Comm error.. it's likely all over" << nRead << std::endl;
+    m_pDiagnostics->report(
+      CDppDiagnostics::COMM_ERRORS, CDppDiagnostics::BOARD,
+      "Comm error.. it's likely all over"
+    );
     return;
   }
   if (status != CAEN_DGTZ_Success) return;   // Unable to buffer for some reason.
+  if (m_pOverload) m_pOverload->sample(double(nRead)/m_rawSize);
   if (nRead == 0) return;                    // Nothing to read.
   
-  status = CAEN_DGTZ_GetDPPEvents(
-      m_handle, m_rawBuffer, nRead, (void**)(m_dppBuffer), (uint32_t*)m_nDppEvents
-  );
-  
-  
+  if (m_hits.load(m_rawBuffer, nRead) != CAEN_DGTZ_Success) {  // Empty if it can't be parsed.
+    m_pDiagnostics->count(CDppDiagnostics::DECODE_FAILURES);
+    return;
+  }
+  countRollovers();
 }
-
 /**
- * findEarliest
- *    Find the channel with the earliest timestamp (TimeTag).  This is part
- *    of ensuring that the data from the digitizer is delivered to the client
- *    in a time ordered fashion.
- *
- * @return channel - the channel whose first undelivered event has the lowest
- *                   timestamp.
- * @note The caller must make certain there's at least one channel with unread
- *       data.  This is done by ensuring dataBuffered() returns true.
+ * countRollovers
+ *    Publish each channel's time tag rollovers after a block is loaded.
  */
-int
-CAENPha::findEarliest()
+void
+CAENPha::countRollovers()
 {
-  uint64_t lowestStamp = 0;
-  lowestStamp--;                      // twos complements means this is umaxint64.
-  int earliest = CAEN_DGTZ_MAX_CHANNEL; // Not allowed.
-  for (int i =0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
-    int offset = m_nOffsets[i];
-    if (offset < m_nDppEvents[i]) {     // Channel has undelivered events.
-      uint64_t tag = m_dppBuffer[i][offset].TimeTag;
-      if(tag < lowestStamp) {
-        lowestStamp = tag;
-        earliest = i;
-      }
-    }
-    
-  }
-  // It's a sorry state of affairs if earliest == CAEN_DGTZ_MAX_CHANNEL,
-  // That means the caller broke the rules.
-  
-  if (earliest == CAEN_DGTZ_MAX_CHANNEL) {
-    throw std::logic_error("CAENPha::findEarliest - no channels with data !!");
+  for (int i = 0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
+    m_pDiagnostics->set(CDppDiagnostics::ROLLOVERS, i, m_hits.rollovers(i));
   }
-  return earliest;
 }
+
 /**
  * Compute the fine gain register given:
  *
@@ -1072,23 +1411,23 @@ CAENPha::processCheatFile()
             break;
           case '.':                                   // set:
             {
-              CAEN_DGTZ_WriteRegister(m_handle, addr, value);
+              m_pBackend->writeRegister(m_handle, addr, value);
             }
             break;
           case '|':                                 // bitwise or.
             {
               uint32_t currentValue;
-              CAEN_DGTZ_ReadRegister(m_handle, addr, &currentValue);
+              m_pBackend->readRegister(m_handle, addr, &currentValue);
               value |= currentValue;
-              CAEN_DGTZ_WriteRegister(m_handle, addr, value);
+              m_pBackend->writeRegister(m_handle, addr, value);
             }
             break;
           case '*':                               // bitwise and.
             {
               uint32_t currentValue;
-              CAEN_DGTZ_ReadRegister(m_handle, addr, &currentValue);
+              m_pBackend->readRegister(m_handle, addr, &currentValue);
               value &= currentValue;
-              CAEN_DGTZ_WriteRegister(m_handle, addr, value);
+              m_pBackend->writeRegister(m_handle, addr, value);
             }
             break;
           default:                               // unrecognized operation.
@@ -26,10 +26,18 @@
 #define CAENPHA_H
 #include <cstddef>
 #include <stdint.h>              // Types CAEN expects rather than <cstdint>
-#include <tuple>
 #include "CAENDigitizer.h"
 #include "CAENPhaParameters.h"
 #include "CAENPhaChannelParameters.h"
+#include "CDppHitStore.h"
+#include "CTracePolicy.h"
+#include "CDigitizerBackend.h"
+#include "CRegisterImage.h"
+#include "CDppDiagnostics.h"
+
+class CDppReadoutThread;
+class COverloadController;
+class CShadowRegisterScope;
 
 
 
@@ -42,7 +50,8 @@
 class CAENPha
 {
 private:
-  CAENPhaParameters&  m_configuration;
+  CAENPhaParameters*  m_pConfiguration;  // Last setup or reconfigure.
+  CDigitizerBackend*  m_pBackend;
   int                 m_handle;
   CAEN_DGTZ_BoardInfo_t m_info;
 
@@ -53,17 +62,28 @@ private:
   bool                m_trgout;
   char*               m_rawBuffer;
   uint32_t            m_rawSize;
-  CAEN_DGTZ_DPP_PHA_Event_t* m_dppBuffer[CAEN_DGTZ_MAX_CHANNEL];
-  uint32_t            m_dppSize;
+  CDppHitStore        m_hits;          // Hits of the last buffer read.
   CAEN_DGTZ_DPP_PHA_Waveforms_t* m_pWaveforms;
   uint32_t            m_wfSize;
-  int32_t            m_nDppEvents[CAEN_DGTZ_MAX_CHANNEL];
-  int32_t            m_nOffsets[CAEN_DGTZ_MAX_CHANNEL];
-  uint64_t           m_nTimestampAdjusts[CAEN_DGTZ_MAX_CHANNEL];
-  uint64_t           m_nLastTimestamp[CAEN_DGTZ_MAX_CHANNEL];
   unsigned           m_nsPerTick; /* Nanoseconds per digitizer clock. */
   unsigned           m_nsPerTrigger;  // ns per trigger clock tick.
   const char*        m_pCheatFile;
+  unsigned           m_nAsyncBlocks;  // 0 - ReadData in fillBuffers, else ring size.
+  CDppReadoutThread* m_pReader;
+  bool               m_inTreeDecode;    // CDppAggregateParser rather than GetDPPEvents.
+  bool               m_readerStopped;   // Its stop has been reported.
+  uint64_t           m_readerFailures;  // Its decode failures counted so far.
+  bool               m_waveformsDecoded; // m_pWaveforms holds the current hit's traces.
+  bool               m_tracesEnabled;   // Board is acquiring waveforms (mixed mode).
+  unsigned           m_tracePrescale;   // Default for channels with no trace prescale.
+  bool               m_fineTime;        // Fold the fine time into the timestamps.
+  bool               m_appliedFineTime; // m_fineTime when the channels were programmed.
+  CTracePolicy       m_tracePolicy;     // Which hits keep their traces.
+  COverloadController* m_pOverload;     // Sheds traces and is told the load, if set.
+  CDppDiagnostics    m_diagnostics;     // Counts what goes wrong if nothing else does.
+  CDppDiagnostics*   m_pDiagnostics;    // Counts what goes wrong.
+  bool               m_coalesce;        // Compose setup register writes (CShadowRegisterFile).
+  const CRegisterImage* m_pImage;       // Compiled registers to setup from, if set.
   int conet_node;
   // Other data
   
@@ -71,29 +91,50 @@ private:
 public:
   CAENPha(CAENPhaParameters& config, CAEN_DGTZ_ConnectionType linkType, int linknum,
           int node, uint32_t base, CAEN_DGTZ_AcqMode_t startMode,
-          bool trgout, unsigned delay, const char* pCheatFile=0);
+          bool trgout, unsigned delay, const char* pCheatFile=0,
+          CDigitizerBackend* pBackend=0);
   ~CAENPha();
-  void setup();
+  void setup(bool startNow = true);
+  bool reconfigure(CAENPhaParameters& config, bool startNow = true);
+  void start();
+  CAEN_DGTZ_AcqMode_t startMode() const { return m_startMode; }
   void shutdown();
+  void setAsyncReadout(unsigned nBlocks);
+  void setInTreeDecode(bool enable);
+  void setTracePrescale(unsigned prescale);
+  void setFineTimestamps(bool enable);
+  void setOverloadController(COverloadController* pController);
+  void setDiagnostics(CDppDiagnostics* pDiagnostics);
+  void setRegisterCoalescing(bool enable);
+  void setRegisterImage(const CRegisterImage* pImage);
 
   bool haveData();
-  std::tuple<int, const CAEN_DGTZ_DPP_PHA_Event_t*, const CAEN_DGTZ_DPP_PHA_Waveforms_t*> Read();
+  bool dataBuffered();
+  const CDppHitStore& hits() const { return m_hits; }
+  const CTracePolicy& tracePolicy() const { return m_tracePolicy; }
+  const CAEN_DGTZ_DPP_PHA_Waveforms_t* waveforms();
+  void next();
 
   // Organizational methods
   
 private:
+  int enabledChannels();
   int setChannelMask();
+  void setTracePolicies();
   void setTriggerAndSyncMode();
   void setCoincidenceTriggers();
-  void setPerChannelParameters();
+  void setPerChannelParameters(uint32_t channels = 0xffffffff);
+  void program();
+  void loadImage(const CRegisterImage::Board& image);
   void calibrate();
+  void freeBuffers();
+  void finishRegisters(CShadowRegisterScope& shadow);
 
   // Utility methods.
 private:
   void setRegisterBits(uint16_t addr, int start_bit, int end_bit, int val);
-  bool dataBuffered();
   void fillBuffers();
-  int  findEarliest();
+  void countRollovers();
   uint16_t fineGainRegister(double value, int k, int m);
   void processCheatFile();
 };
@@ -73,9 +73,39 @@ CAENPhaChannelParameters::operator=(const CAENPhaChannelParameters& rhs)
     psdLowCut    = rhs.psdLowCut;
     psdHighCut   = rhs.psdHighCut;
     fineGain     = rhs.fineGain;
+    fakeevt_ttroll_en = rhs.fakeevt_ttroll_en;
+    readoutCuts  = rhs.readoutCuts;
+    tracePolicy  = rhs.tracePolicy;
   }
   return *this;
 }
+/**
+ * sameRegisterSettings
+ *   Compare the parameters CAENPha programs into the channel's registers.
+ *   The software cuts and trace policy aren't compared.
+ *
+ *   @param rhs - the parameters to compare with.
+ *   @return bool - true if the channel would be programmed the same.
+ */
+bool
+CAENPhaChannelParameters::sameRegisterSettings(const CAENPhaChannelParameters& rhs) const
+{
+  return (enabled == rhs.enabled) && (dcOffset == rhs.dcOffset) &&
+    (decimation == rhs.decimation) && (digitalGain == rhs.digitalGain) &&
+    (polarity == rhs.polarity) && (range == rhs.range) &&
+    (decayTime == rhs.decayTime) && (trapRiseTime == rhs.trapRiseTime) &&
+    (flattopDelay == rhs.flattopDelay) && (trapFlatTop == rhs.trapFlatTop) &&
+    (BLMean == rhs.BLMean) && (trapGain == rhs.trapGain) && (peakMean == rhs.peakMean) &&
+    (baselineHoldoff == rhs.baselineHoldoff) && (peakHoldoff == rhs.peakHoldoff) &&
+    (threshold == rhs.threshold) && (rccr2smoothing == rhs.rccr2smoothing) &&
+    (inputRiseTime == rhs.inputRiseTime) && (triggerHoldoff == rhs.triggerHoldoff) &&
+    (triggerValidationWidth == rhs.triggerValidationWidth) &&
+    (preTrigger == rhs.preTrigger) && (energySkim == rhs.energySkim) &&
+    (lld == rhs.lld) && (uld == rhs.uld) &&
+    (fastTriggerCorrection == rhs.fastTriggerCorrection) &&
+    (baselineClip == rhs.baselineClip) && (baselineAdjust == rhs.baselineAdjust) &&
+    (fineGain == rhs.fineGain) && (fakeevt_ttroll_en == rhs.fakeevt_ttroll_en);
+}
  
 /**
  * unpack
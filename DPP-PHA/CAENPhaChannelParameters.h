@@ -29,6 +29,8 @@
 #define CAENPHACHANNELPARAMETERS_H
 
 #include "pugixml.hpp"
+#include "CHitFilter.h"
+#include "CTracePolicy.h"
 #include <functional>
 
 class CAENPhaChannelParameters
@@ -110,6 +112,11 @@ public:
   bool fakeevt_ttroll_en;
   bool extras_enable;
   bool defaultPUREnable;
+
+  // Software cuts and trace policy applied in the readout (DAQ_PARAM_CH_* keys):
+
+  CHitFilter::Cuts readoutCuts;
+  CTracePolicy::Policy tracePolicy;
   
 
 
@@ -120,6 +127,7 @@ public:
   CAENPhaChannelParameters() :  m_xml(empty) {}          // Default constructor
   CAENPhaChannelParameters(const CAENPhaChannelParameters& rhs);
   CAENPhaChannelParameters& operator=(const CAENPhaChannelParameters& rhs);
+  bool sameRegisterSettings(const CAENPhaChannelParameters& rhs) const;
 
 
   void unpack();
@@ -123,6 +123,45 @@ CAENPhaParameters::~CAENPhaParameters()
     delete m_channelParameters[i].second;
   }
 }
+/**
+ * sameBoardSettings
+ *   Compare the board level parameters CAENPha programs and the set of
+ *   channels and whether they're enabled.  If these are the same the
+ *   board need only have the channels whose parameters changed
+ *   reprogrammed (see CAENPhaChannelParameters::sameRegisterSettings).
+ *
+ *   @param rhs - the parameters to compare with.
+ *   @return bool - true if the board level setup would be the same.
+ */
+bool
+CAENPhaParameters::sameBoardSettings(const CAENPhaParameters& rhs) const
+{
+  if ((acqMode != rhs.acqMode) || (startDelay != rhs.startDelay) ||
+      (recordLength != rhs.recordLength) || (trgoutmode != rhs.trgoutmode) ||
+      (OnboardCoinc != rhs.OnboardCoinc) || (shapTrgWidth != rhs.shapTrgWidth) ||
+      (IOLevel != rhs.IOLevel) || (triggerSource != rhs.triggerSource) ||
+      (ioctlmask != rhs.ioctlmask) || (s_startMode != rhs.s_startMode)) {
+    return false;
+  }
+  if (coincidenceSettings.size() != rhs.coincidenceSettings.size()) return false;
+  for (int i = 0; i < coincidenceSettings.size(); i++) {
+    const ChannelCoincidenceSettings& a(coincidenceSettings[i]);
+    const ChannelCoincidenceSettings& b(rhs.coincidenceSettings[i]);
+    if ((a.s_channel != b.s_channel) || (a.s_enabled != b.s_enabled) ||
+        (a.s_operation != b.s_operation) || (a.s_majorityLevel != b.s_majorityLevel) ||
+        (a.s_window != b.s_window)) {
+      return false;
+    }
+  }
+  if (m_channelParameters.size() != rhs.m_channelParameters.size()) return false;
+  for (int i = 0; i < m_channelParameters.size(); i++) {
+    if ((m_channelParameters[i].first != rhs.m_channelParameters[i].first) ||
+        (m_channelParameters[i].second->enabled != rhs.m_channelParameters[i].second->enabled)) {
+      return false;
+    }
+  }
+  return true;
+}
 
 /**
  * unpack
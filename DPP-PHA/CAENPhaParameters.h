@@ -137,10 +137,12 @@ TRGOUT_MODE_SAMPLE_CLK, TRGOUT_MODE_PLL_CLK, TRGOUT_MODE_BUSY, TRGOUT_MODE_PLL_U
 
 public:
   CAENPhaParameters(pugi::xml_document& m_dom, std::vector<std::pair<unsigned, pugi::xml_document*> >& channelDoms);
-  CAENPhaParameters() : m_dom(empty), m_channelDoms(emptyDoms), acqMode(1) {}                // Default constructor
+  CAENPhaParameters() : m_dom(empty), m_channelDoms(emptyDoms), acqMode(1), ioctlmask(0),
+    isExtTrgEnabled(false), isExtVetoEnabled(false) {}                // Default constructor
   CAENPhaParameters(const CAENPhaParameters& rhs);
   ~CAENPhaParameters();
   CAENPhaParameters& operator=(const CAENPhaParameters& rhs);
+  bool sameBoardSettings(const CAENPhaParameters& rhs) const;
 
 public:
   void unpack();
@@ -20,11 +20,11 @@
 #include <CAENDigitizer.h>
 #include <CAENDigitizerType.h>
 #include "CompassProject.h"
+#include "DppBulkFormat.h"
 #include <cstring>
 #include <fstream>
 #include <sstream>
 #include <iostream>
-#include <chrono>
 
 //static std::ofstream _rout[7]={NULL,NULL,NULL,NULL,NULL,NULL,NULL};
 /*static std::ofstream _rout0("board0.out");
@@ -58,7 +58,13 @@ CompassEventSegment::CompassEventSegment(
 				const char* pCheatFile
 	) : m_filename(filename), m_board(nullptr), m_id(sourceId),
     m_linkType(linkType), m_nLinkNum(linkNum), m_nNode(node), 
-    m_nBase(base) , m_pCheatFile(pCheatFile)
+    m_nBase(base) , m_pCheatFile(pCheatFile), m_nAsyncBlocks(0),
+    m_inTreeDecode(false),
+    m_pBackend(nullptr), m_bulk(false), m_nTracePrescale(1),
+    m_fineTime(false), m_packTraces(false), m_extractFeatures(false),
+    m_keepTraces(true), m_vetted(false),
+    m_diagnostics("PHA source " + std::to_string(sourceId)), m_timeOffset(0),
+    m_incremental(false), m_coalesce(false), m_useImage(false)
 {
     
 }
@@ -71,31 +77,42 @@ CompassEventSegment::~CompassEventSegment()
 }
 /**
  * initialize
- *    Prepare the board for data taking.
+ *    Prepare the board for data taking and start it.
+ */
+void
+CompassEventSegment::initialize()
+{
+    setup();
+    startAcquisition();
+}
+/**
+ * setup
+ *    Prepare the board for data taking without starting it, so that a
+ *    compound segment can start several boards in order (see
+ *    CompassMultiModuleEventSegment::setParallelSetup).
  *    - Parse the Compass file.
  *    - Instantiate the m_board object
  *    - Setup the board from the parsed/processed configuration
  *      file.
  */
 void
-CompassEventSegment::initialize()
+CompassEventSegment::setup()
 {
     try {
-        CompassProject project(m_filename.c_str());
-        project();
+        std::shared_ptr<CompassProject> project = CompassProject::load(m_filename);
         
         // We need to locate the board that matches our parameters.
         std::cout << "\nInitializing board.."<<std::flush;
         CAENPhaParameters* ourBoard(nullptr);
         
-        for (int i = 0; i < project.m_connections.size(); i++) {
+        for (int i = 0; i < project->m_connections.size(); i++) {
             if (
-                (m_linkType == project.m_connections[i].s_linkType)  &&
-                (m_nLinkNum  == project.m_connections[i].s_linkNum)   &&
-                (m_nNode    == project.m_connections[i].s_node)      &&
-                (m_nBase    == project.m_connections[i].s_base) 
+                (m_linkType == project->m_connections[i].s_linkType)  &&
+                (m_nLinkNum  == project->m_connections[i].s_linkNum)   &&
+                (m_nNode    == project->m_connections[i].s_node)      &&
+                (m_nBase    == project->m_connections[i].s_base) 
             ) {
-                ourBoard = (project.m_boards[i]);
+                ourBoard = (project->m_boards[i]);
                 break;
             }
         }
@@ -107,18 +124,24 @@ CompassEventSegment::initialize()
         }
         // Now we can setup the board.
 
-	auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
-			std::chrono::system_clock::now().time_since_epoch()
-			).count();
+	m_rates.reset();                    // Counters start at zero.
+	m_filter.resetCounters();
+	m_overload.reset();
+	m_diagnostics.reset();
+	m_vetted = false;
 
-	//Initialize counters at zero
-	for (int i =0; i < 16; i++) {
-		m_triggerCount[i] = 0;
-		m_missedTriggers[i] = 0;
-	        t[i] =  now; //clock();
-	        tmiss[i] =  now; //clock();
+	// Align our timestamps with the other boards':
+
+	m_timeOffset = 0;
+	if (!m_offsetFile.empty()) {
+	  CTimeOffsetTable offsets;
+	  offsets.read(m_offsetFile);
+	  m_timeOffset = offsets.offset(m_id);
 	}
+	m_useImage = readRegisterImage();
         
+        std::shared_ptr<CompassProject> previous = m_project;  // m_board may refer to it.
+        m_project = project;               // The driver refers to ourBoard.
         setupBoard(*ourBoard);
     } catch (std::string msg) {
         std::cerr << "Initialization failed - " << msg << std::endl;
@@ -130,6 +153,33 @@ CompassEventSegment::initialize()
        throw;
     }
 }
+/**
+ * startAcquisition
+ *    Start (or arm, if it starts on a signal) the board setup() set up.
+ */
+void
+CompassEventSegment::startAcquisition()
+{
+    try {
+        m_board->start();
+    }
+    catch (std::pair<std::string, int> phaErr) {
+       std::cerr << "Starting the board caught a error: "
+        << phaErr.first << "(" << phaErr.second << ")\n";
+       throw;
+    }
+}
+/**
+ * isMaster
+ *    The master is the board started by software; the others are armed
+ *    to start when it does.
+ * @return bool - true if the board is the master.
+ */
+bool
+CompassEventSegment::isMaster() const
+{
+    return m_board && (m_board->startMode() == CAEN_DGTZ_SW_CONTROLLED);
+}
 /**
  * clear
  *    Clear the digitizer.
@@ -179,68 +229,42 @@ CompassEventSegment::disable()
 size_t
 CompassEventSegment::read(void* pBuffer, size_t maxwords)
 {
-  std::tuple<int, const CAEN_DGTZ_DPP_PHA_Event_t*, const CAEN_DGTZ_DPP_PHA_Waveforms_t*>
-  event = m_board->Read();
-  
-  // Figure out the event size.  Note that since CAEN_DGTZ_DPP_PHA_Event_t*
-  // and CAEN_)DGTZ_DPP_PHA_Waveforms_t almost certainly have pads,
-  // we're going to write the data an item at a time into the buffer.
-  
-  int chan = std::get<0>(event);
-  const CAEN_DGTZ_DPP_PHA_Event_t* dppData = std::get<1>(event);
-  const CAEN_DGTZ_DPP_PHA_Waveforms_t* wfData = std::get<2>(event);
+  if (m_bulk) return readBulk(pBuffer, maxwords);
 
-  if (!(dppData || wfData)) {
+  // The hit is the one at the cursor of the board's hit store.  Its
+  // record layout is in DppFragmentFormat.h.
+  
+  if (!m_board->dataBuffered()) {
+    m_diagnostics.count(CDppDiagnostics::REJECTED_READS);
     reject();//Immediately();
     //clear();
     return 0;                            // No event.
   }
+  const CDppHitStore& hit(m_board->hits());
+  int chan = hit.channel();
 
  
- // if(!(dppData->Extras == 10) )
-//     std::cout <<std::dec<< "\nsid:"<< m_id + 1 << "\tCh:" << chan <<"\tEn:" << dppData->Energy<<"\tTs:"<<dppData->TimeTag<<"\tExtr:"<<dppData->Extras<<"\tExtr2:"<<dppData->Extras2;
-
-  if((dppData->Extras&64)>>6 != 0) //bit[5] of extras is trg counter, we force N=128
-   {
-	//m_triggerCount[chan] += 128.;
-	auto now =    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-	//if(m_id==3 && chan==0) std::cout << "\npha:" << static_cast<uint32_t>(128./((now-t[chan])*1.e-3));
-	m_triggerCount[chan] = static_cast<uint32_t>(128./((now-t[chan])*1.e-3));
-	t[chan] = now;
-   }
-  if((dppData->Extras&32)>>5 != 0) //bit[5] of extras is lost_trg counter, we force N=128
-   {
-	//m_triggerCount[chan] += 128.;
-	auto now =    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-	//if(m_id==3 && chan==0) std::cout << "\npha:" << static_cast<uint32_t>(128./((now-t[chan])*1.e-3));
-	m_missedTriggers[chan] = static_cast<uint32_t>(128./((now-tmiss[chan])*1.e-3));
-	tmiss[chan] = now;
-   }
-//if(!(dppData->Extras2 == 0))
-//	std::cout <<std::endl<<"Extr:"<<dppData->Extras<<"\tExtr2:"<<dppData->Extras2;
-
-if((dppData->Extras == 10)||dppData->TimeTag==0) //Fake event with TimeTag=0 and Extras[bit1] = Extras[bit3] =1 
-  {
+ // if(!(hit.extras() == 10) )
+//     std::cout <<std::dec<< "\nsid:"<< m_id + 1 << "\tCh:" << chan <<"\tEn:" << hit.energy()<<"\tTs:"<<hit.timestamp()<<"\tExtr:"<<hit.extras()<<"\tExtr2:"<<hit.extras2();
+
+  if (!acceptHit(chan, hit)) {
+      m_board->next();
       reject();//Immediately();
       clear();
-      std::cout << "\n 'Fake' timestamp rollover event found.. Disable bit 26 in 0x1n80";
-    return 0; //Ignore if it's the 'fake event'
+    return 0; //Ignore if it's the 'fake event' or cut.
   }
+  const CAEN_DGTZ_DPP_PHA_Waveforms_t* wfData = m_board->waveforms();   // Only kept hits are decoded.
 
 
-  
   // Note that both the 730 and 725 have a timestamp in 8ns granularity.
   // We store the timestamp in ns in the body header:
-  //int64_t offsetsubtract[8] = {-6,54,12,8,0,-12,0,0};
-  int64_t offsetsubtract[8] = {0,0,0,0,0,0,0,0};
-//-48.000000	-92.000000	-48.000000	-28.000000	-4.000000	-4.000000	0.000000	
 
   setSourceId(m_id);                     // Source id from member data.    
-  chan = 16*m_id  + chan;     
-  setTimestamp(dppData->TimeTag+(offsetsubtract[(int)m_id]));        // Event timestamp - in ns (CAENPha did that).
-  size_t eventSize = computeEventSize(*dppData, *wfData);
+  setTimestamp(hit.timestamp() + m_timeOffset);        // Event timestamp - in ns (the hit store did that).
+  DppFragment::Traces wf = traces(hit, *wfData);
   
-  if ((eventSize / sizeof(uint16_t)) > maxwords) {
+  if (DppFragment::Pha::bytes(wf) > maxwords*sizeof(uint16_t)) {
+    m_diagnostics.count(CDppDiagnostics::OVERSIZE_EVENTS, chan);
     throw std::string("PHAEventSegment size exceeds maxwords - expand max event size");
   }
 
@@ -258,17 +282,16 @@ if((dppData->Extras == 10)||dppData->TimeTag==0) //Fake event with TimeTag=0 and
 			   case 6 : outstr = &_rout6; break;
 			}
 
-    (*outstr) << std::dec<<"\n"<<dppData->TimeTag+(offsetsubtract[(int)m_id]) <<";"<< dppData->Energy<<";"<< m_id;
+    (*outstr) << std::dec<<"\n"<<hit.timestamp() + m_timeOffset <<";"<< hit.energy()<<";"<< m_id;
    }*/
 
 
 
-  pBuffer = putLong(pBuffer, eventSize);
-  pBuffer = putLong(pBuffer, chan);
-  
-  // Body is dpp data followed by wf data:
-  pBuffer = putDppData(pBuffer, *dppData);
-  pBuffer = putWfData(pBuffer, *wfData);
+  // The event is only the first 'size' bytes of the record (see
+  // DppFragmentFormat.h) - the analyzers know PHA events by that size.
+
+  size_t eventSize = writeHit(pBuffer, chan, hit, wf) - DppFragment::Pha::UNCOUNTED;
+  m_board->next();
   
   return (eventSize / sizeof(uint16_t));     
 }
@@ -283,175 +306,484 @@ CompassEventSegment::checkTrigger()
 {
     return m_board->haveData();
 }
-/*-------------------------------------------------------------------
- * Private member functions.
+/**
+ * nextTimestamp
+ *    Only valid when checkTrigger says there's data.
+ * @return uint64_t - ns timestamp the next read's event will have.
  */
-
+uint64_t
+CompassEventSegment::nextTimestamp()
+{
+    return m_board->hits().timestamp() + m_timeOffset;
+}
 /**
- * setupBoard
- *    Setup the board:
- *    - If there's a Pha object, delete it and set it's pointer to null.
- *    - Create a new board object save it as m_pBoard.
- *    - Invoke the board object's setup mode
- *    @param board - Reference to our board configuration object.
+ * newestTimestamp
+ *    Only valid when checkTrigger says there's data.
+ * @return uint64_t - ns timestamp of the latest hit the board has buffered.
+ */
+uint64_t
+CompassEventSegment::newestTimestamp()
+{
+    return m_board->hits().newestTimestamp() + m_timeOffset;
+}
+/**
+ * setAsyncReadout
+ *    Request that the board's block transfers be done in a background
+ *    thread (see CAENPha::setAsyncReadout).  Takes effect at the next
+ *    initialize.
+ *
+ * @param nBlocks - Number of buffered blocks, 0 to read synchronously.
  */
 void
-CompassEventSegment::setupBoard(CAENPhaParameters& board)
+CompassEventSegment::setAsyncReadout(unsigned nBlocks)
 {
-    delete m_board;                // Get rid of any prior board driver.
-    m_board = nullptr;
-    m_board = new CAENPha(
-        board, m_linkType, m_nLinkNum,
-				m_nNode, m_nBase,
-        board.s_startMode, true, 
-        board.startDelay,
-				m_pCheatFile
-    );
-    m_board->setup();
-    
+    m_nAsyncBlocks = nBlocks;
 }
-
-
-
 /**
- * putWord
- *    Put a word into the buffer.
+ * setInTreeDecode
+ *    Decode readout buffers with the in tree parser rather than
+ *    CAEN_DGTZ_GetDPPEvents (see CAENPha::setInTreeDecode).  Takes effect at
+ *    the next initialize.
  *
- * @param pDest - pointer to where the word goes
- * @param data  -uint16_t to put.
- * @return void* Pointer to the next free slot in the buffer.
+ * @param enable - true to decode in tree, false (the default) for the library.
  */
-void*
-CompassEventSegment::putWord(void* pDest, uint16_t data)
+void
+CompassEventSegment::setInTreeDecode(bool enable)
 {
-    uint16_t* p = reinterpret_cast<uint16_t*>(pDest);
-    *p++ = data;
-    
-    return p;
+    m_inTreeDecode = enable;
 }
 /**
- * putLong
- *  Put a 32 bit long into the buffer.
+ * setBackend
+ *    Select the digitizer backend the board is driven through
+ *    (e.g. a CSimulatedDigitizer).  Takes effect at the next initialize.
  *
- * @param pDest - pointer to where the data goes.
- * @param data  - uint32_t to put.
- * @return void* - pointer to the next free slot in the buffer.
+ * @param pBackend - The backend, nullptr for CDigitizerBackend::getDefault().
  */
-void*
-CompassEventSegment::putLong(void* pDest, uint32_t data)
+void
+CompassEventSegment::setBackend(CDigitizerBackend* pBackend)
 {
-    uint32_t* p = reinterpret_cast<uint32_t*>(pDest);
-    *p++ = data;
-    return p;
+    m_pBackend = pBackend;
 }
-
 /**
- * putQuad
- *    Put a 64 bit quadword into the buffer.
+ * setBulkReadout
+ *    Choose between one event per hit and bulk events that pack all the
+ *    hits buffered from a digitizer read (see DppBulkFormat.h).  Bulk events
+ *    greatly reduce the per event overhead in the ring, event builder and
+ *    event files at high rates.  Analysis must understand the bulk format.
  *
- * @param pDest - pointer to where the data goes.
- * @param data  - the data.
- * @return void* - points to the next free slot in the buffer.
+ * @param enable - true for bulk events.
  */
-void*
-CompassEventSegment::putQuad(void* pDest, uint64_t data)
+void
+CompassEventSegment::setBulkReadout(bool enable)
 {
-    uint64_t* p = reinterpret_cast<uint64_t*>(pDest);
-    *p++ = data;
-    return p;
+    m_bulk = enable;
 }
+/**
+ * setTracePrescale
+ *    When the board takes waveforms keep them for only 1 in prescale hits
+ *    of each channel (see CAENPha::setTracePrescale).  Takes effect at the
+ *    next initialize.
+ *
+ * @param prescale - 1 (the default) keeps all traces, 0 none.
+ */
+void
+CompassEventSegment::setTracePrescale(unsigned prescale)
+{
+    m_nTracePrescale = prescale;
+}
+/**
+ * setFineTimestamps
+ *    Include the board's fine time in the hit timestamps (see
+ *    CAENPha::setFineTimestamps).  The records keep the ps their ns
+ *    timestamps leave out (see DppFragmentFormat.h).  Takes effect at the
+ *    next initialize.
+ *
+ * @param enable - true to include the fine time.
+ */
+void
+CompassEventSegment::setFineTimestamps(bool enable)
+{
+    m_fineTime = enable;
+}
+/**
+ * setTracePacking
+ *    Write the traces of hits losslessly packed (see DppTraceCodec.h),
+ *    typically a third of their size.  The records flag packed traces and
+ *    the analyzers unpack them.
+ *
+ * @param enable - true to pack traces.
+ */
+void
+CompassEventSegment::setTracePacking(bool enable)
+{
+    m_packTraces = enable;
+}
+/**
+ * setTraceFeatures
+ *    Write the features of each hit's trace 1 (see CFeatureExtractor.h) with
+ *    it, alongside its traces or instead of them.  Trace 1 is taken to be
+ *    the input (analog probe 1 = Input), as ADC samples.  Only hits that
+ *    carry traces (see setTracePrescale and the trace policies) get features.
+ *
+ * @param enable     - true to write features.
+ * @param keepTraces - false to leave the traces out.
+ */
+void
+CompassEventSegment::setTraceFeatures(bool enable, bool keepTraces)
+{
+    m_extractFeatures = enable;
+    m_keepTraces      = keepTraces;
+}
+/**
+ * setFeatureSettings
+ *    Tune the feature extraction.
+ *
+ * @param settings - baseline length, CFD fraction and delay, tail start.
+ */
+void
+CompassEventSegment::setFeatureSettings(const CFeatureExtractor::Settings& settings)
+{
+    m_extractor.setSettings(settings);
+}
+/**
+ * setOverloadControl
+ *    When the board's readout backs up, shed traces, then the hits of low
+ *    priority channels (DAQ_PARAM_CH_LOW_PRIORITY), then all but 1 in
+ *    N hits (see COverloadController) rather than let the board lose
+ *    triggers.  The tier and what's shed go out with the scalers.
+ *
+ * @param enable - true to shed under overload; off by default.
+ */
+void
+CompassEventSegment::setOverloadControl(bool enable)
+{
+    m_overload.setEnabled(enable);
+}
+/**
+ * setOverloadSettings
+ *    Tune the overload control.
+ *
+ * @param settings - tier thresholds, hysteresis, smoothing and prescale.
+ */
+void
+CompassEventSegment::setOverloadSettings(const COverloadController::Settings& settings)
+{
+    m_overload.setSettings(settings);
+}
+/**
+ * setTimeOffsets
+ *    Add our source id's offset from a timestamp offset table (see
+ *    CTimeOffsetTable, dpptimealign measures them) to our event timestamps.
+ *    The table is read at each initialize so it can be remeasured between
+ *    runs.  The hit records get it too, so they agree with the body
+ *    headers.  Block captures are left as the board gave them.
+ *
+ * @param filename - The table, nullptr or empty for no offset (the default).
+ */
+void
+CompassEventSegment::setTimeOffsets(const char* filename)
+{
+    m_offsetFile = filename ? filename : "";
+}
+/**
+ * setIncrementalSetup
+ *    When on, initialize() (e.g. on resume after a pause to tweak
+ *    thresholds) keeps the open board if only channel parameters changed
+ *    and has it reprogram just the channels that changed, skipping the
+ *    reset, calibration and buffer allocation.  Board level changes still
+ *    get a full setup.
+ *
+ * @param enable - true to reconfigure incrementally; off by default.
+ */
+void
+CompassEventSegment::setIncrementalSetup(bool enable)
+{
+    m_incremental = enable;
+}
+/**
+ * setRegisterCoalescing
+ *    Have the board compose its setup's register writes in memory and
+ *    write each register once (see CAENPha::setRegisterCoalescing).
+ *
+ * @param enable - true to coalesce; off by default.
+ */
+void
+CompassEventSegment::setRegisterCoalescing(bool enable)
+{
+    m_coalesce = enable;
+}
+/**
+ * setRegisterImage
+ *    Set the board up from a register image compiled from our Compass file
+ *    and cheat file by dppregcompile (see CRegisterImage):  a loop of
+ *    register writes instead of the library calls.  The image is read at
+ *    each initialize; if it's stale (the files or our fine timestamp
+ *    option changed since it was compiled) or lacks our board, the board
+ *    is set up from the files as usual.
+ *
+ * @param filename - The image, nullptr or empty for none (the default).
+ */
+void
+CompassEventSegment::setRegisterImage(const char* filename)
+{
+    m_imageFile = filename ? filename : "";
+}
+/*-------------------------------------------------------------------
+ * Private member functions.
+ */
 
 /**
- * computeEventSize
- *    Figure out how big the event is, in bytes, including a 32 bit event size.
+ * reconfigureBoard
+ *    Try to reconfigure the existing board driver incrementally.
  *
- *  @param dppInfo - reference to the CAEN_DGTZ_PHA_Event_t containing the event.
- *  @param wfInfo  - reference to the CAEN_DGTZ_PHA_Waveforms_t containing decoded waveforms.
- *  @return size_t - Number of bytes the event will require in the data stream.
+ * @param board - The board's new configuration.
+ * @return bool - false if it needs a full setup.
  */
-size_t
-CompassEventSegment::computeEventSize(
-    const CAEN_DGTZ_DPP_PHA_Event_t& dppInfo, const CAEN_DGTZ_DPP_PHA_Waveforms_t& wfInfo
-)
+bool
+CompassEventSegment::reconfigureBoard(CAENPhaParameters& board)
 {
-    size_t result = sizeof(uint32_t);               // Size of event
-    
-    // The dpp info is a time tag (uint64_t), E, extras, (16 bits )and
-    // extras2 (32 bits)):
-    
-    result += sizeof(uint64_t)   +                    // Time tag.
-              2*sizeof(uint16_t) +                    // E, Extras.
-              sizeof(uint32_t);                       // Extras2.
-              
-    // Waveform data size is a bit more complex.  See the putWfData
-    // method for considerations.
-    
-    result += sizeof(uint32_t) + sizeof(uint16_t);  // Ns, and dualtrace flag.
-    if (wfInfo.Ns) {
-        // If there are samples, there's always at least one trace of 16 bit words:
-        
-      size_t nBytes = wfInfo.Ns * sizeof(uint16_t);
-      result += nBytes;
-      
-      //  If dual trace there's a second one:
-      
-      if (wfInfo.DualTrace) {
-	result += nBytes;
-      }
+    setBoardOptions();
+    return m_board->reconfigure(board, false);
+}
+/**
+ * setBoardOptions
+ *    Pass our readout options on to the board driver.
+ */
+void
+CompassEventSegment::setBoardOptions()
+{
+    m_board->setAsyncReadout(m_nAsyncBlocks);
+    m_board->setInTreeDecode(m_inTreeDecode);
+    m_board->setTracePrescale(m_nTracePrescale);
+    m_board->setFineTimestamps(m_fineTime);
+    m_board->setOverloadController(&m_overload);
+    m_board->setDiagnostics(&m_diagnostics);
+    m_board->setRegisterCoalescing(m_coalesce);
+    m_board->setRegisterImage(m_useImage ? &m_image : nullptr);
+}
+/**
+ * readRegisterImage
+ *    Read the register image, if any, and check it's current.
+ *
+ * @return bool - true if the board can be set up from it.
+ * @throw std::string - the image can't be read or is corrupt.
+ */
+bool
+CompassEventSegment::readRegisterImage()
+{
+    m_image.clear();
+    if (m_imageFile.empty()) return false;
+
+    m_image.read(m_imageFile);
+    if (m_image.configHash() != CRegisterImage::hashFiles(m_filename, m_pCheatFile)) {
+        std::cerr << "\n" << m_imageFile << " was compiled from another version of "
+                  << m_filename << " or its cheat file, not using it\n";
+        return false;
     }
-    return result;
+    if (((m_image.flags() & CRegisterImage::FINE_TIMESTAMPS) != 0) != m_fineTime) {
+        std::cerr << "\n" << m_imageFile << " was compiled "
+                  << (m_fineTime ? "without" : "with") << " fine timestamps, not using it\n";
+        return false;
+    }
+    return true;
 }
 
 /**
- * putDppData
- *    Puts the DPP data into the event buffer.
- * @param pDest - where to put the DPP Data.
- * @param dpp   - Reference to the dpp data.
- * @return - pointer to the next free slot in the buffer.
+ * setupBoard
+ *    Setup the board:
+ *    - With incremental setup, if there's a Pha object let it reconfigure
+ *      itself if it can, otherwise:
+ *    - If there's a Pha object, delete it and set it's pointer to null.
+ *    - Create a new board object save it as m_pBoard.
+ *    - Invoke the board object's setup mode
+ *    The board is left for startAcquisition to start.
+ *    @param board - Reference to our board configuration object.
  */
-void*
-CompassEventSegment::putDppData(void* pDest, const CAEN_DGTZ_DPP_PHA_Event_t& dpp)
+void
+CompassEventSegment::setupBoard(CAENPhaParameters& board)
 {
-    pDest = putQuad(pDest, (dpp.TimeTag));
-    pDest = putWord(pDest, (dpp.Energy));
-    pDest = putWord(pDest, (dpp.Extras));
-    pDest = putLong(pDest, (dpp.Extras2));
+    if (!m_incremental || !m_board || !reconfigureBoard(board)) {
+        delete m_board;                // Get rid of any prior board driver.
+        m_board = nullptr;
+        m_board = new CAENPha(
+            board, m_linkType, m_nLinkNum,
+				    m_nNode, m_nBase,
+            board.s_startMode, true, 
+            board.startDelay,
+				    m_pCheatFile, m_pBackend
+        );
+        setBoardOptions();
+        m_board->setup(false);
+    }
+
+    m_filter.clearCuts();
+    for (size_t i = 0; i < board.m_channelParameters.size(); i++) {
+        m_filter.setCuts(
+            board.m_channelParameters[i].first,
+            board.m_channelParameters[i].second->readoutCuts
+        );
+    }
     
-    return pDest;
 }
+/**
+ * readBulk
+ *    Bulk mode read: pack every hit the board has buffered from its last
+ *    read into one event (see DppBulkFormat.h), as long as they fit.
+ *    Hits left over are packed into the next event.  The event is
+ *    timestamped with the first (earliest) hit.
+ *
+ * @param pBuffer  - Pointer to the buffer into which to put the data.
+ * @param maxwords - Largest event we can fit into the event buffer.
+ * @return size_t  - Number of words read.
+ */
+size_t
+CompassEventSegment::readBulk(void* pBuffer, size_t maxwords)
+{
+  size_t           maxBytes = maxwords*sizeof(uint16_t);
+  DppBulk::Header* pHeader  = static_cast<DppBulk::Header*>(pBuffer);
+  uint8_t*         p        = reinterpret_cast<uint8_t*>(pHeader + 1);
+  size_t           nBytes   = sizeof(DppBulk::Header);
+  uint32_t         nHits    = 0;
+  uint64_t         stamp    = 0;
+
+  while (m_board->dataBuffered()) {
+    // Drop hits before decoding their traces.  A kept hit that doesn't
+    // fit stays vetted for the next event so it isn't counted twice.
+
+    const CDppHitStore& hit(m_board->hits());
+    int chan = hit.channel();
+    if (!m_vetted && !acceptHit(chan, hit)) {
+      m_board->next();
+      continue;
+    }
+    m_vetted = true;
 
+    // Size the next hit before taking it so it's never lost for lack of room:
+
+    DppFragment::Traces wf       = traces(hit, *m_board->waveforms());
+    size_t              hitBytes = DppFragment::Pha::bytes(wf);
+    if ((nBytes + hitBytes) > maxBytes) {
+      if (!nHits) {
+        m_diagnostics.count(CDppDiagnostics::OVERSIZE_EVENTS, chan);
+        throw std::string("PHAEventSegment size exceeds maxwords - expand max event size");
+      }
+      break;
+    }
+
+    if (!nHits) stamp = hit.timestamp() + m_timeOffset;
+    writeHit(p, chan, hit, wf);
+    m_board->next();
+    m_vetted = false;
+    p      += hitBytes;
+    nBytes += hitBytes;
+    nHits++;
+  }
+  if (!nHits) {
+    m_diagnostics.count(CDppDiagnostics::REJECTED_READS);
+    reject();
+    return 0;
+  }
+  pHeader->s_marker   = DppBulk::MARKER;
+  pHeader->s_nBytes   = nBytes;
+  pHeader->s_firmware = DppBulk::PHA;
+  pHeader->s_unused   = 0;
+  pHeader->s_nHits    = nHits;
+
+  setSourceId(m_id);
+  setTimestamp(stamp);
+  return nBytes/sizeof(uint16_t);
+}
 /**
- * putWfData
- *    Put the waveform data to the output buffer.
- *    We put the following information:
- *    -   ns - number of samples (32 bits)
- *    -   dt - Non zero if ther are two traces (16 bits).
- *             note that we widen this in order to make alignment better.
- *    -   First trace if ns > 0 ns*16 bits.
- *    -   Second trace if ns > 0 && dual trace  ns * 16 bits.
+ * acceptHit
+ *    Book keep a hit's trigger/lost trigger counter flags and decide if it
+ *    should be kept.  Call it once per hit as it counts.
  *
- * @param pDest - pointer to where the data must go
- * @param wf    - Reference to CAEN_DGTZ_PHA_Waveforms_t - the decoded waveforms.
- * @return void* - Pointer to the next free memory of the buffer (where next data goes).
- */
-void*
-CompassEventSegment::putWfData(void* pDest, const CAEN_DGTZ_DPP_PHA_Waveforms_t& wf)
-{
-  pDest = putLong(pDest, wf.Ns);                            // # samples.
-  pDest = putWord(pDest, wf.DualTrace);
-    size_t nBytes = wf.Ns * sizeof(uint16_t);
-    if (nBytes > 0) {                                   // There are waveforms:
-      uint8_t* p = reinterpret_cast<uint8_t*>(pDest);
-        memcpy(p, wf.Trace1, nBytes);               // Write trace 1...
-        p +=  nBytes;
-        
-        if (wf.DualTrace) {                            // Write second trace too:
-            memcpy(p, wf.Trace2, nBytes);
-            p += nBytes;
+ * @param chan    - board channel the hit came from.
+ * @param hit     - the board's hit store, its cursor on the hit.
+ * @return bool   - false if the hit is the 'fake' event the board emits at
+ *                  timestamp rollovers, fails the channel's software
+ *                  cuts (see CHitFilter) or is shed under overload (see
+ *                  COverloadController) and should be dropped.
+ */
+bool
+CompassEventSegment::acceptHit(int chan, const CDppHitStore& hit)
+{
+  uint16_t extras = hit.extras();
+  // bit[6] of extras is the trg counter, bit[5] the lost_trg counter, we force N=128
+
+  m_rates.record(chan, hit.timestamp(), (extras & 64) != 0, (extras & 32) != 0);
+  if((extras == 10)||hit.timestamp()==0) //Fake event with TimeTag=0 and Extras[bit1] = Extras[bit3] =1 
+  {
+      m_diagnostics.report(
+          CDppDiagnostics::FAKE_EVENTS, chan,
+          "'Fake' timestamp rollover event found.. Disable bit 26 in 0x1n80"
+      );
+      return false;
+  }
+  return m_filter.acceptPha(chan, hit.energy()) &&
+      m_overload.accept(chan, m_filter.cuts(chan).s_lowPriority);
+}
+/**
+ * traces
+ *    Describe the waveforms, if any, a hit carries, with their features
+ *    and packed if setTraceFeatures/setTracePacking asked for that, and
+ *    its fine time if setFineTimestamps did.
+ *
+ * @param hit - the board's hit store, its cursor on the hit.
+ * @param wf  - The hit's decoded waveforms (Ns is 0 if it carries none).
+ * @return DppFragment::Traces - the traces to write with the hit.
+ */
+DppFragment::Traces
+CompassEventSegment::traces(const CDppHitStore& hit, const CAEN_DGTZ_DPP_PHA_Waveforms_t& wf)
+{
+    DppFragment::Traces result;
+    result.s_samples = wf.Ns;
+    result.s_dual    = wf.DualTrace;
+    result.s_probe   = 0;
+    result.s_trace1  = wf.Trace1;
+    result.s_trace2  = wf.Trace2;
+    result.s_packed  = nullptr;
+    result.s_packedBytes = 0;
+    result.s_features    = nullptr;
+    result.s_fineTime    = hit.fineTime();
+    result.s_picoseconds = hit.picoseconds();
+    if (m_extractFeatures && result.s_samples) {
+        m_extractor.extract(
+            m_features, reinterpret_cast<const uint16_t*>(wf.Trace1), result.s_samples
+        );
+        result.s_features = &m_features;
+        if (!m_keepTraces) {
+            result.s_samples = 0;
+            result.s_dual    = 0;
         }
-	pDest = p;
     }
-    return pDest;
+    if (m_packTraces && result.s_samples) {
+        size_t nBytes = DppFragment::maxPackedBytes(result);
+        if (m_packed.size() < nBytes) m_packed.resize(nBytes);
+        DppFragment::pack(result, m_packed.data());
+    }
+    return result;
+}
+/**
+ * writeHit
+ *    Write a hit's record (see DppFragmentFormat.h) to the buffer.
+ *
+ * @param pDest  - Where the record goes.
+ * @param chan   - board channel the hit came from.
+ * @param hit    - the board's hit store, its cursor on the hit.
+ * @param traces - the hit's traces.
+ * @return size_t - bytes written.
+ */
+size_t
+CompassEventSegment::writeHit(
+    void* pDest, int chan, const CDppHitStore& hit, const DppFragment::Traces& traces
+)
+{
+    DppFragment::PhaHit record;
+    record.s_channel   = 16*m_id + chan;
+    record.s_timestamp = hit.timestamp() + m_timeOffset;
+    record.s_energy    = hit.energy();
+    record.s_extras    = hit.extras();
+    record.s_extras2   = hit.extras2();
+    return DppFragment::Pha::write(pDest, record, traces);
 }
-
-
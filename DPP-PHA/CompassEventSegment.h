@@ -17,25 +17,44 @@
 #define COMPASSEVENTSEGMENT_H
 #include <CEventSegment.h>
 #include <string>
+#include <vector>
+#include <memory>
 #include <CAENDigitizerType.h>
-#include <chrono>
+#include "CTimeOrderedSource.h"
+#include "CTriggerRateMeter.h"
+#include "CHitFilter.h"
+#include "COverloadController.h"
+#include "CDppDiagnostics.h"
+#include "CTimeOffsetTable.h"
+#include "CFeatureExtractor.h"
+#include "CRegisterImage.h"
+#include "DppFragmentFormat.h"
+
+class CDigitizerBackend;
+class CDppHitStore;
 
 class CAENPha;
 class CAENPhaParameters;
+class CompassProject;
 
 /**
  * @class CompassEventSegment
  *    This event segment is much like the PHAEventSegment except that
  *    everything needed to initialize come from a COMPASS configuration
  *    XML file.  At each initialization, the configuration file is reprocessed
- *    in case there are changes and used to setup the digitizer.k
+ *    in case there are changes and used to setup the digitizer.  The parsed
+ *    file is shared with the other boards it configures (see
+ *    CompassProject::load).
  *
+ *    As a CTimeOrderedSource a compound segment can emit the hits of
+ *    several of these in timestamp order.
  */
-class CompassEventSegment : public  CEventSegment
+class CompassEventSegment : public  CEventSegment, public CTimeOrderedSource
 {
 private:
     std::string m_filename;
     CAENPha*    m_board;                    // Board level driver.
+    std::shared_ptr<CompassProject> m_project;  // m_board's configuration is in it.
     int         m_id;
 
     CAEN_DGTZ_ConnectionType m_linkType;
@@ -43,6 +62,30 @@ private:
     int                      m_nNode;
     uint32_t                 m_nBase;
     const char*              m_pCheatFile;
+    unsigned                 m_nAsyncBlocks;
+    bool                     m_inTreeDecode;   // Decode without GetDPPEvents.
+    CDigitizerBackend*       m_pBackend;
+    bool                     m_bulk;           // Pack all buffered hits into one event.
+    unsigned                 m_nTracePrescale; // Keep 1 in this many traces.
+    bool                     m_fineTime;       // Timestamps include the fine time.
+    bool                     m_packTraces;     // Write traces packed.
+    std::vector<uint8_t>     m_packed;         // The current hit's packed traces.
+    bool                     m_extractFeatures; // Write the features of traces.
+    bool                     m_keepTraces;     // ...and the traces too.
+    CFeatureExtractor        m_extractor;
+    DppFragment::Features    m_features;       // The current hit's.
+    CTriggerRateMeter        m_rates;          // From the trigger counter flags.
+    CHitFilter               m_filter;         // Software cuts from the configuration.
+    COverloadController      m_overload;       // Sheds data when we can't keep up.
+    bool                     m_vetted;         // acceptHit passed the hit at the cursor.
+    CDppDiagnostics          m_diagnostics;    // What went wrong, instead of std::cout.
+    std::string              m_offsetFile;     // CTimeOffsetTable read at initialize.
+    int64_t                  m_timeOffset;     // ns added to our event timestamps.
+    bool                     m_incremental;    // Reprogram only what changed when possible.
+    bool                     m_coalesce;       // Compose setup register writes.
+    std::string              m_imageFile;      // CRegisterImage read at initialize.
+    CRegisterImage           m_image;
+    bool                     m_useImage;       // m_image is current.
     
 public:
     CompassEventSegment(
@@ -60,28 +103,48 @@ public:
     virtual void disable();
     virtual size_t read(void* pBuffer, size_t maxwords);
     
-    /** Code from here down could be refactored into a base class
-     *  common to PHAEventSegment and  CompassEventSegment.
-     */
-    uint32_t           m_triggerCount[16];
-    uint32_t           m_missedTriggers[16];
-    double t[16];
-    double tmiss[16];
-
-    
     // Other publics:
     
-    bool checkTrigger();
+    void setup();
+    void startAcquisition();
+    bool isMaster() const;
+    
+    virtual bool checkTrigger();
+    virtual uint64_t nextTimestamp();
+    virtual uint64_t newestTimestamp();
+    void setAsyncReadout(unsigned nBlocks);
+    void setInTreeDecode(bool enable);
+    void setBackend(CDigitizerBackend* pBackend);
+    void setBulkReadout(bool enable);
+    void setTracePrescale(unsigned prescale);
+    void setFineTimestamps(bool enable);
+    void setTracePacking(bool enable);
+    void setTraceFeatures(bool enable, bool keepTraces = true);
+    void setFeatureSettings(const CFeatureExtractor::Settings& settings);
+    void setOverloadControl(bool enable);
+    void setOverloadSettings(const COverloadController::Settings& settings);
+    void setTimeOffsets(const char* filename);
+    void setIncrementalSetup(bool enable);
+    void setRegisterCoalescing(bool enable);
+    void setRegisterImage(const char* filename);
+    const CTriggerRateMeter& triggerRates() const { return m_rates; }
+    const CHitFilter&        hitFilter() const    { return m_filter; }
+    const COverloadController& overload() const   { return m_overload; }
+    const CDppDiagnostics&   diagnostics() const  { return m_diagnostics; }
+    int64_t                  timeOffset() const   { return m_timeOffset; }
 private:
-    size_t computeEventSize(const CAEN_DGTZ_DPP_PHA_Event_t& dppInfo, const CAEN_DGTZ_DPP_PHA_Waveforms_t& wfInfo);
+    size_t readBulk(void* pBuffer, size_t maxwords);
+    bool   acceptHit(int chan, const CDppHitStore& hit);
     void   setupBoard(CAENPhaParameters& board);
+    bool   reconfigureBoard(CAENPhaParameters& board);
+    void   setBoardOptions();
+    bool   readRegisterImage();
     // Buffer storage methods
     
-    void*  putWord(void* pDest, uint16_t data);
-    void*  putLong(void* pDest, uint32_t data);
-    void*  putQuad(void* pDest, uint64_t data);
-    void*  putDppData(void* pDest, const CAEN_DGTZ_DPP_PHA_Event_t& dpp);
-    void*  putWfData(void* pDest, const CAEN_DGTZ_DPP_PHA_Waveforms_t& wf);
+    DppFragment::Traces traces(const CDppHitStore& hit, const CAEN_DGTZ_DPP_PHA_Waveforms_t& wf);
+    size_t writeHit(
+        void* pDest, int chan, const CDppHitStore& hit, const DppFragment::Traces& traces
+    );
     
 };
 
@@ -15,12 +15,14 @@
 */
 #include "CompassMultiModuleEventSegment.h"
 #include "CompassEventSegment.h"
+#include "CBoardSetupPool.h"
+#include <iostream>
 
 /**
  *   Constructor -- just initialize m_nextRead (round robbin member).
  */
 CompassMultiModuleEventSegment::CompassMultiModuleEventSegment() :
-    m_nextRead(0)
+    m_nextRead(0), m_timeOrdered(false), m_setupThreads(0)
 {}
 
 /**
@@ -32,6 +34,44 @@ void
 CompassMultiModuleEventSegment::addModule(CompassEventSegment* p)
 {
     m_modules.push_back(p);
+    m_window.addSource(p);
+}
+/**
+ * setTimeOrdered
+ *    Choose between reading the modules round robin and reading the
+ *    oldest hit buffered by any module, held back until it's windowNs
+ *    older than the newest buffered hit (or maxHoldMs passes) while some
+ *    module has nothing buffered.  See CReorderWindow.  When this segment
+ *    is inside a time ordered COneOnlyEventSegment a 0 window is best.
+ *
+ * @param enable    - true to read in time order.
+ * @param windowNs  - Reorder window in ns.
+ * @param maxHoldMs - Longest a hit is held, ms.
+ */
+void
+CompassMultiModuleEventSegment::setTimeOrdered(bool enable, uint64_t windowNs, unsigned maxHoldMs)
+{
+    m_timeOrdered = enable;
+    m_window.setWindow(windowNs, maxHoldMs);
+}
+/**
+ * setParallelSetup
+ *    Choose between setting the modules up one after another, each
+ *    started as soon as it's set up, and setting up to nThreads of them up
+ *    at once, each on its own handle.  Once all are set up (and only if
+ *    all succeeded) the modules are started in order:  those armed to
+ *    start on a signal first, then the software started master(s).
+ *    Setup times are reported per module.  Modules daisy chained on one
+ *    link take turns with its accesses (see CCAENDigitizerBackend) while
+ *    their settling sleeps overlap.
+ *
+ * @param nThreads - Most modules set up at once; 0 or 1 (the default)
+ *                   sets them up one after another.
+ */
+void
+CompassMultiModuleEventSegment::setParallelSetup(unsigned nThreads)
+{
+    m_setupThreads = nThreads;
 }
 /**
  * initialize
@@ -40,9 +80,14 @@ CompassMultiModuleEventSegment::addModule(CompassEventSegment* p)
 void
 CompassMultiModuleEventSegment::initialize()
 {
-    for (int i =0; i < m_modules.size(); i++) {
-        m_modules[i]->initialize();
+    if (m_setupThreads > 1) {
+        setupParallel();
+    } else {
+        for (int i =0; i < m_modules.size(); i++) {
+            m_modules[i]->initialize();
+        }
     }
+    m_window.reset();
 }
 /**
  *  clear
@@ -79,6 +124,14 @@ CompassMultiModuleEventSegment::disable()
 size_t
 CompassMultiModuleEventSegment::read(void* pBuffer, size_t maxwords)
 {
+    if (m_timeOrdered) {
+        int i = m_window.select();
+        if (i < 0) {                   // Nothing buffered or holding the oldest.
+            reject();
+            return 0;
+        }
+        return m_modules[i]->read(pBuffer, maxwords);
+    }
     size_t nM = m_modules.size();
     for (int i =0; i < nM; i++) {
         size_t nRead = m_modules[m_nextRead]->read(pBuffer, maxwords);
@@ -87,3 +140,56 @@ CompassMultiModuleEventSegment::read(void* pBuffer, size_t maxwords)
     }
     return 0;          // Nobody had data after all.
 }
+/**
+ * checkTrigger
+ *    Used when we are a source of a time ordered COneOnlyEventSegment.
+ *    If we read round robin the modules are all asked afresh.
+ * @return bool - true if some module has data.
+ */
+bool
+CompassMultiModuleEventSegment::checkTrigger()
+{
+    if (!m_timeOrdered) m_window.reset();
+    return m_window.poll();
+}
+/**
+ * nextTimestamp
+ * @return uint64_t - the oldest timestamp buffered by the modules.
+ */
+uint64_t
+CompassMultiModuleEventSegment::nextTimestamp()
+{
+    return m_window.nextTimestamp();
+}
+/**
+ * newestTimestamp
+ * @return uint64_t - the newest timestamp buffered by the modules.
+ */
+uint64_t
+CompassMultiModuleEventSegment::newestTimestamp()
+{
+    return m_window.newestTimestamp();
+}
+/*-------------------------------------------------------------------
+ * Private member functions.
+ */
+
+/**
+ * setupParallel
+ *    Set the modules up on a CBoardSetupPool, then start them:  the
+ *    slaves are armed before the master starts them.
+ */
+void
+CompassMultiModuleEventSegment::setupParallel()
+{
+    CBoardSetupPool pool(m_setupThreads);
+    pool.run(m_modules.size(), [this](size_t i) { m_modules[i]->setup(); });
+    std::cout << "\n" << pool.report("PHA") << std::flush;
+
+    for (int i = 0; i < m_modules.size(); i++) {
+        if (!m_modules[i]->isMaster()) m_modules[i]->startAcquisition();
+    }
+    for (int i = 0; i < m_modules.size(); i++) {
+        if (m_modules[i]->isMaster()) m_modules[i]->startAcquisition();
+    }
+}
@@ -18,6 +18,8 @@
 #define COMPASSMULTIMODULESEGMENT_H
 #include <CEventSegment.h>
 #include <vector>
+#include "CTimeOrderedSource.h"
+#include "CReorderWindow.h"
 
 class CompassEventSegment;
 
@@ -25,12 +27,19 @@ class CompassEventSegment;
  *  @class CompassMultiModuleEventSegment
  *    - is to CompassEventSegment as PHAMultiModuleEventSegment is to
  *      PHAEventSegment.
+ *    - Modules are read round robin unless setTimeOrdered selects reading
+ *      the oldest buffered hit of all modules through a CReorderWindow.
+ *    - Modules are set up one after another unless setParallelSetup
+ *      selects setting them up at once (see CBoardSetupPool).
  */
-class CompassMultiModuleEventSegment : public CEventSegment
+class CompassMultiModuleEventSegment : public CEventSegment, public CTimeOrderedSource
 {
 private:
     std::vector<CompassEventSegment*> m_modules;
     unsigned                      m_nextRead;
+    bool                          m_timeOrdered;
+    CReorderWindow                m_window;
+    unsigned                      m_setupThreads;
 
 public:
   CompassMultiModuleEventSegment();
@@ -38,8 +47,15 @@ public:
     virtual void clear();
     virtual void disable();
     virtual size_t read(void* pBuffer, size_t maxwords);
+    virtual bool     checkTrigger();
+    virtual uint64_t nextTimestamp();
+    virtual uint64_t newestTimestamp();
 public:
   void addModule(CompassEventSegment* p);
+  void setTimeOrdered(bool enable, uint64_t windowNs = 0, unsigned maxHoldMs = 100);
+  void setParallelSetup(unsigned nThreads);
+private:
+  void setupParallel();
 };
 
 
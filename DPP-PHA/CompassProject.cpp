@@ -17,6 +17,7 @@
 #include "pugiutils.h"
 #include "CAENPhaChannelParameters.h"
 #include "CAENPhaParameters.h"
+#include "CConfigurationCache.h"
 
 #include <stdexcept>
 #include <iostream>
@@ -35,6 +36,28 @@ CompassProject::CompassProject(const char*name)
   // m_channelDefaults.inputRiseTime = .256;   // This seems compass's hard coded ussec value
    
 }
+/**
+ * load
+ *    Get the parsed project of a file from the process' configuration
+ *    cache, so a file is parsed once however many boards it configures
+ *    (and again only when it changes).  The boards share it and must not
+ *    modify it.
+ *
+ * @param file - name of the file.
+ * @return std::shared_ptr<CompassProject> - the parsed project.
+ */
+std::shared_ptr<CompassProject>
+CompassProject::load(const std::string& file)
+{
+    return CConfigurationCache<CompassProject>::instance().get(
+        file,
+        [](const std::string& name) {
+            std::shared_ptr<CompassProject> project(new CompassProject(name.c_str()));
+            (*project)();
+            return project;
+        }
+    );
+}
 /**
  destructor
 */
@@ -224,6 +247,8 @@ CompassProject::processChannelParams(
  *     - SRV_PARAM_CH_SATURATION_REJECTION_ENABLE - filter out saturated events.
  *     - SRV_PARAM_CH_PUR_ENABLE    - Enable pile up rejection.
  *     - SRV_PARAM_CH_ENERGY_FINE_GAIN - Fine gain for the channel
+ *     - DAQ_PARAM_CH_* - software cuts applied by the readout (not Compass),
+ *                        see processReadoutCut.
  *
  *   @param entry - <entry> tag node.
  *   @param params - Pointer to the channel parameters.
@@ -415,6 +440,12 @@ CompassProject::processChannelEntry(pugi::xml_node entry, CAENPhaChannelParamete
     else if(key=="SW_PARAMETER_CH_ENERGYCUTENABLE"){
 	;
     }
+    else if (processReadoutCut(key, entry, param->readoutCuts)) {
+	;
+    }
+    else if (processTracePolicy(key, entry, param->tracePolicy)) {
+	;
+    }
 
 
     else {
@@ -461,6 +492,7 @@ CompassProject::processBoardParameters(
   m_channelDefaults.baselineAdjust = 0;
   m_channelDefaults.digitalGain = 0;             // Gain code for 1 (decimation gain).
   m_channelDefaults.fineGain    = 1.0;           // Default fine gain.
+  m_channelDefaults.fakeevt_ttroll_en = false;   // Only some Compass versions have it.
   board.triggerSource= CAENPhaParameters::internal;
 
     // Load the connection parameters into connection.  Note that
@@ -902,6 +934,12 @@ CompassProject::processABoardParameter(pugi::xml_node param, CAENPhaParameters&
     else if(key=="SRV_PARAM_CH_TIME_OFFSET"){
 	;
     }
+    else if (processReadoutCut(key, param, m_channelDefaults.readoutCuts)) {
+	;                             // Default readout cuts.
+    }
+    else if (processTracePolicy(key, param, m_channelDefaults.tracePolicy)) {
+	;                             // Default trace policy.
+    }
 
 
 
@@ -914,6 +952,91 @@ CompassProject::processABoardParameter(pugi::xml_node param, CAENPhaParameters&
 
  
 }
+/**
+ * processReadoutCut
+ *    Process a key that sets the software cuts the readout applies to a
+ *    channel's hits (see CHitFilter).  These are not Compass parameters;
+ *    add them to the channel <values> or, as defaults, the board
+ *    <parameters>:
+ *
+ *    - DAQ_PARAM_CH_ENERGYCUT_ENABLE - bool, keep only energies in the window.
+ *    - DAQ_PARAM_CH_ENERGYCUT_LOW    - Lowest energy kept.
+ *    - DAQ_PARAM_CH_ENERGYCUT_HIGH   - Highest energy kept.
+ *    - DAQ_PARAM_CH_PUR_REJECT       - bool, drop hits flagged as piled up.
+ *    - DAQ_PARAM_CH_PSDCUT_ENABLE    - bool, (PSD only) keep only
+ *                                      (long - short)/long in the window.
+ *    - DAQ_PARAM_CH_PSDCUT_LOW, DAQ_PARAM_CH_PSDCUT_HIGH - That window.
+ *    - DAQ_PARAM_CH_LOW_PRIORITY     - bool, drop the channel's hits first
+ *                                      under overload (see COverloadController).
+ *
+ * @param key   - The parameter key.
+ * @param value - The node holding its value.
+ * @param cuts  - The cuts to modify.
+ * @return bool - false if key isn't a readout cut key.
+ */
+bool
+CompassProject::processReadoutCut(
+    const std::string& key, pugi::xml_node value, CHitFilter::Cuts& cuts
+)
+{
+    if (key == "DAQ_PARAM_CH_ENERGYCUT_ENABLE") {
+        cuts.s_energyCut = getBoolValue(value);
+    } else if (key == "DAQ_PARAM_CH_ENERGYCUT_LOW") {
+        cuts.s_energyLow = static_cast<uint32_t>(getDoubleValue(value));
+    } else if (key == "DAQ_PARAM_CH_ENERGYCUT_HIGH") {
+        cuts.s_energyHigh = static_cast<uint32_t>(getDoubleValue(value));
+    } else if (key == "DAQ_PARAM_CH_PUR_REJECT") {
+        cuts.s_rejectPileup = getBoolValue(value);
+    } else if (key == "DAQ_PARAM_CH_PSDCUT_ENABLE") {
+        cuts.s_psdCut = getBoolValue(value);
+    } else if (key == "DAQ_PARAM_CH_PSDCUT_LOW") {
+        cuts.s_psdLow = getDoubleValue(value);
+    } else if (key == "DAQ_PARAM_CH_PSDCUT_HIGH") {
+        cuts.s_psdHigh = getDoubleValue(value);
+    } else if (key == "DAQ_PARAM_CH_LOW_PRIORITY") {
+        cuts.s_lowPriority = getBoolValue(value);
+    } else {
+        return false;
+    }
+    return true;
+}
+/**
+ * processTracePolicy
+ *    Process a key that sets which of a channel's hits keep their traces
+ *    when the board takes waveforms (see CTracePolicy).  Like the readout
+ *    cuts these are ours, in the channel <values> or board <parameters>:
+ *
+ *    - DAQ_PARAM_CH_TRACE_PRESCALE      - Keep 1 in this many traces (0 none),
+ *                                         default the segment's prescale.
+ *    - DAQ_PARAM_CH_TRACE_ENERGY_ENABLE - bool, only hits in the energy window.
+ *    - DAQ_PARAM_CH_TRACE_ENERGY_LOW, DAQ_PARAM_CH_TRACE_ENERGY_HIGH - That window.
+ *    - DAQ_PARAM_CH_TRACE_PILEUP_ONLY   - bool, only hits flagged as piled up.
+ *
+ * @param key    - The parameter key.
+ * @param value  - The node holding its value.
+ * @param policy - The policy to modify.
+ * @return bool  - false if key isn't a trace policy key.
+ */
+bool
+CompassProject::processTracePolicy(
+    const std::string& key, pugi::xml_node value, CTracePolicy::Policy& policy
+)
+{
+    if (key == "DAQ_PARAM_CH_TRACE_PRESCALE") {
+        policy.s_prescale = static_cast<unsigned>(getDoubleValue(value));
+    } else if (key == "DAQ_PARAM_CH_TRACE_ENERGY_ENABLE") {
+        policy.s_energyWindow = getBoolValue(value);
+    } else if (key == "DAQ_PARAM_CH_TRACE_ENERGY_LOW") {
+        policy.s_energyLow = static_cast<uint32_t>(getDoubleValue(value));
+    } else if (key == "DAQ_PARAM_CH_TRACE_ENERGY_HIGH") {
+        policy.s_energyHigh = static_cast<uint32_t>(getDoubleValue(value));
+    } else if (key == "DAQ_PARAM_CH_TRACE_PILEUP_ONLY") {
+        policy.s_pileupOnly = getBoolValue(value);
+    } else {
+        return false;
+    }
+    return true;
+}
 
 /*--------------------------------------------------------------------------
  *  Data conversion convenience methods:
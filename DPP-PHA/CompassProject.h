@@ -20,6 +20,7 @@
 #include "pugiutils.h"
 #include <vector>
 #include <string>
+#include <memory>
 #include "CAENPhaParameters.h"
 #include "CAENPhaChannelParameters.h"
 #include <CAENDigitizerType.h>
@@ -47,6 +48,8 @@ public:
     virtual ~CompassProject();
     
     void operator()();                    // Parse the configuration.
+
+    static std::shared_ptr<CompassProject> load(const std::string& file);
     
 protected:
     std::vector<ChannelInfo> parseBoardChannelConfig(pugi::xml_node board);
@@ -58,6 +61,12 @@ protected:
         ConnectionParameters& connection
     );
     void processABoardParameter(pugi::xml_node entry, CAENPhaParameters& board);
+    bool processReadoutCut(
+        const std::string& key, pugi::xml_node value, CHitFilter::Cuts& cuts
+    );
+    bool processTracePolicy(
+        const std::string& key, pugi::xml_node value, CTracePolicy::Policy& policy
+    );
     int convertRccr2Smoothing(const std::string& code);
     unsigned convertBaselineMeanCode(const std::string& code);
     unsigned convertPeakMeanCode(const std::string& code);
@@ -15,6 +15,12 @@
 #include "CompassTrigger.h"
 #include "CompassEventSegment.h"
 
+/**
+ * constructor
+ */
+CompassTrigger::CompassTrigger() :
+    m_nNextModule(0)
+{}
 /**
  * addModule
  *    Adds a module to the trigger.
@@ -24,6 +30,39 @@ void
 CompassTrigger::addModule(CompassEventSegment* p)
 {
     m_modules.push_back(p);
+    m_scheduler.addBoard();
+}
+/**
+ * setMaxPollLatency
+ *    Let modules whose polls find no data back off, to at most this long
+ *    between polls (see CPollScheduler).
+ *
+ * @param us - Maximum time between polls of a module, 0 (the default)
+ *             polls every module every time.
+ */
+void
+CompassTrigger::setMaxPollLatency(unsigned us)
+{
+    m_scheduler.setMaxLatency(us);
+}
+/**
+ * pollStatistics
+ * @param module - index of the module in the order they were added.
+ * @return const CPollScheduler::Statistics& - how its polls went this run.
+ */
+const CPollScheduler::Statistics&
+CompassTrigger::pollStatistics(unsigned module) const
+{
+    return m_scheduler.statistics(module);
+}
+/**
+ * setup
+ *    Start of run - poll everything and start the statistics over.
+ */
+void
+CompassTrigger::setup()
+{
+    m_scheduler.reset();
 }
 /**
  * operator()
@@ -34,9 +73,13 @@ CompassTrigger::addModule(CompassEventSegment* p)
 bool
 CompassTrigger::operator()()
 {
+    CPollScheduler::Clock::time_point now = CPollScheduler::Clock::now();
     for (int i =0; i < m_modules.size(); i++) {
         next();
-        if (m_modules[m_nNextModule]->checkTrigger()) return true;
+        if (!m_scheduler.due(m_nNextModule, now)) continue;
+        bool found = m_modules[m_nNextModule]->checkTrigger();
+        m_scheduler.record(m_nNextModule, found, now);
+        if (found) return true;
     }
     return false;
 }
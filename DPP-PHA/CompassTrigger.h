@@ -17,22 +17,29 @@
 
 #include <CEventTrigger.h>
 #include <vector>
+#include "CPollScheduler.h"
 
 class CompassEventSegment;
 
 /**
  * @class CompassTrigger
  *    Checks for triggers in a collection of CompassEventSegment
- *    modules.
+ *    modules.  A CPollScheduler can make idle modules back off so the
+ *    busy ones are polled more often.
  */
 class CompassTrigger : public CEventTrigger
 {
 private:
     std::vector<CompassEventSegment*> m_modules;
     unsigned                          m_nNextModule;
+    CPollScheduler                    m_scheduler;
     void next();                    // module iteration.
 public:
+    CompassTrigger();
     void addModule(CompassEventSegment* module);
+    void setMaxPollLatency(unsigned us);
+    const CPollScheduler::Statistics& pollStatistics(unsigned module) const;
+    virtual void setup();
     virtual bool operator()();
     
 };
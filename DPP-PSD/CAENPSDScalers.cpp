@@ -28,26 +28,64 @@
  * constructor
  *   @param pEventSegment - the associated CompassEvent segment.
  *   @param srcid         - Source id set for scaler events. Defaults to 0.
+ *   @param filter        - Also report the hits its cuts accepted and dropped.
+ *   @param diagnostics   - Also report the segment's diagnostic counts.
  */
-CAENPSDScalers::CAENPSDScalers(CDPpPsdEventSegment* pEventSegment, int srcid) :
+CAENPSDScalers::CAENPSDScalers(
+    CDPpPsdEventSegment* pEventSegment, int srcid, bool filter, bool diagnostics
+) :
     m_pSegment(pEventSegment),
-    m_nSourceId(srcid)
+    m_nSourceId(srcid),
+    m_filter(filter),
+    m_diagnostics(diagnostics)
 {}
 /**
  * read
- *    Just grab the counters from the event segment.
+ *    Grab a snapshot of the trigger counters from the event segment.
  *    note these must be configured as non-incremental.  They are
- *    cumulative over the life of the run.
+ *    cumulative over the life of the run.  With overload control on
+ *    (see COverloadController) four more follow: the current tier, the
+ *    traces shed, the low priority hits shed and the hits prescaled away.
+ *    Then, if asked for, the board's totals of each of the diagnostic
+ *    counts (CDppDiagnostics::Counter order).  Last, if asked for, the
+ *    16 channels' hits accepted by the hit filter (CHitFilter) followed by
+ *    the 16 channels' hits it dropped.
  */
 std::vector<uint32_t>
 CAENPSDScalers::read()
 {
     std::vector<uint32_t> result;
+    CTriggerRateMeter::Snapshot counters;
+    m_pSegment->triggerRates().snapshot(counters);
     for (int i = 0; i < 16; i++) {
-        result.push_back(m_pSegment->m_triggerCount[i]);
+        result.push_back(counters.s_channels[i].s_counted);
     }
     for (int i =0; i < 16; i++) {
-        result.push_back(m_pSegment->m_missedTriggers[i]);
+        result.push_back(counters.s_channels[i].s_lost);
+    }
+    if (m_pSegment->overload().enabled()) {
+        COverloadController::Counters overload;
+        m_pSegment->overload().counters(overload);
+        result.push_back(overload.s_tier);
+        result.push_back(overload.s_tracesShed);
+        result.push_back(overload.s_lowPriorityShed);
+        result.push_back(overload.s_prescaled);
+    }
+    if (m_diagnostics) {
+        const CDppDiagnostics& diagnostics(m_pSegment->diagnostics());
+        for (int i = 0; i < CDppDiagnostics::COUNTERS; i++) {
+            result.push_back(diagnostics.total(static_cast<CDppDiagnostics::Counter>(i)));
+        }
+    }
+    if (m_filter) {
+        CHitFilter::Counters filtered[16];
+        for (int i = 0; i < 16; i++) {
+            m_pSegment->hitFilter().counters(i, filtered[i]);
+            result.push_back(filtered[i].s_accepted);
+        }
+        for (int i = 0; i < 16; i++) {
+            result.push_back(filtered[i].s_dropped);
+        }
     }
     
     return result;
@@ -43,8 +43,13 @@ class CAENPSDScalers : public CScaler
 private:
     CDPpPsdEventSegment*     m_pSegment;
     int                   m_nSourceId;
+    bool                  m_filter;         // Append the hit filter's counts.
+    bool                  m_diagnostics;    // Append the segment's diagnostic counts.
 public:
-    CAENPSDScalers(CDPpPsdEventSegment* pEventSegment, int srcid = 0);
+    CAENPSDScalers(
+        CDPpPsdEventSegment* pEventSegment, int srcid = 0, bool filter = false,
+        bool diagnostics = false
+    );
     virtual std::vector<uint32_t> read();
     virtual int sourceId() {return m_nSourceId;}
 };
@@ -23,6 +23,12 @@
 */
 #include "CCompoundTrigger.h"
 
+/**
+ * constructor
+ */
+CCompoundTrigger::CCompoundTrigger() :
+    m_nNext(0)
+{}
 /**
  * setup
  *   just iterate overa all objects setting them up
@@ -47,13 +53,20 @@ CCompoundTrigger::teardown()
 }
 /**
  * operator()
+ *    Check the triggers starting with the one after the one that last
+ *    fired.
  *    @return bool - true if any object has a trigger.
  */
 bool
 CCompoundTrigger::operator()()
 {
-    for (int i =0; i < m_triggers.size(); i++) {
-        if ((*m_triggers[i])()) return true;
+    unsigned n = m_triggers.size();
+    for (int i =0; i < n; i++) {
+        unsigned t = (m_nNext + i) % n;
+        if ((*m_triggers[t])()) {
+            m_nNext = (t + 1) % n;
+            return true;
+        }
     }
     return false;
 }
@@ -30,13 +30,16 @@
  * @class CCompoundTrigger
  *    Supports getting an event trigger from the logical or of several sources.
  *    For exmample, DPP-PSD and DPP-PHA modules or those modules in conjunction
- *    with some other trigger source.
+ *    with some other trigger source.  The triggers are checked round robin
+ *    so a busy one can't keep the others from being looked at.
  */
 class CCompoundTrigger : public CEventTrigger
 {
 private:
     std::vector<CEventTrigger*> m_triggers;
+    unsigned                    m_nNext;
 public:
+    CCompoundTrigger();
 
     virtual void setup();
     virtual void teardown();
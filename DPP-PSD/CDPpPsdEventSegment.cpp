@@ -22,6 +22,8 @@
 *
 */
 #include "CDPpPsdEventSegment.h"
+#include "CDppReadoutThread.h"
+#include "DppBulkFormat.h"
 #include <CAENDigitizer.h>
 #include <sstream>
 #include <iostream>
@@ -67,13 +69,14 @@ CDPpPsdEventSegment::CDPpPsdEventSegment(
     m_configFilename(configFile), m_pCurrentConfiguration(nullptr),
     m_linkType(linkType), m_linkNum(linkNum), m_nodeNumber(nodeNum),
     m_base(base), m_handle(-1), m_moduleName(""), m_serialNumber(-1),
-    m_nSourceId(sourceid), m_rawBuffer(nullptr), m_pWaveforms(nullptr), m_pCheatFile(pCheatFile)
+    m_nSourceId(sourceid), m_rawBuffer(nullptr), m_hits(true), m_pWaveforms(nullptr), m_pCheatFile(pCheatFile),
+    m_nAsyncBlocks(0), m_inTreeDecode(false), m_pReader(nullptr), m_readerStopped(false), m_readerFailures(0),
+    m_pBackend(CDigitizerBackend::getDefault()), m_bulk(false), m_tracePrescale(1),
+    m_vetted(false), m_packTraces(false), m_extractFeatures(false), m_keepTraces(true),
+    m_diagnostics("PSD source " + std::to_string(sourceid)), m_timeOffset(0),
+    m_incremental(false), m_open(false), m_programmed(false), m_coalesce(false),
+    m_useImage(false)
 {
-    for(int i =0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
-        m_dppBuffer[i] = nullptr;
-        m_nHits[i]     = 0;
-        m_nChannelIndices[i]= 0;
-    }
 
 
 }
@@ -84,12 +87,15 @@ CDPpPsdEventSegment::CDPpPsdEventSegment(
  */
 CDPpPsdEventSegment::~CDPpPsdEventSegment()
 {
+    delete m_pReader;
     delete m_pCurrentConfiguration;
     
-    // Free the acquisition buffers:
+    // Free the acquisition buffers while the board is still open:
     
     freeDAQBuffers();
-    
+    if (m_open) {
+        m_pBackend->closeDigitizer(m_handle);    // Kept open by incremental setup.
+    }
 }
 /**
  * initialize
@@ -103,11 +109,17 @@ CDPpPsdEventSegment::~CDPpPsdEventSegment()
 void
 CDPpPsdEventSegment::initialize()
 {
-    openModule();
-    getModuleInformation();
-    PSDParameters systemConfig;
-    systemConfig.parseConfigurationFile(m_configFilename.c_str());
-    m_pCurrentConfiguration = matchConfig(systemConfig);
+    // With incremental setup the board stays open between runs:
+    
+    if (!m_open) {
+        m_programmed = false;
+        openModule();
+        m_open = true;
+        getModuleInformation();
+    }
+    std::shared_ptr<PSDParameters> systemConfig = PSDParameters::load(m_configFilename);
+    std::unique_ptr<PSDBoardParameters> previous(m_pCurrentConfiguration);  // Any prior run's copy.
+    m_pCurrentConfiguration = matchConfig(*systemConfig);
     if (!m_pCurrentConfiguration) {
         std::stringstream strErrorMessage;
         strErrorMessage << "The " << m_moduleName << " Serial number: "
@@ -121,26 +133,44 @@ CDPpPsdEventSegment::initialize()
         throw strErrorMessage.str();
     }
     
-    setupBoard();
+    m_useImage      = readRegisterImage();
+    bool programmed = m_programmed;
+    m_programmed    = false;            // Until the board is setup.
+    if (m_incremental && programmed && previous && !m_useImage &&
+        previous->sameBoardSettings(*m_pCurrentConfiguration)) {
+        reconfigureBoard(*previous);
+    } else {
+        setupBoard();
+    }
+    m_programmed = true;
     
-    auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
-			std::chrono::system_clock::now().time_since_epoch()
-			).count();
+    m_rates.reset();                  // Trigger counters start at zero.
+    m_filter.resetCounters();
+    m_overload.reset();
+    m_diagnostics.reset();
+    m_vetted = false;
 
+    // Align our timestamps with the other boards':
 
-    for (int i=0; i<16; i++)
-    {
-	  m_triggerCount[i]=0;
-          m_missedTriggers[i]=0;
-          t[i] = now;
-          tmiss[i] = now;
+    m_timeOffset = 0;
+    if (!m_offsetFile.empty()) {
+        CTimeOffsetTable offsets;
+        offsets.read(m_offsetFile);
+        m_timeOffset = offsets.offset(m_nSourceId);
     }
+    for (int i = 0; i < 16; i++) {
+        m_filter.setCuts(i, m_pCurrentConfiguration->s_channelConfig[i].s_readoutCuts);
+        m_tracePolicy.setPolicy(
+            i, m_pCurrentConfiguration->s_channelConfig[i].s_tracePolicy, m_tracePrescale
+        );
+    }
+    m_tracePolicy.reset();
 
-
-    // 32 -64 bit timestamp adjustments:
+    // 32 -64 bit timestamp adjustments start over, anything buffered
+    // is from a prior run:
     
-    memset(m_timestampAdjust, 0, CAEN_DGTZ_MAX_CHANNEL*sizeof(uint64_t));
-    memset(m_lastTimestamps, 0, CAEN_DGTZ_MAX_CHANNEL*sizeof(uint32_t));
+    m_hits.setNsPerTick(m_nsPerTick);
+    m_hits.reset();
     
     // Let the external world do this in case we're compound.
 
@@ -162,12 +192,27 @@ size_t
 CDPpPsdEventSegment::read(void* pBuffer, size_t maxwords)
 {
     if (needBufferFill()) fillBuffer();
-    int chan = oldestChannel();
+    if (m_bulk) return readBulk(pBuffer, maxwords);
+    if (needBufferFill()) {             // Nothing to read after all.
+        m_diagnostics.count(CDppDiagnostics::REJECTED_READS);
+        reject();
+        return 0;
+    }
+    
+    int chan = m_hits.channel();
+    if (!acceptHit(chan)) {             // Dropped before its traces are decoded.
+        nextHit(chan);
+        reject();
+        return 0;
+    }
     size_t nBytes = sizeEvent(chan);
     if(nBytes > (maxwords*sizeof(uint16_t))) {
+        m_diagnostics.count(CDppDiagnostics::OVERSIZE_EVENTS, chan);
         throw std::string("Event is bigger than event size - increase event buffer size");
     }
-    return formatEvent(pBuffer, chan)/sizeof(uint16_t);
+    size_t nFormatted = formatEvent(pBuffer, chan);
+    nextHit(chan);
+    return nFormatted/sizeof(uint16_t);
 }
 
 /**
@@ -183,7 +228,7 @@ CDPpPsdEventSegment::checkTrigger()
     if (!needBufferFill()) return true;
    /* uint32_t statusRegister;
     throwIfBadStatus(
-        CAEN_DGTZ_ReadRegister(m_handle,CAEN_DGTZ_ACQ_STATUS_ADD , &statusRegister) ,
+        m_pBackend->readRegister(m_handle,CAEN_DGTZ_ACQ_STATUS_ADD , &statusRegister) ,
         "Unable to read status register to see if there are events"
     );
 
@@ -197,6 +242,26 @@ CDPpPsdEventSegment::checkTrigger()
   }
 
 }
+/**
+ * nextTimestamp
+ *    Only valid when checkTrigger says there's data.
+ * @return uint64_t - ns timestamp the next read's event will have.
+ */
+uint64_t
+CDPpPsdEventSegment::nextTimestamp()
+{
+    return m_hits.timestamp() + m_timeOffset;
+}
+/**
+ * newestTimestamp
+ *    Only valid when checkTrigger says there's data.
+ * @return uint64_t - ns timestamp of the latest hit buffered.
+ */
+uint64_t
+CDPpPsdEventSegment::newestTimestamp()
+{
+    return m_hits.newestTimestamp() + m_timeOffset;
+}
 /**
  * disable
  *    Just stops data acquisition in the module:
@@ -204,12 +269,227 @@ CDPpPsdEventSegment::checkTrigger()
 void
 CDPpPsdEventSegment::disable()
 {
+    // The reader thread must let go of the board before it's closed:
+    
+    delete m_pReader;
+    m_pReader = nullptr;
+    
     throwIfBadStatus(
-        CAEN_DGTZ_SWStopAcquisition(m_handle), "Failed to stop acquisition"
+        m_pBackend->swStopAcquisition(m_handle), "Failed to stop acquisition"
     );
-    // Since we setup all over again next run, close the digitizer here:
+    // Unless we only reprogram what changed, we setup all over again next
+    // run so close the digitizer here:
+
+    if (!m_incremental) {
+        m_open       = false;
+        m_programmed = false;
+        freeDAQBuffers();                     // Library event buffers need the handle.
+        throwIfBadStatus(m_pBackend->closeDigitizer(m_handle), "Failed to close the digitzer");
+    }
+}
 
-    throwIfBadStatus(CAEN_DGTZ_CloseDigitizer(m_handle), "Failed to close the digitzer");
+/**
+ * setAsyncReadout
+ *    Choose between block transfers in fillBuffer (in line with
+ *    formatting) or in a background CDppReadoutThread that keeps a ring of
+ *    transferred and decoded blocks ahead of read().
+ *    Takes effect at the next startAcquisition.
+ *
+ *  @param nBlocks - blocks in the reader's ring, 0 to read synchronously.
+ */
+void
+CDPpPsdEventSegment::setAsyncReadout(unsigned nBlocks)
+{
+    m_nAsyncBlocks = nBlocks;
+}
+/**
+ * setInTreeDecode
+ *    Choose between decoding readout buffers with CAEN_DGTZ_GetDPPEvents
+ *    (the default) and the in tree CDppAggregateParser.  The parser has
+ *    only been checked against CDppEventDecoder, not against the library
+ *    on real boards.  Takes effect the next time the board is opened.
+ *
+ *  @param enable - true to decode in tree.
+ */
+void
+CDPpPsdEventSegment::setInTreeDecode(bool enable)
+{
+    m_inTreeDecode = enable;
+}
+/**
+ * setBackend
+ *    Select the digitizer backend the board is accessed through
+ *    (e.g. a CSimulatedDigitizer).  Must be called before the first
+ *    initialize since the digitizer is opened through the backend.
+ *
+ *  @param pBackend - the backend, nullptr for CDigitizerBackend::getDefault().
+ */
+void
+CDPpPsdEventSegment::setBackend(CDigitizerBackend* pBackend)
+{
+    m_pBackend = pBackend ? pBackend : CDigitizerBackend::getDefault();
+}
+/**
+ * setBulkReadout
+ *    Choose between one event per hit and bulk events that pack all the
+ *    hits buffered from one block read (see DppBulkFormat.h).  Bulk events
+ *    cut the per event cost in the ring, event builder and event files at
+ *    high rates, but analysis must understand the bulk format.
+ *
+ *  @param enable - true for bulk events.
+ */
+void
+CDPpPsdEventSegment::setBulkReadout(bool enable)
+{
+    m_bulk = enable;
+}
+/**
+ * setTracePrescale
+ *    When waveforms are enabled keep them for only 1 in prescale hits of
+ *    each channel.  The other hits go out without a trace and their
+ *    waveforms are never decoded.  Channels whose configuration sets a
+ *    trace prescale (DAQ_PARAM_CH_TRACE_PRESCALE) use theirs instead.
+ *    Takes effect at the next initialize.
+ *
+ *  @param prescale - 1 (the default) keeps every trace, 0 keeps none.
+ */
+void
+CDPpPsdEventSegment::setTracePrescale(unsigned prescale)
+{
+    m_tracePrescale = prescale;
+}
+/**
+ * setFineTimestamps
+ *    Fold the fine time the board puts in each hit's extras word into the
+ *    hit timestamps.  The records keep the ps their ns timestamps leave
+ *    out (see DppFragmentFormat.h).  Off by default.
+ *
+ * @param enable - true to include the fine time.
+ */
+void
+CDPpPsdEventSegment::setFineTimestamps(bool enable)
+{
+    m_hits.setFineTime(enable);
+}
+/**
+ * setTracePacking
+ *    Write the traces of hits losslessly packed (see DppTraceCodec.h),
+ *    typically a third of their size.  The analyzers unpack them.
+ *
+ * @param enable - true to pack traces.
+ */
+void
+CDPpPsdEventSegment::setTracePacking(bool enable)
+{
+    m_packTraces = enable;
+}
+/**
+ * setTraceFeatures
+ *    Write the features of each hit's trace 1 (see CFeatureExtractor.h),
+ *    alongside its traces or instead of them.  Only hits whose traces are
+ *    kept (see the trace policies) get features.
+ *
+ * @param enable     - true to write features.
+ * @param keepTraces - false to leave the traces out.
+ */
+void
+CDPpPsdEventSegment::setTraceFeatures(bool enable, bool keepTraces)
+{
+    m_extractFeatures = enable;
+    m_keepTraces      = keepTraces;
+}
+/**
+ * setFeatureSettings
+ *    Tune the feature extraction.
+ *
+ * @param settings - baseline length, CFD fraction and delay, tail start.
+ */
+void
+CDPpPsdEventSegment::setFeatureSettings(const CFeatureExtractor::Settings& settings)
+{
+    m_extractor.setSettings(settings);
+}
+/**
+ * setOverloadControl
+ *    When the readout backs up, shed traces, then the hits of low priority
+ *    channels (DAQ_PARAM_CH_LOW_PRIORITY), then all but 1 in N hits (see
+ *    COverloadController) rather than let the board lose triggers.  The
+ *    tier and what's shed go out with the scalers.
+ *
+ * @param enable - true to shed under overload; off by default.
+ */
+void
+CDPpPsdEventSegment::setOverloadControl(bool enable)
+{
+    m_overload.setEnabled(enable);
+}
+/**
+ * setOverloadSettings
+ *    Tune the overload control.
+ *
+ * @param settings - tier thresholds, hysteresis, smoothing and prescale.
+ */
+void
+CDPpPsdEventSegment::setOverloadSettings(const COverloadController::Settings& settings)
+{
+    m_overload.setSettings(settings);
+}
+/**
+ * setTimeOffsets
+ *    Add our source id's offset from a timestamp offset table (see
+ *    CTimeOffsetTable) to our event timestamps.  The table is read at
+ *    each initialize.  The hit records get it too, so they agree with the
+ *    body headers.
+ *
+ * @param filename - The table, nullptr or empty for no offset (the default).
+ */
+void
+CDPpPsdEventSegment::setTimeOffsets(const char* filename)
+{
+    m_offsetFile = filename ? filename : "";
+}
+/**
+ * setIncrementalSetup
+ *    When on, disable() leaves the board open and the next initialize()
+ *    (e.g. on resume after a pause to tweak thresholds) reprograms just
+ *    the channels whose parameters changed, skipping the reset,
+ *    calibration and open.  Board level changes still get a full setup.
+ *
+ *  @param enable - true to reconfigure incrementally; off by default.
+ */
+void
+CDPpPsdEventSegment::setIncrementalSetup(bool enable)
+{
+    m_incremental = enable;
+}
+/**
+ * setRegisterCoalescing
+ *    Have setups compose their register writes in a CShadowRegisterFile
+ *    and write each register once, rather than a read and a write per
+ *    field.
+ *
+ *  @param enable - true to coalesce; off by default.
+ */
+void
+CDPpPsdEventSegment::setRegisterCoalescing(bool enable)
+{
+    m_coalesce = enable;
+}
+/**
+ * setRegisterImage
+ *    Set the board up from a register image compiled from our Compass file
+ *    and cheat file by dppregcompile (see CRegisterImage):  a loop of
+ *    register writes instead of the library calls.  The image is read at
+ *    each initialize; if it's stale (the files changed since it was
+ *    compiled) or lacks our board, the board is set up from the files as
+ *    usual.  startAcquisition still sets up the start and synchronization.
+ *
+ *  @param filename - The image, nullptr or empty for none (the default).
+ */
+void
+CDPpPsdEventSegment::setRegisterImage(const char* filename)
+{
+    m_imageFile = filename ? filename : "";
 }
 
 /**
@@ -280,7 +560,7 @@ CDPpPsdEventSegment::openModule()
         (m_linkType == PSDBoardParameters::usb) ?
             CAEN_DGTZ_USB : CAEN_DGTZ_OpticalLink;
     CAEN_DGTZ_ErrorCode status =
-        CAEN_DGTZ_OpenDigitizer(
+        m_pBackend->openDigitizer(
             linkType, m_linkNum, m_nodeNumber, m_base, &m_handle
         );
     throwIfBadStatus(status, "Unable to access the board");
@@ -296,7 +576,7 @@ void
 CDPpPsdEventSegment::getModuleInformation()
 {
     CAEN_DGTZ_BoardInfo_t info;
-    CAEN_DGTZ_ErrorCode stat = CAEN_DGTZ_GetInfo(m_handle, &info);
+    CAEN_DGTZ_ErrorCode stat = m_pBackend->getInfo(m_handle, &info);
     throwIfBadStatus(stat, "Unable to get board information");
 /*
     int lsb, msb, SN;
@@ -304,14 +584,14 @@ CDPpPsdEventSegment::getModuleInformation()
     uint32_t temp;
     
     throwIfBadStatus(
-            CAEN_DGTZ_ReadRegister(m_handle, 0xF084, &temp),
+            m_pBackend->readRegister(m_handle, 0xF084, &temp),
             "Reading a channel algorithm control register (LSB S/N)"
         );
 
     lsb = (0xFF & temp);
 
     throwIfBadStatus(
-            CAEN_DGTZ_ReadRegister(m_handle, 0xF080, &temp),
+            m_pBackend->readRegister(m_handle, 0xF080, &temp),
             "Reading a channel algorithm control register (MSB S/N)"
         );
     msb = (0xFF & temp)<<8;
@@ -341,20 +621,22 @@ CDPpPsdEventSegment::getModuleInformation()
  *   must, of course be valid.  The  final start of the
  *   board is done in startAcuisition.  This allows boards to be setup,
  *   then the slaves started and, finally  the master started.
+ *   The per channel parameters are programmed by setupChannels.
  */
 void
 CDPpPsdEventSegment::setupBoard()
 {
-    CAEN_DGTZ_ErrorCode status;
+    CAEN_DGTZ_ErrorCode  status;
+    CShadowRegisterScope shadow(m_pBackend, m_coalesce);
     
-    status = CAEN_DGTZ_Reset(m_handle);
+    status = m_pBackend->reset(m_handle);
     throwIfBadStatus(status, "Resetting the board");
     
     // Reset the board.  If the user wants to calibrate it then do so:
     
     if (m_pCurrentConfiguration->s_calibrateBeforeStart) {
         throwIfBadStatus(
-            CAEN_DGTZ_Calibrate(m_handle),
+            m_pBackend->calibrate(m_handle),
             "Calibrating board"
         );
     }
@@ -377,11 +659,111 @@ CDPpPsdEventSegment::setupBoard()
     }
     
     throwIfBadStatus(
-        CAEN_DGTZ_SetDPPAcquisitionMode(m_handle, acqMode, storeData),
+        m_pBackend->setDPPAcquisitionMode(m_handle, acqMode, storeData),
         "Setting DPP Acquisition mode."
     );
+    // With a register image the rest is in it.  The library still needs
+    // the record length to size the waveform buffers:
+    
+    const CRegisterImage::Board* pImage = m_useImage ? m_image.find(m_serialNumber) : nullptr;
+    if (m_useImage && !pImage) {
+        std::cerr << "\nPSD: board " << m_serialNumber
+                  << " is not in the register image, setting it up from the configuration";
+    }
+    if (pImage) {
+        uint32_t reclen = nsToSamples(m_pCurrentConfiguration->s_recordLength);
+        throwIfBadStatus(
+            m_pBackend->setRecordLength(m_handle, ((reclen + 7)/8) * 8),
+            "Setting up record length"
+        );
+        throwIfBadStatus(
+            CRegisterImage::apply(m_pBackend, m_handle, *pImage),
+            "Writing the register image"
+        );
+        std::cout << "\nPSD: Loaded " << pImage->s_writes.size()
+                  << " registers from the register image";
+        finishRegisters(shadow);
+        return;
+    }
     // Set per channel parameters:
     
+    setupChannels(0xffffffff);
+    
+    // Board configuration -- hard coded for now
+    // extras enabled, charge recording, timestamp recording, auto-flush enabled.
+
+    throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x8000, 0xe0115),
+		     "Unable to setup board status register");
+
+    
+
+    // I/O levels:
+    
+    CAEN_DGTZ_IOLevel_t lvl;
+    if (m_pCurrentConfiguration->s_ioLevel == PSDBoardParameters::nim) {
+        lvl = CAEN_DGTZ_IOLevel_NIM;
+    } else {
+        lvl = CAEN_DGTZ_IOLevel_TTL;
+    }
+
+    throwIfBadStatus(
+        m_pBackend->setIOLevel(m_handle, lvl),
+        "Setting front panel I/O levels"
+    );
+    // Trigger out signal:
+    //   Note this stuff was done by reverse engineering what 
+    //   CoMPASS did for each output mode...as the docs for the
+    //   registers that have to be set are not so clear about the final results.
+    
+    setOutputMode();
+    
+    // Set the enabled channels mask:
+    
+    uint32_t enabledChannels(0);
+    for (int i = 0; i < m_nChans; i++) {
+        if(m_pCurrentConfiguration->s_channelConfig[i].s_enabled) enabledChannels |= (1 << i);
+    }
+    throwIfBadStatus(
+        m_pBackend->setChannelEnableMask(m_handle, enabledChannels),
+        "Setting channel enables mask."
+    );
+    
+    // For now set the aggregate organization to 5 -- that's what it works out to in compass
+
+    throwIfBadStatus(
+       m_pBackend->writeRegister(m_handle, 0x800c, 5), 
+       "Unable to set buffer organization"
+    );
+    
+
+    /*Setup Onboard Coincidences*/
+    //std::cout << "\nCoinc mode " << m_pCurrentConfiguration->s_coincidenceMode << " " << PSDBoardParameters::ExtTrgGate;
+    switch(m_pCurrentConfiguration->s_coincidenceMode)
+	{
+		case PSDBoardParameters::ExtTrgGate: 
+		case PSDBoardParameters::ExtTrgVeto: uint32_t temp;
+						     throwIfBadStatus(m_pBackend->readRegister(m_handle, 0x811c, &temp), "Reading 0x811c");
+	  				     	     temp |= ((3<<10)); 
+						     throwIfBadStatus( m_pBackend->writeRegister(m_handle, 0x811c, temp),  "Unable to set 0x811c");
+						     break;
+		//case PSDBoardParameters::disabled: 
+		default:;
+	}
+
+   processCheatFile();
+   finishRegisters(shadow);
+}
+/**
+ * setupChannels
+ *   Program the per channel parameters of some of the channels from
+ *   m_pCurrentConfiguration.  setupBoard does all of them,
+ *   reconfigureBoard just those that changed.
+ *
+ *  @param channels - mask of the channels to program.
+ */
+void
+CDPpPsdEventSegment::setupChannels(uint32_t channels)
+{
     CAEN_DGTZ_DPP_PSD_Params_t dppParameters;
     memset(&dppParameters, 0, sizeof(dppParameters));
     uint32_t        enabledChannels(0);
@@ -392,11 +774,12 @@ CDPpPsdEventSegment::setupBoard()
     const uint32_t cfdFracMask      = 0x300;
     const uint32_t cfdMode          = (1 << 6);   // zero in this bit is led.
     for (int i =0; i < m_nChans; i++) {
+        if (!(channels & (1 << i))) continue;
         uint32_t chSelect = i << 8;
         
         uint32_t algoControl;
         throwIfBadStatus(
-            CAEN_DGTZ_ReadRegister(m_handle, DPP_ALGORITHM_CONTROL | chSelect, &algoControl),
+            m_pBackend->readRegister(m_handle, DPP_ALGORITHM_CONTROL | chSelect, &algoControl),
             "Reading a channel algorithm control register (setting polarity)"
         );
             if (m_pCurrentConfiguration->s_channelConfig[i].s_polarity == PSDChannelParameters::positive) {
@@ -407,7 +790,7 @@ CDPpPsdEventSegment::setupBoard()
 
 //	algoControl |= (1<<6); //Set bit 6 to high because compass is doing so too.
 	throwIfBadStatus(
-            CAEN_DGTZ_WriteRegister(m_handle, DPP_ALGORITHM_CONTROL | chSelect, algoControl),
+            m_pBackend->writeRegister(m_handle, DPP_ALGORITHM_CONTROL | chSelect, algoControl),
             "Writing a channel algorithm control register."
         );
 	
@@ -417,7 +800,7 @@ CDPpPsdEventSegment::setupBoard()
                 0 : 1;
 
         throwIfBadStatus(
-            CAEN_DGTZ_WriteRegister(m_handle, DPP_DYNRANGE | chSelect,ppRangeValue),
+            m_pBackend->writeRegister(m_handle, DPP_DYNRANGE | chSelect,ppRangeValue),
             "Setting a channel dynamic range"
         );
 
@@ -427,13 +810,13 @@ CDPpPsdEventSegment::setupBoard()
         
         uint32_t cfdSettings;
         throwIfBadStatus(
-            CAEN_DGTZ_ReadRegister(m_handle, CFD_SETTINGS | chSelect, &cfdSettings),
+            m_pBackend->readRegister(m_handle, CFD_SETTINGS | chSelect, &cfdSettings),
             "Reading the CFD Settings register set the CFD delay"
         );
         cfdSettings &= ~cfdDelayMask;
         cfdSettings |= cfdDelay(i);
         throwIfBadStatus(
-            CAEN_DGTZ_WriteRegister(m_handle, CFD_SETTINGS | chSelect, cfdSettings),
+            m_pBackend->writeRegister(m_handle, CFD_SETTINGS | chSelect, cfdSettings),
             "Writing the CFD Setings register to set the CFD"
         );
         
@@ -454,14 +837,14 @@ CDPpPsdEventSegment::setupBoard()
         
         uint32_t fractionValue = cfdFraction(i);
         throwIfBadStatus(
-            CAEN_DGTZ_ReadRegister(
+            m_pBackend->readRegister(
                 m_handle, CFD_SETTINGS | chSelect, &cfdSettings
             ), "Reading CFD settings (set fraction)"
         );
         cfdSettings &= ~cfdFracMask;
         cfdSettings |= fractionValue;
         throwIfBadStatus(
-            CAEN_DGTZ_WriteRegister(
+            m_pBackend->writeRegister(
                 m_handle, CFD_SETTINGS | chSelect, cfdSettings
             ), "Writing CFD Fraction value"
         );
@@ -474,15 +857,18 @@ CDPpPsdEventSegment::setupBoard()
         );
 	// This value seems to be the percentage of 0xffff *sigh*
 
+        // Inverted for positive signals.  Not in the configuration, which is
+        // compared with the next one by reconfigureBoard:
+
+        double dcOffset = m_pCurrentConfiguration->s_channelConfig[i].s_dcOffset;
         if (m_pCurrentConfiguration->s_channelConfig[i].s_polarity == PSDChannelParameters::positive) {
-		m_pCurrentConfiguration->s_channelConfig[i].s_dcOffset = 100.0 - m_pCurrentConfiguration->s_channelConfig[i].s_dcOffset;
+		dcOffset = 100.0 - dcOffset;
 	}
 
-	uint32_t dcOffsetValue = 
-            m_pCurrentConfiguration->s_channelConfig[i].s_dcOffset*65535.0/100.0;
+	uint32_t dcOffsetValue = dcOffset*65535.0/100.0;
 
         throwIfBadStatus(
-            CAEN_DGTZ_SetChannelDCOffset(m_handle, i, dcOffsetValue),
+            m_pBackend->setChannelDCOffset(m_handle, i, dcOffsetValue),
             "Setting channel DC Offset"
         );
         dppParameters.csens[i] = coarseGainToSensitivity(i);
@@ -492,7 +878,7 @@ CDPpPsdEventSegment::setupBoard()
         dppParameters.selft[i] = 1;
         dppParameters.purh = CAEN_DGTZ_DPP_PSD_PUR_DetectOnly;    // Not actually per channel.
         throwIfBadStatus(
-            CAEN_DGTZ_WriteRegister(
+            m_pBackend->writeRegister(
                 m_handle, PRE_TRIGGER | chSelect,
                 m_pCurrentConfiguration->s_channelConfig[i].s_preTrigger
             ), "Setting channel pre-trigger value"
@@ -503,15 +889,18 @@ CDPpPsdEventSegment::setupBoard()
     }
     // Program the dpp parameters...
     
-    throwIfBadStatus(
-        CAEN_DGTZ_SetDPPParameters(m_handle, enabledChannels, &dppParameters),
-        "Settging DPP Parameters"
-    );
+    if (enabledChannels & channels) {
+        throwIfBadStatus(
+            m_pBackend->setDPPParameters(m_handle, enabledChannels & channels, &dppParameters),
+            "Settging DPP Parameters"
+        );
+    }
     
     // There are a few items that are per channel that need 
     // register writes:
 
     for (int i =0; i < m_nChans; i++) {
+        if (!(channels & (1 << i))) continue;
         uint32_t chSelect = i << 8;
 
 	
@@ -519,7 +908,7 @@ CDPpPsdEventSegment::setupBoard()
         // Discriminator mode: Moved here from the loop before SetDPPParameters(), by B.Sudarsan.
         uint32_t algoControl;
         throwIfBadStatus(
-            CAEN_DGTZ_ReadRegister(
+            m_pBackend->readRegister(
                 m_handle, DPP_ALGORITHM_CONTROL | chSelect, &algoControl
             ), "Reading DPP Algorithm control (set Discriminator mode)"
         );
@@ -541,7 +930,7 @@ CDPpPsdEventSegment::setupBoard()
 	//std::cout << std::hex<< algoControl << '\n'<< std::dec;
 
         throwIfBadStatus(
-            CAEN_DGTZ_WriteRegister(
+            m_pBackend->writeRegister(
                 m_handle, DPP_ALGORITHM_CONTROL | chSelect, algoControl
             ), "Writing DPP Algorithm control (set Discriminator mode)"
         );
@@ -551,7 +940,7 @@ CDPpPsdEventSegment::setupBoard()
         
         uint32_t localTriggerManagement;
         throwIfBadStatus(
-            CAEN_DGTZ_ReadRegister(m_handle, DPP_LOCAL_TRIGGER_MANAGEMENT | chSelect, &localTriggerManagement),
+            m_pBackend->readRegister(m_handle, DPP_LOCAL_TRIGGER_MANAGEMENT | chSelect, &localTriggerManagement),
             "Reading local trigger management register (CFD Smoothing)"
         );
         
@@ -559,7 +948,7 @@ CDPpPsdEventSegment::setupBoard()
 	localTriggerManagement &= ~cfdSmoothMask;
 
         throwIfBadStatus(
-            CAEN_DGTZ_WriteRegister(
+            m_pBackend->writeRegister(
                 m_handle, DPP_LOCAL_TRIGGER_MANAGEMENT| chSelect, localTriggerManagement | cfdSmooth(i) | (1<<9)
             ),
             "Setting CFD SMoothing in local trigger management register."
@@ -572,7 +961,7 @@ CDPpPsdEventSegment::setupBoard()
         uint32_t fixedBaselineValue =
             m_pCurrentConfiguration->s_channelConfig[i].s_fixedBline;
         throwIfBadStatus(
-            CAEN_DGTZ_WriteRegister(
+            m_pBackend->writeRegister(
                 m_handle, DPP_FIXED_BASELINE | chSelect, fixedBaselineValue
             ), "Writing channel fixed baseline register value"
         );
@@ -586,7 +975,7 @@ CDPpPsdEventSegment::setupBoard()
 	PSDChannelParameters& params(m_pCurrentConfiguration->s_channelConfig[i]);
         uint32_t purGapValue = (uint32_t)(params.s_purGap);
         throwIfBadStatus(
-            CAEN_DGTZ_WriteRegister(m_handle, DPP_PURGAP | chSelect, purGapValue),
+            m_pBackend->writeRegister(m_handle, DPP_PURGAP | chSelect, purGapValue),
                 "Setting the pile up rejection gap"
         );
 	
@@ -603,14 +992,14 @@ CDPpPsdEventSegment::setupBoard()
 	  uint32_t reclenReg = reclen;
 	  reclenReg = ((reclenReg+7)/8) * 8;   // Round to nearest multiple of 8 (the +7).
 	  throwIfBadStatus(
-	    CAEN_DGTZ_SetRecordLength(m_handle, reclenReg, i),
+	    m_pBackend->setRecordLength(m_handle, reclenReg, i),
 	    "Setting up record length"
 	  );
 	}
 	// Can't seem to get 1n34 right without doing it myself:
 
 	throwIfBadStatus(
-	   CAEN_DGTZ_WriteRegister(
+	   m_pBackend->writeRegister(
               m_handle, 0x1034 | chSelect,
 	      static_cast<uint32_t>(m_pCurrentConfiguration->s_eventAggregation)
 	      ),
@@ -621,14 +1010,14 @@ CDPpPsdEventSegment::setupBoard()
 	
 	uint32_t preTrigSamples = nsToSamples(params.s_preTrigger);
 	throwIfBadStatus(
- 	    CAEN_DGTZ_SetDPPPreTriggerSize(m_handle, i, preTrigSamples),
+ 	    m_pBackend->setDPPPreTriggerSize(m_handle, i, preTrigSamples),
 	    "Unable to set per channel pre-trigger samples"
 	);
 	// per channel trigger threshold... seem to have to do this with register writes.
 	
 	uint32_t thresh = params.s_threshold;
 	throwIfBadStatus(
-	   CAEN_DGTZ_WriteRegister(m_handle, 0x1060 | chSelect, thresh),
+	   m_pBackend->writeRegister(m_handle, 0x1060 | chSelect, thresh),
 	   "Unable to set per channel trigger threshold (0x1n60)"
 	);
 
@@ -644,13 +1033,13 @@ CDPpPsdEventSegment::setupBoard()
 
 	if(m_nsPerTick==2)
 	throwIfBadStatus(
-	   CAEN_DGTZ_WriteRegister(m_handle, 0x1070 | chSelect, 0xc),
+	   m_pBackend->writeRegister(m_handle, 0x1070 | chSelect, 0xc),
 	   "Unable to set per channel shaped trigger width"
 	);
 
 	if(m_nsPerTick==4)
 	throwIfBadStatus(
-	   CAEN_DGTZ_WriteRegister(m_handle, 0x1070 | chSelect, 0x6),
+	   m_pBackend->writeRegister(m_handle, 0x1070 | chSelect, 0x6),
 	   "Unable to set per channel shaped trigger width"
 	);
 	
@@ -668,91 +1057,105 @@ CDPpPsdEventSegment::setupBoard()
 	}
 	uint32_t trghoReg = params.s_triggerHoldoff /trghoDivisor;
 	throwIfBadStatus(
-	   CAEN_DGTZ_WriteRegister(m_handle, 0x1074 | chSelect, trghoReg),
+	   m_pBackend->writeRegister(m_handle, 0x1074 | chSelect, trghoReg),
 "Unable to set the trigger hold off register value"
 	);
 
 /*	throwIfBadStatus(
-	    CAEN_DGTZ_WriteRegister(m_handle, DPP_ALGORITHM_CONTROL | chSelect, 0x330042),
+	    m_pBackend->writeRegister(m_handle, DPP_ALGORITHM_CONTROL | chSelect, 0x330042),
 	    "Writing a channel algorithm control register."
 	);
 */
 
 	uint32_t temp;
-        throwIfBadStatus(CAEN_DGTZ_ReadRegister(m_handle, DPP_LOCAL_TRIGGER_MANAGEMENT | chSelect, &temp),"Reading local trigger management register");
+        throwIfBadStatus(m_pBackend->readRegister(m_handle, DPP_LOCAL_TRIGGER_MANAGEMENT | chSelect, &temp),"Reading local trigger management register");
       	temp |= 0x10200;
 	if(m_pCurrentConfiguration->s_coincidenceMode == PSDBoardParameters::ExtTrgGate)
 		temp |= 0x50;
 	else if(m_pCurrentConfiguration->s_coincidenceMode == PSDBoardParameters::ExtTrgVeto)
 		temp |= 0x40050;
 
-	throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x1084 | chSelect, temp),"Writing a channel algorithm control 2 register.");
+	throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x1084 | chSelect, temp),"Writing a channel algorithm control 2 register.");
 	temp = 0;
 	temp = m_pCurrentConfiguration->s_coincidenceTriggerOut/(m_nsPerTick*4);
-	throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x1070 | chSelect, temp), "Writing shaped trigger width");
+	throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x1070 | chSelect, temp), "Writing shaped trigger width");
 
 	// End per channel settings.
     }
-    
-    // Board configuration -- hard coded for now
-    // extras enabled, charge recording, timestamp recording, auto-flush enabled.
-
-    throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x8000, 0xe0115),
-		     "Unable to setup board status register");
-
-    
-
-    // I/O levels:
-    
-    CAEN_DGTZ_IOLevel_t lvl;
-    if (m_pCurrentConfiguration->s_ioLevel == PSDBoardParameters::nim) {
-        lvl = CAEN_DGTZ_IOLevel_NIM;
-    } else {
-        lvl = CAEN_DGTZ_IOLevel_TTL;
+}
+/**
+ * reconfigureBoard
+ *   Reprogram a board that's still setup from the previous run with
+ *   only channel parameters changed:  no reset or calibration, just the
+ *   channels whose parameters differ, then the cheat file in case it
+ *   overrides any of them.  What the board buffered is then cleared.
+ *
+ *  @param previous - the configuration the board is setup with.
+ */
+void
+CDPpPsdEventSegment::reconfigureBoard(const PSDBoardParameters& previous)
+{
+    uint32_t changed  = 0;
+    unsigned nChanged = 0;
+    for (int i = 0; i < m_nChans; i++) {
+        if (!m_pCurrentConfiguration->s_channelConfig[i].sameRegisterSettings(
+                previous.s_channelConfig[i]
+            )) {
+            changed |= 1 << i;
+            nChanged++;
+        }
+    }
+    if (changed) {
+        CShadowRegisterScope shadow(m_pBackend, m_coalesce);
+        setupChannels(changed);
+        processCheatFile();
+        finishRegisters(shadow);
     }
+    std::cout << "\nPSD: Reprogrammed " << nChanged << " changed channel(s), no reset";
 
-    throwIfBadStatus(
-        CAEN_DGTZ_SetIOLevel(m_handle, lvl),
-        "Setting front panel I/O levels"
-    );
-    // Trigger out signal:
-    //   Note this stuff was done by reverse engineering what 
-    //   CoMPASS did for each output mode...as the docs for the
-    //   registers that have to be set are not so clear about the final results.
-    
-    setOutputMode();
+    // Hits left from the last run would look like a time tag rollover to
+    // the first of this one:
     
-    // Set the enabled channels mask:
-    
-    throwIfBadStatus(
-        CAEN_DGTZ_SetChannelEnableMask(m_handle, enabledChannels),
-        "Setting channel enables mask."
-    );
-    
-    // For now set the aggregate organization to 5 -- that's what it works out to in compass
-
-    throwIfBadStatus(
-       CAEN_DGTZ_WriteRegister(m_handle, 0x800c, 5), 
-       "Unable to set buffer organization"
-    );
-    
-
-    /*Setup Onboard Coincidences*/
-    //std::cout << "\nCoinc mode " << m_pCurrentConfiguration->s_coincidenceMode << " " << PSDBoardParameters::ExtTrgGate;
-    switch(m_pCurrentConfiguration->s_coincidenceMode)
-	{
-		case PSDBoardParameters::ExtTrgGate: 
-		case PSDBoardParameters::ExtTrgVeto: uint32_t temp;
-						     throwIfBadStatus(CAEN_DGTZ_ReadRegister(m_handle, 0x811c, &temp), "Reading 0x811c");
-	  				     	     temp |= ((3<<10)); 
-						     throwIfBadStatus( CAEN_DGTZ_WriteRegister(m_handle, 0x811c, temp),  "Unable to set 0x811c");
-						     break;
-		//case PSDBoardParameters::disabled: 
-		default:;
-	}
-
-   processCheatFile();
+    throwIfBadStatus(m_pBackend->clearData(m_handle), "Unable to clear the board's data");
+}
+/**
+ * readRegisterImage
+ *   Read the register image, if any, and check it's current.
+ *
+ *  @return bool - true if the board can be set up from it.
+ *  @throw std::string - the image can't be read or is corrupt.
+ */
+bool
+CDPpPsdEventSegment::readRegisterImage()
+{
+    m_image.clear();
+    if (m_imageFile.empty()) return false;
+    
+    m_image.read(m_imageFile);
+    if (m_image.configHash() != CRegisterImage::hashFiles(m_configFilename, m_pCheatFile)) {
+        std::cerr << "\n" << m_imageFile << " was compiled from another version of "
+                  << m_configFilename << " or its cheat file, not using it\n";
+        return false;
+    }
+    return true;
+}
+/**
+ * finishRegisters
+ *   Do the register writes a setup composed in its shadow, if it did,
+ *   and say how many accesses that saved.
+ *
+ *  @param shadow - The setup's shadow.
+ */
+void
+CDPpPsdEventSegment::finishRegisters(CShadowRegisterScope& shadow)
+{
+    if (!shadow.enabled()) return;
 
+    throwIfBadStatus(shadow.finish(), "Coalesced register writes failed");
+    const CShadowRegisterFile& registers(shadow.shadow());
+    std::cout << "\nPSD: " << registers.boardAccesses() << " register accesses for "
+              << registers.reads() + registers.writes() << " requested, "
+              << registers.saved() << " saved";
 }
 /**
  *  startAcquisition
@@ -772,7 +1175,7 @@ CDPpPsdEventSegment::startAcquisition()
     //std::cout << "\n Start Delay:" << delayValue;
 
     throwIfBadStatus(
-        CAEN_DGTZ_WriteRegister(m_handle, DPP_START_DELAY, delayValue),
+        m_pBackend->writeRegister(m_handle, DPP_START_DELAY, delayValue),
         "Setting the start delay"
     );
 
@@ -781,14 +1184,14 @@ CDPpPsdEventSegment::startAcquisition()
 	{
 	  uint32_t AcqControl;
 	     throwIfBadStatus(
-		    CAEN_DGTZ_ReadRegister(
+		    m_pBackend->readRegister(
 		        m_handle, 0x8100, &AcqControl
 		    ), "Reading Acq control (startmode)"
 		);
      	  AcqControl &= ~0x3; //Unset bits 0,1
      	  AcqControl |= 0x00; //Write them back in as 0b01
 
-	  throwIfBadStatus( CAEN_DGTZ_WriteRegister(m_handle, 0x8100, AcqControl),  "Unable to start acquisition(SW)"); //Arm acquisition
+	  throwIfBadStatus( m_pBackend->writeRegister(m_handle, 0x8100, AcqControl),  "Unable to start acquisition(SW)"); //Arm acquisition
 
 	}
 
@@ -796,45 +1199,58 @@ CDPpPsdEventSegment::startAcquisition()
 	{
 	  uint32_t AcqControl;
 	     throwIfBadStatus(
-		    CAEN_DGTZ_ReadRegister(
+		    m_pBackend->readRegister(
 		        m_handle, 0x8100, &AcqControl
 		    ), "Reading Acq control (startmode)"
 		);
      	  AcqControl &= ~0x3; //Unset bits 0,1
      	  AcqControl |= 0x1; //Write them back in as 0b01
 
-	  throwIfBadStatus( CAEN_DGTZ_WriteRegister(m_handle, 0x8100, AcqControl),  "Unable to start acquisition(S-IN)");
+	  throwIfBadStatus( m_pBackend->writeRegister(m_handle, 0x8100, AcqControl),  "Unable to start acquisition(S-IN)");
 	}
 
 	if(m_pCurrentConfiguration->s_startMode == PSDBoardParameters::firstTrigger)
 	{
 	  uint32_t AcqControl;
 	     throwIfBadStatus(
-		    CAEN_DGTZ_ReadRegister(
+		    m_pBackend->readRegister(
 		        m_handle, 0x8100, &AcqControl
 		    ), "Reading Acq control (startmode)"
 		);
      	  AcqControl &= ~0x3; //Unset bits 0,1
      	  AcqControl |= 0x2; //Write them back in as 0b10
 
-	  throwIfBadStatus( CAEN_DGTZ_WriteRegister(m_handle, 0x8100, AcqControl),  "Unable to start acquisition(FirstTrg)");
+	  throwIfBadStatus( m_pBackend->writeRegister(m_handle, 0x8100, AcqControl),  "Unable to start acquisition(FirstTrg)");
 
-	  throwIfBadStatus( CAEN_DGTZ_SetRunSynchronizationMode(m_handle, CAEN_DGTZ_RUN_SYNC_TrgOutTrgInDaisyChain), "Unable to start acquisition(FirstTrg)");
-	  //throwIfBadStatus( CAEN_DGTZ_SetRunSynchronizationMode(m_handle, CAEN_DGTZ_RUN_SYNC_Disabled), "Unable to start acquisition(FirstTrg)");
-	  throwIfBadStatus( CAEN_DGTZ_WriteRegister(m_handle, 0x8108, 1),  "Unable to start acquisition(SW)");
+	  throwIfBadStatus( m_pBackend->setRunSynchronizationMode(m_handle, CAEN_DGTZ_RUN_SYNC_TrgOutTrgInDaisyChain), "Unable to start acquisition(FirstTrg)");
+	  //throwIfBadStatus( m_pBackend->setRunSynchronizationMode(m_handle, CAEN_DGTZ_RUN_SYNC_Disabled), "Unable to start acquisition(FirstTrg)");
+	  throwIfBadStatus( m_pBackend->writeRegister(m_handle, 0x8108, 1),  "Unable to start acquisition(SW)");
 	}
 
-    throwIfBadStatus(CAEN_DGTZ_SWStartAcquisition(m_handle), "Unable to start acquisition");    
+    throwIfBadStatus(m_pBackend->swStartAcquisition(m_handle), "Unable to start acquisition");    
 
 /* throwIfBadStatus(
-       CAEN_DGTZ_WriteRegister(m_handle, 0x8100, 6), 
+       m_pBackend->writeRegister(m_handle, 0x8100, 6), 
        "Unable to arm acquisition"
     );*/
   
   /*Needs an additional software trigger if we have the first board with 'trgout-trgin-auto'*/
   if(m_pCurrentConfiguration->s_startMode == PSDBoardParameters::firstTrigger && m_pCurrentConfiguration->s_triggerOutputMode==PSDBoardParameters::softwareTrigger)
-          throwIfBadStatus( CAEN_DGTZ_WriteRegister(m_handle, 0x8108, 1),  "Unable to start acquisition(SW)"); //Start acquisition
+          throwIfBadStatus( m_pBackend->writeRegister(m_handle, 0x8108, 1),  "Unable to start acquisition(SW)"); //Start acquisition
 
+  // With the board started, the background reader can start transferring:
+  
+  delete m_pReader;
+  m_pReader = nullptr;
+  m_readerStopped  = false;
+  m_readerFailures = 0;
+  if (m_nAsyncBlocks) {
+      if (!m_rawBuffer) allocateBuffers();    // Our half of the exchange.
+      m_pReader = new CDppReadoutThread(
+          m_pBackend, m_handle, true, m_inTreeDecode, m_nAsyncBlocks
+      );
+      m_pReader->start();
+  }
 }
 
 /**
@@ -1086,7 +1502,7 @@ CDPpPsdEventSegment::setOutputMode()
 
     for (int i =0; i < 8; i++) {
       uint32_t offset = 4*i;
-      throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x8180+offset, 0),
+      throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x8180+offset, 0),
 		       "Unable t write the trigger validation mask.");
     }
 }
@@ -1094,8 +1510,7 @@ CDPpPsdEventSegment::setOutputMode()
  * needBufferFill
  *    We need a buffer fill if:
  *    - We don't have any raw, dpp or waveform buffers.
- *    - We have those buffers but our channel indices are all >= the number of hits
- *      in each channel.
+ *    - We have those buffers but the hit store has no unconsumed hits.
  * @return bool - true if we need to fill the buffers.
  */
 bool
@@ -1103,10 +1518,68 @@ CDPpPsdEventSegment::needBufferFill()
 {
     // We assume buffer allocation is all or nothing:
     if (!m_rawBuffer) return true;
-    for (int i = 0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
-        if (m_nChannelIndices[i] < m_nHits[i]) return false;
+    
+    return m_hits.empty();
+}
+/**
+ * readBulk
+ *    Format all buffered hits, oldest first, into one bulk event as long
+ *    as they fit in the buffer.  Those that don't go in the next event.
+ *    The event's timestamp is that of the first hit.
+ *
+ *  @param void* pBuffer - Where to put the event.
+ *  @param size_t maxwords - Maximum # uint16_t words available in pBuffer
+ *  @throw std::string - if even a single hit does not fit.
+ *  @return size_t number of 16 bit words read.
+ */
+size_t
+CDPpPsdEventSegment::readBulk(void* pBuffer, size_t maxwords)
+{
+    size_t           maxBytes = maxwords*sizeof(uint16_t);
+    DppBulk::Header* pHeader  = static_cast<DppBulk::Header*>(pBuffer);
+    uint8_t*         p        = reinterpret_cast<uint8_t*>(pHeader + 1);
+    size_t           nBytes   = sizeof(DppBulk::Header);
+    uint32_t         nHits    = 0;
+    uint64_t         stamp    = 0;
+    
+    while (!needBufferFill()) {
+        // A kept hit that doesn't fit stays vetted for the next event so
+        // it isn't counted twice:
+        
+        int chan = m_hits.channel();
+        if (!m_vetted && !acceptHit(chan)) {
+            nextHit(chan);
+            continue;
+        }
+        m_vetted = true;
+        if ((nBytes + sizeEvent(chan)) > maxBytes) {
+            if (!nHits) {
+                m_diagnostics.count(CDppDiagnostics::OVERSIZE_EVENTS, chan);
+                throw std::string("Event is bigger than event size - increase event buffer size");
+            }
+            break;
+        }
+        size_t nFormatted = formatEvent(p, chan);
+        nextHit(chan);
+        m_vetted = false;
+        if (!nHits) stamp = DppFragment::PsdView(p).timestamp();
+        p      += nFormatted;
+        nBytes += nFormatted;
+        nHits++;
     }
-    return true;
+    if (!nHits) {                          // Nothing buffered after all.
+        m_diagnostics.count(CDppDiagnostics::REJECTED_READS);
+        reject();
+        return 0;
+    }
+    pHeader->s_marker   = DppBulk::MARKER;
+    pHeader->s_nBytes   = nBytes;
+    pHeader->s_firmware = DppBulk::PSD;
+    pHeader->s_unused   = 0;
+    pHeader->s_nHits    = nHits;
+    
+    setTimestamp(stamp);                   // formatEvent stamped with the last hit.
+    return nBytes/sizeof(uint16_t);
 }
 /**
  * fillBuffer
@@ -1120,304 +1593,245 @@ CDPpPsdEventSegment::fillBuffer()
 {
     uint32_t readSize;
     if (!m_rawBuffer) allocateBuffers();
-    throwIfBadStatus(
-        CAEN_DGTZ_ReadData(
-                m_handle, CAEN_DGTZ_SLAVE_TERMINATED_READOUT_MBLT, m_rawBuffer,
-                &readSize
-        ),
-        "Unable to read raw data from the digitizer"
+    if (m_pReader) {
+        
+        // Swap our consumed buffers for the next block the reader
+        // transferred and parsed.  The blocks waiting for us are the load:
+        
+        m_overload.sample(m_pReader->backlog());
+        for (uint64_t n = m_pReader->decodeFailures(); m_readerFailures < n; m_readerFailures++) {
+            m_diagnostics.count(CDppDiagnostics::DECODE_FAILURES);
+        }
+        if (m_pReader->exchange(m_rawBuffer, m_hits)) {
+            countRollovers();
+        } else if (!m_readerStopped && (m_pReader->status() != CAEN_DGTZ_Success)) {
+            
+            // The reader quit on a failed read.  Say so once, not every poll:
+            
+            m_readerStopped = true;
+            m_diagnostics.report(
+                CDppDiagnostics::COMM_ERRORS, CDppDiagnostics::BOARD,
+                "Background reader stopped on a failed read.. it's likely all over"
+            );
+        }
+        return;
+    }
+    CAEN_DGTZ_ErrorCode status = m_pBackend->readData(
+        m_handle, CAEN_DGTZ_SLAVE_TERMINATED_READOUT_MBLT, m_rawBuffer, &readSize
     );
+    if (status != CAEN_DGTZ_Success) {
+        m_diagnostics.count(CDppDiagnostics::COMM_ERRORS);
+        throwIfBadStatus(status, "Unable to read raw data from the digitizer");
+    }
 //  if (status != CAEN_DGTZ_Success) return;   // Unable to buffer for some reason.
+    m_overload.sample(double(readSize)/m_rawBufferSize);
   if (readSize == 0) return;                    // Nothing to read.
 
-    throwIfBadStatus(
-        CAEN_DGTZ_GetDPPEvents(
-            m_handle, m_rawBuffer, readSize,
-            reinterpret_cast<void**>(m_dppBuffer), m_nHits
-        ), "Unable to get dpp events from the raw buffer"
-    );
-    // Reset the channel indices:
-    
-    memset(m_nChannelIndices, 0, CAEN_DGTZ_MAX_CHANNEL*sizeof(uint32_t));
-    
-    
-
+    status = m_hits.load(m_rawBuffer, readSize);
+    if (status != CAEN_DGTZ_Success) {
+        m_diagnostics.count(CDppDiagnostics::DECODE_FAILURES);
+        throwIfBadStatus(status, "Unable to get dpp events from the raw buffer");
+    }
+    countRollovers();
+}
+/**
+ * countRollovers
+ *    Publish each channel's time tag rollovers after a block is loaded.
+ */
+void
+CDPpPsdEventSegment::countRollovers()
+{
+    for (int i = 0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
+        m_diagnostics.set(CDppDiagnostics::ROLLOVERS, i, m_hits.rollovers(i));
+    }
 }
 /**
  * allocateBuffers
  *    Allocate the buffers for data acquisition.
  *    - Raw buffer.
- *    - DPP Events buffer.
  *    - Decoded waveform buffer.
+ *    - Unless decoding in tree, the GetDPPEvents event arrays of m_hits.
+ *    The hits decoded from the raw buffer are kept in m_hits.
  */
 void
 CDPpPsdEventSegment::allocateBuffers()
 {
 
     throwIfBadStatus(
-        CAEN_DGTZ_MallocReadoutBuffer(m_handle, &m_rawBuffer, &m_rawBufferSize),
+        m_pBackend->mallocReadoutBuffer(m_handle, &m_rawBuffer, &m_rawBufferSize),
         "Failed to allocated raw readout buffer"
     );
     throwIfBadStatus(
-        CAEN_DGTZ_MallocDPPEvents(
-            m_handle, reinterpret_cast<void**>(m_dppBuffer), &m_dppBufferSize
-        ), "Failed to allocated DPP Event matrix"
-    );
-    throwIfBadStatus(
-        CAEN_DGTZ_MallocDPPWaveforms(
+        m_pBackend->mallocDPPWaveforms(
             m_handle, reinterpret_cast<void**>(&m_pWaveforms), &m_wfBufferSize
         ), "Failed to allocate decoded waveform buffers."
     );
-   
+    m_pWaveforms->Ns = 0;                   // For hits that carry no trace.
+    throwIfBadStatus(
+        m_hits.useLibrary(m_inTreeDecode ? nullptr : m_pBackend, m_handle),
+        "Failed to allocate DPP event buffers."
+    );
 }
 /**
- * oldestChannel
- *    The assumption is that there are hits in at least one channel.
- *    For each channel with hits, figure out the adjusted timestamp.
- *    The adjusted timestamp is a 64 bit timestamp computed from the
- *    Raw hit timestamp and the number of times it's wrapped.
- *    We also detect wraps here using and, if necessary, updating
- *    m_lastTimestamps and m_timestampAdjust
+ * nextHit
+ *    Called after formatEvent has used the hit at the cursor of the hit
+ *    store.  Moves the cursor on to the next oldest hit.
  *
- *  @return uin32_t - the channel with the oldest timestamp.
- *  @throw std::logic_error - if there are no channels with data as that's supposed
- *                       to have been taken care of for us.
+ * @param chan - the channel of the hit just used.
  */
-uint
-CDPpPsdEventSegment::oldestChannel()
-{
-    uint32_t result = 0xffffffff;           // Illegal channel.
-    uint64_t smallest = 0xffffffffffffffff; // ALl timestamps will be smaller than this.
-    uint64_t adjustout = 0x0;
-    for (int i =0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
-        // Only look at channels with data left buffered:
-        
-        if (m_nChannelIndices[i] < m_nHits[i]) {
-            CAEN_DGTZ_DPP_PSD_Event_t* pHit = &(m_dppBuffer[i][m_nChannelIndices[i]]);
-            uint32_t rawTimestamp = pHit->TimeTag;
-            
-            uint64_t adjust = m_timestampAdjust[i];
-            
-            // Is there one more adjust:
-	    //std::cout << "\n--->" << std::hex<<     rawTimestamp  << "\t" <<  m_lastTimestamps[i] << std::dec << "\n";            
-//            if (rawTimestamp <= m_lastTimestamps[i]) adjust += UINT64_C(0x100000000);
-            if (rawTimestamp <= m_lastTimestamps[i]) adjust += UINT64_C(0x80000000); //why does this work? :(
-            
-            // Figure out the 64 bit timestamp:
-            
-            uint64_t adjustedTimestamp = adjust + rawTimestamp;
-            if (adjustedTimestamp < smallest) {
-                result = i;
-                smallest = adjustedTimestamp;
-            }
-        }
-    }
-    
-    if (result == 0xffffffff) {
-        throw std::logic_error("BUG- CDPpPsdEvent found no valid smallest timestamp!!");
-    }
-    // We need to commit the last timestamp and timestamp adjust for the  channel.
-    // We can retrieve this from the smallest timestamp:
-    
-    m_timestampAdjust[result] = smallest & 0xffffffff80000000;   // Top 32 bits. (33?)
-    m_lastTimestamps[result]  = smallest & 0x7fffffff;           // Bottom 32 bits. (31?)
+void
+CDPpPsdEventSegment::nextHit(int chan)
+{
+    m_tracePolicy.next(chan, m_hits.chargeLong(), m_hits.extras() != 0);
+    m_hits.next();
+}
+/**
+ * acceptHit
+ *    Book keep the trigger/lost trigger counter flags of the hit at the
+ *    hit store's cursor and decide if it passes the channel's software
+ *    cuts (see CHitFilter) and isn't shed under overload (see
+ *    COverloadController).  Call it once per hit as it counts.
+ *
+ * @param chan  - the channel of the hit.
+ * @return bool - false if the hit should be dropped.
+ */
+bool
+CDPpPsdEventSegment::acceptHit(int chan)
+{
+    // extras [15:12] are 0b(ABCD) with bit A = trigger lost, B=over range
+    // (set when a trigger is lost or over range in a single event),
+    // C = set each time 128 triggers are counted, D each time 128 triggers are lost.
 
-    //std::cout << "\n" << std::hex<<     m_timestampAdjust[result]  << "\t" <<  m_lastTimestamps[result] << std::dec << "\n";
+    uint32_t flags = (m_hits.extras2() & 0xf000) >> 12;
+    m_rates.record(chan, m_hits.timestamp(), (flags & 2) != 0, (flags & 1) != 0);
     
-    return result;
+    return m_filter.acceptPsd(
+        chan, m_hits.energy(), m_hits.chargeLong(), m_hits.extras() != 0
+    ) && m_overload.accept(chan, m_filter.cuts(chan).s_lowPriority);
 }
 /**
  * formatEvent
  *    Given a channel:
  *    - Format an event into the event buffer from that channel.
- *    - The resulting event will have the following format:
+ *    - The event is a PSD hit record, see DppFragmentFormat.h:
  *    |  32 bit total event size         |  (Self inclusive bytes).
  *    |  64 bit derived timestamp        |  (also tags the event, as does our source id).
  *    |  16 bit channel number           |
  *    |  32  bit short-gate charge value |
  *    |  32 bit long-gate charge value   |
- *    |  16 bit baseline                 |
- *    |  16 bit pileup rejection indicator |
- *    |  32 bit waveform length          | (0 if traces are not being sasved.)
+ *    |  32 bit extras                   |
+ *    |  32 bit waveform size            | (4 if traces are not being saved.)
  *    |  The waveform data if it was taken |
  *
  * @param pBuffer  - Pointer to the buffer describing where the data goes
- * @param chan     - channel from which the data comes.
+ * @param chan     - channel from which the data comes (that of the hit store's cursor).
  * @return size_t  - Size of the events in bytes (same as what's put in the first uint32_t).
- * @note the channels m_nChannelIndices value is incremented to consume the event.
+ * @note nextHit must be called to consume the event.
+ * @note sizeEvent must have been called for the hit as it decodes the waveforms.
  */
 size_t
 CDPpPsdEventSegment::formatEvent(void* pBuffer, int chan)
 {
-    // hold a pointer to the event size:
-    
-    uint32_t* pSize  = static_cast<uint32_t*>(pBuffer);
-    uint64_t* pStamp = reinterpret_cast<uint64_t*>(pSize + 1);
-    
-    // Get a pointer to the hit and fill in the adjusted timestamp value and all
+    // Fill in the adjusted timestamp value (already ns) and all
     // the simple stuff from the hit information.
     
-    CAEN_DGTZ_DPP_PSD_Event_t* pHit = &(m_dppBuffer[chan][m_nChannelIndices[chan]]);
-    m_nChannelIndices[chan]++;
-    uint64_t adjustedStamp = pHit->TimeTag;
-    adjustedStamp         += m_timestampAdjust[chan];
-    *pStamp++ = adjustedStamp*m_nsPerTick;
-    //std::cout << "\nTs:" << adjustedStamp*m_nsPerTick;
+    DppFragment::PsdHit hit;
+    hit.s_timestamp   = m_hits.timestamp() + m_timeOffset;
+    hit.s_channel     = chan;
+    hit.s_chargeShort = m_hits.energy();
+    hit.s_chargeLong  = m_hits.chargeLong();
+    hit.s_extras      = m_hits.extras2();
     
     // Set the timestamp and the source id.
     
-    setTimestamp(adjustedStamp*m_nsPerTick);
+    setTimestamp(hit.s_timestamp);
     setSourceId(m_nSourceId);
 
-    // CHannel number:
-
-    uint16_t* p16 = reinterpret_cast<uint16_t*>(pStamp);
-    *p16++ = chan;
-    //std::cout << " ch:" << chan;
-    
-    // now the charges:
-    
-    uint32_t* p32 = reinterpret_cast<uint32_t*>(p16);
-    *p32++  = pHit->ChargeShort;
-    *p32++  = pHit->ChargeLong;
-    //std::cout << " Elong:" << pHit->ChargeShort;
-//    std::cout << " Extras:" << pHit->Extras;
-     uint32_t temp = (pHit->Extras&0xf000)>>12;
-//     if(temp)
-	
-     /*temp has the structure: 0b(ABCD) with bit A = trigger lost, B=over range (set when a trigger is lost or over range in a single event)*/
-     /* C = set each time 128 triggers are counted, D is set each time 128 triggers are lost */
-     if(temp&2)//
-     {
-//	m_triggerCount[chan] += 128.;//./(double(clock() - t[chan]));
-//	t[chan] = clock();
-	auto now =    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-	m_triggerCount[chan] = static_cast<uint32_t>(128./((now-t[chan])*1.e-3));
-	t[chan] = now;
-        //std::cout << "\n Extras:" << pHit->Extras << " 1024s:" << temp << " ft:" << (pHit->Extras&0x1ff) << " xt:" << ((pHit->Extras&0xffff0000) >>16);
-     }
-     if(temp&1)//
-     {
-	auto now =    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-	m_missedTriggers[chan] = static_cast<uint32_t>(128./((now-tmiss[chan])*1.e-3));
-	tmiss[chan] = now;
-     }
-
-    // Now the baselines and the Pileup rejection flag:
-    *p32++ = pHit->Extras;
-    //std::cout << std::hex<< "\n Extras: 0x" << pHit->Extras << std::dec << " 1024s:" << temp << " ft:" << (pHit->Extras&0x1ff) << " xt:" << ((pHit->Extras&0xffff0000) >>16);
-    /* Old form here */
-    //p16 = reinterpret_cast<uint16_t*>(p32);
-    //*p16++ = pHit->Baseline;
-    //*p16++ = pHit->Pur;
-    
-    //p32    = reinterpret_cast<uint32_t*>(p16);
-    
     /* Now the waveforms:
        While the XML does not yet support dual traces,
        we write the code as if it does as well as handling
-       analog probes  The data we write is:
-       |  uint32_t size in bytes,                                     |
-       |   uint32_t num. samples                                      |
-       |   uint8_t nonzero if dual trace mode                        |
-       |   uint8_t nonzero if analog probe 1 is on idents the probe   |
-       |  Trace one - if num samples > 0  ns*uint16_t                |
-       |  Trace two - if dt,                                         //
-       
-       Note that if number of samples is zero, size in bytes is sizeof(uint32_t)
-       and no further data are included.
-       
-       Note: We assume that sizeEvent has already decoded the waveform as
-       that's necessary to determine the size of the event.
+       analog probes.  Note: We assume that sizeEvent has already decoded
+       the waveform as that's necessary to determine the size of the event.
    */
     
-    uint8_t* p8;
-    if (m_pWaveforms->Ns == 0) {
-        *p32++ = sizeof(uint32_t);             // NO traces to write.
-        p8     = reinterpret_cast<uint8_t*>(p32);  // end of event.
-    } else {
-        *p32++ = sizeTraces();
-        *p32++ = m_pWaveforms->Ns;
-         p8    = reinterpret_cast<uint8_t*>(p32);
-        *p8++  = m_pWaveforms->dualTrace;
-        *p8++  = m_pWaveforms->anlgProbe;
-        p16    = reinterpret_cast<uint16_t*>(p8);    // Traces go here:
-        memcpy(p16, m_pWaveforms->Trace1, m_pWaveforms->Ns*sizeof(uint16_t));
-        p16   += m_pWaveforms->Ns;
-        if(m_pWaveforms->dualTrace) {               // second trace
-            memcpy(p16, m_pWaveforms->Trace2, m_pWaveforms->Ns*sizeof(uint16_t));
-            p16 += m_pWaveforms->Ns;
-        }
-        p8 = reinterpret_cast<uint8_t*>(p16);      // end of event.
-    }
-    
-    // Figure out the event size and
-    // Set it in pSize and return it:
-    
-    uint32_t nBytes = (p8 - (reinterpret_cast<uint8_t*>(pBuffer)));
-    *pSize = nBytes;
-    
-    return static_cast<size_t>(nBytes);
-    
+    return DppFragment::Psd::write(pBuffer, hit, m_traces);
 }
 /**
- * sizeTraces
- *    Figure out how many bytes of trace data there are to write.
- *    We assume that m_pWaveforms has been decoded into by (e.g.) sizeEvent.
+ * traces
+ *    Describe the traces decoded by sizeEvent, with their features and
+ *    packed if setTraceFeatures/setTracePacking asked for that, and the
+ *    hit's fine time if setFineTimestamps did.
  *
- * @return uint32_t number of bytes of trace data, including the size uint32_t.
- * @note we also assume this is only called if, in fact, there are traces.
+ * @return DppFragment::Traces - the hit's traces (none if Ns is 0).
  */
-uint32_t
-CDPpPsdEventSegment::sizeTraces()
+DppFragment::Traces
+CDPpPsdEventSegment::traces()
 {
-    // There's a fixed header of a size, sample count, dual trace flag and
-    // analog probe selector:
-    
-    uint32_t result = 2*sizeof(uint32_t) + 2*sizeof(uint8_t);
-    
-    // The number of traces depends on the dual trace count.
-    // Each trace is number of samples * sizeof(uint16_t).
-    
-    int ntraces = 1;
-    if (m_pWaveforms->dualTrace) {
-        ntraces = 2;
+    DppFragment::Traces result;
+    result.s_samples = m_pWaveforms->Ns;
+    result.s_dual    = m_pWaveforms->dualTrace;
+    result.s_probe   = m_pWaveforms->anlgProbe;
+    result.s_trace1  = m_pWaveforms->Trace1;
+    result.s_trace2  = m_pWaveforms->Trace2;
+    result.s_packed  = nullptr;
+    result.s_packedBytes = 0;
+    result.s_features    = nullptr;
+    result.s_fineTime    = m_hits.fineTime();
+    result.s_picoseconds = m_hits.picoseconds();
+    if (m_extractFeatures && result.s_samples) {
+        m_extractor.extract(m_features, m_pWaveforms->Trace1, result.s_samples);
+        result.s_features = &m_features;
+        if (!m_keepTraces) {
+            result.s_samples = 0;
+            result.s_dual    = 0;
+        }
+    }
+    if (m_packTraces && result.s_samples) {
+        size_t nBytes = DppFragment::maxPackedBytes(result);
+        if (m_packed.size() < nBytes) m_packed.resize(nBytes);
+        DppFragment::pack(result, m_packed.data());
     }
-    result += ntraces*m_pWaveforms->Ns*sizeof(uint16_t);
     return result;
 }
 /**
  * sizeEvent
- *    Determines the size of an event.
+ *    Determines the size of the event for the hit at the hit store's cursor.
  * @param chan - the channel number.
  * @return size_t - number of bytes in the event.
  * @note to do this, the waveforms, if any, for the event will be decoded.
+ *       Hits that won't carry a trace (see wantTrace) are not decoded, nor
+ *       do hits whose trace can't be decoded carry one.
  */
 size_t
 CDPpPsdEventSegment::sizeEvent(int chan)
 {
-    throwIfBadStatus(
-        CAEN_DGTZ_DecodeDPPWaveforms(
-            m_handle,
-            &(m_dppBuffer[chan][m_nChannelIndices[chan]]),
-            m_pWaveforms
-        ), "Decoding hit waveforms"
-    );
-    
-    // The event consists of the fixed header and optional traces:
-    
-    size_t result = 3*sizeof(uint32_t) + sizeof(uint64_t) + 2*sizeof(uint16_t);
-    
-    // Now the waveforms:
-    
-    if (m_pWaveforms->Ns == 0) {
-        result += sizeof(uint32_t);             // Just the empty waveform size.
+    if (wantTrace(chan)) {
+        if (m_hits.decodeWaveforms(m_pWaveforms) != CAEN_DGTZ_Success) {
+            m_diagnostics.count(CDppDiagnostics::DECODE_FAILURES, chan);
+            m_pWaveforms->Ns = 0;               // Send the hit without its trace.
+        }
     } else {
-        result += sizeTraces();
+        m_pWaveforms->Ns = 0;
     }
-    
-    
-    return result;
+    m_traces = traces();
+    return DppFragment::Psd::bytes(m_traces);
+}
+/**
+ * wantTrace
+ *    Determines if the next hit of a channel will carry its trace.  That
+ *    needs waveforms enabled in the configuration (otherwise the board
+ *    takes none), the hit to be selected by the channel's trace policy
+ *    and traces not to be shed under overload.
+ *
+ * @param chan - the channel number.
+ * @return bool - true if the hit's waveforms must be decoded.
+ */
+bool
+CDPpPsdEventSegment::wantTrace(int chan)
+{
+    return m_pCurrentConfiguration->s_waveforms &&
+        m_tracePolicy.want(chan, m_hits.chargeLong(), m_hits.extras() != 0) &&
+        m_overload.keepTrace();
 }
 /**
  *  freeDAQBuffers
@@ -1428,15 +1842,13 @@ CDPpPsdEventSegment::sizeEvent(int chan)
 void
 CDPpPsdEventSegment::freeDAQBuffers()
 {
-    CAEN_DGTZ_FreeReadoutBuffer(&m_rawBuffer);
-    CAEN_DGTZ_FreeDPPEvents(m_handle, reinterpret_cast<void**>(m_dppBuffer));
-    CAEN_DGTZ_FreeDPPWaveforms(m_handle, reinterpret_cast<void*>(m_pWaveforms));
+    if (m_rawBuffer)  m_pBackend->freeReadoutBuffer(&m_rawBuffer);
+    if (m_pWaveforms) m_pBackend->freeDPPWaveforms(m_handle, reinterpret_cast<void*>(m_pWaveforms));
     
     m_pWaveforms = nullptr;
     m_rawBuffer = nullptr;
-    for (int i = 0; i < CAEN_DGTZ_MAX_CHANNEL; i++) {
-        m_dppBuffer[i] = nullptr;
-    }
+    m_hits.discard();                 // Its waveforms pointed into m_rawBuffer.
+    m_hits.useLibrary(nullptr, m_handle);
 }
 /**
  * setLVDSLevel0Trigger
@@ -1448,11 +1860,11 @@ CDPpPsdEventSegment::setLVDSLevel0Trigger()
 {
   // Set the FP LVDS I/O new features register and enable new features:
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x81a0, 0x1111),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x81a0, 0x1111),
 		   "Unable to set the LVDS I/O New features register");
 
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x811c, 0x8100),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x811c, 0x8100),
 		   "Unable to write FP I/O control register.");
 }
 /**
@@ -1465,11 +1877,11 @@ CDPpPsdEventSegment::setLVDSLevel1Trigger()
 {
   // Set the FP LVDS I/O new features register and enable new features:
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x81a0, 0x1111),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x81a0, 0x1111),
 		   "Unable to set the LVDS I/O New features register");
 
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x811c, 0xc100),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x811c, 0xc100),
 		   "Unable to write FP I/O control register.");
 }
 /**
@@ -1481,21 +1893,21 @@ CDPpPsdEventSegment::setLVDSSwTrigger()
 {
   // Enable software trigger:
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x8110, 0x8000ffff),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x8110, 0x8000ffff),
 		   "Unable to enable sw trigger in mask register");
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x810c, 0x8000ffff),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x810c, 0x8000ffff),
 		   "Unable to enable sw trigger in mask register");
 
   // Enable new LVDS Features:
   int temp = (m_pCurrentConfiguration->s_ioLevel==PSDBoardParameters::nim)? 0 : 1 ;
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x811c, 0x0100+temp),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x811c, 0x0100+temp),
 		   "Unable to enable new lvds featurs in FP IO control register"
 		   );
   // Set the lVDS to reflect triggers:
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x81a0, 0x1111), 
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x81a0, 0x1111), 
 		   "Unable to set LVDS output");
 }
 /**
@@ -1507,16 +1919,16 @@ CDPpPsdEventSegment::setLVDSExternalTrigger()
 {
   // Enable software trigger:
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x8110, 0x40000000),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x8110, 0x40000000),
 		   "Unable to enable sw trigger in mask register");
   // Enable new LVDS Features:
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x811c, 0x100),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x811c, 0x100),
 		   "Unable to enable new lvds featurs in FP IO control register"
 		   );
   // Set the lVDS to reflect triggers:
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x81a0, 0x1111), 
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x81a0, 0x1111), 
 		   "Unable to set LVDS output");
 }
 /**
@@ -1530,25 +1942,25 @@ CDPpPsdEventSegment::setLVDSGlobalOrTrigger()
   // Set the channel couples to or mode:
 
   for (int i = 0; i < m_nChans; i++) {
-    throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x1084 | (i << 8), 0x10207),
+    throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x1084 | (i << 8), 0x10207),
 		     "Could not set the per channel DPPAlgorithm control 2 register");
   }
 
   //Disable local shaped trigger
 //  for (int i = 0; i < m_nChans; i++) {
-//    throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x1084 | (i << 8), 0x200),
+//    throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x1084 | (i << 8), 0x200),
 //		     "Could not set the per channel DPPAlgorithm control 2 register");
 //  }
 
   //  Enable the couples to participate
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x8110, 0xff),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x8110, 0xff),
 		   "Could not set the FP-GPO Trigger enable mask register");
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x811c, 0x100),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x811c, 0x100),
 		   "Could not write the FP-IO control register");
  // Set the lVDS to reflect triggers:
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x81a0, 0x1111), 
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x81a0, 0x1111), 
 		   "Unable to set LVDS output");
 }
 /**
@@ -1560,17 +1972,17 @@ CDPpPsdEventSegment::setLVDSRun()
 {
   // set the global trigger mask:triggers -> FPIO.
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x8110, 0x80000000),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x8110, 0x80000000),
 		   "Failed to write the global trigger mask");
 
   // Enable new features; trgout reflects run state
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x811c, 0x10100),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x811c, 0x10100),
 		   "Failed to write the FP I/O COntrol register");
 
  // Set the lVDS to reflect triggers:
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x81a0, 0x1111), 
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x81a0, 0x1111), 
 		   "Unable to set LVDS output");
 }
 /**
@@ -1582,17 +1994,17 @@ CDPpPsdEventSegment::setLVDSDelayedRun()
 {
    // set the global trigger mask:triggers -> FPIO.
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x8110, 0x80000000),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x8110, 0x80000000),
 		   "Failed to write the global trigger mask");
 
   // Enable new features; trgout reflects delayed run state
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x811c, 0x110100),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x811c, 0x110100),
 		   "Failed to write the FP I/O COntrol register");
 
  // Set the lVDS to reflect triggers:
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x81a0, 0x1111), 
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x81a0, 0x1111), 
 		   "Unable to set LVDS output");
 }
 /**
@@ -1604,17 +2016,17 @@ CDPpPsdEventSegment::setLVDSSampleClock()
 {
    // set the global trigger mask:triggers -> FPIO.
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x8110, 0x80000000),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x8110, 0x80000000),
 		   "Failed to write the global trigger mask");
 
   // Enable new features; trgout reflects Sample Clock
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x811c, 0x50100),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x811c, 0x50100),
 		   "Failed to write the FP I/O COntrol register");
 
  // Set the lVDS to reflect triggers:
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x81a0, 0x1111), 
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x81a0, 0x1111), 
 		   "Unable to set LVDS output");
 }
 
@@ -1628,19 +2040,19 @@ CDPpPsdEventSegment::setLVDSPLLClock()
 {
    // set the global trigger mask:triggers -> FPIO.
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x8110, 0x80000000),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x8110, 0x80000000),
 		   "Failed to write the global trigger mask");
 
   // Enable new features; trgout reflects Motherboard virtual probe
   // and set that probe to the CLK Phase (presumably the PLL Recovered 
   // clock?
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x811c, 0x90100),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x811c, 0x90100),
 		   "Failed to write the FP I/O COntrol register");
 
  // Set the lVDS to reflect triggers:
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x81a0, 0x1111), 
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x81a0, 0x1111), 
 		   "Unable to set LVDS output");
 }
 /**
@@ -1655,19 +2067,19 @@ CDPpPsdEventSegment::setLVDSBusy()
 {
    // set the global trigger mask:triggers -> FPIO.
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x8110, 0x80000000),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x8110, 0x80000000),
 		   "Failed to write the global trigger mask");
 
   // Enable new features; trgout reflects Motherboard virtual probe
   // and set that probe to the Busy/Unlock but not setting bit
   // 20 (PLL Lock lost).
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x811c, 0xd0100),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x811c, 0xd0100),
 		   "Failed to write the FP I/O COntrol register");
 
  // Set the lVDS to reflect triggers:
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x81a0, 0x1111), 
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x81a0, 0x1111), 
 		   "Unable to set LVDS output");
 }
 /**
@@ -1682,19 +2094,19 @@ CDPpPsdEventSegment::setLVDSPLLLockLost()
 {
    // set the global trigger mask:triggers -> FPIO.
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x8110, 0x80000000),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x8110, 0x80000000),
 		   "Failed to write the global trigger mask");
 
   // Enable new features; trgout reflects Motherboard virtual probe
   // and set that probe to the Busy/Unlock but not setting bit
   // 20 (PLL Lock lost).
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x811c, 0x1d0100),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x811c, 0x1d0100),
 		   "Failed to write the FP I/O COntrol register");
 
  // Set the lVDS to reflect triggers:
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x81a0, 0x1111), 
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x81a0, 0x1111), 
 		   "Unable to set LVDS output");
 }
 /**
@@ -1706,17 +2118,17 @@ CDPpPsdEventSegment::setLVDSVirtualProbe()
 {
    // set the global trigger mask:triggers -> FPIO.
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x8110, 0x80000000),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x8110, 0x80000000),
 		   "Failed to write the global trigger mask");
 
   //   Select the channel virtual probes.
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x811c, 0x20100),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x811c, 0x20100),
 		   "Failed to write the FP I/O COntrol register");
 
  // Set the lVDS to reflect triggers:
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x81a0, 0x1111), 
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x81a0, 0x1111), 
 		   "Unable to set LVDS output");
 }
 /**
@@ -1728,18 +2140,18 @@ void
 CDPpPsdEventSegment::setLVDSSIN()
 {   // set the global trigger mask:triggers -> FPIO.
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x8110, 0x80000000),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x8110, 0x80000000),
 		   "Failed to write the global trigger mask");
 
   // Enable new features; trgout reflects SIN
 
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x811c, 0x30100),
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x811c, 0x30100),
 		   "Failed to write the FP I/O COntrol register");
 
  // Set the lVDS to reflect triggers:
 
-  throwIfBadStatus(CAEN_DGTZ_WriteRegister(m_handle, 0x81a0, 0x1111), 
+  throwIfBadStatus(m_pBackend->writeRegister(m_handle, 0x81a0, 0x1111), 
 		   "Unable to set LVDS output");
 
 }
@@ -1819,23 +2231,23 @@ void CDPpPsdEventSegment::processCheatFile()
             break;
           case '.':                                   // set:
             {
-              CAEN_DGTZ_WriteRegister(m_handle, addr, value);
+              m_pBackend->writeRegister(m_handle, addr, value);
             }
             break;
           case '|':                                 // bitwise or.
             {
               uint32_t currentValue;
-              CAEN_DGTZ_ReadRegister(m_handle, addr, &currentValue);
+              m_pBackend->readRegister(m_handle, addr, &currentValue);
               value |= currentValue;
-              CAEN_DGTZ_WriteRegister(m_handle, addr, value);
+              m_pBackend->writeRegister(m_handle, addr, value);
             }
             break;
           case '*':                               // bitwise and.
             {
               uint32_t currentValue;
-              CAEN_DGTZ_ReadRegister(m_handle, addr, &currentValue);
+              m_pBackend->readRegister(m_handle, addr, &currentValue);
               value &= currentValue;
-              CAEN_DGTZ_WriteRegister(m_handle, addr, value);
+              m_pBackend->writeRegister(m_handle, addr, value);
             }
             break;
           default:                               // unrecognized operation.
@@ -27,8 +27,23 @@
 #include <CEventSegment.h>           // Base class from NSCLDAQ
 #include "PSDParameters.h"
 #include <string>
-#include <chrono>
+#include <vector>
 #include <CAENDigitizerType.h>
+#include "CDppHitStore.h"
+#include "CTriggerRateMeter.h"
+#include "CHitFilter.h"
+#include "CTracePolicy.h"
+#include "CFeatureExtractor.h"
+#include "COverloadController.h"
+#include "CDppDiagnostics.h"
+#include "CTimeOffsetTable.h"
+#include "CDigitizerBackend.h"
+#include "CShadowRegisterFile.h"
+#include "CRegisterImage.h"
+#include "CTimeOrderedSource.h"
+#include "DppFragmentFormat.h"
+
+class CDppReadoutThread;
 
 /**
  * @class CDPpPSdEventSegment
@@ -43,8 +58,10 @@
  *    initialize is when the configuration is when the configuration is found
  *    and processed.  The assumption is that parsing the configuration file
  *    is relatively inexpensive compared with initialization and running.
+ *    As a CTimeOrderedSource a compound segment can emit the hits of
+ *    several of these in timestamp order.
  */
-class CDPpPsdEventSegment : public CEventSegment
+class CDPpPsdEventSegment : public CEventSegment, public CTimeOrderedSource
 {
 private:
     std::string         m_configFilename;
@@ -77,16 +94,41 @@ private:
     
     char*     m_rawBuffer;
     uint32_t  m_rawBufferSize;
-    CAEN_DGTZ_DPP_PSD_Event_t* m_dppBuffer[CAEN_DGTZ_MAX_CHANNEL];
-    uint32_t m_dppBufferSize;
+    CDppHitStore m_hits;                     // Hits of the last buffer read.
     CAEN_DGTZ_DPP_PSD_Waveforms_t* m_pWaveforms;
     uint32_t m_wfBufferSize;
-    uint32_t                   m_nHits[CAEN_DGTZ_MAX_CHANNEL];
-    uint32_t                   m_nChannelIndices[CAEN_DGTZ_MAX_CHANNEL];
-    uint64_t                   m_timestampAdjust[CAEN_DGTZ_MAX_CHANNEL];
-    uint32_t                   m_lastTimestamps[CAEN_DGTZ_MAX_CHANNEL];
     uint64_t m_nsPerTick;
     const char*        m_pCheatFile;
+    unsigned           m_nAsyncBlocks;       // 0 means fillBuffer does ReadData.
+    bool               m_inTreeDecode;       // CDppAggregateParser rather than GetDPPEvents.
+    CDppReadoutThread* m_pReader;
+    bool               m_readerStopped;           // Its stop has been reported.
+    uint64_t           m_readerFailures;          // Its decode failures counted so far.
+    CDigitizerBackend* m_pBackend;
+    bool               m_bulk;               // Pack all buffered hits into one event.
+    unsigned           m_tracePrescale;      // Default for channels with no trace prescale.
+    CTracePolicy       m_tracePolicy;        // Which hits keep their traces.
+    CTriggerRateMeter  m_rates;              // From the trigger counter flags.
+    CHitFilter         m_filter;             // Software cuts from the configuration.
+    bool               m_vetted;             // acceptHit passed the hit at the cursor.
+    bool               m_packTraces;         // Write traces packed.
+    std::vector<uint8_t> m_packed;           // The current hit's packed traces.
+    DppFragment::Traces  m_traces;           // Traces sizeEvent chose for the hit.
+    bool                 m_extractFeatures;  // Write the features of traces.
+    bool                 m_keepTraces;       // ...and the traces too.
+    CFeatureExtractor    m_extractor;
+    DppFragment::Features m_features;        // The current hit's.
+    COverloadController  m_overload;         // Sheds data when we can't keep up.
+    CDppDiagnostics      m_diagnostics;      // What went wrong, instead of std::cout.
+    std::string          m_offsetFile;       // CTimeOffsetTable read at initialize.
+    int64_t              m_timeOffset;       // ns added to our event timestamps.
+    bool                 m_incremental;      // Reprogram only what changed.
+    bool                 m_open;             // m_handle is open on the board.
+    bool                 m_programmed;       // ...and setup with m_pCurrentConfiguration.
+    bool                 m_coalesce;         // Compose setup register writes.
+    std::string          m_imageFile;        // CRegisterImage read at initialize.
+    CRegisterImage       m_image;
+    bool                 m_useImage;         // m_image is current.
     
 public:
     CDPpPsdEventSegment(
@@ -99,26 +141,47 @@ public:
     
   virtual void   initialize();
   virtual size_t read(void* pBuffer, size_t maxwords) ;
-  bool    checkTrigger();
+  virtual bool     checkTrigger();
+  virtual uint64_t nextTimestamp();
+  virtual uint64_t newestTimestamp();
   void    disable();
+  void    setAsyncReadout(unsigned nBlocks);
+  void    setInTreeDecode(bool enable);
+  void    setBackend(CDigitizerBackend* pBackend);
+  void    setBulkReadout(bool enable);
+  void    setTracePrescale(unsigned prescale);
+  void    setFineTimestamps(bool enable);
+  void    setTracePacking(bool enable);
+  void    setTraceFeatures(bool enable, bool keepTraces = true);
+  void    setFeatureSettings(const CFeatureExtractor::Settings& settings);
+  void    setOverloadControl(bool enable);
+  void    setOverloadSettings(const COverloadController::Settings& settings);
+  void    setTimeOffsets(const char* filename);
+  void    setIncrementalSetup(bool enable);
+  void    setRegisterCoalescing(bool enable);
+  void    setRegisterImage(const char* filename);
+  const CTriggerRateMeter& triggerRates() const { return m_rates; }
+  const CHitFilter&        hitFilter() const    { return m_filter; }
+  const COverloadController& overload() const   { return m_overload; }
+  const CDppDiagnostics&   diagnostics() const  { return m_diagnostics; }
+  int64_t                  timeOffset() const   { return m_timeOffset; }
+  const CTracePolicy&      tracePolicy() const  { return m_tracePolicy; }
   
   // Support for multiple boards:
   
   bool isMaster();
   void startAcquisition();  
 
-  uint32_t           m_triggerCount[16];
-  uint32_t           m_missedTriggers[16];
-  double t[16];
-  double tmiss[16];
-
-
 private:
     PSDBoardParameters* matchConfig(const PSDParameters& systemConfig);
     bool ourConfig(const PSDBoardParameters& board);
     void openModule();
     void getModuleInformation();
     void setupBoard();
+    void setupChannels(uint32_t channels);
+    void reconfigureBoard(const PSDBoardParameters& previous);
+    void finishRegisters(CShadowRegisterScope& shadow);
+    bool readRegisterImage();
     void processCheatFile();
     
     
@@ -133,13 +196,17 @@ private:
     int       coarseGainToSensitivity(int chan);
     void      setOutputMode();
     bool      needBufferFill();
+    size_t    readBulk(void* pBuffer, size_t maxwords);
     void      fillBuffer();
+    void      countRollovers();
     void      allocateBuffers();
-    uint32_t  oldestChannel();
+    void      nextHit(int chan);
+    bool      acceptHit(int chan);
     size_t    formatEvent(void* pBuffer, int chan);
     size_t    sizeEvent(int chan);
+    bool      wantTrace(int chan);
     void      freeDAQBuffers();
-    uint32_t  sizeTraces();
+    DppFragment::Traces traces();
     void      setLVDSLevel0Trigger();
     void      setLVDSLevel1Trigger();
     void      setLVDSSwTrigger();
@@ -22,11 +22,13 @@
 *
 */
 #include "COneOnlyEventSegment.h"
+#include "CTimeOrderedSource.h"
+#include <string>
 
 /**
  * constructor
  */
-COneOnlyEventSegment::COneOnlyEventSegment() : m_nextRead(0)
+COneOnlyEventSegment::COneOnlyEventSegment() : m_nextRead(0), m_timeOrdered(false)
 {
     
 }
@@ -40,13 +42,18 @@ COneOnlyEventSegment::~COneOnlyEventSegment()
 /**
  *  initialize
  *     Just let each segment intialize itself.
+ * @throw std::string - time ordered but some segment is not a CTimeOrderedSource.
  */
 void
 COneOnlyEventSegment::initialize()
 {
+    if (m_timeOrdered && (m_window.size() != m_segments.size())) {
+        throw std::string("COneOnlyEventSegment - time ordering needs every segment to be a CTimeOrderedSource");
+    }
     for (int i =0; i < m_segments.size(); i++) {
         m_segments[i]->initialize();
     }
+    m_window.reset();
 }
 /**
  * clear
@@ -81,6 +88,14 @@ COneOnlyEventSegment::disable()
 size_t
 COneOnlyEventSegment::read(void* pBuffer, size_t maxwords)
 {
+    if (m_timeOrdered) {
+        int i = m_window.select();
+        if (i < 0) {                   // Nothing buffered or holding the oldest.
+            reject();
+            return 0;
+        }
+        return m_segments[i]->read(pBuffer, maxwords);
+    }
     for (int i =0; i < m_segments.size(); i++) {
         CEventSegment* p = nextToRead();
         size_t result = p->read(pBuffer, maxwords);
@@ -98,6 +113,26 @@ void
 COneOnlyEventSegment::addModule(CEventSegment* p)
 {
     m_segments.push_back(p);
+    CTimeOrderedSource* pSource = dynamic_cast<CTimeOrderedSource*>(p);
+    if (pSource) m_window.addSource(pSource);
+}
+/**
+ * setTimeOrdered
+ *    Choose between reading the segments round robin and reading the one
+ *    with the oldest buffered hit, held back until it's windowNs older
+ *    than the newest buffered hit (or maxHoldMs passes) while some segment
+ *    has nothing buffered.  See CReorderWindow.  Compound segments added
+ *    here should be time ordered themselves with a 0 window.
+ *
+ * @param enable    - true to read in time order.
+ * @param windowNs  - Reorder window in ns.
+ * @param maxHoldMs - Longest a hit is held, ms.
+ */
+void
+COneOnlyEventSegment::setTimeOrdered(bool enable, uint64_t windowNs, unsigned maxHoldMs)
+{
+    m_timeOrdered = enable;
+    m_window.setWindow(windowNs, maxHoldMs);
 }
 /////////////////////////////////////////////////////////////////////////
 // Local utility methods.
@@ -25,13 +25,22 @@
 #define CONEONLYEVENTSEGMENT_H
 #include <CEventSegment.h>
 #include <vector>
+#include "CReorderWindow.h"
 
 
+/**
+ * @class COneOnlyEventSegment
+ *    Each read takes an event from just one of the segments, round robin
+ *    unless setTimeOrdered selects the segment with the oldest buffered hit
+ *    (all segments must then be CTimeOrderedSources).
+ */
 class COneOnlyEventSegment : public CEventSegment
 {
 private:
     std::vector<CEventSegment*>  m_segments;
     unsigned                     m_nextRead;
+    bool                         m_timeOrdered;
+    CReorderWindow               m_window;
 public:
     COneOnlyEventSegment();
     virtual ~COneOnlyEventSegment();
@@ -42,6 +51,7 @@ public:
     virtual size_t read(void* pBuffer, size_t maxwords);
     
     void addModule(CEventSegment* p);
+    void setTimeOrdered(bool enable, uint64_t windowNs = 0, unsigned maxHoldMs = 100);
 private:
     CEventSegment* nextToRead();
     void           nextSegment();
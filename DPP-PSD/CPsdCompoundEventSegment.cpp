@@ -22,6 +22,7 @@
 
 #include "CPsdCompoundEventSegment.h"
 #include "CDPpPsdEventSegment.h"
+#include "CBoardSetupPool.h"
 #include <iostream>
 
 /**
@@ -29,7 +30,7 @@
  *    Just set the next read to index 0.
  */
 CPsdCompoundEventSegment::CPsdCompoundEventSegment() :
-    m_nextRead(0)
+    m_nextRead(0), m_timeOrdered(false), m_setupThreads(0)
 {}
 /**
  * destructor
@@ -44,10 +45,17 @@ CPsdCompoundEventSegment::~CPsdCompoundEventSegment()
  *     - initialize all of the modules.
  *     - Start the modules that are not masters.
  *     - Start the master module.
+ *     With parallel setup all modules are initialized before any is
+ *     started.
  */
 void
 CPsdCompoundEventSegment::initialize()
 {
+    if (m_setupThreads > 1) {
+        setupParallel();
+        m_window.reset();
+        return;
+    }
     for (int i = 0; i < m_modules.size(); i++) {
         m_modules[i]->initialize();
         
@@ -62,6 +70,7 @@ CPsdCompoundEventSegment::initialize()
             m_modules[i]->startAcquisition();
         }
     }
+    m_window.reset();
 
 
 }
@@ -104,6 +113,14 @@ CPsdCompoundEventSegment::read(void* pBuffer, size_t maxwords)
     } else {
         return 0;
     }*/
+    if (m_timeOrdered) {
+        int i = m_window.select();
+        if (i < 0) {                   // Nothing buffered or holding the oldest.
+            reject();
+            return 0;
+        }
+        return m_modules[i]->read(pBuffer, maxwords);
+    }
     size_t nRead=0;
     size_t nM = m_modules.size();
     for (int i =0; i < nM; i++) {
@@ -119,6 +136,36 @@ CPsdCompoundEventSegment::read(void* pBuffer, size_t maxwords)
     return nRead;
 
 }
+/**
+ * checkTrigger
+ *    Used when we are a source of a time ordered COneOnlyEventSegment.
+ *    If we read round robin the modules are all asked afresh.
+ * @return bool - true if some module has data.
+ */
+bool
+CPsdCompoundEventSegment::checkTrigger()
+{
+    if (!m_timeOrdered) m_window.reset();
+    return m_window.poll();
+}
+/**
+ * nextTimestamp
+ * @return uint64_t - the oldest timestamp buffered by the modules.
+ */
+uint64_t
+CPsdCompoundEventSegment::nextTimestamp()
+{
+    return m_window.nextTimestamp();
+}
+/**
+ * newestTimestamp
+ * @return uint64_t - the newest timestamp buffered by the modules.
+ */
+uint64_t
+CPsdCompoundEventSegment::newestTimestamp()
+{
+    return m_window.newestTimestamp();
+}
 /**
  * addModule
  *   Add a new module to the modules we're reading. Normally,
@@ -136,10 +183,71 @@ void
 CPsdCompoundEventSegment::addModule(CDPpPsdEventSegment* p)
 {
     m_modules.push_back(p);
+    m_window.addSource(p);
+}
+/**
+ * setTimeOrdered
+ *    Choose between reading the modules round robin and reading the
+ *    oldest hit buffered by any module, held back until it's windowNs
+ *    older than the newest buffered hit (or maxHoldMs passes) while some
+ *    module has nothing buffered.  See CReorderWindow.  When this segment
+ *    is inside a time ordered COneOnlyEventSegment a 0 window is best.
+ *
+ * @param enable    - true to read in time order.
+ * @param windowNs  - Reorder window in ns.
+ * @param maxHoldMs - Longest a hit is held, ms.
+ */
+void
+CPsdCompoundEventSegment::setTimeOrdered(bool enable, uint64_t windowNs, unsigned maxHoldMs)
+{
+    m_timeOrdered = enable;
+    m_window.setWindow(windowNs, maxHoldMs);
+}
+/**
+ * setParallelSetup
+ *    Choose between initializing the modules one after another and
+ *    initializing up to nThreads of them at once, each on its own handle.
+ *    Once all are initialized (and only if all succeeded) the slaves are
+ *    started and then the master, as in serial setup.  Setup times are
+ *    reported per module.  Modules daisy chained on one link take turns
+ *    with its accesses (see CCAENDigitizerBackend) while their settling
+ *    sleeps overlap.
+ *
+ * @param nThreads - Most modules set up at once; 0 or 1 (the default)
+ *                   sets them up one after another.
+ */
+void
+CPsdCompoundEventSegment::setParallelSetup(unsigned nThreads)
+{
+    m_setupThreads = nThreads;
 }
 ////////////////////////////////////////////////////////////////////////
 // Utility methods
 
+/**
+ * setupParallel
+ *    Initialize the modules on a CBoardSetupPool, then start the slaves
+ *    and, last, the master.
+ */
+void
+CPsdCompoundEventSegment::setupParallel()
+{
+    CBoardSetupPool pool(m_setupThreads);
+    pool.run(m_modules.size(), [this](size_t i) { m_modules[i]->initialize(); });
+    std::cout << "\n" << pool.report("PSD") << std::flush;
+
+    for (int i = 0; i < m_modules.size(); i++) {
+        if (!(m_modules[i]->isMaster())) {
+            m_modules[i]->startAcquisition();
+        }
+    }
+    for (int i = 0; i < m_modules.size(); i++) {
+        if (m_modules[i]->isMaster()) {
+            m_modules[i]->startAcquisition();
+        }
+    }
+}
+
 /**
  * nextToRead
  *    Figure out which module is going to be read next:
@@ -25,15 +25,28 @@
 #include <CEventSegment.h>
 #include <vector>
 #include <memory>
+#include "CTimeOrderedSource.h"
+#include "CReorderWindow.h"
 
 class CDPpPsdEventSegment;
 
 
-class CPsdCompoundEventSegment  : public CEventSegment
+/**
+ * @class CPsdCompoundEventSegment
+ *    Reads several DPP-PSD boards, round robin unless setTimeOrdered
+ *    selects reading the oldest buffered hit of all through a
+ *    CReorderWindow.  The boards are set up one after another unless
+ *    setParallelSetup selects setting them up at once (see
+ *    CBoardSetupPool).
+ */
+class CPsdCompoundEventSegment  : public CEventSegment, public CTimeOrderedSource
 {
 private:
     std::vector<CDPpPsdEventSegment*> m_modules;
     unsigned                          m_nextRead;
+    bool                              m_timeOrdered;
+    CReorderWindow                    m_window;
+    unsigned                          m_setupThreads;
 public:
     CPsdCompoundEventSegment();
     virtual ~CPsdCompoundEventSegment();
@@ -41,10 +54,16 @@ public:
     virtual void clear();
     virtual void disable();
     virtual size_t read(void* pBuffer, size_t maxwords);
+    virtual bool     checkTrigger();
+    virtual uint64_t nextTimestamp();
+    virtual uint64_t newestTimestamp();
     
     void addModule(CDPpPsdEventSegment* p);
+    void setTimeOrdered(bool enable, uint64_t windowNs = 0, unsigned maxHoldMs = 100);
+    void setParallelSetup(unsigned nThreads);
 private:
     CDPpPsdEventSegment* nextToRead();
+    void setupParallel();
 
 
     void nextModule();
@@ -24,6 +24,21 @@
 #include "CPsdTrigger.h"
 #include "CDPpPsdEventSegment.h"
 
+/**
+ * constructor
+ */
+CPsdTrigger::CPsdTrigger() :
+    m_nNextModule(0)
+{}
+/**
+ * setup
+ *    Start of run - poll everything and start the statistics over.
+ */
+void
+CPsdTrigger::setup()
+{
+    m_scheduler.reset();
+}
 /**
  * operator()
  *    Check at most all modules beginning with m_n NextModule and return true if
@@ -33,9 +48,13 @@
 bool
 CPsdTrigger::operator()()
 {
+    CPollScheduler::Clock::time_point now = CPollScheduler::Clock::now();
     for (int i =0; i < m_modules.size(); i++) {
         next();
-        if (m_modules[m_nNextModule]->checkTrigger()) return true;
+        if (!m_scheduler.due(m_nNextModule, now)) continue;   // Backing off.
+        bool found = m_modules[m_nNextModule]->checkTrigger();
+        m_scheduler.record(m_nNextModule, found, now);
+        if (found) return true;
     }
     // Checked all of them.
     
@@ -50,6 +69,30 @@ void
 CPsdTrigger::addModule(CDPpPsdEventSegment* pModule)
 {
     m_modules.push_back(pModule);
+    m_scheduler.addBoard();
+}
+/**
+ * setMaxPollLatency
+ *    Let modules whose polls find no data back off, to at most this long
+ *    between polls (see CPollScheduler).
+ *
+ * @param us - Maximum time between polls of a module, 0 (the default)
+ *             polls every module every time.
+ */
+void
+CPsdTrigger::setMaxPollLatency(unsigned us)
+{
+    m_scheduler.setMaxLatency(us);
+}
+/**
+ * pollStatistics
+ * @param module - index of the module in the order they were added.
+ * @return const CPollScheduler::Statistics& - how its polls went this run.
+ */
+const CPollScheduler::Statistics&
+CPsdTrigger::pollStatistics(unsigned module) const
+{
+    return m_scheduler.statistics(module);
 }
 ////////////////////////////////////////////////////////////////////////////
 // Utility methods;
@@ -25,6 +25,7 @@
 #define CPSDTRIGGER_H
 #include <CEventTrigger.h>
 #include <vector>
+#include "CPollScheduler.h"
 
 class CDPpPsdEventSegment;
 
@@ -32,15 +33,21 @@ class CDPpPsdEventSegment;
  * @class CPsdTrigger
  *    Provides a trigger checker for a set of PSD modules - the modules need not
  *    all be synchronized though it hardly makes sense to run them asynch unless you're
- *    doing a singles experiment.
+ *    doing a singles experiment.  A CPollScheduler can make idle modules
+ *    back off so the busy ones are polled more often.
  */
 class CPsdTrigger : public CEventTrigger {
 private:
     std::vector<CDPpPsdEventSegment*> m_modules;
     unsigned                          m_nNextModule;
+    CPollScheduler                    m_scheduler;
 public:
+    CPsdTrigger();
+    virtual void setup();
     virtual bool operator()();
     void addModule(CDPpPsdEventSegment* p);
+    void setMaxPollLatency(unsigned us);
+    const CPollScheduler::Statistics& pollStatistics(unsigned module) const;
 private:
     void next();                    // module iteration.
 };
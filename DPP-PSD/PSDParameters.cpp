@@ -20,6 +20,7 @@
 */
 #include "PSDParameters.h"
 #include "pugiutils.h"
+#include "CConfigurationCache.h"
 
 #include <stdexcept>
 #include <iostream>
@@ -45,6 +46,79 @@ PSDParameters::parseConfigurationFile(const char* pFilename)
     parseConfiguration(doc);
     
 }
+/**
+ * load
+ *    Get the parsed configuration of a file from the process'
+ *    configuration cache, so a file is parsed once however many boards it
+ *    configures (and again only when it changes).  The boards share it and
+ *    must copy what they modify.
+ *
+ * @param filename - the name of the file.
+ * @return std::shared_ptr<PSDParameters> - the parsed configuration.
+ */
+std::shared_ptr<PSDParameters>
+PSDParameters::load(const std::string& filename)
+{
+    return CConfigurationCache<PSDParameters>::instance().get(
+        filename,
+        [](const std::string& name) {
+            std::shared_ptr<PSDParameters> config(new PSDParameters);
+            config->parseConfigurationFile(name.c_str());
+            return config;
+        }
+    );
+}
+/**
+ * PSDChannelParameters::sameRegisterSettings
+ *    Compare the parameters CDPpPsdEventSegment::setupBoard programs into
+ *    the channel's registers.  The software cuts and trace policy aren't
+ *    compared.
+ *
+ *  @param rhs - the parameters to compare with.
+ *  @return bool - true if the channel would be programmed the same.
+ */
+bool
+PSDChannelParameters::sameRegisterSettings(const PSDChannelParameters& rhs) const
+{
+    return (s_polarity == rhs.s_polarity) && (s_threshold == rhs.s_threshold) &&
+        (s_blineNsMean == rhs.s_blineNsMean) && (s_cfdDelay == rhs.s_cfdDelay) &&
+        (s_enabled == rhs.s_enabled) && (s_cfdSmoothing == rhs.s_cfdSmoothing) &&
+        (s_purGap == rhs.s_purGap) && (s_dynamicRange == rhs.s_dynamicRange) &&
+        (s_shortGate == rhs.s_shortGate) && (s_cfdFraction == rhs.s_cfdFraction) &&
+        (s_discriminatorType == rhs.s_discriminatorType) &&
+        (s_fixedBline == rhs.s_fixedBline) && (s_triggerHoldoff == rhs.s_triggerHoldoff) &&
+        (s_gateLen == rhs.s_gateLen) && (s_dcOffset == rhs.s_dcOffset) &&
+        (s_coarseGain == rhs.s_coarseGain) && (s_gatePre == rhs.s_gatePre) &&
+        (s_preTrigger == rhs.s_preTrigger);
+}
+/**
+ * PSDBoardParameters::sameBoardSettings
+ *    Compare the board level parameters CDPpPsdEventSegment::setupBoard
+ *    programs and which channels are enabled.  If these are the same only
+ *    the channels whose parameters changed need be reprogrammed (see
+ *    PSDChannelParameters::sameRegisterSettings).  The start delay is set
+ *    at each start so it isn't compared.
+ *
+ *  @param rhs - the parameters to compare with.
+ *  @return bool - true if the board level setup would be the same.
+ */
+bool
+PSDBoardParameters::sameBoardSettings(const PSDBoardParameters& rhs) const
+{
+    if ((s_psPerSample != rhs.s_psPerSample) || (s_energy != rhs.s_energy) ||
+        (s_coincidenceMode != rhs.s_coincidenceMode) || (s_startMode != rhs.s_startMode) ||
+        (s_coincidenceTriggerOut != rhs.s_coincidenceTriggerOut) ||
+        (s_calibrateBeforeStart != rhs.s_calibrateBeforeStart) ||
+        (s_recordLength != rhs.s_recordLength) || (s_waveforms != rhs.s_waveforms) ||
+        (s_ioLevel != rhs.s_ioLevel) || (s_triggerOutputMode != rhs.s_triggerOutputMode) ||
+        (s_eventAggregation != rhs.s_eventAggregation)) {
+        return false;
+    }
+    for (int i = 0; i < 16; i++) {
+        if (s_channelConfig[i].s_enabled != rhs.s_channelConfig[i].s_enabled) return false;
+    }
+    return true;
+}
 /**
  * parseConfiguration
  *    Given that the XML configuration has been loaded into a
@@ -456,6 +530,22 @@ PSDParameters::setParameterValue(
         } else {
             board.s_channelConfig[chan].s_preTrigger = pre;
         }
+    } else if (key.compare(0, 19, "DAQ_PARAM_CH_TRACE_") == 0) {
+        if (chan == -1) {
+            for (int i =0; i < 16; i++) {
+                setTracePolicy(board.s_channelConfig[i], key, valNode);
+            }
+        } else {
+            setTracePolicy(board.s_channelConfig[chan], key, valNode);
+        }
+    } else if (key.compare(0, 13, "DAQ_PARAM_CH_") == 0) {
+        if (chan == -1) {
+            for (int i =0; i < 16; i++) {
+                setReadoutCut(board.s_channelConfig[i], key, valNode);
+            }
+        } else {
+            setReadoutCut(board.s_channelConfig[chan], key, valNode);
+        }
     } else {
         // Ignore all keys other than the ones above.
     }
@@ -810,3 +900,73 @@ PSDParameters::setTriggerOutMode(
         throw msg;
     }
 }
+/**
+ * setReadoutCut
+ *    Set one of a channel's software readout cuts (see CHitFilter).
+ *
+ *  @param chanParams - References the channel parameters.
+ *  @param key        - DAQ_PARAM_CH_... key naming the cut parameter.
+ *  @param valNode    - Node holding its value.
+ *  @throw std::string - if the key is not recognized.
+ */
+void
+PSDParameters::setReadoutCut(
+    PSDChannelParameters& chanParams, const std::string& key,
+    pugi::xml_node& valNode
+)
+{
+    CHitFilter::Cuts& cuts(chanParams.s_readoutCuts);
+    if (key == "DAQ_PARAM_CH_ENERGYCUT_ENABLE") {
+        cuts.s_energyCut = getBoolValue(valNode);
+    } else if (key == "DAQ_PARAM_CH_ENERGYCUT_LOW") {
+        cuts.s_energyLow = static_cast<uint32_t>(getDoubleValue(valNode));
+    } else if (key == "DAQ_PARAM_CH_ENERGYCUT_HIGH") {
+        cuts.s_energyHigh = static_cast<uint32_t>(getDoubleValue(valNode));
+    } else if (key == "DAQ_PARAM_CH_PUR_REJECT") {
+        cuts.s_rejectPileup = getBoolValue(valNode);
+    } else if (key == "DAQ_PARAM_CH_PSDCUT_ENABLE") {
+        cuts.s_psdCut = getBoolValue(valNode);
+    } else if (key == "DAQ_PARAM_CH_PSDCUT_LOW") {
+        cuts.s_psdLow = getDoubleValue(valNode);
+    } else if (key == "DAQ_PARAM_CH_PSDCUT_HIGH") {
+        cuts.s_psdHigh = getDoubleValue(valNode);
+    } else if (key == "DAQ_PARAM_CH_LOW_PRIORITY") {
+        cuts.s_lowPriority = getBoolValue(valNode);
+    } else {
+        std::string msg = "Readout cut parameter not recognized: ";
+        msg += key;
+        throw msg;
+    }
+}
+/**
+ * setTracePolicy
+ *    Set part of a channel's trace policy (see CTracePolicy).
+ *
+ *  @param chanParams - References the channel parameters.
+ *  @param key        - DAQ_PARAM_CH_TRACE_... key naming the policy parameter.
+ *  @param valNode    - Node holding its value.
+ *  @throw std::string - if the key is not recognized.
+ */
+void
+PSDParameters::setTracePolicy(
+    PSDChannelParameters& chanParams, const std::string& key,
+    pugi::xml_node& valNode
+)
+{
+    CTracePolicy::Policy& policy(chanParams.s_tracePolicy);
+    if (key == "DAQ_PARAM_CH_TRACE_PRESCALE") {
+        policy.s_prescale = static_cast<unsigned>(getDoubleValue(valNode));
+    } else if (key == "DAQ_PARAM_CH_TRACE_ENERGY_ENABLE") {
+        policy.s_energyWindow = getBoolValue(valNode);
+    } else if (key == "DAQ_PARAM_CH_TRACE_ENERGY_LOW") {
+        policy.s_energyLow = static_cast<uint32_t>(getDoubleValue(valNode));
+    } else if (key == "DAQ_PARAM_CH_TRACE_ENERGY_HIGH") {
+        policy.s_energyHigh = static_cast<uint32_t>(getDoubleValue(valNode));
+    } else if (key == "DAQ_PARAM_CH_TRACE_PILEUP_ONLY") {
+        policy.s_pileupOnly = getBoolValue(valNode);
+    } else {
+        std::string msg = "Trace policy parameter not recognized: ";
+        msg += key;
+        throw msg;
+    }
+}
@@ -25,6 +25,9 @@
 #define PSDPARAMETERS_H
 #include <string>
 #include <vector>
+#include <memory>
+#include "CHitFilter.h"
+#include "CTracePolicy.h"
 
 namespace pugi {
     class xml_document;
@@ -82,6 +85,10 @@ struct PSDChannelParameters {
     } s_coarseGain;                 // Coarse gain in femto coulombs/lsb.
     double s_gatePre;               // integration prior to gate(?).
     double s_preTrigger;            // Waveform capture pre-trigger.
+    CHitFilter::Cuts s_readoutCuts; // Software cuts applied by the readout.
+    CTracePolicy::Policy s_tracePolicy; // Which hits keep their traces.
+
+    bool sameRegisterSettings(const PSDChannelParameters& rhs) const;
 };
 
 struct PSDBoardParameters
@@ -146,6 +153,8 @@ struct PSDBoardParameters
     // per channel parameters - 16 channels.
     
     PSDChannelParameters s_channelConfig[16];
+
+    bool sameBoardSettings(const PSDBoardParameters& rhs) const;
     
 };
 
@@ -240,6 +249,30 @@ struct PSDBoardParameters
  *  |SRV_PARAM_CH_ENERGY_COARSE_GAIN | text enum | Energy coarse gain value |
  *  |SRV_PARAM_CH_GATEPRE   | double ns   | Gate pre trigger |
  *  |SRV_PARAM_CH_PRETRG   | double ns   | Pre trigger value |
+ *
+ *  The readout can also drop hits that fail per channel software cuts (see
+ *  CHitFilter).  These keys are ours, not Compass's, and may be channel
+ *  parameters or board level defaults:
+ *
+ *  |   Key name                    |data type | Meaning                       |
+ *  |DAQ_PARAM_CH_ENERGYCUT_ENABLE  | bool     | Keep only long charges in the window |
+ *  |DAQ_PARAM_CH_ENERGYCUT_LOW     | double   | Lowest long charge kept       |
+ *  |DAQ_PARAM_CH_ENERGYCUT_HIGH    | double   | Highest long charge kept      |
+ *  |DAQ_PARAM_CH_PUR_REJECT        | bool     | Drop hits flagged as piled up |
+ *  |DAQ_PARAM_CH_PSDCUT_ENABLE     | bool     | Keep only (long-short)/long in the window |
+ *  |DAQ_PARAM_CH_PSDCUT_LOW        | double   | Lowest PSD ratio kept         |
+ *  |DAQ_PARAM_CH_PSDCUT_HIGH       | double   | Highest PSD ratio kept        |
+ *  |DAQ_PARAM_CH_LOW_PRIORITY      | bool     | Drop hits first under overload |
+ *
+ *  When waveforms are taken, the channel's trace policy (see CTracePolicy)
+ *  chooses the hits that keep them; the same rules apply to these keys:
+ *
+ *  |   Key name                       |data type | Meaning                    |
+ *  |DAQ_PARAM_CH_TRACE_PRESCALE       | double   | Keep 1 in this many traces (0 none) |
+ *  |DAQ_PARAM_CH_TRACE_ENERGY_ENABLE  | bool     | Only hits with long charge in the window |
+ *  |DAQ_PARAM_CH_TRACE_ENERGY_LOW     | double   | Lowest long charge         |
+ *  |DAQ_PARAM_CH_TRACE_ENERGY_HIGH    | double   | Highest long charge        |
+ *  |DAQ_PARAM_CH_TRACE_PILEUP_ONLY    | bool     | Only hits flagged as piled up |
  * 
  */
 struct PSDParameters {
@@ -250,6 +283,7 @@ public:
     // Top level parsing.
     
     void parseConfigurationFile(const char* pFilename);
+    static std::shared_ptr<PSDParameters> load(const std::string& filename);
     void parseConfiguration(pugi::xml_document& doc);
     void configureBoard(pugi::xml_node& boardNode, PSDBoardParameters& board);
     
@@ -303,6 +337,14 @@ public:
     void setTriggerOutMode(
         PSDBoardParameters& board, const std::string& mode
     );
+    void setReadoutCut(
+        PSDChannelParameters& chanParams, const std::string& key,
+        pugi::xml_node& valNode
+    );
+    void setTracePolicy(
+        PSDChannelParameters& chanParams, const std::string& key,
+        pugi::xml_node& valNode
+    );
 };
 
 
@@ -35,7 +35,8 @@
 #include <DataFormat.h>           // Defines the ring item types.
 // Fragment index provides iterator functionality on the fragments of a
 // built event.
-#include "FragmentIndex.h"         
+#include "FragmentIndex.h"
+#include "DppBulkFormat.h"         
 #include <iostream>
 #include <fstream>
 /**
@@ -68,6 +69,21 @@ CDPPRingItemDecoder::registerFragmentHandler(std::uint32_t sourceId, CFragmentHa
     m_fragmentHandlers[sourceId] = pHandler;    
 }
 
+/**
+ * registerBulkHandler
+ *    Register the handler for bulk fragments (see DppBulkFormat.h) from a
+ *    firmware type.  These can't be registered by size as their size varies.
+ *
+ * @param firmware - DppEvent::PHA or DppEvent::PSD.
+ * @param pHandler - Pointer to the handler.  The caller is responsible for
+ *                   storage management.
+ */
+void
+CDPPRingItemDecoder::registerBulkHandler(DppEvent::type firmware, CFragmentHandler* pHandler)
+{
+    m_bulkHandlers[firmware] = pHandler;
+}
+
 /**
  * registerEndHandler
  *    Registers a handler that's invoked after all fragments of an event
@@ -150,16 +166,18 @@ CDPPRingItemDecoder::decodePhysicsEvent(CPhysicsEventItem* pItem)
     
     for (size_t i = 0; i < nFrags; i++) {
         FragmentInfo f = iterator.getFragment(i);
-        CDppFragmentHandler *h = dynamic_cast<CDppFragmentHandler*>(m_fragmentHandlers[f.s_size]);
+        CDppFragmentHandler *h = findHandler(f.s_size, f.s_itembody);
         if (h)
 	{
 	  (*h)(f); // Invoke the fragment handler if it exists
-	  if(runMode == _DUMP)
-		  h->printEvent();	
-	  else if(runMode == _ROOT)
-		  WriteToROOTFile(h->getEvent());
-	  else 
-		events.push_back(h->getEvent()); // 'events' taken together will represent one coincident bunch of events
+	  for (const DppEvent& hit : h->getEvents()) {
+	    if(runMode == _DUMP)
+		  h->printEvent(hit);
+	    else if(runMode == _ROOT)
+		  WriteToROOTFile(hit);
+	    else 
+		  events.push_back(hit); // 'events' taken together will represent one coincident bunch of events
+	  }
 	 	  
 	}
         
@@ -213,6 +231,7 @@ CDPPRingItemDecoder::setOutputMode(std::string mode)
 		ttree->Branch("Energy", &(treepointer.s_data.second),"Energy/s");
 		ttree->Branch("EnergyShort", &(treepointer.EShort),"EnergyShort/s");
 		ttree->Branch("Timestamp", &(treepointer.timeStamp),"Timestamp/l");
+		ttree->Branch("FineTime", &(treepointer.Picoseconds),"FineTime/s");
 		ttree->Branch("Channel", &(treepointer.s_data.first),"Channel/s");
 		ttree->Branch("Board", &(treepointer.Board),"Board/s");
 		ttree->Branch("Flags", &(treepointer.Extras),"Flags/i");
@@ -237,3 +256,28 @@ void CDPPRingItemDecoder::WriteToROOTFile(DppEvent event)
 	treepointer.s_data.first%=16;
 	ttree->Fill();
 }
+
+/**
+ * findHandler
+ *    Find the handler for a fragment.  Single hit fragments are recognized
+ *    by their size.  Bulk fragments (see DppBulkFormat.h) vary in size and are
+ *    instead recognized by their marker and handled by firmware type.
+ *
+ * @param size  - the fragment's size.
+ * @param pBody - the fragment's body (starts with Readout's event size).
+ * @return CDppFragmentHandler* - null if there's no handler for the fragment.
+ */
+CDppFragmentHandler*
+CDPPRingItemDecoder::findHandler(std::uint32_t size, std::uint16_t* pBody)
+{
+    CFragmentHandler* pHandler;
+    if (DppBulk::isBulk(pBody + 2)) {
+        const DppBulk::Header* pHeader = reinterpret_cast<const DppBulk::Header*>(pBody + 2);
+        pHandler = m_bulkHandlers[
+            (pHeader->s_firmware == DppBulk::PHA) ? DppEvent::PHA : DppEvent::PSD
+        ];
+    } else {
+        pHandler = m_fragmentHandlers[size];
+    }
+    return dynamic_cast<CDppFragmentHandler*>(pHandler);
+}
@@ -64,6 +64,8 @@ class CDPPRingItemDecoder {
 private:
     // m_fragmentHandlers maps source ids to fragment handsler object pointers:
     std::map<std::uint32_t, CFragmentHandler*> m_fragmentHandlers;
+    // m_bulkHandlers maps firmware types to bulk fragment handlers:
+    std::map<DppEvent::type, CFragmentHandler*> m_bulkHandlers;
     TTree *ttree;
     TFile *outfile;
     DppEvent treepointer;
@@ -84,6 +86,7 @@ public:
 	}
 
     void registerFragmentHandler(std::uint32_t sourceId, CFragmentHandler* pHandler);
+    void registerBulkHandler(DppEvent::type firmware, CFragmentHandler* pHandler);
     void registerEndHandler(CEndOfEventHandler* pHandler);
     std::vector<DppEvent> operator()(CRingItem* pItem);
     void setOutputMode(std::string mode);
@@ -92,6 +95,7 @@ public:
 protected:
     std::vector<DppEvent> decodePhysicsEvent(CPhysicsEventItem* pItem);
     void decodeOtherItems(CRingItem* pItem);
+    CDppFragmentHandler* findHandler(std::uint32_t size, std::uint16_t* pBody);
     void WriteToROOTFile(DppEvent event);
 };
 
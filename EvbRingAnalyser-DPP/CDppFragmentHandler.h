@@ -31,17 +31,23 @@ struct FragmentInfo;
 #include <vector>
 #include <iostream>
 #include "CFragmentHandler.h"
+#include "DppFragmentFormat.h"
 struct DppEvent
 {
   typedef enum _type { PHA, PSD } type;
   type firmwareType;
   uint32_t size;
   uint64_t timeStamp;
+  uint16_t Picoseconds;               // Past timeStamp, 0 unless the record has its fine time.
   uint32_t Extras;
   uint32_t EShort;
   uint32_t Extras2;
   uint32_t Board;		
   std::pair<std::uint32_t,uint32_t> s_data; //First element channel number, second element data
+  std::vector<std::uint16_t> Trace1;  // The hit's traces, empty if it has none.
+  std::vector<std::uint16_t> Trace2;  // Empty unless dual trace.
+  bool HasFeatures;                   // Features holds those of Trace1 (see CFeatureExtractor.h).
+  DppFragment::Features Features;
 };
 
 /**
@@ -54,9 +60,12 @@ struct DppEvent
 class CDppFragmentHandler : public CFragmentHandler{
 protected:
    DppEvent event;
+   std::vector<DppEvent> hits;       // All hits in the last fragment (more than one if bulk).
 public:
     DppEvent getEvent() { return event; }
-    void printEvent()
+    const std::vector<DppEvent>& getEvents() { return hits; }
+    void printEvent() { printEvent(event); }
+    void printEvent(const DppEvent& event)
 	{
 	if(event.firmwareType == DppEvent::PHA)
 		std::cout << "\nphaHead ";
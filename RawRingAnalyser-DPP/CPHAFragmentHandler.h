@@ -25,6 +25,7 @@
 #define CPHAFRAGMENTHANDLER_H
 
 #include "CDppFragmentHandler.h"
+#include "DppFragmentFormat.h"
 #include <map>
 #include <string>
 #include <cstdint>
@@ -39,6 +40,9 @@ public:
     CPHAFragmentHandler();
     void operator()(FragmentInfo& frag);
     void printEvent(FragmentInfo& frag);
+private:
+    void parseHit(const DppFragment::PhaView& hit, size_t available, FragmentInfo& frag);
+    void parseBulk(std::uint16_t* pBody, FragmentInfo& frag);
 };
 
 #endif
@@ -25,6 +25,7 @@
 #define CPSDFRAGMENTHANDLER_H
 
 #include "CDppFragmentHandler.h"
+#include "DppFragmentFormat.h"
 
 #include <map>
 #include <string>
@@ -40,6 +41,9 @@ public:
     CPSDFragmentHandler();
     void operator()(FragmentInfo& frag);
     void printEvent(FragmentInfo& frag);
+private:
+    void parseHit(const DppFragment::PsdView& hit, FragmentInfo& frag);
+    void parseBulk(std::uint16_t* pBody, FragmentInfo& frag);
 };
 
 #endif
@@ -159,6 +159,14 @@ main(int argc, char**argv)
     
     decoder.registerFragmentHandler(62, &psdhandler); //The size differentiates PHA and PSD fragments
     decoder.registerFragmentHandler(58, &phahandler);
+    decoder.registerFragmentHandler(100, &psdhandler); //Hits with features but no traces
+    decoder.registerFragmentHandler(94, &phahandler);
+    decoder.registerFragmentHandler(70, &psdhandler); //Hits with fine time (setFineTimestamps)
+    decoder.registerFragmentHandler(64, &phahandler);
+    decoder.registerFragmentHandler(102, &psdhandler); //Fine time and features
+    decoder.registerFragmentHandler(96, &phahandler);
+    decoder.registerBulkHandler(DppEvent::PSD, &psdhandler); //Bulk fragments vary in size
+    decoder.registerBulkHandler(DppEvent::PHA, &phahandler);
     decoder.registerEndHandler(&endhandler);
 
     decoder.setOutputMode(mode);
@@ -29,6 +29,8 @@
 #include <COneOnlyEventSegment.h>
 #include <CompassEventSegment.h>
 #include <CompassProject.h>
+#include <CSimulatedDigitizer.h>
+#include <CRecordingDigitizer.h>
 
 
 
@@ -114,6 +116,21 @@ Skeleton::SetupReadout(CExperiment* pExperiment)
   // experiment.  Additional modules can be created and added to the segment.
   // Note that the event segment will seek out the correct module in a multi module
   // config file.
+
+  // To run without a crate, route the drivers through simulated boards
+  // (keyed by link and node).  This must be done before the segments are made:
+  //  CSimulatedDigitizer* pSim = new CSimulatedDigitizer;
+  //  CSimulatedDigitizer::BoardConfig psdBoard;
+  //  psdBoard.s_firmware = CSimulatedDigitizer::PSD;
+  //  pSim->addBoard(0, 0, psdBoard);
+  //  pSim->addBoard(0, 1, CSimulatedDigitizer::BoardConfig());   // 730 PHA.
+  //  CDigitizerBackend::setDefault(pSim);
+  //
+  // To capture each board's raw readout blocks for dppreplay, record
+  // through the backend that talks to the boards:
+  //  CDigitizerBackend::setDefault(
+  //    new CRecordingDigitizer(CDigitizerBackend::getDefault(), "/scratch/capture")
+  //  );
   
     psdSegment =
     new CDPpPsdEventSegment(PSDBoardParameters::conet, 0, 0, 0x00000000, 0, "/home/daq2/Compass/TwoBoardTest-730PSD-725PHA/.compass/settings.xml");
@@ -124,6 +141,66 @@ Skeleton::SetupReadout(CExperiment* pExperiment)
 			    CAEN_DGTZ_OpticalLink, 
 			    0, 1, 0x00000000, "");
 
+    // Optionally move each board's block transfers into a background
+    // thread with a ring of N buffered blocks (0, the default, reads inline):
+    //  psdSegment->setAsyncReadout(4);
+    //  phaSegment->setAsyncReadout(4);
+
+    // Optionally decode the blocks with the in tree parser rather than
+    // CAEN_DGTZ_GetDPPEvents (check it with dppparsebench on a capture of
+    // the boards first):
+    //  psdSegment->setInTreeDecode(true);
+    //  phaSegment->setInTreeDecode(true);
+
+    // Optionally pack every hit buffered from a block transfer into one
+    // event (see DppBulkFormat.h).  Raise the max event size to suit:
+    //  psdSegment->setBulkReadout(true);
+    //  phaSegment->setBulkReadout(true);
+
+    // When waveforms are enabled, optionally keep (and decode) the traces
+    // of only 1 in N hits per channel:
+    //  psdSegment->setTracePrescale(100);
+    //  phaSegment->setTracePrescale(100);
+
+    // Optionally fold the boards' fine time into the hit timestamps:
+    //  psdSegment->setFineTimestamps(true);
+    //  phaSegment->setFineTimestamps(true);
+
+    // Optionally write the baseline, amplitude, rise time, CFD time and
+    // integrals of each trace (see CFeatureExtractor.h), with the traces or,
+    // passing false, instead of them:
+    //  psdSegment->setTraceFeatures(true, false);
+    //  phaSegment->setTraceFeatures(true, false);
+
+    // Optionally shed traces, then low priority channels, then all but 1 in
+    // N hits when the readout backs up (see COverloadController), rather
+    // than let the boards lose triggers:
+    //  psdSegment->setOverloadControl(true);
+    //  phaSegment->setOverloadControl(true);
+
+    // Optionally add each board's offset from a timestamp offset table to
+    // its event timestamps so the event builder window can be small.
+    // dpptimealign measures them from captures of a common signal:
+    //  psdSegment->setTimeOffsets("offsets.txt");
+    //  phaSegment->setTimeOffsets("offsets.txt");
+
+    // Optionally keep the boards open between runs and, at begin/resume,
+    // reprogram only the channels whose parameters changed in the
+    // configuration file (board level changes still get a full setup):
+    //  psdSegment->setIncrementalSetup(true);
+    //  phaSegment->setIncrementalSetup(true);
+
+    // Optionally compose each setup's register writes in memory and write
+    // each register once (see CShadowRegisterFile), which saves round trips
+    // over optical links.  The accesses saved are reported at setup:
+    //  psdSegment->setRegisterCoalescing(true);
+    //  phaSegment->setRegisterCoalescing(true);
+
+    // Optionally set the boards up from a register image compiled from the
+    // configuration and cheat file by dppregcompile (see CRegisterImage):
+    // a loop of register writes.  A stale image is reported and not used:
+    //  psdSegment->setRegisterImage("psd.img");
+    //  phaSegment->setRegisterImage("pha.img");
 
 
 
@@ -132,7 +209,13 @@ Skeleton::SetupReadout(CExperiment* pExperiment)
 
   CompassMultiModuleEventSegment*  pCompound2 = new CompassMultiModuleEventSegment();
   pCompound2->addModule(phaSegment);
-  
+
+  // Optionally set up to n boards of a compound at once rather than one
+  // after another; all are started (master last) once all are set up.
+  // Setup times are reported per board:
+  //  pCompound->setParallelSetup(4);
+  //  pCompound2->setParallelSetup(4);
+
 /*Method #1, works well - but not 'fair' trigger search
 //  pExperiment->AddEventSegment(pCompound);
 //  pExperiment->AddEventSegment(pCompound2); */
@@ -141,6 +224,14 @@ COneOnlyEventSegment* finalSeg = new COneOnlyEventSegment();
 finalSeg->addModule(pCompound2);
 finalSeg->addModule(pCompound);//Add segment with master last!
 
+  // Optionally emit the hits of all boards in timestamp order rather than
+  // round robin.  The outermost segment holds the oldest hit until it is
+  // the window (ns) older than the newest buffered hit (or 100ms pass) while
+  // some board has nothing buffered; inner compounds use a 0 window:
+  //  pCompound->setTimeOrdered(true);
+  //  pCompound2->setTimeOrdered(true);
+  //  finalSeg->setTimeOrdered(true, 20000);
+
 pExperiment->AddEventSegment(finalSeg);
 
   // Establish your trigger here by creating a trigger object
@@ -156,6 +247,11 @@ pExperiment->AddEventSegment(finalSeg);
   CompassTrigger* PHATrigger = new CompassTrigger;
   PHATrigger->addModule(phaSegment);
 
+  // Optionally let boards whose polls find no data back off (doubling up
+  // to this many us between polls) so busy boards get the link time.
+  // pollStatistics(i) reports how each board's polls went:
+  //  pTrigger->setMaxPollLatency(1000);
+  //  PHATrigger->setMaxPollLatency(1000);
 
   xTrigger->addTrigger(pTrigger);
   xTrigger->addTrigger(PHATrigger);
@@ -190,7 +286,11 @@ Skeleton::SetupScalers(CExperiment* pExperiment)
   CTimedTrigger* pTrigger = new CTimedTrigger(t);
   pExperiment->setScalerTrigger(pTrigger);
 
-  // Create and add your scaler modules here.
+  // Create and add your scaler modules here.  To also report each channel's
+  // hits accepted and dropped by the readout cuts (see CHitFilter), pass
+  // true as a third argument.  Pass true as a fourth to also report each
+  // board's fake events, comm errors, decode failures, rejected reads,
+  // oversize events and rollovers (see CDppDiagnostics).
 
   CAENPHAScalers* pBoard1Scalers = new CAENPHAScalers(phaSegment);
   CAENPSDScalers* pBoard2Scalers = new CAENPSDScalers(psdSegment);
@@ -0,0 +1,275 @@
+ /**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file dppparsebench.cpp
+# @brief Validate and time CDppAggregateParser against GetDPPEvents.
+
+*/
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <stdint.h>
+#include <CDigitizerBackend.h>
+#include <CCAENDigitizerBackend.h>
+#include <CReplayDigitizer.h>
+#include <CDppEventDecoder.h>
+#include <CDppAggregateParser.h>
+#include <DppCaptureFormat.h>
+
+/*  The blocks of a capture file (see DppCaptureFormat.h) are decoded by
+    GetDPPEvents and by CDppAggregateParser and every hit compared field
+    by field, traces included (each decoded by its own decoder).  Then
+    each is timed decoding all the blocks repeatedly.
+
+    GetDPPEvents is the CAEN library's when a link and node are given.  The
+    library needs an open board to decode, so a board running the firmware
+    (and settings) the capture was taken with must be at that link/node;
+    it's only opened.  Without a board, CReplayDigitizer's (i.e.
+    CDppEventDecoder) is used.
+*/
+
+/**
+ * Usage
+ *    output program usage to cerr and exit.
+ */
+static
+void Usage()
+{
+    std::cerr << "Usage\n";
+    std::cerr << "   dppparsebench capturefile [repeats [link node]]\n";
+    std::cerr << "     capturefile  - Block capture of one board (.dppraw).\n";
+    std::cerr << "     repeats      - Times to decode the capture when timing (default 10).\n";
+    std::cerr << "     link node    - Optical link/CONET node of a board to decode with the\n";
+    std::cerr << "                    CAEN library (default decode with CDppEventDecoder).\n";
+
+    std::exit(EXIT_FAILURE);
+}
+/**
+ * loadBlocks
+ *    Read the blocks of a capture file.
+ *
+ * @param filename - capture file.
+ * @param info     - Receives the board information from the file header.
+ * @return std::vector<std::vector<char>> - the blocks.
+ */
+static std::vector<std::vector<char>>
+loadBlocks(const std::string& filename, CAEN_DGTZ_BoardInfo_t& info)
+{
+    std::vector<std::vector<char>> result;
+    std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+    DppCapture::FileHeader header;
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in || (header.s_magic != DppCapture::MAGIC) || (header.s_version != DppCapture::VERSION)) {
+        throw std::string("Not a capture file: ") + filename;
+    }
+    std::vector<char> infoBytes(header.s_infoSize);
+    in.read(infoBytes.data(), infoBytes.size());
+    memset(&info, 0, sizeof(info));
+    memcpy(&info, infoBytes.data(), std::min(infoBytes.size(), sizeof(info)));
+
+    DppCapture::BlockHeader block;
+    while (in.read(reinterpret_cast<char*>(&block), sizeof(block))) {
+        std::vector<char> data(block.s_nBytes);
+        if (!in.read(data.data(), data.size())) break;
+        result.push_back(data);
+    }
+    return result;
+}
+/**
+ * sameTraces
+ *    Compare decoded waveforms.
+ */
+template <class W>
+static bool
+sameTraces(const W& a, const W& b)
+{
+    if (a.Ns != b.Ns) return false;
+    for (uint32_t i = 0; i < a.Ns; i++) {
+        if ((a.Trace1[i] != b.Trace1[i]) || (a.DTrace1[i] != b.DTrace1[i]) ||
+            (a.DTrace2[i] != b.DTrace2[i])) return false;
+    }
+    return true;
+}
+/**
+ * compareBlock
+ *    Compare the hits GetDPPEvents and the parser got from a block.
+ *
+ * @return uint64_t - number of hits that differ (a channel whose hit count
+ *                    differs counts all its hits).
+ */
+static uint64_t
+compareBlock(
+    bool psd, CDigitizerBackend& ref, int handle, void** events, uint32_t* nEvents,
+    void* refWf, CDppAggregateParser& parser, void* parserWf
+)
+{
+    uint64_t nBad = 0;
+    for (int ch = 0; ch < CAEN_DGTZ_MAX_CHANNEL; ch++) {
+        const DppHitColumns& c(parser.channel(ch));
+        if (c.s_nHits != nEvents[ch]) {
+            std::cerr << "Channel " << ch << ": " << nEvents[ch] << " hits from GetDPPEvents, "
+                      << c.s_nHits << " from the parser\n";
+            nBad += std::max(c.s_nHits, nEvents[ch]);
+            continue;
+        }
+        for (uint32_t i = 0; i < c.s_nHits; i++) {
+            bool same;
+            bool traces;
+            if (psd) {
+                CAEN_DGTZ_DPP_PSD_Event_t& e(static_cast<CAEN_DGTZ_DPP_PSD_Event_t*>(events[ch])[i]);
+                same = (e.Format == c.s_format[i]) && (e.TimeTag == c.s_timeTag[i]) &&
+                    (uint16_t(e.ChargeShort) == c.s_energy[i]) &&
+                    (uint16_t(e.ChargeLong) == c.s_chargeLong[i]) &&
+                    (uint16_t(e.Pur) == c.s_extras[i]) && (e.Extras == c.s_extras2[i]);
+                traces = e.Waveforms || c.s_waveforms[i];
+                if (same && traces) {
+                    ref.decodeDPPWaveforms(handle, &e, refWf);
+                    parser.decodeWaveforms(ch, i, parserWf);
+                    const CAEN_DGTZ_DPP_PSD_Waveforms_t& a(*static_cast<CAEN_DGTZ_DPP_PSD_Waveforms_t*>(refWf));
+                    const CAEN_DGTZ_DPP_PSD_Waveforms_t& b(*static_cast<CAEN_DGTZ_DPP_PSD_Waveforms_t*>(parserWf));
+                    same = sameTraces(a, b) && (a.dualTrace == b.dualTrace);
+                    for (uint32_t s = 0; same && a.dualTrace && (s < a.Ns); s++) {
+                        same = a.Trace2[s] == b.Trace2[s];
+                    }
+                }
+            } else {
+                CAEN_DGTZ_DPP_PHA_Event_t& e(static_cast<CAEN_DGTZ_DPP_PHA_Event_t*>(events[ch])[i]);
+                same = (e.Format == c.s_format[i]) && (e.TimeTag == c.s_timeTag[i]) &&
+                    (e.Energy == c.s_energy[i]) && (uint16_t(e.Extras) == c.s_extras[i]) &&
+                    (e.Extras2 == c.s_extras2[i]);
+                traces = e.Waveforms || c.s_waveforms[i];
+                if (same && traces) {
+                    ref.decodeDPPWaveforms(handle, &e, refWf);
+                    parser.decodeWaveforms(ch, i, parserWf);
+                    const CAEN_DGTZ_DPP_PHA_Waveforms_t& a(*static_cast<CAEN_DGTZ_DPP_PHA_Waveforms_t*>(refWf));
+                    const CAEN_DGTZ_DPP_PHA_Waveforms_t& b(*static_cast<CAEN_DGTZ_DPP_PHA_Waveforms_t*>(parserWf));
+                    same = sameTraces(a, b) && (a.DualTrace == b.DualTrace);
+                    for (uint32_t s = 0; same && a.DualTrace && (s < a.Ns); s++) {
+                        same = a.Trace2[s] == b.Trace2[s];
+                    }
+                }
+            }
+            if (!same) {
+                if (nBad < 10) {
+                    std::cerr << "Channel " << ch << " hit " << i << " differs\n";
+                }
+                nBad++;
+            }
+        }
+    }
+    return nBad;
+}
+/**
+ * main
+ *    Entry point.
+ */
+int main(int argc, char** argv)
+{
+    if ((argc != 2) && (argc != 3) && (argc != 5)) Usage();
+    unsigned repeats = (argc > 2) ? strtoul(argv[2], NULL, 0) : 10;
+
+    try {
+        CAEN_DGTZ_BoardInfo_t info;
+        std::vector<std::vector<char>> blocks = loadBlocks(argv[1], info);
+        bool psd = CDppEventDecoder::isPsd(info);
+
+        CCAENDigitizerBackend caen;
+        CReplayDigitizer      replay;
+        CDigitizerBackend*    pRef;
+        int                   handle;
+        CAEN_DGTZ_ErrorCode   status;
+        if (argc == 5) {
+            pRef   = &caen;
+            status = caen.openDigitizer(
+                CAEN_DGTZ_OpticalLink, strtoul(argv[3], NULL, 0), strtoul(argv[4], NULL, 0), 0, &handle
+            );
+        } else {
+            pRef = &replay;
+            replay.addBoard(0, 0, argv[1]);
+            status = replay.openDigitizer(CAEN_DGTZ_OpticalLink, 0, 0, 0, &handle);
+        }
+        if (status != CAEN_DGTZ_Success) throw std::string("Unable to open the reference digitizer");
+
+        void*    events[CAEN_DGTZ_MAX_CHANNEL];
+        uint32_t nEvents[CAEN_DGTZ_MAX_CHANNEL];
+        void*    refWf;
+        void*    parserWf;
+        uint32_t size;
+        if ((pRef->mallocDPPEvents(handle, events, &size) != CAEN_DGTZ_Success) ||
+            (pRef->mallocDPPWaveforms(handle, &refWf, &size) != CAEN_DGTZ_Success) ||
+            (CDppEventDecoder::mallocWaveforms(psd, &parserWf, &size) != CAEN_DGTZ_Success)) {
+            throw std::string("Unable to allocate event/waveform storage");
+        }
+        CDppAggregateParser parser(psd);
+
+        // Validate:
+
+        uint64_t nHits = 0;
+        uint64_t nBad  = 0;
+        for (size_t b = 0; b < blocks.size(); b++) {
+            std::vector<char>& block(blocks[b]);
+            if (pRef->getDPPEvents(handle, block.data(), block.size(), events, nEvents) != CAEN_DGTZ_Success) {
+                std::cerr << "GetDPPEvents failed on block " << b << std::endl;
+                nBad++;
+                continue;
+            }
+            if (parser.parse(block.data(), block.size()) != CAEN_DGTZ_Success) {
+                std::cerr << "The parser failed on block " << b << std::endl;
+                nBad++;
+                continue;
+            }
+            for (int ch = 0; ch < CAEN_DGTZ_MAX_CHANNEL; ch++) nHits += nEvents[ch];
+            nBad += compareBlock(psd, *pRef, handle, events, nEvents, refWf, parser, parserWf);
+        }
+        std::cout << (psd ? "PSD" : "PHA") << " capture: " << blocks.size() << " blocks, "
+                  << nHits << " hits, " << nBad << " differences\n";
+
+        // Time:
+
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned r = 0; r < repeats; r++) {
+            for (size_t b = 0; b < blocks.size(); b++) {
+                pRef->getDPPEvents(handle, blocks[b].data(), blocks[b].size(), events, nEvents);
+            }
+        }
+        double refSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        for (unsigned r = 0; r < repeats; r++) {
+            for (size_t b = 0; b < blocks.size(); b++) {
+                parser.parse(blocks[b].data(), blocks[b].size());
+            }
+        }
+        double parserSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        double total = double(nHits)*repeats;
+        if (total > 0) {
+            std::cout << "  GetDPPEvents: " << 1.0e9*refSeconds/total << " ns/hit, "
+                      << total/refSeconds << " hits/s\n";
+            std::cout << "  Parser:       " << 1.0e9*parserSeconds/total << " ns/hit, "
+                      << total/parserSeconds << " hits/s\n";
+        }
+
+        pRef->freeDPPEvents(handle, events);
+        pRef->freeDPPWaveforms(handle, refWf);
+        CDppEventDecoder::freeWaveforms(parserWf);
+        pRef->closeDigitizer(handle);
+
+        std::exit(nBad ? EXIT_FAILURE : EXIT_SUCCESS);
+    }
+    catch (std::string& msg) {
+        std::cerr << "Failed: " << msg << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+}
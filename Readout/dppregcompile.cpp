@@ -0,0 +1,346 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file dppregcompile.cpp
+# @brief Compile a Compass configuration into a register image, list and verify images.
+
+*/
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <CAENPha.h>
+#include <CompassProject.h>
+#include <CDPpPsdEventSegment.h>
+#include <PSDParameters.h>
+#include <CForwardingDigitizer.h>
+#include <CShadowRegisterFile.h>
+#include <CRegisterImage.h>
+
+/*  Each board of a Compass configuration is set up by its driver exactly as
+    Readout would (including the cheat file) but not started.  The
+    translation of the parameters into registers is then done:  the
+    configuration registers of the board are read back and saved, in an
+    order safe to write them in, as the board's part of a CRegisterImage.
+    The library's Set* calls program registers inside the library, so this
+    needs the boards; compile when the configuration changes.
+
+    Which registers are saved:  the configuration registers of the
+    firmware (the tables below) and any others the driver or cheat file
+    wrote that just store their value (CShadowRegisterFile::isStorage).
+    The acquisition control is saved last with its run bit clear.
+
+    An image can be listed in the format pharegdump and psdregdump use and
+    verified against their output for a board, e.g. after Readout set it up
+    from the image.
+*/
+
+static const uint32_t ACQ_CONTROL = 0x8100;
+static const uint32_t RUN_BIT     = 4;
+
+static const uint32_t boardRegisters[] = {   // Written first, in this order.
+    0x8000, 0x800c, 0x8120, 0x810c, 0x8110, 0x811c, 0x8170, 0x817c,
+    0x8180, 0x8184, 0x8188, 0x818c, 0x8190, 0x8194, 0x8198, 0x819c,
+    0x81a0, 0xef1c, 0
+};
+static const uint32_t phaChannelRegisters[] = {  // Offsets in 0x1n00.
+    0x20, 0x28, 0x34, 0x38, 0x40, 0x4c, 0x54, 0x58, 0x5c, 0x60, 0x64, 0x68,
+    0x6c, 0x70, 0x74, 0x78, 0x7c, 0x80, 0x84, 0x98, 0xa0, 0
+};
+static const uint32_t psdChannelRegisters[] = {
+    0x20, 0x28, 0x34, 0x38, 0x3c, 0x44, 0x54, 0x58, 0x5c, 0x60, 0x64, 0x70,
+    0x74, 0x78, 0x7c, 0x80, 0x84, 0x98, 0xd4, 0
+};
+
+/**
+ * Usage
+ *    output program usage to cerr and exit.
+ */
+static
+void Usage()
+{
+    std::cerr << "Usage\n";
+    std::cerr << "   dppregcompile pha|psd compassfile imagefile [cheatfile] [-f]\n";
+    std::cerr << "     Set up each board of compassfile and save its registers in imagefile.\n";
+    std::cerr << "     cheatfile    - The register cheat file Readout gives the segments.\n";
+    std::cerr << "     -f           - (PHA) compile for setFineTimestamps(true).\n";
+    std::cerr << "   dppregcompile list imagefile\n";
+    std::cerr << "     List the image in the format of pharegdump/psdregdump.\n";
+    std::cerr << "   dppregcompile verify imagefile serial dumpfile\n";
+    std::cerr << "     Compare the image of the board with that serial number with\n";
+    std::cerr << "     pharegdump/psdregdump output (- for stdin).  Exits nonzero if they differ.\n";
+
+    std::exit(EXIT_FAILURE);
+}
+
+/**
+ * @class CRegisterCapture
+ *    Remembers the board a driver opened and the registers it wrote.
+ */
+class CRegisterCapture : public CForwardingDigitizer
+{
+public:
+    CRegisterImage::BoardHeader s_board;
+    int                         s_handle;
+    std::vector<uint32_t>       s_written;      // In first write order.
+
+    CRegisterCapture() : CForwardingDigitizer(CDigitizerBackend::getDefault()), s_handle(-1) {}
+
+    virtual CAEN_DGTZ_ErrorCode openDigitizer(
+        CAEN_DGTZ_ConnectionType linkType, int linkNum, int conetNode,
+        uint32_t vmeBase, int* handle
+    ) {
+        CAEN_DGTZ_ErrorCode status =
+            CForwardingDigitizer::openDigitizer(linkType, linkNum, conetNode, vmeBase, handle);
+        CRegisterImage::BoardHeader board = {linkType, linkNum, conetNode, vmeBase, 0, 0};
+        s_board  = board;
+        s_handle = *handle;
+        s_written.clear();
+        return status;
+    }
+    virtual CAEN_DGTZ_ErrorCode writeRegister(int handle, uint32_t address, uint32_t data) {
+        if (std::find(s_written.begin(), s_written.end(), address) == s_written.end()) {
+            s_written.push_back(address);
+        }
+        return CForwardingDigitizer::writeRegister(handle, address, data);
+    }
+};
+
+/**
+ * readBack
+ *    Read the configuration registers of the board a driver set up through
+ *    a capture into an image.
+ *
+ * @param capture   - The board's capture backend.
+ * @param pChannelRegisters - Its firmware's channel registers.
+ * @param image     - The image to add the board to.
+ */
+static void
+readBack(CRegisterCapture& capture, const uint32_t* pChannelRegisters, CRegisterImage& image)
+{
+    CAEN_DGTZ_BoardInfo_t info;
+    if (capture.getInfo(capture.s_handle, &info) != CAEN_DGTZ_Success) {
+        throw std::string("Unable to get the board information");
+    }
+    std::vector<uint32_t> addresses;
+    for (const uint32_t* p = boardRegisters; *p; p++) {
+        addresses.push_back(*p);
+    }
+    for (uint32_t c = 0; c < info.Channels; c++) {
+        for (const uint32_t* p = pChannelRegisters; *p; p++) {
+            addresses.push_back(0x1000 | (c << 8) | *p);
+        }
+    }
+    for (size_t i = 0; i < capture.s_written.size(); i++) {
+        uint32_t a = capture.s_written[i];
+        bool     channel = (a & 0xf000) == 0x1000;
+        if (CShadowRegisterFile::isStorage(a) && (a & 0xff) != 0x88 &&
+            (!channel || (((a >> 8) & 0xf) < info.Channels)) &&
+            (std::find(addresses.begin(), addresses.end(), a) == addresses.end())) {
+            addresses.push_back(a);
+        }
+    }
+    addresses.push_back(ACQ_CONTROL);
+
+    CRegisterImage::BoardHeader header = capture.s_board;
+    header.s_serial = info.SerialNumber;
+    CRegisterImage::Board& board(image.addBoard(header));
+    for (size_t i = 0; i < addresses.size(); i++) {
+        CRegisterImage::Write w = {addresses[i], 0};
+        if (capture.readRegister(capture.s_handle, w.s_address, &w.s_value) != CAEN_DGTZ_Success) {
+            char msg[100];
+            sprintf(msg, "Unable to read register %x", w.s_address);
+            throw std::string(msg);
+        }
+        if (w.s_address == ACQ_CONTROL) w.s_value &= ~RUN_BIT;
+        board.s_writes.push_back(w);
+    }
+    std::cout << "Board " << info.SerialNumber << " (" << info.ModelName << "): "
+              << board.s_writes.size() << " registers\n";
+}
+/**
+ * compilePha
+ *    Add the PHA boards of a Compass file to an image.
+ */
+static void
+compilePha(const std::string& config, const char* pCheatFile, bool fineTime, CRegisterImage& image)
+{
+    std::shared_ptr<CompassProject> project = CompassProject::load(config);
+    for (size_t i = 0; i < project->m_connections.size(); i++) {
+        CompassProject::ConnectionParameters& conn(project->m_connections[i]);
+        CAENPhaParameters&                   board(*project->m_boards[i]);
+        CRegisterCapture                     capture;
+        CAENPha driver(
+            board, conn.s_linkType, conn.s_linkNum, conn.s_node, conn.s_base,
+            board.s_startMode, true, board.startDelay, pCheatFile, &capture
+        );
+        driver.setFineTimestamps(fineTime);
+        driver.setup(false);
+        readBack(capture, phaChannelRegisters, image);
+    }
+}
+/**
+ * compilePsd
+ *    Add the PSD boards of a Compass file to an image.
+ */
+static void
+compilePsd(const std::string& config, const char* pCheatFile, CRegisterImage& image)
+{
+    std::shared_ptr<PSDParameters> project = PSDParameters::load(config);
+    for (size_t i = 0; i < project->s_boardParams.size(); i++) {
+        PSDBoardParameters& board(project->s_boardParams[i]);
+        CRegisterCapture    capture;
+        CDPpPsdEventSegment segment(
+            board.s_linkType, board.s_linkNum, board.s_node, board.s_base, i,
+            config.c_str(), pCheatFile
+        );
+        segment.setBackend(&capture);
+        segment.initialize();               // Doesn't start the board.
+        readBack(capture, psdChannelRegisters, image);
+    }
+}
+/**
+ * list
+ *    List an image.
+ */
+static void
+list(const CRegisterImage& image)
+{
+    char hash[20];
+    sprintf(hash, "%016llx", static_cast<unsigned long long>(image.configHash()));
+    std::cout << "Configuration hash " << hash
+              << ((image.flags() & CRegisterImage::FINE_TIMESTAMPS) ? ", fine timestamps" : "")
+              << std::endl;
+    for (size_t i = 0; i < image.boards().size(); i++) {
+        const CRegisterImage::Board& board(image.boards()[i]);
+        std::cout << "Board " << board.s_header.s_serial
+                  << " link type " << board.s_header.s_linkType
+                  << " link " << board.s_header.s_linkNum
+                  << " node " << board.s_header.s_node
+                  << " base " << std::hex << board.s_header.s_base << std::dec
+                  << ": " << board.s_writes.size() << " registers\n";
+        for (size_t w = 0; w < board.s_writes.size(); w++) {
+            std::cout << "  Addr " << std::hex << board.s_writes[w].s_address
+                      << " : " << board.s_writes[w].s_value << std::dec << std::endl;
+        }
+    }
+}
+/**
+ * verify
+ *    Compare a board's image with a register dump.  The dump's
+ *    "  Addr <hex> : <hex>" lines are the registers; those not in the
+ *    image are ignored.
+ *
+ * @return int - number of registers that differ.
+ */
+static int
+verify(const CRegisterImage& image, uint32_t serial, std::istream& dump)
+{
+    const CRegisterImage::Board* pBoard = image.find(serial);
+    if (!pBoard) {
+        throw std::string("The image has no board with that serial number");
+    }
+    unsigned nCompared = 0;
+    int      nDiffer   = 0;
+    std::string line;
+    while (std::getline(dump, line)) {
+        size_t   pos = line.find("Addr");
+        unsigned address, value;
+        if ((pos == std::string::npos) ||
+            (sscanf(line.c_str() + pos, "Addr %x : %x", &address, &value) != 2)) continue;
+        for (size_t i = 0; i < pBoard->s_writes.size(); i++) {
+            const CRegisterImage::Write& w(pBoard->s_writes[i]);
+            if (w.s_address != address) continue;
+            uint32_t mask = (address == ACQ_CONTROL) ? ~RUN_BIT : 0xffffffff;
+            nCompared++;
+            if ((w.s_value & mask) != (value & mask)) {
+                std::cout << "  Addr " << std::hex << address << " : image " << w.s_value
+                          << " board " << value << std::dec << std::endl;
+                nDiffer++;
+            }
+            break;
+        }
+    }
+    std::cout << nCompared << " registers compared, " << nDiffer << " differ\n";
+    if (!nCompared) nDiffer = 1;             // Nothing verified is a failure.
+    return nDiffer;
+}
+/**
+ * main
+ *    Entry point.
+ */
+int
+main(int argc, char** argv)
+{
+    if (argc < 3) Usage();
+    std::string mode(argv[1]);
+
+    try {
+        CRegisterImage image;
+        if ((mode == "pha") || (mode == "psd")) {
+            if (argc < 4) Usage();
+            const char* pCheatFile = nullptr;
+            bool        fineTime   = false;
+            for (int i = 4; i < argc; i++) {
+                if (std::string(argv[i]) == "-f") {
+                    fineTime = true;
+                } else {
+                    pCheatFile = argv[i];
+                }
+            }
+            if (fineTime && (mode == "psd")) Usage();
+            image.setConfigHash(CRegisterImage::hashFiles(argv[2], pCheatFile));
+            image.setFlags(fineTime ? CRegisterImage::FINE_TIMESTAMPS : 0);
+            if (mode == "pha") {
+                compilePha(argv[2], pCheatFile, fineTime, image);
+            } else {
+                compilePsd(argv[2], pCheatFile, image);
+            }
+            image.write(argv[3]);
+            std::cout << image.boards().size() << " board(s) compiled to " << argv[3] << std::endl;
+
+        } else if (mode == "list") {
+            image.read(argv[2]);
+            list(image);
+
+        } else if (mode == "verify") {
+            if (argc != 5) Usage();
+            image.read(argv[2]);
+            uint32_t serial = strtoul(argv[3], NULL, 0);
+            if (std::string(argv[4]) == "-") {
+                return verify(image, serial, std::cin) ? EXIT_FAILURE : EXIT_SUCCESS;
+            }
+            std::ifstream dump(argv[4]);
+            if (!dump) {
+                throw std::string("Unable to open ") + argv[4];
+            }
+            return verify(image, serial, dump) ? EXIT_FAILURE : EXIT_SUCCESS;
+
+        } else {
+            Usage();
+        }
+    }
+    catch (std::string msg) {
+        std::cerr << msg << std::endl;
+        return EXIT_FAILURE;
+    }
+    catch (std::pair<std::string, int> err) {
+        std::cerr << err.first << " (" << err.second << ")\n";
+        return EXIT_FAILURE;
+    }
+    catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,148 @@
+ /**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+
+##
+# @file dppreplay.cpp
+# @brief Push captured raw readout blocks back through the PHA driver.
+
+*/
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <stdint.h>
+#include <CAENPha.h>
+#include <CompassProject.h>
+#include <CReplayDigitizer.h>
+#include <DppCaptureFormat.h>
+
+/*  Each PHA board of a Compass configuration file is opened through a
+    CReplayDigitizer fed the block capture Readout (or dppsimbench) made of
+    that board, and set up by CAENPha exactly as Readout would.  The
+    blocks then go through the same parse and merge path they did when
+    captured, either as fast as the driver can take them or at the pace
+    they were captured.  Every hit is pulled through haveData/next and
+    the throughput and time ordering reported.  Since
+    the input is fixed, runs are reproducible and can be compared
+    before/after a driver change.
+*/
+
+/**
+ * Usage
+ *    output program usage to cerr and exit.
+ */
+static
+void Usage()
+{
+    std::cerr << "Usage\n";
+    std::cerr << "   dppreplay compassfile prefix [run [realtime [asyncBlocks]]]\n";
+    std::cerr << "     compassfile  - Compass settings.xml the capture was taken with.\n";
+    std::cerr << "     prefix       - Capture file prefix (prefix-l<link>-n<node>-r<run>.dppraw).\n";
+    std::cerr << "     run          - Which capture of each board to replay (default 0).\n";
+    std::cerr << "     realtime     - Nonzero to replay at the captured pace (default 0).\n";
+    std::cerr << "     asyncBlocks  - Background reader ring size, 0 for none (default 0).\n";
+
+    std::exit(EXIT_FAILURE);
+}
+/**
+ * main
+ *    Entry point.
+ */
+int main(int argc, char** argv)
+{
+    if ((argc < 3) || (argc > 6)) Usage();
+    std::string prefix      = argv[2];
+    unsigned    run         = 0;
+    bool        realTime    = false;
+    unsigned    asyncBlocks = 0;
+    if (argc > 3) run         = strtoul(argv[3], NULL, 0);
+    if (argc > 4) realTime    = strtoul(argv[4], NULL, 0) != 0;
+    if (argc > 5) asyncBlocks = strtoul(argv[5], NULL, 0);
+
+    bool failed = false;
+    try {
+        CompassProject project(argv[1]);
+        project();
+
+        for (size_t i = 0; i < project.m_boards.size(); i++) {
+            CompassProject::ConnectionParameters& conn(project.m_connections[i]);
+            CAENPhaParameters& board(*project.m_boards[i]);
+
+            CReplayDigitizer replay;
+            replay.addBoard(
+                conn.s_linkNum, conn.s_node,
+                DppCapture::fileName(prefix, conn.s_linkNum, conn.s_node, run), realTime
+            );
+            CAENPha driver(
+                board, conn.s_linkType, conn.s_linkNum, conn.s_node, conn.s_base,
+                board.s_startMode, true, board.startDelay, nullptr, &replay
+            );
+            driver.setAsyncReadout(asyncBlocks);
+            driver.setup();
+
+            // Once the capture's exhausted, a short run of empty polls means
+            // the driver (and any background reader) has nothing left.
+
+            uint64_t nRead      = 0;
+            uint64_t nDisorder  = 0;
+            uint64_t lastStamp  = 0;
+            unsigned idlePolls  = 0;
+            auto start    = std::chrono::steady_clock::now();
+            auto lastData = start;
+            while (idlePolls < 100) {
+                if (!driver.haveData()) {
+                    if (replay.exhausted()) {
+                        idlePolls++;
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    }
+                    continue;
+                }
+                idlePolls = 0;
+                uint64_t stamp = driver.hits().timestamp();
+                if (stamp < lastStamp) nDisorder++;
+                lastStamp = stamp;
+                driver.next();
+                nRead++;
+                lastData = std::chrono::steady_clock::now();
+            }
+            double seconds = std::chrono::duration<double>(lastData - start).count();
+            uint64_t nBlocks = replay.blocksReplayed();
+            driver.shutdown();
+
+            std::cout << "Board " << i << " (link " << conn.s_linkNum
+                      << " node " << conn.s_node << "): "
+                      << nBlocks << " blocks, " << nRead << " hits in " << seconds << " s\n";
+            if (nRead && (seconds > 0.0)) {
+                std::cout << "  " << nRead/seconds << " hits/s, "
+                          << 1.0e9*seconds/nRead << " ns/hit\n";
+            }
+            std::cout << "  Last timestamp " << lastStamp << " ns, "
+                      << nDisorder << " hits out of time order\n";
+            if (nDisorder) {
+                std::cerr << "Board " << i << " delivered hits out of time order!\n";
+                failed = true;
+            }
+        }
+    }
+    catch (std::pair<std::string, int>& e) {
+        std::cerr << "Driver failed: " << e.first << " : " << e.second << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    catch (std::string& msg) {
+        std::cerr << "Failed: " << msg << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    catch (std::exception& e) {
+        std::cerr << "Failed: " << e.what() << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::exit(failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,165 @@
+ /**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+
+##
+# @file dppsimbench.cpp
+# @brief Run the PHA readout chain against simulated boards and time it.
+
+*/
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <stdint.h>
+#include <CAENPha.h>
+#include <CompassProject.h>
+#include <CSimulatedDigitizer.h>
+#include <CRecordingDigitizer.h>
+
+/*  Each board of a Compass configuration file is opened through a
+    CSimulatedDigitizer running flat out (not paced by the wall clock)
+    and set up by CAENPha exactly as Readout would.  Hits are then pulled
+    through haveData/Read until the requested count is reached and the
+    rate reported.  The time ordering and rollover handling of each board's
+    hits is checked along the way so this doubles as a regression test of
+    the driver.
+
+    Given a recordPrefix, the raw blocks are captured on their way to the
+    driver (see CRecordingDigitizer) so dppreplay can push the same data
+    through the driver again.
+*/
+
+/**
+ * Usage
+ *    output program usage to cerr and exit.
+ */
+static
+void Usage()
+{
+    std::cerr << "Usage\n";
+    std::cerr << "   dppsimbench compassfile [hits [rate [traceSamples [asyncBlocks [recordPrefix]]]]]\n";
+    std::cerr << "     compassfile  - Compass settings.xml describing the boards.\n";
+    std::cerr << "     hits         - Hits to read from each board (default 1000000).\n";
+    std::cerr << "     rate         - Simulated hits/s per channel (default 10000).\n";
+    std::cerr << "     traceSamples - Take traces of this many samples (mixed mode),\n";
+    std::cerr << "                    0 for the configured (list) mode (default 0).\n";
+    std::cerr << "     asyncBlocks  - Background reader ring size, 0 for none (default 0).\n";
+    std::cerr << "     recordPrefix - Capture the raw blocks to files with this prefix.\n";
+
+    std::exit(EXIT_FAILURE);
+}
+/**
+ * main
+ *    Entry point.
+ */
+int main(int argc, char** argv)
+{
+    if ((argc < 2) || (argc > 7)) Usage();
+    uint64_t nHits        = 1000000;
+    double   rate         = 10000.0;
+    unsigned traceSamples = 0;
+    unsigned asyncBlocks  = 0;
+    if (argc > 2) nHits        = strtoull(argv[2], NULL, 0);
+    if (argc > 3) rate         = strtod(argv[3], NULL);
+    if (argc > 4) traceSamples = strtoul(argv[4], NULL, 0);
+    if (argc > 5) asyncBlocks  = strtoul(argv[5], NULL, 0);
+    std::string recordPrefix;
+    if (argc > 6) recordPrefix = argv[6];
+    if (!nHits || (rate <= 0.0)) Usage();
+
+    try {
+        CompassProject project(argv[1]);
+        project();
+
+        CSimulatedDigitizer sim;
+        for (size_t i = 0; i < project.m_boards.size(); i++) {
+            CSimulatedDigitizer::BoardConfig config;
+            config.s_serialNumber = i;
+            config.s_realTime     = false;
+            config.s_traceSamples = traceSamples;
+            config.s_startTick    = UINT64_C(0x7f000000);   // First rollover comes quickly.
+            config.s_seed         = i + 1;
+            for (int c = 0; c < CAEN_DGTZ_MAX_CHANNEL; c++) {
+                config.s_rate[c] = rate;
+            }
+            sim.addBoard(
+                project.m_connections[i].s_linkNum, project.m_connections[i].s_node, config
+            );
+        }
+
+        CDigitizerBackend* pBackend = &sim;
+        std::unique_ptr<CRecordingDigitizer> pRecorder;
+        if (!recordPrefix.empty()) {
+            pRecorder.reset(new CRecordingDigitizer(&sim, recordPrefix));
+            pBackend = pRecorder.get();
+        }
+
+        for (size_t i = 0; i < project.m_boards.size(); i++) {
+            CompassProject::ConnectionParameters& conn(project.m_connections[i]);
+            CAENPhaParameters& board(*project.m_boards[i]);
+            CAENPha driver(
+                board, conn.s_linkType, conn.s_linkNum, conn.s_node, conn.s_base,
+                board.s_startMode, true, board.startDelay, nullptr, pBackend
+            );
+            if (traceSamples) board.acqMode = 0;        // Mixed: hits carry traces.
+            driver.setAsyncReadout(asyncBlocks);
+            driver.setup();
+
+            uint64_t nRead      = 0;
+            uint64_t nDisorder  = 0;
+            uint64_t nSamples   = 0;
+            uint64_t lastStamp  = 0;
+            auto start = std::chrono::steady_clock::now();
+            while (nRead < nHits) {
+                if (!driver.haveData()) continue;
+                const CAEN_DGTZ_DPP_PHA_Waveforms_t* pWf = driver.waveforms();
+                if (!pWf) continue;
+                uint64_t stamp = driver.hits().timestamp();
+                if (stamp < lastStamp) nDisorder++;
+                lastStamp = stamp;
+                nSamples += pWf->Ns;
+                driver.next();
+                nRead++;
+            }
+            double seconds = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start
+            ).count();
+            driver.shutdown();
+
+            std::cout << "Board " << i << " (link " << conn.s_linkNum
+                      << " node " << conn.s_node << "): "
+                      << nRead << " hits in " << seconds << " s\n";
+            std::cout << "  " << nRead/seconds << " hits/s, "
+                      << 1.0e9*seconds/nRead << " ns/hit, "
+                      << nSamples/nRead << " samples/hit\n";
+            std::cout << "  Last timestamp " << lastStamp << " ns, "
+                      << nDisorder << " hits out of time order\n";
+            if (nDisorder) {
+                std::cerr << "Board " << i << " delivered hits out of time order!\n";
+                std::exit(EXIT_FAILURE);
+            }
+        }
+    }
+    catch (std::pair<std::string, int>& e) {
+        std::cerr << "Driver failed: " << e.first << " : " << e.second << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    catch (std::string& msg) {
+        std::cerr << "Failed: " << msg << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    catch (std::exception& e) {
+        std::cerr << "Failed: " << e.what() << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,188 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file dpptimealign.cpp
+# @brief Measure inter-board timestamp offsets from captures, write the table.
+
+*/
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <CDppEventDecoder.h>
+#include <CDppHitStore.h>
+#include <CTimeAligner.h>
+#include <CTimeOffsetTable.h>
+#include <DppCaptureFormat.h>
+
+/*  Each board's block capture (see CRecordingDigitizer), taken in the same
+    run, is loaded into a CDppHitStore to get the timestamps the readout
+    would give its hits.  One channel of each board should see the same
+    signals, e.g. a pulser fanned out to all of them.  The hits of those
+    channels are given to a CTimeAligner, the first board the reference, and
+    the offset that aligns each board with the reference written to a
+    CTimeOffsetTable for the event segments' setTimeOffsets.
+*/
+
+/**
+ * Usage
+ *    output program usage to cerr and exit.
+ */
+static
+void Usage()
+{
+    std::cerr << "Usage\n";
+    std::cerr << "   dpptimealign offsetfile window bin source:channel:capturefile...\n";
+    std::cerr << "     offsetfile   - Timestamp offset table to write.\n";
+    std::cerr << "     window       - Pair hits within +/- this many ns (e.g. 500).\n";
+    std::cerr << "     bin          - Time difference histogram bin width in ns (e.g. 2).\n";
+    std::cerr << "     source       - Source id of a board's event segment.\n";
+    std::cerr << "     channel      - Its channel that sees the common signal.\n";
+    std::cerr << "     capturefile  - Block capture of the board (.dppraw).\n";
+    std::cerr << "   The first board is the reference, at least two are needed.\n";
+
+    std::exit(EXIT_FAILURE);
+}
+/**
+ * Board
+ *    A board on the command line.
+ */
+struct Board {
+    int         s_sourceId;
+    int         s_channel;
+    std::string s_filename;
+};
+/**
+ * parseBoard
+ *    Parse source:channel:capturefile.
+ */
+static Board
+parseBoard(const char* spec)
+{
+    Board       result;
+    std::string s(spec);
+    size_t      c1 = s.find(':');
+    size_t      c2 = (c1 == std::string::npos) ? c1 : s.find(':', c1 + 1);
+    if (c2 == std::string::npos) Usage();
+    result.s_sourceId = strtol(s.substr(0, c1).c_str(), NULL, 0);
+    result.s_channel  = strtol(s.substr(c1 + 1, c2 - c1 - 1).c_str(), NULL, 0);
+    result.s_filename = s.substr(c2 + 1);
+    if ((result.s_channel < 0) || (result.s_channel >= CAEN_DGTZ_MAX_CHANNEL)) Usage();
+    return result;
+}
+/**
+ * loadTimestamps
+ *    Get the ns timestamps of a channel's hits in a capture file.
+ *
+ * @param board  - The board, channel and capture.
+ * @return std::vector<uint64_t> - the timestamps.
+ */
+static std::vector<uint64_t>
+loadTimestamps(const Board& board)
+{
+    std::ifstream in(board.s_filename.c_str(), std::ios::in | std::ios::binary);
+    DppCapture::FileHeader header;
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in || (header.s_magic != DppCapture::MAGIC) || (header.s_version != DppCapture::VERSION)) {
+        throw std::string("Not a capture file: ") + board.s_filename;
+    }
+    std::vector<char> infoBytes(header.s_infoSize);
+    in.read(infoBytes.data(), infoBytes.size());
+    CAEN_DGTZ_BoardInfo_t info;
+    memset(&info, 0, sizeof(info));
+    memcpy(&info, infoBytes.data(), std::min(infoBytes.size(), sizeof(info)));
+
+    CDppHitStore hits(
+        CDppEventDecoder::isPsd(info), (info.FamilyCode == CAEN_DGTZ_XX730_FAMILY_CODE) ? 2 : 4
+    );
+    std::vector<uint64_t>   result;
+    DppCapture::BlockHeader block;
+    std::vector<char>       data;
+    while (in.read(reinterpret_cast<char*>(&block), sizeof(block))) {
+        data.resize(block.s_nBytes);
+        if (!in.read(data.data(), data.size())) break;
+        if (hits.load(data.data(), data.size()) != CAEN_DGTZ_Success) {
+            throw std::string("Undecodable block in ") + board.s_filename;
+        }
+        const DppHitColumns& c(hits.columns(board.s_channel));
+        const uint64_t*      ps = hits.timestamps(board.s_channel);
+        for (uint32_t i = 0; i < c.s_nHits; i++) {
+            result.push_back(ps[i]/CTimestampUnwrapper::PS_PER_NS);
+        }
+    }
+    return result;
+}
+/**
+ * main
+ */
+int
+main(int argc, char** argv)
+{
+    if (argc < 6) Usage();
+
+    CTimeAligner::Settings settings;
+    settings.s_windowNs = strtoul(argv[2], NULL, 0);
+    settings.s_binNs    = strtoul(argv[3], NULL, 0);
+    if (!settings.s_windowNs || !settings.s_binNs) Usage();
+
+    try {
+        std::vector<Board> boards;
+        for (int i = 4; i < argc; i++) boards.push_back(parseBoard(argv[i]));
+
+        CTimeAligner aligner(settings);
+        for (size_t b = 0; b < boards.size(); b++) {
+            std::vector<uint64_t> stamps = loadTimestamps(boards[b]);
+            std::cout << "Source " << boards[b].s_sourceId << " channel " << boards[b].s_channel
+                      << ": " << stamps.size() << " hits\n";
+            for (size_t i = 0; i < stamps.size(); i++) {
+                if (b) {
+                    aligner.addHit(boards[b].s_sourceId, stamps[i]);
+                } else {
+                    aligner.addReference(stamps[i]);
+                }
+            }
+        }
+
+        CTimeOffsetTable table;
+        table.setOffset(boards[0].s_sourceId, 0);
+        std::ostringstream comment;
+        comment << "Written by dpptimealign, reference source " << boards[0].s_sourceId
+                << " channel " << boards[0].s_channel << ".\n";
+        bool ok = true;
+        for (size_t b = 1; b < boards.size(); b++) {
+            int                  id = boards[b].s_sourceId;
+            CTimeAligner::Result r  = aligner.fit(id);
+            if (!r.s_ok) {
+                std::cerr << "Source " << id << ": no coincidence peak in " << r.s_pairs
+                          << " pairs\n";
+                ok = false;
+                continue;
+            }
+            table.setOffset(id, CTimeAligner::offset(r));
+            std::ostringstream line;
+            line << "Source " << id << " channel " << boards[b].s_channel << ": peak at "
+                 << r.s_peakNs << "ns sigma " << r.s_sigmaNs << "ns, " << r.s_peakCounts
+                 << " counts over " << r.s_background << " background";
+            std::cout << line.str() << " -> offset " << CTimeAligner::offset(r) << "ns\n";
+            comment << line.str() << '\n';
+        }
+        table.write(argv[1], comment.str());
+        std::cout << "Wrote " << argv[1] << std::endl;
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    catch (std::string msg) {
+        std::cerr << msg << std::endl;
+    }
+    return EXIT_FAILURE;
+}
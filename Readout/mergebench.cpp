@@ -0,0 +1,173 @@
+ /**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+
+##
+# @file mergebench.cpp
+# @brief Time the heap merger against the linear channel scan the drivers used.
+
+*/
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <chrono>
+#include <stdint.h>
+#include <CTimeOrderedMerger.h>
+
+/*  The drivers buffer up to a few hundred hits per channel from each block
+    transfer.  We simulate that with per channel time ordered stamps
+    with random spacings and then deliver them in time order both ways.
+*/
+
+typedef std::vector<std::vector<uint64_t> > HitBuffer;
+
+/**
+ * Usage
+ *    output program usage to cerr and exit.
+ */
+static
+void Usage()
+{
+    std::cerr << "Usage\n";
+    std::cerr << "   mergebench [nchannels [hitsPerChannel [repeats]]]\n";
+    std::cerr << "     nchannels      - Number of hit sources (default 16).\n";
+    std::cerr << "     hitsPerChannel - Hits buffered per source (default 256).\n";
+    std::cerr << "     repeats        - Number of buffers merged (default 1000).\n";
+
+    std::exit(EXIT_FAILURE);
+}
+/**
+ * makeHits
+ *    Produce a buffer of time ordered hits in each channel.
+ *
+ * @param nChans - number of channels.
+ * @param nHits  - hits per channel.
+ * @return HitBuffer
+ */
+static HitBuffer
+makeHits(unsigned nChans, unsigned nHits)
+{
+    HitBuffer result(nChans);
+    for (unsigned c = 0; c < nChans; c++) {
+        uint64_t stamp = std::rand() % 1000;
+        for (unsigned h = 0; h < nHits; h++) {
+            stamp += 1 + std::rand() % 2000;
+            result[c].push_back(stamp);
+        }
+    }
+    return result;
+}
+/**
+ * scanMerge
+ *    Deliver the hits the way findEarliest/oldestChannel did: a scan of
+ *    all channels per hit.
+ *
+ * @param hits - the buffered hits.
+ * @return uint64_t - checksum of the delivery order.
+ */
+static uint64_t
+scanMerge(const HitBuffer& hits)
+{
+    std::vector<size_t> offsets(hits.size(), 0);
+    uint64_t sum = 0;
+    uint64_t n   = 0;
+    for (;;) {
+        uint64_t lowest   = UINT64_MAX;
+        size_t   earliest = hits.size();
+        for (size_t c = 0; c < hits.size(); c++) {
+            if (offsets[c] < hits[c].size()) {
+                uint64_t tag = hits[c][offsets[c]];
+                if (tag < lowest) {
+                    lowest   = tag;
+                    earliest = c;
+                }
+            }
+        }
+        if (earliest == hits.size()) break;
+        offsets[earliest]++;
+        sum += (++n) * earliest;
+    }
+    return sum;
+}
+/**
+ * heapMerge
+ *    Deliver the hits using CTimeOrderedMerger.
+ *
+ * @param hits   - the buffered hits.
+ * @param merger - merger to use (re-used to avoid allocation as the drivers do).
+ * @return uint64_t - checksum of the delivery order.
+ */
+static uint64_t
+heapMerge(const HitBuffer& hits, CTimeOrderedMerger<unsigned>& merger)
+{
+    std::vector<size_t> offsets(hits.size(), 0);
+    uint64_t sum = 0;
+    uint64_t n   = 0;
+    merger.clear();
+    for (unsigned c = 0; c < hits.size(); c++) {
+        if (!hits[c].empty()) merger.push(hits[c][0], c);
+    }
+    while (!merger.empty()) {
+        unsigned c = merger.top();
+        offsets[c]++;
+        sum += (++n) * c;
+        if (offsets[c] < hits[c].size()) {
+            merger.replaceTop(hits[c][offsets[c]]);
+        } else {
+            merger.pop();
+        }
+    }
+    return sum;
+}
+
+/**
+ * main
+ *    Entry point.
+ */
+int main(int argc, char** argv)
+{
+    unsigned nChans   = 16;
+    unsigned nHits    = 256;
+    unsigned nRepeats = 1000;
+    if (argc > 4) Usage();
+    if (argc > 1) nChans   = strtoul(argv[1], NULL, 0);
+    if (argc > 2) nHits    = strtoul(argv[2], NULL, 0);
+    if (argc > 3) nRepeats = strtoul(argv[3], NULL, 0);
+    if (!nChans || !nHits || !nRepeats) Usage();
+
+    HitBuffer hits = makeHits(nChans, nHits);
+    CTimeOrderedMerger<unsigned> merger;
+    merger.reserve(nChans);
+
+    // The two must deliver in the same order:
+
+    if (scanMerge(hits) != heapMerge(hits, merger)) {
+        std::cerr << "Heap and scan merges delivered hits in different orders!\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    uint64_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < nRepeats; i++) checksum += scanMerge(hits);
+    auto scanTime = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < nRepeats; i++) checksum -= heapMerge(hits, merger);
+    auto heapTime = std::chrono::steady_clock::now() - start;
+
+    double nTotal = double(nChans) * nHits * nRepeats;
+    double scanNs = std::chrono::duration<double, std::nano>(scanTime).count();
+    double heapNs = std::chrono::duration<double, std::nano>(heapTime).count();
+
+    std::cout << nChans << " channels, " << nHits << " hits/channel, "
+              << nRepeats << " buffers (checksum " << checksum << ")\n";
+    std::cout << "  Linear scan : " << scanNs/nTotal << " ns/hit\n";
+    std::cout << "  Heap merge  : " << heapNs/nTotal << " ns/hit\n";
+
+    std::exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,336 @@
+/**
+#******************************************************************************
+#
+# Via Vetraia, 11 - 55049 - Viareggio ITALY
+# +390594388398 - www.caen.it
+#
+#***************************************************************************//**
+#
+##
+# @file tracepackbench.cpp
+# @brief Measure trace packing (DppTraceCodec.h) on the hits of event files.
+
+*/
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <stdint.h>
+#include <DppFragmentFormat.h>
+#include <DppBulkFormat.h>
+
+/*  The physics events of NSCLDAQ event files - Readout's own or built by
+    the event builder - are walked for PHA and PSD hit records (single
+    hit and bulk events).  Every hit that carries traces has them packed
+    as setTracePacking would, unpacked again and compared.  Then packing
+    and unpacking all the traces are timed and compared with copying them.
+
+    Single hit events don't say their firmware; a record is taken to be
+    PSD if its trace bytes field agrees with its size.
+*/
+
+namespace {
+    const uint32_t PHYSICS_EVENT = 30;
+
+    struct HitTraces {
+        uint32_t              s_samples;
+        bool                  s_dual;
+        std::vector<uint16_t> s_trace1;
+        std::vector<uint16_t> s_trace2;
+    };
+    struct Totals {
+        uint64_t s_events;
+        uint64_t s_eventBytes;
+        uint64_t s_hits;
+        uint64_t s_packedHits;              // Already packed by the readout.
+    };
+}
+
+/**
+ * Usage
+ *    output program usage to cerr and exit.
+ */
+static
+void Usage()
+{
+    std::cerr << "Usage\n";
+    std::cerr << "   tracepackbench evtfile... [-r repeats]\n";
+    std::cerr << "     evtfile  - Event files, Readout's or the event builder's.\n";
+    std::cerr << "     repeats  - Times to pack/unpack the traces when timing (default 10).\n";
+
+    std::exit(EXIT_FAILURE);
+}
+/**
+ * isPsd
+ *    Guess the firmware of a single hit event's record.
+ */
+static bool
+isPsd(const uint8_t* pRecord, size_t nBytes)
+{
+    DppFragment::PsdView psd(pRecord);
+    return psd.isEvent(nBytes) &&
+        (psd.traceBytes() == nBytes - DppFragment::Psd::TraceBytes::offset);
+}
+/**
+ * segmentBody
+ *    Collect the hits of one segment's event body: a longword of 16 bit
+ *    words then a single hit record or a bulk event.
+ */
+static void
+segmentBody(const uint8_t* p, size_t nBytes, std::vector<HitTraces>& traces, Totals& totals)
+{
+    if (nBytes < 2*sizeof(uint32_t)) return;
+    p      += sizeof(uint32_t);
+    nBytes -= sizeof(uint32_t);
+
+    auto take = [&](bool psd, const uint8_t* pRecord, size_t available) {
+        HitTraces t;
+        uint32_t  samples = 0;
+        if (psd) {
+            DppFragment::PsdView hit(pRecord);
+            if (hit.hasTraces() && (hit.bytes() >= DppFragment::Psd::TRACE_BYTES)) {
+                samples = hit.samples();
+                t.s_dual = hit.dualTrace();
+            }
+            totals.s_hits++;
+            if (!samples) return;
+            if (hit.packed()) totals.s_packedHits++;
+            t.s_samples = samples;
+            t.s_trace1.resize(samples);
+            t.s_trace2.resize(t.s_dual ? samples : 0);
+            if (hit.traces(t.s_trace1.data(), t.s_trace2.data())) traces.push_back(t);
+        } else {
+            DppFragment::PhaView hit(pRecord);
+            if (available >= DppFragment::Pha::HEADER_BYTES) {
+                samples  = hit.samples();
+                t.s_dual = hit.dualTrace();
+            }
+            totals.s_hits++;
+            if (!samples) return;
+            if (hit.packed()) totals.s_packedHits++;
+            t.s_samples = samples;
+            t.s_trace1.resize(samples);
+            t.s_trace2.resize(t.s_dual ? samples : 0);
+            if (hit.traces(t.s_trace1.data(), t.s_trace2.data(), available)) traces.push_back(t);
+        }
+    };
+
+    if (DppBulk::isBulk(p)) {
+        DppBulk::Header header;
+        if (nBytes < sizeof(header)) return;
+        memcpy(&header, p, sizeof(header));
+        const uint8_t* pHit = p + sizeof(header);
+        const uint8_t* pEnd = p + std::min<size_t>(header.s_nBytes, nBytes);
+        for (uint32_t i = 0; (i < header.s_nHits) && (pHit + sizeof(uint32_t) <= pEnd); i++) {
+            uint32_t bytes = DppBulk::recordBytes(header.s_firmware, pHit);
+            if (!bytes || (bytes > size_t(pEnd - pHit))) break;
+            take(header.s_firmware == DppBulk::PSD, pHit, bytes);
+            pHit += bytes;
+        }
+    } else {
+        take(isPsd(p, nBytes), p, nBytes);
+    }
+}
+/**
+ * physicsBody
+ *    Collect the hits of a physics event body.  A built event starts with
+ *    its size in bytes, then fragments each holding a ring item; one from
+ *    Readout with its size in 16 bit words.
+ */
+static void
+physicsBody(const uint8_t* p, size_t nBytes, std::vector<HitTraces>& traces, Totals& totals)
+{
+    uint32_t first;
+    if (nBytes < sizeof(first)) return;
+    memcpy(&first, p, sizeof(first));
+    if (first != nBytes) {
+        segmentBody(p, nBytes, traces, totals);
+        return;
+    }
+    const size_t FRAGMENT_HEADER = 20;          // Timestamp, source id, size, barrier.
+    const uint8_t* pFrag = p + sizeof(first);
+    const uint8_t* pEnd  = p + nBytes;
+    while (pFrag + FRAGMENT_HEADER <= pEnd) {
+        uint32_t payload;
+        memcpy(&payload, pFrag + 12, sizeof(payload));
+        const uint8_t* pItem = pFrag + FRAGMENT_HEADER;
+        if (payload > size_t(pEnd - pItem) || (payload < 3*sizeof(uint32_t))) break;
+
+        uint32_t bodyHeader;
+        memcpy(&bodyHeader, pItem + 2*sizeof(uint32_t), sizeof(bodyHeader));
+        size_t skip = 2*sizeof(uint32_t) + (bodyHeader ? bodyHeader : sizeof(uint32_t));
+        if (skip < payload) segmentBody(pItem + skip, payload - skip, traces, totals);
+        pFrag = pItem + payload;
+    }
+}
+/**
+ * loadFile
+ *    Collect the traces of the hits in an event file.
+ */
+static void
+loadFile(const std::string& filename, std::vector<HitTraces>& traces, Totals& totals)
+{
+    std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!in) throw std::string("Unable to open ") + filename;
+
+    std::vector<uint8_t> item;
+    uint32_t header[2];
+    while (in.read(reinterpret_cast<char*>(header), sizeof(header))) {
+        if (header[0] < sizeof(header)) throw std::string("Bad ring item in ") + filename;
+        item.resize(header[0] - sizeof(header));
+        if (!in.read(reinterpret_cast<char*>(item.data()), item.size())) break;
+        if ((header[1] != PHYSICS_EVENT) || (item.size() < sizeof(uint32_t))) continue;
+
+        uint32_t bodyHeader;
+        memcpy(&bodyHeader, item.data(), sizeof(bodyHeader));
+        size_t skip = bodyHeader ? bodyHeader : sizeof(uint32_t);
+        if (skip >= item.size()) continue;
+        totals.s_events++;
+        totals.s_eventBytes += item.size() + sizeof(header);
+        physicsBody(item.data() + skip, item.size() - skip, traces, totals);
+    }
+}
+/**
+ * describe
+ *    The Traces of a hit.
+ */
+static DppFragment::Traces
+describe(const HitTraces& t)
+{
+    DppFragment::Traces result;
+    result.s_samples     = t.s_samples;
+    result.s_dual        = t.s_dual;
+    result.s_probe       = 0;
+    result.s_trace1      = t.s_trace1.data();
+    result.s_trace2      = t.s_trace2.data();
+    result.s_packed      = nullptr;
+    result.s_packedBytes = 0;
+    result.s_features    = nullptr;
+    result.s_fineTime    = false;
+    result.s_picoseconds = 0;
+    return result;
+}
+/**
+ * main
+ *    Entry point.
+ */
+int main(int argc, char** argv)
+{
+    std::vector<std::string> files;
+    unsigned repeats = 10;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "-r") {
+            if (++i == argc) Usage();
+            repeats = strtoul(argv[i], NULL, 0);
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty()) Usage();
+
+    try {
+        std::vector<HitTraces> traces;
+        Totals totals = {0, 0, 0, 0};
+        for (size_t i = 0; i < files.size(); i++) {
+            loadFile(files[i], traces, totals);
+        }
+        std::cout << totals.s_events << " events (" << totals.s_eventBytes << " bytes), "
+                  << totals.s_hits << " hits, " << traces.size() << " with traces ("
+                  << totals.s_packedHits << " already packed)\n";
+        if (traces.empty()) {
+            std::cout << "  Nothing to pack - record with waveforms enabled.\n";
+            return EXIT_SUCCESS;
+        }
+
+        // Pack, unpack and compare:
+
+        std::vector<uint8_t>  scratch;
+        std::vector<uint16_t> trace1, trace2;
+        uint64_t rawBytes = 0, packedBytes = 0, samples = 0, nBad = 0, nUnpacked = 0;
+        for (size_t i = 0; i < traces.size(); i++) {
+            const HitTraces&    t(traces[i]);
+            DppFragment::Traces d = describe(t);
+            scratch.resize(DppFragment::maxPackedBytes(d));
+            DppFragment::pack(d, scratch.data());
+
+            rawBytes    += DppFragment::sampleBytes(d);
+            packedBytes += DppFragment::dataBytes(d);
+            samples     += t.s_samples * (t.s_dual ? 2 : 1);
+            if (!d.s_packedBytes) {
+                nUnpacked++;
+                continue;
+            }
+            trace1.resize(t.s_samples);
+            trace2.resize(t.s_samples);
+            const uint8_t* p = static_cast<const uint8_t*>(d.s_packed);
+            if (!DppFragment::getSamples(
+                    trace1.data(), trace2.data(), t.s_samples, DppFragment::traceFlags(d),
+                    p, p + d.s_packedBytes) ||
+                (trace1 != t.s_trace1) ||
+                (t.s_dual && (trace2 != t.s_trace2))) {
+                nBad++;
+            }
+        }
+        std::cout << "  Traces: " << rawBytes << " bytes, packed " << packedBytes
+                  << " (" << double(rawBytes)/packedBytes << " to 1), "
+                  << nUnpacked << " left unpacked, " << nBad << " differences\n";
+        std::cout << "  Events: " << totals.s_eventBytes << " bytes, about "
+                  << totals.s_eventBytes - (rawBytes - packedBytes) << " packed\n";
+
+        // Time packing, unpacking and, for reference, copying:
+
+        std::vector<DppFragment::Traces> packed(traces.size());
+        std::vector<std::vector<uint8_t>> buffers(traces.size());
+        for (size_t i = 0; i < traces.size(); i++) {
+            packed[i] = describe(traces[i]);
+            buffers[i].resize(DppFragment::maxPackedBytes(packed[i]));
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned r = 0; r < repeats; r++) {
+            for (size_t i = 0; i < traces.size(); i++) {
+                packed[i] = describe(traces[i]);
+                DppFragment::pack(packed[i], buffers[i].data());
+            }
+        }
+        double packSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        for (unsigned r = 0; r < repeats; r++) {
+            for (size_t i = 0; i < traces.size(); i++) {
+                const DppFragment::Traces& d(packed[i]);
+                const uint8_t* p = static_cast<const uint8_t*>(d.s_packedBytes ? d.s_packed : d.s_trace1);
+                size_t         n = DppFragment::dataBytes(d);
+                DppFragment::getSamples(
+                    trace1.data(), trace2.data(), d.s_samples, DppFragment::traceFlags(d), p, p + n
+                );
+            }
+        }
+        double unpackSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        for (unsigned r = 0; r < repeats; r++) {
+            for (size_t i = 0; i < traces.size(); i++) {
+                const HitTraces& t(traces[i]);
+                memcpy(trace1.data(), t.s_trace1.data(), t.s_samples*sizeof(uint16_t));
+                if (t.s_dual) memcpy(trace2.data(), t.s_trace2.data(), t.s_samples*sizeof(uint16_t));
+            }
+        }
+        double copySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        double total = double(samples)*repeats;
+        std::cout << "  Pack:   " << 1.0e9*packSeconds/total << " ns/sample, "
+                  << total/packSeconds/1.0e6 << " Msamples/s\n";
+        std::cout << "  Unpack: " << 1.0e9*unpackSeconds/total << " ns/sample, "
+                  << total/unpackSeconds/1.0e6 << " Msamples/s\n";
+        std::cout << "  Copy:   " << 1.0e9*copySeconds/total << " ns/sample\n";
+        return nBad ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+    catch (std::string msg) {
+        std::cerr << msg << std::endl;
+    }
+    return EXIT_FAILURE;
+}
@@ -22,6 +22,7 @@
  sbalak2@lsu.edu, Aug-Sep 2020 */
 
 #include "CPHAFragmentHandler.h"
+#include "DppBulkFormat.h"
 #include "FragmentIndex.h"
 #include <iostream>
 #include <string>
@@ -58,62 +59,95 @@ CPHAFragmentHandler::operator()(FragmentInfo& frag)
   auto end = p+*p;
     
 
-  uint16_t temp1, temp2, temp3, temp4; //Temporary words to store data
-  uint32_t Energy, channelNum; //Temporary variables to be made into a std::pair for ease-of-access by CRawUnpacker.cpp
-  auto iter = p; //Start with parsing        
-
-  if (iter<end) {
-	temp1 = *iter++;
-	temp1 = *iter++;
-
-	temp1 = *iter++; //Will be 001a typically - the size of event
-	temp2 = *iter++; //Will be 0000 - the padded zeros usually
-	event.size = temp1+0x10000*temp2; //Store it in the size variable
-	//std::cout << "\t" << event.size;
-	temp1 = *iter++; //Channel number
-	temp2 = *iter++; // Padded zeros
-	channelNum = temp1+0x10000*temp2  + 16*frag.s_sourceId; //Store channelnumber
-	//std::cout << "\t" << channelNum;
-	temp1 = *iter++; //Time stamp bits 0-3
-	temp2 = *iter++; // TS 4-7
-	temp3 = *iter++; // TS 8-11
-	temp4 = *iter++; // TS 12-15
-	event.timeStamp &= 0x0000000000000000;
-	event.timeStamp |=  temp4 ; 
-	event.timeStamp = event.timeStamp<<16;
-	event.timeStamp |= temp3;
-	event.timeStamp = event.timeStamp<<16;
-	event.timeStamp |= temp2;
-	event.timeStamp = event.timeStamp<<16;
-	event.timeStamp |= temp1;
-	//std::cout << "\t" << event.timeStamp;
-
-	temp1 = *iter++; 
-	temp2 = *iter++; 
-	Energy = temp1+0x10000*temp2; //Store energy in temp variable
-	//std::cout << "\t";
-	//std::cout << "\t" << Energy;
-	temp1 = *iter++; 
-	temp2 = *iter++; 
-	event.Extras = temp1+0x10000*temp2;
-	//std::cout << "\t" << event.Extras;
-	temp1 = *iter++;
+  // A bulk event (all hits from a digitizer read) can be bigger than
+  // the low 16 bits of the size can say, so check for one first.
 
-	//Write the channel-number and data to the pair s_data
-        event.s_data.first = channelNum;
-        event.s_data.second = Energy;
+  if (DppBulk::isBulk(p + 2)) {
+    parseBulk(p + 2, frag);
+    return;
+  }
 
-	event.firmwareType = DppEvent::PHA;
-  } else {
+  if ((end - p) <= 2) {              // Nothing after Readout's event size.
     std::string errmsg("CRawPHAUnpacker::parseEvent() ");
     errmsg += "Incomplete event found in buffer.";
     throw std::runtime_error(errmsg);
   }
-  if((iter < end)||(iter>end)){
+  DppFragment::PhaView hit(p + 2);
+  if (!hit.isEvent((end - (p + 2))*sizeof(std::uint16_t))) {
     std::string errmsg("CRawPHAUnpacker::parseEvent() ");
     errmsg += "Incorrect event size";
     throw std::runtime_error(errmsg);
 	}
+  parseHit(hit, hit.size(), frag);
+  hits.assign(1, event);
+}
+/**
+ * parseHit
+ *    Parse one hit record (see DppFragmentFormat.h) into event.
+ *
+ *  @param hit       - the hit's record.
+ *  @param available - bytes of it that are there (a single hit event is cut off).
+ *  @param frag      - the fragment the hit is in.
+ */
+void
+CPHAFragmentHandler::parseHit(const DppFragment::PhaView& hit, size_t available, FragmentInfo& frag)
+{
+	event.size      = hit.size();
+	event.timeStamp = hit.timestamp();
+	event.Picoseconds = hit.picoseconds(available);
+	event.Extras    = hit.extras2();
+
+	//Write the channel-number and data to the pair s_data
+        event.s_data.first = hit.channel()  + 16*frag.s_sourceId;
+        event.s_data.second = hit.energy() + 0x10000*hit.extras();
 
+	event.firmwareType = DppEvent::PHA;
 
+	// Traces, unpacked if need be.  Unpacked traces are never all in a
+	// single hit event (see DppFragmentFormat.h) so those are left out.
+
+	event.Trace1.clear();
+	event.Trace2.clear();
+	event.HasFeatures = hit.features(event.Features, available);
+	if ((available >= DppFragment::Pha::HEADER_BYTES) && hit.samples()) {
+	  event.Trace1.resize(hit.samples());
+	  event.Trace2.resize(hit.dualTrace() ? hit.samples() : 0);
+	  if (!hit.traces(event.Trace1.data(), event.Trace2.data(), available)) {
+	    if (hit.packed()) {
+	      std::string errmsg("CRawPHAUnpacker::parseHit() ");
+	      errmsg += "Bad packed traces.";
+	      throw std::runtime_error(errmsg);
+	    }
+	    event.Trace1.clear();
+	    event.Trace2.clear();
+	  }
+	}
+}
+/**
+ * parseBulk
+ *    Parse all of the hits in a bulk event (see DppBulkFormat.h) into hits.
+ *    event is left holding the last of them.
+ *
+ *  @param pBody - points to the bulk header.
+ *  @param frag  - the fragment the hits are in.
+ */
+void
+CPHAFragmentHandler::parseBulk(std::uint16_t* pBody, FragmentInfo& frag)
+{
+  DppBulk::Header* pHeader = reinterpret_cast<DppBulk::Header*>(pBody);
+  std::uint8_t*    pHit    = reinterpret_cast<std::uint8_t*>(pHeader + 1);
+  std::uint8_t*    pEnd    = reinterpret_cast<std::uint8_t*>(pHeader) + pHeader->s_nBytes;
+
+  hits.clear();
+  for (std::uint32_t i = 0; i < pHeader->s_nHits; i++) {
+    DppFragment::PhaView hit(pHit);
+    if ((pHit > pEnd) || !hit.fits(pEnd - pHit)) {
+      std::string errmsg("CRawPHAUnpacker::parseBulk() ");
+      errmsg += "Incomplete hit found in bulk event.";
+      throw std::runtime_error(errmsg);
+    }
+    parseHit(hit, hit.bytes(), frag);
+    hits.push_back(event);
+    pHit += hit.bytes();
+  }
 }
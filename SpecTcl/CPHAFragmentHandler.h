@@ -23,6 +23,7 @@
 #define CPHAFRAGMENTHANDLER_H
 
 #include "CDppFragmentHandler.h"
+#include "DppFragmentFormat.h"
 #include <map>
 #include <string>
 #include <cstdint>
@@ -37,6 +38,9 @@ public:
     CPHAFragmentHandler();
     void operator()(FragmentInfo& frag);
     void printEvent(FragmentInfo& frag);
+private:
+    void parseHit(const DppFragment::PhaView& hit, size_t available, FragmentInfo& frag);
+    void parseBulk(std::uint16_t* pBody, FragmentInfo& frag);
 };
 
 #endif
@@ -22,6 +22,7 @@
  sbalak2@lsu.edu, Aug-Sep 2020 */
 
 #include "CPSDFragmentHandler.h"
+#include "DppBulkFormat.h"
 #include "FragmentIndex.h"
 #include <string>
 #include <stdexcept>
@@ -53,76 +54,92 @@ CPSDFragmentHandler::operator()(FragmentInfo& frag)
    std::uint16_t* p = frag.s_itembody;
 
    auto end = p+*p;
-  //std::cout << "\t"<<frag.s_sourceId;
-  uint16_t temp1, temp2, temp3, temp4; //Temporary words to store data
-  uint32_t Energy, channelNum; //Temporary variables to be made into a std::pair for ease-of-access by CRawUnpacker.cpp
-
-  auto iter = p; //Start with parsing      
-  //iter = iter+12;        
-  if (iter<end) {
-	temp1 = *iter++;
-	temp1 = *iter++;
-
-	temp1 = *iter++; //Will be 0011 typically - the size of event	
-	temp2 = *iter++; //Will be 0000 - the padded zeros usually
-	event.size = temp1+0x10000*temp2; //Store it in the size variable
-
-
-	temp1 = *iter++; //Time stamp bits 0-3
-	temp2 = *iter++; // TS 4-7
-	temp3 = *iter++; // TS 8-11
-	temp4 = *iter++; // TS 12-15
-	event.timeStamp &= 0x0000000000000000;
-	event.timeStamp |=  temp4 ; 
-	event.timeStamp = event.timeStamp<<16;
-	event.timeStamp |= temp3;
-	event.timeStamp = event.timeStamp<<16;
-	event.timeStamp |= temp2;
-	event.timeStamp = event.timeStamp<<16;
-	event.timeStamp |= temp1;
-	//event.timeStamp*=2;
-
-	temp1 = *iter++; //Channel number
-	//temp2 = *iter++; // Padded zeros
-	channelNum = temp1+16*frag.s_sourceId;//+0x10000*temp2; //Store channelnumber
-
-
-	temp1 = *iter++; 
-	temp2 = *iter++; 
-	Energy = temp1+0x10000*temp2; //Store energy in temp variable
-	event.EShort = Energy;
-	
-	temp1 = *iter++; 
-	temp2 = *iter++; 
-	Energy = temp1+0x10000*temp2; //Store energy in temp variable
-
-	temp1 = *iter++; 
-	temp2 = *iter++; 
-	event.Extras = temp1+0x10000*temp2;
-
-	temp1 = *iter++; 
-	temp2 = *iter++; 
-	event.Extras2 = temp1+0x10000*temp2;
 
-	event.firmwareType = DppEvent::PSD;
-	//temp1 = *iter++;
-	//EOF1 = temp1;
-
-	//Write the channel-number and data to the pair s_data
-        event.s_data.first = channelNum;
-        event.s_data.second = Energy;
+  // A bulk event (all hits from a digitizer read) can be bigger than
+  // the low 16 bits of the size can say, so check for one first.
 
+  if (DppBulk::isBulk(p + 2)) {
+    parseBulk(p + 2, frag);
+    return;
+  }
 
-  } else {
+  if ((end - p) <= 2) {              // Nothing after Readout's event size.
     std::string errmsg("CRawPSDUnpacker::parseEvent() ");
     errmsg += "Incomplete event found in buffer.";
     throw std::runtime_error(errmsg);
   }
-
-  if((iter < end)||(iter>end)){
+  DppFragment::PsdView hit(p + 2);
+  if (!hit.isEvent((end - (p + 2))*sizeof(std::uint16_t))) {
     std::string errmsg("CRawPSDUnpacker::parseEvent() ");
     errmsg += "Incorrect event size";
     throw std::runtime_error(errmsg);
 	}
-    
+  parseHit(hit, frag);
+  hits.assign(1, event);
+}
+/**
+ * parseHit
+ *    Parse one hit record (see DppFragmentFormat.h) into event.
+ *
+ *  @param hit  - the hit's record.
+ *  @param frag - the fragment the hit is in.
+ */
+void
+CPSDFragmentHandler::parseHit(const DppFragment::PsdView& hit, FragmentInfo& frag)
+{
+	event.size      = hit.size();
+	event.timeStamp = hit.timestamp();
+	event.Picoseconds = hit.picoseconds();
+	event.EShort    = hit.chargeShort();
+	event.Extras    = hit.extras();
+	event.Extras2   = hit.traceBytes();
+
+	event.firmwareType = DppEvent::PSD;
+
+	// Traces, unpacked if need be:
+
+	event.Trace1.clear();
+	event.Trace2.clear();
+	event.HasFeatures = hit.features(event.Features);
+	if (hit.hasTraces()) {
+	  event.Trace1.resize(hit.samples());
+	  event.Trace2.resize(hit.dualTrace() ? hit.samples() : 0);
+	  if (!hit.traces(event.Trace1.data(), event.Trace2.data())) {
+	    std::string errmsg("CRawPSDUnpacker::parseHit() ");
+	    errmsg += "Incomplete traces.";
+	    throw std::runtime_error(errmsg);
+	  }
+	}
+
+	//Write the channel-number and data to the pair s_data
+        event.s_data.first = hit.channel()+16*frag.s_sourceId;
+        event.s_data.second = hit.chargeLong();
+}
+/**
+ * parseBulk
+ *    Parse all of the hits in a bulk event (see DppBulkFormat.h) into hits.
+ *    event is left holding the last of them.
+ *
+ *  @param pBody - points to the bulk header.
+ *  @param frag  - the fragment the hits are in.
+ */
+void
+CPSDFragmentHandler::parseBulk(std::uint16_t* pBody, FragmentInfo& frag)
+{
+  DppBulk::Header* pHeader = reinterpret_cast<DppBulk::Header*>(pBody);
+  std::uint8_t*    pHit    = reinterpret_cast<std::uint8_t*>(pHeader + 1);
+  std::uint8_t*    pEnd    = reinterpret_cast<std::uint8_t*>(pHeader) + pHeader->s_nBytes;
+
+  hits.clear();
+  for (std::uint32_t i = 0; i < pHeader->s_nHits; i++) {
+    DppFragment::PsdView hit(pHit);
+    if ((pHit > pEnd) || !hit.fits(pEnd - pHit)) {
+      std::string errmsg("CRawPSDUnpacker::parseBulk() ");
+      errmsg += "Incomplete hit found in bulk event.";
+      throw std::runtime_error(errmsg);
+    }
+    parseHit(hit, frag);
+    hits.push_back(event);
+    pHit += hit.bytes();
+  }
 }
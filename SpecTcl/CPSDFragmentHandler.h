@@ -23,6 +23,7 @@
 #define CPSDFRAGMENTHANDLER_H
 
 #include "CDppFragmentHandler.h"
+#include "DppFragmentFormat.h"
 
 #include <map>
 #include <string>
@@ -38,6 +39,9 @@ public:
     CPSDFragmentHandler();
     void operator()(FragmentInfo& frag);
     void printEvent(FragmentInfo& frag);
+private:
+    void parseHit(const DppFragment::PsdView& hit, FragmentInfo& frag);
+    void parseBulk(std::uint16_t* pBody, FragmentInfo& frag);
 };
 
 #endif
@@ -58,6 +58,14 @@ CRawUnpacker::operator()(const Address_t pEvent,
     
     decoder.registerFragmentHandler(62, &psdhandler);
     decoder.registerFragmentHandler(58, &phahandler);
+    decoder.registerFragmentHandler(100, &psdhandler);  // Features, no traces.
+    decoder.registerFragmentHandler(94, &phahandler);
+    decoder.registerFragmentHandler(70, &psdhandler);   // With fine time (setFineTimestamps).
+    decoder.registerFragmentHandler(64, &phahandler);
+    decoder.registerFragmentHandler(102, &psdhandler);  // Fine time and features.
+    decoder.registerFragmentHandler(96, &phahandler);
+    decoder.registerBulkHandler(DppEvent::PSD, &psdhandler);
+    decoder.registerBulkHandler(DppEvent::PHA, &phahandler);
     decoder.registerEndHandler(&endhandler);
 
     try {
@@ -69,10 +77,9 @@ CRawUnpacker::operator()(const Address_t pEvent,
 	 {
 		DppEvent event = events[i];
 		m_values[event.s_data.first] = event.s_data.second;
-		if(event.firmwareType == DppEvent::PSD && (event.Extras2&0x4))
-			m_timestamps[event.s_data.first] = event.timeStamp + (event.Extras&0x1ff)*2*1e-3;			
-		else 
-			m_timestamps[event.s_data.first] = event.timeStamp;
+		// The readout folds the fine time into timeStamp itself and
+		// records the ps that leaves out (see DppFragmentFormat.h):
+		m_timestamps[event.s_data.first] = event.timeStamp + event.Picoseconds*1e-3;
 	 }
          delete pRingItem;
     	}
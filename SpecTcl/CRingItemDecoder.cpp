@@ -35,7 +35,8 @@
 #include <DataFormat.h>           // Defines the ring item types.
 // Fragment index provides iterator functionality on the fragments of a
 // built event.
-#include "FragmentIndex.h"         
+#include "FragmentIndex.h"
+#include "DppBulkFormat.h"         
 #include <iostream>
 
 /**
@@ -68,6 +69,21 @@ CRingItemDecoder::registerFragmentHandler(std::uint32_t sourceId, CFragmentHandl
     m_fragmentHandlers[sourceId] = pHandler;    
 }
 
+/**
+ * registerBulkHandler
+ *    Register the handler for bulk fragments (see DppBulkFormat.h) from a
+ *    firmware type.  These can't be registered by size as their size varies.
+ *
+ * @param firmware - DppEvent::PHA or DppEvent::PSD.
+ * @param pHandler - Pointer to the handler.  The caller is responsible for
+ *                   storage management.
+ */
+void
+CRingItemDecoder::registerBulkHandler(DppEvent::type firmware, CFragmentHandler* pHandler)
+{
+    m_bulkHandlers[firmware] = pHandler;
+}
+
 /**
  * registerEndHandler
  *    Registers a handler that's invoked after all fragments of an event
@@ -152,11 +168,13 @@ CRingItemDecoder::decodePhysicsEvent(CPhysicsEventItem* pItem)
     for (size_t i = 0; i < nFrags; i++) {
         FragmentInfo f = iterator.getFragment(i);
         //std::cout << "\nns_size:" << f.s_size << " sid:" << f.s_sourceId;  
-        CDppFragmentHandler *h = dynamic_cast<CDppFragmentHandler*>(m_fragmentHandlers[f.s_size]);
+        CDppFragmentHandler *h = findHandler(f.s_size, f.s_itembody);
         if (h)
 	{
 	  (*h)(f); // Invoke the fragment handler if it exists.
-	  events.push_back(h->getEvent());
+	  for (const DppEvent& hit : h->getEvents()) {
+	    events.push_back(hit);
+	  }
 	}
         
     }
@@ -180,4 +198,27 @@ CRingItemDecoder::decodeOtherItems(CRingItem* pItem)
     std::cout << pItem->type() << std::endl;
 }
 
-
+/**
+ * findHandler
+ *    Find the handler for a fragment.  Single hit fragments are recognized
+ *    by their size.  Bulk fragments (see DppBulkFormat.h) vary in size and are
+ *    instead recognized by their marker and handled by firmware type.
+ *
+ * @param size  - the fragment's size.
+ * @param pBody - the fragment's body (starts with Readout's event size).
+ * @return CDppFragmentHandler* - null if there's no handler for the fragment.
+ */
+CDppFragmentHandler*
+CRingItemDecoder::findHandler(std::uint32_t size, std::uint16_t* pBody)
+{
+    CFragmentHandler* pHandler;
+    if (DppBulk::isBulk(pBody + 2)) {
+        const DppBulk::Header* pHeader = reinterpret_cast<const DppBulk::Header*>(pBody + 2);
+        pHandler = m_bulkHandlers[
+            (pHeader->s_firmware == DppBulk::PHA) ? DppEvent::PHA : DppEvent::PSD
+        ];
+    } else {
+        pHandler = m_fragmentHandlers[size];
+    }
+    return dynamic_cast<CDppFragmentHandler*>(pHandler);
+}
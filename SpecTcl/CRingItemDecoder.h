@@ -61,6 +61,8 @@ private:
     // m_fragmentHandlers maps source ids to fragment handsler object pointers:
     
     std::map<std::uint32_t, CFragmentHandler*> m_fragmentHandlers;
+    // m_bulkHandlers maps firmware types to bulk fragment handlers:
+    std::map<DppEvent::type, CFragmentHandler*> m_bulkHandlers;
     
     std::vector<DppEvent> events;
     // m_endHandler, if registered is invoked at the end of a physics event
@@ -71,6 +73,7 @@ public:
     CRingItemDecoder();
     
     void registerFragmentHandler(std::uint32_t sourceId, CFragmentHandler* pHandler);
+    void registerBulkHandler(DppEvent::type firmware, CFragmentHandler* pHandler);
     void registerEndHandler(CEndOfEventHandler* pHandler);
     std::vector<DppEvent> operator()(CRingItem* pItem);
     // Handlers for ring item types:
@@ -78,6 +81,7 @@ public:
 protected:
     std::vector<DppEvent> decodePhysicsEvent(CPhysicsEventItem* pItem);
     void decodeOtherItems(CRingItem* pItem);
+    CDppFragmentHandler* findHandler(std::uint32_t size, std::uint16_t* pBody);
 };
 
 #endif